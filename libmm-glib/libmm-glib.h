@@ -48,8 +48,9 @@
 #if defined (_LIBMM_INSIDE_MM) ||    \
     defined (_LIBMM_INSIDE_MMCLI) || \
     defined (LIBMM_GLIB_COMPILATION)
-/* This one is not even installed */
+/* These ones are not even installed */
 # include <mm-common-helpers.h>
+# include <mm-nmea.h>
 #endif
 
 #include <mm-simple-status.h>
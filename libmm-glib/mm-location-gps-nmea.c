@@ -14,11 +14,10 @@
  */
 
 #include <string.h>
-#include <ctype.h>
-#include <stdlib.h>
 
 #include "mm-common-helpers.h"
 #include "mm-errors-types.h"
+#include "mm-nmea.h"
 #include "mm-location-gps-nmea.h"
 
 /**
@@ -36,81 +35,71 @@
 
 G_DEFINE_TYPE (MMLocationGpsNmea, mm_location_gps_nmea, G_TYPE_OBJECT);
 
+/* Enough for any NMEA address, including proprietary ones */
+#define TRACE_TYPE_MAX_LEN 31
+
 struct _MMLocationGpsNmeaPrivate {
     GHashTable *traces;
-    GRegex *sequence_regex;
 };
 
-/*****************************************************************************/
+/* The trace buffers are reused when newer sentences of the same type arrive */
+typedef struct {
+    GString *str;
+    /* Last message index appended, for sequences like GSV */
+    guint sequence_index;
+} Trace;
 
-static gboolean
-check_append_or_replace (MMLocationGpsNmea *self,
-                         const gchar *trace)
+static void
+trace_free (Trace *trace)
 {
-    /* By default, replace */
-    gboolean append_or_replace = FALSE;
-    GMatchInfo *match_info = NULL;
-
-    if (G_UNLIKELY (!self->priv->sequence_regex))
-        self->priv->sequence_regex = g_regex_new ("\\$GPGSV,(\\d),(\\d).*",
-                                                  G_REGEX_RAW | G_REGEX_OPTIMIZE,
-                                                  0,
-                                                  NULL);
-
-    if (g_regex_match (self->priv->sequence_regex, trace, 0, &match_info)) {
-        guint index;
-
-        /* If we don't have the first element of a sequence, append */
-        if (mm_get_uint_from_match_info (match_info, 2, &index) && index != 1)
-            append_or_replace = TRUE;
-    }
-    g_match_info_free (match_info);
-
-    return append_or_replace;
+    g_string_free (trace->str, TRUE);
+    g_slice_free (Trace, trace);
 }
 
-static gboolean
-location_gps_nmea_take_trace (MMLocationGpsNmea *self,
-                              gchar *trace)
-{
-    gchar *i;
-    gchar *trace_type;
+/*****************************************************************************/
 
-    i = strchr (trace, ',');
-    if (!i || i == trace)
+gboolean
+mm_location_gps_nmea_add_sentence (MMLocationGpsNmea *self,
+                                   const MMNmeaSentence *sentence)
+{
+    gchar trace_type[TRACE_TYPE_MAX_LEN + 1];
+    guint trace_type_len;
+    guint sequence_index = 0;
+    Trace *trace;
+
+    /* The trace type is the address, including the leading '$' */
+    trace_type_len = sentence->field_start[0] + sentence->field_len[0];
+    if (trace_type_len > TRACE_TYPE_MAX_LEN)
         return FALSE;
-
-    trace_type = g_malloc (i - trace + 1);
-    memcpy (trace_type, trace, i - trace);
-    trace_type[i - trace] = '\0';
+    memcpy (trace_type, sentence->trace, trace_type_len);
+    trace_type[trace_type_len] = '\0';
+
+    trace = g_hash_table_lookup (self->priv->traces, trace_type);
+    if (!trace) {
+        trace = g_slice_new (Trace);
+        trace->str = g_string_sized_new (sentence->len);
+        trace->sequence_index = 0;
+        g_hash_table_insert (self->priv->traces, g_strdup (trace_type), trace);
+    }
 
     /* Some traces are part of a SEQUENCE; so we need to decide whether we
      * completely replace the previous trace, or we append the new one to
-     * the already existing list */
-    if (check_append_or_replace (self, trace)) {
-        /* Append */
-        const gchar *previous;
-
-        previous = g_hash_table_lookup (self->priv->traces, trace_type);
-        if (previous) {
-            gchar *sequence;
-
-            /* Skip the trace if we already have it there */
-            if (strstr (previous, trace))
-                return TRUE;
-
-            sequence = g_strdup_printf ("%s%s%s",
-                                        previous,
-                                        g_str_has_suffix (previous, "\r\n") ? "" : "\r\n",
-                                        trace);
-            g_free (trace);
-            trace = sequence;
-        }
-    }
-
-    g_hash_table_replace (self->priv->traces,
-                          trace_type,
-                          trace);
+     * the already existing list. If we don't have the first element of a
+     * sequence, append. */
+    if (mm_nmea_sentence_is (sentence, "GSV") &&
+        mm_nmea_sentence_get_uint (sentence, 2, &sequence_index) &&
+        sequence_index > 1 &&
+        trace->str->len > 0) {
+        /* Skip the trace if we already have it there */
+        if (sequence_index <= trace->sequence_index)
+            return TRUE;
+
+        g_string_append_len (trace->str, "\r\n", 2);
+    } else
+        g_string_truncate (trace->str, 0);
+
+    g_string_append_len (trace->str, sentence->trace, sentence->len);
+    trace->sequence_index = sequence_index;
     return TRUE;
 }
 
@@ -118,7 +107,12 @@ gboolean
 mm_location_gps_nmea_add_trace (MMLocationGpsNmea *self,
                                 const gchar *trace)
 {
-    return location_gps_nmea_take_trace (self, g_strdup (trace));
+    MMNmeaSentence sentence;
+
+    if (!mm_nmea_sentence_parse (trace, &sentence))
+        return FALSE;
+
+    return mm_location_gps_nmea_add_sentence (self, &sentence);
 }
 
 /*****************************************************************************/
@@ -136,20 +130,22 @@ const gchar *
 mm_location_gps_nmea_get_trace (MMLocationGpsNmea *self,
                                 const gchar *trace_type)
 {
-    return (const gchar *)g_hash_table_lookup (self->priv->traces, trace_type);
+    Trace *trace;
+
+    trace = g_hash_table_lookup (self->priv->traces, trace_type);
+    return trace ? trace->str->str : NULL;
 }
 
 /*****************************************************************************/
 
 static void
 build_full_foreach (const gchar *trace_type,
-                    const gchar *trace,
+                    Trace *trace,
                     GString **built)
 {
-    if ((*built)->len == 0 || g_str_has_suffix ((*built)->str, "\r\n"))
-        g_string_append (*built, trace);
-    else
-        g_string_append_printf (*built, "\r\n%s", trace);
+    if ((*built)->len > 0)
+        g_string_append_len (*built, "\r\n", 2);
+    g_string_append_len (*built, trace->str->str, trace->str->len);
 }
 
 /**
@@ -221,14 +217,9 @@ mm_location_gps_nmea_new_from_string_variant (GVariant *string,
     /* Create new location object */
     self = mm_location_gps_nmea_new ();
 
-    for (i = 0; split[i]; i++) {
-        if (!location_gps_nmea_take_trace (self, split[i]))
-            g_free (split[i]);
-    }
-
-    /* Note that the strings in the array of strings were already taken
-     * or freed */
-    g_free (split);
+    for (i = 0; split[i]; i++)
+        mm_location_gps_nmea_add_trace (self, split[i]);
+    g_strfreev (split);
 
     return self;
 }
@@ -252,7 +243,7 @@ mm_location_gps_nmea_init (MMLocationGpsNmea *self)
     self->priv->traces = g_hash_table_new_full (g_str_hash,
                                                 g_str_equal,
                                                 g_free,
-                                                g_free);
+                                                (GDestroyNotify)trace_free);
 }
 
 static void
@@ -261,8 +252,6 @@ finalize (GObject *object)
     MMLocationGpsNmea *self = MM_LOCATION_GPS_NMEA (object);
 
     g_hash_table_destroy (self->priv->traces);
-    if (self->priv->sequence_regex)
-        g_regex_unref (self->priv->sequence_regex);
 
     G_OBJECT_CLASS (mm_location_gps_nmea_parent_class)->finalize (object);
 }
@@ -66,6 +66,8 @@ gchar *mm_location_gps_nmea_build_full (MMLocationGpsNmea *self);
     defined (_LIBMM_INSIDE_MMCLI) || \
     defined (LIBMM_GLIB_COMPILATION)
 
+#include "mm-nmea.h"
+
 MMLocationGpsNmea *mm_location_gps_nmea_new (void);
 MMLocationGpsNmea *mm_location_gps_nmea_new_from_string_variant (GVariant *string,
                                                                  GError **error);
@@ -73,6 +75,10 @@ MMLocationGpsNmea *mm_location_gps_nmea_new_from_string_variant (GVariant *strin
 gboolean mm_location_gps_nmea_add_trace (MMLocationGpsNmea *self,
                                          const gchar *trace);
 
+/* The sentence must have been parsed with mm_nmea_sentence_parse() */
+gboolean mm_location_gps_nmea_add_sentence (MMLocationGpsNmea *self,
+                                            const MMNmeaSentence *sentence);
+
 GVariant *mm_location_gps_nmea_get_string_variant (MMLocationGpsNmea *self);
 
 #endif
@@ -69,6 +69,8 @@ gdouble      mm_location_gps_raw_get_altitude  (MMLocationGpsRaw *self);
     defined (_LIBMM_INSIDE_MMCLI) || \
     defined (LIBMM_GLIB_COMPILATION)
 
+#include "mm-nmea.h"
+
 MMLocationGpsRaw *mm_location_gps_raw_new (void);
 MMLocationGpsRaw *mm_location_gps_raw_new_from_dictionary (GVariant *string,
                                                            GError **error);
@@ -76,6 +78,10 @@ MMLocationGpsRaw *mm_location_gps_raw_new_from_dictionary (GVariant *string,
 gboolean mm_location_gps_raw_add_trace (MMLocationGpsRaw *self,
                                         const gchar *trace);
 
+/* The sentence must have been parsed with mm_nmea_sentence_parse() */
+gboolean mm_location_gps_raw_add_sentence (MMLocationGpsRaw *self,
+                                           const MMNmeaSentence *sentence);
+
 GVariant *mm_location_gps_raw_get_dictionary (MMLocationGpsRaw *self);
 
 #endif
@@ -225,6 +225,107 @@ mm_modem_location_setup_sync (MMModemLocation *self,
 
 /*****************************************************************************/
 
+/**
+ * mm_modem_location_get_gps_streaming_interval:
+ * @self: A #MMModemLocation.
+ *
+ * Gets the minimum time between two GPS fixes streamed by the #MMModemLocation.
+ *
+ * Returns: the interval in milliseconds, or 0 if GPS fix streaming is disabled.
+ */
+guint
+mm_modem_location_get_gps_streaming_interval (MMModemLocation *self)
+{
+    g_return_val_if_fail (MM_IS_MODEM_LOCATION (self), 0);
+
+    return mm_gdbus_modem_location_get_gps_streaming_interval (MM_GDBUS_MODEM_LOCATION (self));
+}
+
+/*****************************************************************************/
+
+/**
+ * mm_modem_location_setup_gps_streaming_finish:
+ * @self: A #MMModemLocation.
+ * @res: The #GAsyncResult obtained from the #GAsyncReadyCallback passed to mm_modem_location_setup_gps_streaming().
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with mm_modem_location_setup_gps_streaming().
+ *
+ * Returns: %TRUE if the setup was successful, %FALSE if @error is set.
+ */
+gboolean
+mm_modem_location_setup_gps_streaming_finish (MMModemLocation *self,
+                                              GAsyncResult *res,
+                                              GError **error)
+{
+    g_return_val_if_fail (MM_IS_MODEM_LOCATION (self), FALSE);
+
+    return mm_gdbus_modem_location_call_setup_gps_streaming_finish (MM_GDBUS_MODEM_LOCATION (self), res, error);
+}
+
+/**
+ * mm_modem_location_setup_gps_streaming:
+ * @self: A #MMModemLocation.
+ * @interval: Minimum time between two streamed GPS fixes, in milliseconds, or 0 to disable streaming.
+ * @cancellable: (allow-none): A #GCancellable or %NULL.
+ * @callback: A #GAsyncReadyCallback to call when the request is satisfied or %NULL.
+ * @user_data: User data to pass to @callback.
+ *
+ * Asynchronously enables or disables the streaming of GPS fixes through the
+ * #MmGdbusModemLocation::gps-fix signal.
+ *
+ * When the operation is finished, @callback will be invoked in the <link linkend="g-main-context-push-thread-default">thread-default main loop</link> of the thread you are calling this method from.
+ * You can then call mm_modem_location_setup_gps_streaming_finish() to get the result of the operation.
+ *
+ * See mm_modem_location_setup_gps_streaming_sync() for the synchronous, blocking version of this method.
+ */
+void
+mm_modem_location_setup_gps_streaming (MMModemLocation *self,
+                                       guint interval,
+                                       GCancellable *cancellable,
+                                       GAsyncReadyCallback callback,
+                                       gpointer user_data)
+{
+    g_return_if_fail (MM_IS_MODEM_LOCATION (self));
+
+    mm_gdbus_modem_location_call_setup_gps_streaming (MM_GDBUS_MODEM_LOCATION (self),
+                                                      interval,
+                                                      cancellable,
+                                                      callback,
+                                                      user_data);
+}
+
+/**
+ * mm_modem_location_setup_gps_streaming_sync:
+ * @self: A #MMModemLocation.
+ * @interval: Minimum time between two streamed GPS fixes, in milliseconds, or 0 to disable streaming.
+ * @cancellable: (allow-none): A #GCancellable or %NULL.
+ * @error: Return location for error or %NULL.
+ *
+ * Synchronously enables or disables the streaming of GPS fixes through the
+ * #MmGdbusModemLocation::gps-fix signal.
+ *
+ * The calling thread is blocked until a reply is received. See mm_modem_location_setup_gps_streaming()
+ * for the asynchronous version of this method.
+ *
+ * Returns: %TRUE if the setup was successful, %FALSE if @error is set.
+ */
+gboolean
+mm_modem_location_setup_gps_streaming_sync (MMModemLocation *self,
+                                            guint interval,
+                                            GCancellable *cancellable,
+                                            GError **error)
+{
+    g_return_val_if_fail (MM_IS_MODEM_LOCATION (self), FALSE);
+
+    return mm_gdbus_modem_location_call_setup_gps_streaming_sync (MM_GDBUS_MODEM_LOCATION (self),
+                                                                  interval,
+                                                                  cancellable,
+                                                                  error);
+}
+
+/*****************************************************************************/
+
 static gboolean
 build_locations (GVariant *dictionary,
                  MMLocation3gpp **location_3gpp,
@@ -91,6 +91,21 @@ gboolean mm_modem_location_setup_sync   (MMModemLocation *self,
                                          GCancellable *cancellable,
                                          GError **error);
 
+guint    mm_modem_location_get_gps_streaming_interval (MMModemLocation *self);
+
+void     mm_modem_location_setup_gps_streaming        (MMModemLocation *self,
+                                                       guint interval,
+                                                       GCancellable *cancellable,
+                                                       GAsyncReadyCallback callback,
+                                                       gpointer user_data);
+gboolean mm_modem_location_setup_gps_streaming_finish (MMModemLocation *self,
+                                                       GAsyncResult *res,
+                                                       GError **error);
+gboolean mm_modem_location_setup_gps_streaming_sync   (MMModemLocation *self,
+                                                       guint interval,
+                                                       GCancellable *cancellable,
+                                                       GError **error);
+
 void            mm_modem_location_get_3gpp        (MMModemLocation *self,
                                                    GCancellable *cancellable,
                                                    GAsyncReadyCallback callback,
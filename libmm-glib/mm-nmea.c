@@ -0,0 +1,286 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#include <string.h>
+
+#include "mm-common-helpers.h"
+#include "mm-location-common.h"
+#include "mm-nmea.h"
+
+/* Numeric fields are copied here to be NUL-terminated */
+#define NUMBER_MAX_LEN 31
+
+/*****************************************************************************/
+
+static gboolean
+add_field (MMNmeaSentence *sentence,
+           guint start,
+           guint end)
+{
+    if (sentence->n_fields == MM_NMEA_MAX_FIELDS)
+        return FALSE;
+
+    sentence->field_start[sentence->n_fields] = start;
+    sentence->field_len[sentence->n_fields] = end - start;
+    sentence->n_fields++;
+    return TRUE;
+}
+
+gboolean
+mm_nmea_sentence_parse (const gchar *trace,
+                        MMNmeaSentence *sentence)
+{
+    guint8 checksum = 0;
+    guint start;
+    guint end;
+    guint i;
+
+    if (!trace || trace[0] != '$')
+        return FALSE;
+
+    sentence->trace = trace;
+    sentence->n_fields = 0;
+
+    /* Up to the line terminator, if any */
+    for (i = 1; trace[i] && trace[i] != '\r' && trace[i] != '\n'; i++) {
+        if (i == G_MAXUINT16)
+            return FALSE;
+    }
+    sentence->len = i;
+
+    /* The checksum is the XOR of everything between '$' and '*' */
+    end = sentence->len;
+    for (i = 1, start = 1; i < sentence->len; i++) {
+        if (trace[i] == '*') {
+            end = i;
+            break;
+        }
+        checksum ^= (guint8) trace[i];
+        if (trace[i] == ',') {
+            if (!add_field (sentence, start, i))
+                return FALSE;
+            start = i + 1;
+        }
+    }
+    if (!add_field (sentence, start, end))
+        return FALSE;
+
+    if (end < sentence->len) {
+        gint expected;
+
+        if (sentence->len - end != 3)
+            return FALSE;
+        expected = mm_utils_hex2byte (&trace[end + 1]);
+        if (expected < 0 || (guint8) expected != checksum)
+            return FALSE;
+    }
+
+    /* There must be an address and at least one data field */
+    return (sentence->n_fields >= 2 && sentence->field_len[0] > 0);
+}
+
+gboolean
+mm_nmea_sentence_is (const MMNmeaSentence *sentence,
+                     const gchar *formatter)
+{
+    guint len;
+
+    len = strlen (formatter);
+    return (sentence->field_len[0] >= len &&
+            !memcmp (&sentence->trace[sentence->field_start[0] + sentence->field_len[0] - len],
+                     formatter,
+                     len));
+}
+
+const gchar *
+mm_nmea_sentence_get_field (const MMNmeaSentence *sentence,
+                            guint i,
+                            guint *len)
+{
+    if (i >= sentence->n_fields)
+        return NULL;
+
+    *len = sentence->field_len[i];
+    return &sentence->trace[sentence->field_start[i]];
+}
+
+static gboolean
+get_number (const MMNmeaSentence *sentence,
+            guint i,
+            gchar number[NUMBER_MAX_LEN + 1])
+{
+    const gchar *field;
+    guint len;
+
+    field = mm_nmea_sentence_get_field (sentence, i, &len);
+    if (!field || !len || len > NUMBER_MAX_LEN)
+        return FALSE;
+
+    memcpy (number, field, len);
+    number[len] = '\0';
+    return TRUE;
+}
+
+gboolean
+mm_nmea_sentence_get_uint (const MMNmeaSentence *sentence,
+                           guint i,
+                           guint *out)
+{
+    gchar number[NUMBER_MAX_LEN + 1];
+
+    return (get_number (sentence, i, number) &&
+            mm_get_uint_from_str (number, out));
+}
+
+gboolean
+mm_nmea_sentence_get_double (const MMNmeaSentence *sentence,
+                             guint i,
+                             gdouble *out)
+{
+    gchar number[NUMBER_MAX_LEN + 1];
+
+    return (get_number (sentence, i, number) &&
+            mm_get_double_from_str (number, out));
+}
+
+/*****************************************************************************/
+
+void
+mm_nmea_fix_init (MMNmeaFix *fix)
+{
+    fix->utc_time[0] = '\0';
+    fix->latitude = MM_LOCATION_LATITUDE_UNKNOWN;
+    fix->longitude = MM_LOCATION_LONGITUDE_UNKNOWN;
+    fix->altitude = MM_LOCATION_ALTITUDE_UNKNOWN;
+    fix->n_satellites = 0;
+    fix->hdop = MM_NMEA_FIX_HDOP_UNKNOWN;
+}
+
+gboolean
+mm_nmea_fix_equal (const MMNmeaFix *a,
+                   const MMNmeaFix *b)
+{
+    return (a->latitude == b->latitude &&
+            a->longitude == b->longitude &&
+            a->altitude == b->altitude &&
+            a->n_satellites == b->n_satellites &&
+            a->hdop == b->hdop &&
+            g_str_equal (a->utc_time, b->utc_time));
+}
+
+static gboolean
+get_longitude_or_latitude (const MMNmeaSentence *sentence,
+                           guint i,
+                           gdouble *out)
+{
+    gchar number[NUMBER_MAX_LEN + 1];
+    gchar *aux;
+    gdouble minutes;
+    gdouble degrees;
+
+    if (!get_number (sentence, i, number))
+        return FALSE;
+
+    /* 4533.35 is 45 degrees and 33.35 minutes */
+
+    aux = strchr (number, '.');
+    if (!aux || ((aux - number) < 3))
+        return FALSE;
+
+    aux -= 2;
+    if (!mm_get_double_from_str (aux, &minutes))
+        return FALSE;
+
+    aux[0] = '\0';
+    if (!mm_get_double_from_str (number, &degrees))
+        return FALSE;
+
+    /* Include the minutes as part of the degrees */
+    *out = degrees + (minutes / 60.0);
+    return TRUE;
+}
+
+static gboolean
+field_starts_with (const MMNmeaSentence *sentence,
+                   guint i,
+                   gchar c)
+{
+    const gchar *field;
+    guint len;
+
+    field = mm_nmea_sentence_get_field (sentence, i, &len);
+    return (field && len && field[0] == c);
+}
+
+gboolean
+mm_nmea_fix_update (MMNmeaFix *fix,
+                    const MMNmeaSentence *sentence)
+{
+    const gchar *field;
+    guint len;
+
+    /*
+     * $GPGGA,hhmmss.ss,llll.ll,a,yyyyy.yy,a,x,xx,x.x,x.x,M,x.x,M,x.x,xxxx*hh
+     * 1    = UTC of Position
+     * 2    = Latitude
+     * 3    = N or S
+     * 4    = Longitude
+     * 5    = E or W
+     * 6    = GPS quality indicator (0=invalid; 1=GPS fix; 2=Diff. GPS fix)
+     * 7    = Number of satellites in use [not those in view]
+     * 8    = Horizontal dilution of position
+     * 9    = Antenna altitude above/below mean sea level (geoid)
+     * 10   = Meters  (Antenna height unit)
+     * 11   = Geoidal separation (Diff. between WGS-84 earth ellipsoid and
+     *        mean sea level.  -=geoid is below WGS-84 ellipsoid)
+     * 12   = Meters  (Units of geoidal separation)
+     * 13   = Age in seconds since last update from diff. reference station
+     * 14   = Diff. reference station ID#
+     */
+    if (!mm_nmea_sentence_is (sentence, "GGA") || sentence->n_fields < 10)
+        return FALSE;
+
+    /* UTC time */
+    field = mm_nmea_sentence_get_field (sentence, 1, &len);
+    if (len < MM_NMEA_FIX_UTC_TIME_SIZE) {
+        memcpy (fix->utc_time, field, len);
+        fix->utc_time[len] = '\0';
+    } else
+        fix->utc_time[0] = '\0';
+
+    /* Latitude */
+    fix->latitude = MM_LOCATION_LATITUDE_UNKNOWN;
+    if (get_longitude_or_latitude (sentence, 2, &fix->latitude) &&
+        field_starts_with (sentence, 3, 'S'))
+        fix->latitude *= -1;
+
+    /* Longitude */
+    fix->longitude = MM_LOCATION_LONGITUDE_UNKNOWN;
+    if (get_longitude_or_latitude (sentence, 4, &fix->longitude) &&
+        field_starts_with (sentence, 5, 'W'))
+        fix->longitude *= -1;
+
+    /* Satellites and HDOP */
+    if (!mm_nmea_sentence_get_uint (sentence, 7, &fix->n_satellites))
+        fix->n_satellites = 0;
+    if (!mm_nmea_sentence_get_double (sentence, 8, &fix->hdop))
+        fix->hdop = MM_NMEA_FIX_HDOP_UNKNOWN;
+
+    /* Altitude */
+    if (!mm_nmea_sentence_get_double (sentence, 9, &fix->altitude))
+        fix->altitude = MM_LOCATION_ALTITUDE_UNKNOWN;
+
+    return TRUE;
+}
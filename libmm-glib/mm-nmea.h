@@ -0,0 +1,86 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#include <glib.h>
+
+#if !defined (__LIBMM_GLIB_H_INSIDE__) && !defined (LIBMM_GLIB_COMPILATION)
+#error "Only <libmm-glib.h> can be included directly."
+#endif
+
+#ifndef MM_NMEA_H
+#define MM_NMEA_H
+
+/* NMEA 0183 sentences are at most 82 characters long, so the number of fields
+ * is bounded as well */
+#define MM_NMEA_MAX_FIELDS 40
+
+/* A single NMEA sentence, split in fields without copying it. Field 0 is the
+ * address (e.g. "GPGGA"), without the leading '$'. */
+typedef struct {
+    const gchar *trace;
+    /* Length of the sentence, without line terminators */
+    guint len;
+    guint n_fields;
+    guint16 field_start[MM_NMEA_MAX_FIELDS];
+    guint16 field_len[MM_NMEA_MAX_FIELDS];
+} MMNmeaSentence;
+
+/* Splits the sentence in @trace, which must start with '$'. The checksum is
+ * optional, but if present it must be right. @trace must outlive @sentence. */
+gboolean mm_nmea_sentence_parse (const gchar *trace,
+                                 MMNmeaSentence *sentence);
+
+/* Checks the sentence formatter (e.g. "GGA"), whatever the talker is */
+gboolean mm_nmea_sentence_is (const MMNmeaSentence *sentence,
+                              const gchar *formatter);
+
+/* Returns a pointer to the field, not NUL-terminated, or NULL if missing */
+const gchar *mm_nmea_sentence_get_field (const MMNmeaSentence *sentence,
+                                         guint i,
+                                         guint *len);
+
+gboolean mm_nmea_sentence_get_uint   (const MMNmeaSentence *sentence,
+                                      guint i,
+                                      guint *out);
+gboolean mm_nmea_sentence_get_double (const MMNmeaSentence *sentence,
+                                      guint i,
+                                      gdouble *out);
+
+/*****************************************************************************/
+
+#define MM_NMEA_FIX_UTC_TIME_SIZE 16
+#define MM_NMEA_FIX_HDOP_UNKNOWN  -1.0
+
+/* Last fix reported by the GPS, as given in GGA sentences. Unknown values are
+ * the MM_LOCATION_*_UNKNOWN ones, an empty UTC time, no satellites and
+ * MM_NMEA_FIX_HDOP_UNKNOWN. */
+typedef struct {
+    gchar   utc_time[MM_NMEA_FIX_UTC_TIME_SIZE];
+    gdouble latitude;
+    gdouble longitude;
+    gdouble altitude;
+    guint   n_satellites;
+    gdouble hdop;
+} MMNmeaFix;
+
+void     mm_nmea_fix_init   (MMNmeaFix *fix);
+gboolean mm_nmea_fix_equal  (const MMNmeaFix *a,
+                             const MMNmeaFix *b);
+
+/* Returns TRUE if the sentence was a GGA one, and so the fix got updated */
+gboolean mm_nmea_fix_update (MMNmeaFix *fix,
+                             const MMNmeaSentence *sentence);
+
+#endif /* MM_NMEA_H */
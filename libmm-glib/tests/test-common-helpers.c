@@ -13,6 +13,7 @@
  * Copyright (C) 2012 Google, Inc.
  */
 
+#include <string.h>
 #include <glib-object.h>
 
 #include <libmm-glib.h>
@@ -488,6 +489,135 @@ field_parser_double (void)
 
 /**************************************************************/
 
+#define GGA_TRACE  "$GPGGA,092750.000,5321.6802,N,00630.3372,W,1,8,1.03,61.7,M,55.2,M,,*76"
+#define GSV1_TRACE "$GPGSV,3,1,11,10,63,137,17,07,61,098,15,05,59,290,20,08,54,157,30*70"
+#define GSV2_TRACE "$GPGSV,3,2,11,02,39,223,19,13,28,070,17,26,23,252,,04,14,186,14*79"
+
+static void
+nmea_sentence_parse (void)
+{
+    MMNmeaSentence sentence;
+    const gchar *field;
+    guint len;
+    guint num;
+
+    /* Failures */
+
+    g_assert (mm_nmea_sentence_parse (NULL, &sentence) == FALSE);
+
+    g_assert (mm_nmea_sentence_parse ("", &sentence) == FALSE);
+
+    g_assert (mm_nmea_sentence_parse ("GPGGA,1,2", &sentence) == FALSE);
+
+    g_assert (mm_nmea_sentence_parse ("$GPGGA", &sentence) == FALSE);
+
+    /* Wrong checksum */
+    g_assert (mm_nmea_sentence_parse ("$GPGGA,092750.000,5321.6802,N,00630.3372,W,1,8,1.03,61.7,M,55.2,M,,*77",
+                                      &sentence) == FALSE);
+
+    /* Truncated checksum */
+    g_assert (mm_nmea_sentence_parse ("$GPGGA,092750.000,5321.6802,N,00630.3372,W,1,8,1.03,61.7,M,55.2,M,,*7",
+                                      &sentence) == FALSE);
+
+    /* Successes */
+
+    g_assert (mm_nmea_sentence_parse (GGA_TRACE "\r\n", &sentence) == TRUE);
+    g_assert_cmpuint (sentence.len, ==, strlen (GGA_TRACE));
+    g_assert_cmpuint (sentence.n_fields, ==, 15);
+    g_assert (mm_nmea_sentence_is (&sentence, "GGA") == TRUE);
+    g_assert (mm_nmea_sentence_is (&sentence, "GSV") == FALSE);
+
+    field = mm_nmea_sentence_get_field (&sentence, 0, &len);
+    g_assert_cmpuint (len, ==, 5);
+    g_assert (strncmp (field, "GPGGA", len) == 0);
+
+    field = mm_nmea_sentence_get_field (&sentence, 14, &len);
+    g_assert (field != NULL);
+    g_assert_cmpuint (len, ==, 0);
+
+    g_assert (mm_nmea_sentence_get_field (&sentence, 15, &len) == NULL);
+
+    g_assert (mm_nmea_sentence_get_uint (&sentence, 7, &num) == TRUE);
+    g_assert_cmpuint (num, ==, 8);
+
+    g_assert (mm_nmea_sentence_get_uint (&sentence, 14, &num) == FALSE);
+
+    /* Checksum is optional */
+    g_assert (mm_nmea_sentence_parse ("$GPGSV,3,1,11", &sentence) == TRUE);
+    g_assert_cmpuint (sentence.n_fields, ==, 4);
+    g_assert (mm_nmea_sentence_is (&sentence, "GSV") == TRUE);
+}
+
+static void
+nmea_fix_update (void)
+{
+    MMNmeaSentence sentence;
+    MMNmeaFix fix;
+
+    mm_nmea_fix_init (&fix);
+
+    g_assert (mm_nmea_sentence_parse (GSV1_TRACE, &sentence) == TRUE);
+    g_assert (mm_nmea_fix_update (&fix, &sentence) == FALSE);
+    g_assert (fix.latitude == MM_LOCATION_LATITUDE_UNKNOWN);
+
+    g_assert (mm_nmea_sentence_parse (GGA_TRACE, &sentence) == TRUE);
+    g_assert (mm_nmea_fix_update (&fix, &sentence) == TRUE);
+    g_assert_cmpstr (fix.utc_time, ==, "092750.000");
+    g_assert (fix.latitude - (53.0 + 21.6802 / 60.0) < 0000000.1);
+    g_assert (fix.latitude > 0);
+    g_assert (fix.longitude - (-6.0 - 30.3372 / 60.0) < 0000000.1);
+    g_assert (fix.longitude < 0);
+    g_assert (fix.altitude - 61.7 < 0000000.1);
+    g_assert_cmpuint (fix.n_satellites, ==, 8);
+    g_assert (fix.hdop - 1.03 < 0000000.1);
+}
+
+static void
+nmea_location_gps_nmea (void)
+{
+    MMLocationGpsNmea *location;
+
+    location = mm_location_gps_nmea_new ();
+
+    g_assert (mm_location_gps_nmea_add_trace (location, "not a trace") == FALSE);
+
+    g_assert (mm_location_gps_nmea_add_trace (location, GGA_TRACE "\r\n") == TRUE);
+    g_assert_cmpstr (mm_location_gps_nmea_get_trace (location, "$GPGGA"), ==, GGA_TRACE);
+
+    /* Sequences get appended, but only once */
+    g_assert (mm_location_gps_nmea_add_trace (location, GSV1_TRACE) == TRUE);
+    g_assert (mm_location_gps_nmea_add_trace (location, GSV2_TRACE) == TRUE);
+    g_assert (mm_location_gps_nmea_add_trace (location, GSV2_TRACE) == TRUE);
+    g_assert_cmpstr (mm_location_gps_nmea_get_trace (location, "$GPGSV"), ==,
+                     GSV1_TRACE "\r\n" GSV2_TRACE);
+
+    /* A new sequence replaces the previous one */
+    g_assert (mm_location_gps_nmea_add_trace (location, GSV1_TRACE) == TRUE);
+    g_assert_cmpstr (mm_location_gps_nmea_get_trace (location, "$GPGSV"), ==, GSV1_TRACE);
+
+    g_object_unref (location);
+}
+
+static void
+nmea_location_gps_raw (void)
+{
+    MMLocationGpsRaw *location;
+
+    location = mm_location_gps_raw_new ();
+
+    g_assert (mm_location_gps_raw_add_trace (location, GSV1_TRACE) == FALSE);
+    g_assert (mm_location_gps_raw_get_utc_time (location) == NULL);
+
+    g_assert (mm_location_gps_raw_add_trace (location, GGA_TRACE) == TRUE);
+    g_assert_cmpstr (mm_location_gps_raw_get_utc_time (location), ==, "092750.000");
+    g_assert (mm_location_gps_raw_get_latitude (location) > 53.0);
+    g_assert (mm_location_gps_raw_get_longitude (location) < -6.0);
+
+    g_object_unref (location);
+}
+
+/**************************************************************/
+
 int main (int argc, char **argv)
 {
     g_type_init ();
@@ -525,5 +655,10 @@ int main (int argc, char **argv)
     g_test_add_func ("/MM/Common/FieldParsers/Uint", field_parser_uint);
     g_test_add_func ("/MM/Common/FieldParsers/Double", field_parser_double);
 
+    g_test_add_func ("/MM/Common/Nmea/sentence-parse", nmea_sentence_parse);
+    g_test_add_func ("/MM/Common/Nmea/fix-update", nmea_fix_update);
+    g_test_add_func ("/MM/Common/Nmea/location-gps-nmea", nmea_location_gps_nmea);
+    g_test_add_func ("/MM/Common/Nmea/location-gps-raw", nmea_location_gps_raw);
+
     return g_test_run ();
 }
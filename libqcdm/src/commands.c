@@ -26,6 +26,7 @@
 #include "result-private.h"
 #include "utils.h"
 
+#define ARRAY_LEN(a) (sizeof (a) / sizeof ((a)[0]))
 
 /**********************************************************************/
 
@@ -409,6 +410,18 @@ qcdm_cmd_cdma_status_new (char *buf, size_t len)
     return dm_encapsulate_buffer (cmdbuf, sizeof (*cmd), sizeof (cmdbuf), buf, len);
 }
 
+static const QcdmResultField cdma_status_fields[] = {
+    [QCDM_CMD_CDMA_STATUS_FIELD_ESN]             = { QCDM_CMD_CDMA_STATUS_ITEM_ESN, QCDM_RESULT_FIELD_STRING, 8 },
+    [QCDM_CMD_CDMA_STATUS_FIELD_RF_MODE]         = { QCDM_CMD_CDMA_STATUS_ITEM_RF_MODE, QCDM_RESULT_FIELD_U32 },
+    [QCDM_CMD_CDMA_STATUS_FIELD_RX_STATE]        = { QCDM_CMD_CDMA_STATUS_ITEM_RX_STATE, QCDM_RESULT_FIELD_U32 },
+    [QCDM_CMD_CDMA_STATUS_FIELD_ENTRY_REASON]    = { QCDM_CMD_CDMA_STATUS_ITEM_ENTRY_REASON, QCDM_RESULT_FIELD_U32 },
+    [QCDM_CMD_CDMA_STATUS_FIELD_CURRENT_CHANNEL] = { QCDM_CMD_CDMA_STATUS_ITEM_CURRENT_CHANNEL, QCDM_RESULT_FIELD_U32 },
+    [QCDM_CMD_CDMA_STATUS_FIELD_CODE_CHANNEL]    = { QCDM_CMD_CDMA_STATUS_ITEM_CODE_CHANNEL, QCDM_RESULT_FIELD_U8 },
+    [QCDM_CMD_CDMA_STATUS_FIELD_PILOT_BASE]      = { QCDM_CMD_CDMA_STATUS_ITEM_PILOT_BASE, QCDM_RESULT_FIELD_U32 },
+    [QCDM_CMD_CDMA_STATUS_FIELD_SID]             = { QCDM_CMD_CDMA_STATUS_ITEM_SID, QCDM_RESULT_FIELD_U32 },
+    [QCDM_CMD_CDMA_STATUS_FIELD_NID]             = { QCDM_CMD_CDMA_STATUS_ITEM_NID, QCDM_RESULT_FIELD_U32 },
+};
+
 QcdmResult *
 qcdm_cmd_cdma_status_result (const char *buf, size_t len, int *out_error)
 {
@@ -423,7 +436,9 @@ qcdm_cmd_cdma_status_result (const char *buf, size_t len, int *out_error)
     if (!check_command (buf, len, DIAG_CMD_STATUS, sizeof (DMCmdStatusRsp), out_error))
         return NULL;
 
-    result = qcdm_result_new ();
+    result = qcdm_result_new_fixed (cdma_status_fields, ARRAY_LEN (cdma_status_fields));
+    if (!result)
+        return NULL;
 
     /* Convert the ESN from binary to a hex string; it's LE so we have to
      * swap it to get the correct ordering.
@@ -434,31 +449,31 @@ qcdm_cmd_cdma_status_result (const char *buf, size_t len, int *out_error)
     swapped[3] = rsp->esn[0];
 
     tmp = bin2hexstr (&swapped[0], sizeof (swapped));
-    qcdm_result_add_string (result, QCDM_CMD_CDMA_STATUS_ITEM_ESN, tmp);
+    qcdm_result_set_string (result, QCDM_CMD_CDMA_STATUS_FIELD_ESN, tmp);
     free (tmp);
 
     tmp_num = (u_int32_t) le16toh (rsp->rf_mode);
-    qcdm_result_add_u32 (result, QCDM_CMD_CDMA_STATUS_ITEM_RF_MODE, tmp_num);
+    qcdm_result_set_u32 (result, QCDM_CMD_CDMA_STATUS_FIELD_RF_MODE, tmp_num);
 
     tmp_num = (u_int32_t) le16toh (rsp->cdma_rx_state);
-    qcdm_result_add_u32 (result, QCDM_CMD_CDMA_STATUS_ITEM_RX_STATE, tmp_num);
+    qcdm_result_set_u32 (result, QCDM_CMD_CDMA_STATUS_FIELD_RX_STATE, tmp_num);
 
     tmp_num = (u_int32_t) le16toh (rsp->entry_reason);
-    qcdm_result_add_u32 (result, QCDM_CMD_CDMA_STATUS_ITEM_ENTRY_REASON, tmp_num);
+    qcdm_result_set_u32 (result, QCDM_CMD_CDMA_STATUS_FIELD_ENTRY_REASON, tmp_num);
 
     tmp_num = (u_int32_t) le16toh (rsp->curr_chan);
-    qcdm_result_add_u32 (result, QCDM_CMD_CDMA_STATUS_ITEM_CURRENT_CHANNEL, tmp_num);
+    qcdm_result_set_u32 (result, QCDM_CMD_CDMA_STATUS_FIELD_CURRENT_CHANNEL, tmp_num);
 
-    qcdm_result_add_u8 (result, QCDM_CMD_CDMA_STATUS_ITEM_CODE_CHANNEL, rsp->cdma_code_chan);
+    qcdm_result_set_u8 (result, QCDM_CMD_CDMA_STATUS_FIELD_CODE_CHANNEL, rsp->cdma_code_chan);
 
     tmp_num = (u_int32_t) le16toh (rsp->pilot_base);
-    qcdm_result_add_u32 (result, QCDM_CMD_CDMA_STATUS_ITEM_PILOT_BASE, tmp_num);
+    qcdm_result_set_u32 (result, QCDM_CMD_CDMA_STATUS_FIELD_PILOT_BASE, tmp_num);
 
     tmp_num = (u_int32_t) le16toh (rsp->sid);
-    qcdm_result_add_u32 (result, QCDM_CMD_CDMA_STATUS_ITEM_SID, tmp_num);
+    qcdm_result_set_u32 (result, QCDM_CMD_CDMA_STATUS_FIELD_SID, tmp_num);
 
     tmp_num = (u_int32_t) le16toh (rsp->nid);
-    qcdm_result_add_u32 (result, QCDM_CMD_CDMA_STATUS_ITEM_NID, tmp_num);
+    qcdm_result_set_u32 (result, QCDM_CMD_CDMA_STATUS_FIELD_NID, tmp_num);
 
     return result;
 }
@@ -547,6 +562,16 @@ digit_fixup (u_int8_t d)
     return 0;
 }
 
+static const QcdmResultField status_snapshot_fields[] = {
+    [QCDM_CMD_STATUS_SNAPSHOT_FIELD_ESN]               = { QCDM_CMD_STATUS_SNAPSHOT_ITEM_ESN, QCDM_RESULT_FIELD_STRING, 8 },
+    [QCDM_CMD_STATUS_SNAPSHOT_FIELD_HOME_MCC]          = { QCDM_CMD_STATUS_SNAPSHOT_ITEM_HOME_MCC, QCDM_RESULT_FIELD_U32 },
+    [QCDM_CMD_STATUS_SNAPSHOT_FIELD_BAND_CLASS]        = { QCDM_CMD_STATUS_SNAPSHOT_ITEM_BAND_CLASS, QCDM_RESULT_FIELD_U8 },
+    [QCDM_CMD_STATUS_SNAPSHOT_FIELD_BASE_STATION_PREV] = { QCDM_CMD_STATUS_SNAPSHOT_ITEM_BASE_STATION_PREV, QCDM_RESULT_FIELD_U8 },
+    [QCDM_CMD_STATUS_SNAPSHOT_FIELD_MOBILE_PREV]       = { QCDM_CMD_STATUS_SNAPSHOT_ITEM_MOBILE_PREV, QCDM_RESULT_FIELD_U8 },
+    [QCDM_CMD_STATUS_SNAPSHOT_FIELD_PREV_IN_USE]       = { QCDM_CMD_STATUS_SNAPSHOT_ITEM_PREV_IN_USE, QCDM_RESULT_FIELD_U8 },
+    [QCDM_CMD_STATUS_SNAPSHOT_FIELD_STATE]             = { QCDM_CMD_STATUS_SNAPSHOT_ITEM_STATE, QCDM_RESULT_FIELD_U8 },
+};
+
 QcdmResult *
 qcdm_cmd_status_snapshot_result (const char *buf, size_t len, int *out_error)
 {
@@ -562,7 +587,9 @@ qcdm_cmd_status_snapshot_result (const char *buf, size_t len, int *out_error)
     if (!check_command (buf, len, DIAG_CMD_STATUS_SNAPSHOT, sizeof (*rsp), out_error))
         return NULL;
 
-    result = qcdm_result_new ();
+    result = qcdm_result_new_fixed (status_snapshot_fields, ARRAY_LEN (status_snapshot_fields));
+    if (!result)
+        return NULL;
 
     /* Convert the ESN from binary to a hex string; it's LE so we have to
      * swap it to get the correct ordering.
@@ -573,7 +600,7 @@ qcdm_cmd_status_snapshot_result (const char *buf, size_t len, int *out_error)
     swapped[3] = rsp->esn[0];
 
     tmp = bin2hexstr (&swapped[0], sizeof (swapped));
-    qcdm_result_add_string (result, QCDM_CMD_STATUS_SNAPSHOT_ITEM_ESN, tmp);
+    qcdm_result_set_string (result, QCDM_CMD_STATUS_SNAPSHOT_FIELD_ESN, tmp);
     free (tmp);
 
     /* Cheap binary -> decimal conversion */
@@ -583,13 +610,13 @@ qcdm_cmd_status_snapshot_result (const char *buf, size_t len, int *out_error)
     tmcc[0] = (hmcc - (tmcc[2] * 100) - (tmcc[1] * 10));
 
     mcc = (100 * digit_fixup (tmcc[2])) + (10 * digit_fixup (tmcc[1])) + digit_fixup (tmcc[0]);
-    qcdm_result_add_u32 (result, QCDM_CMD_STATUS_SNAPSHOT_ITEM_HOME_MCC, mcc);
+    qcdm_result_set_u32 (result, QCDM_CMD_STATUS_SNAPSHOT_FIELD_HOME_MCC, mcc);
 
-    qcdm_result_add_u8 (result, QCDM_CMD_STATUS_SNAPSHOT_ITEM_BAND_CLASS, cdma_band_class_to_qcdm (rsp->band_class));
-    qcdm_result_add_u8 (result, QCDM_CMD_STATUS_SNAPSHOT_ITEM_BASE_STATION_PREV, cdma_prev_to_qcdm (rsp->prev));
-    qcdm_result_add_u8 (result, QCDM_CMD_STATUS_SNAPSHOT_ITEM_MOBILE_PREV, cdma_prev_to_qcdm (rsp->mob_prev));
-    qcdm_result_add_u8 (result, QCDM_CMD_STATUS_SNAPSHOT_ITEM_PREV_IN_USE, cdma_prev_to_qcdm (rsp->prev_in_use));
-    qcdm_result_add_u8 (result, QCDM_CMD_STATUS_SNAPSHOT_ITEM_STATE, snapshot_state_to_qcdm (rsp->state & 0xF));
+    qcdm_result_set_u8 (result, QCDM_CMD_STATUS_SNAPSHOT_FIELD_BAND_CLASS, cdma_band_class_to_qcdm (rsp->band_class));
+    qcdm_result_set_u8 (result, QCDM_CMD_STATUS_SNAPSHOT_FIELD_BASE_STATION_PREV, cdma_prev_to_qcdm (rsp->prev));
+    qcdm_result_set_u8 (result, QCDM_CMD_STATUS_SNAPSHOT_FIELD_MOBILE_PREV, cdma_prev_to_qcdm (rsp->mob_prev));
+    qcdm_result_set_u8 (result, QCDM_CMD_STATUS_SNAPSHOT_FIELD_PREV_IN_USE, cdma_prev_to_qcdm (rsp->prev_in_use));
+    qcdm_result_set_u8 (result, QCDM_CMD_STATUS_SNAPSHOT_FIELD_STATE, snapshot_state_to_qcdm (rsp->state & 0xF));
 
     return result;
 }
@@ -615,16 +642,30 @@ qcdm_cmd_pilot_sets_new (char *buf, size_t len)
 #define PILOT_SETS_CMD_CANDIDATE_SET "candidate-set"
 #define PILOT_SETS_CMD_NEIGHBOR_SET  "neighbor-set"
 
-static const char *
-set_num_to_str (u_int32_t num)
+enum {
+    PILOT_SETS_FIELD_ACTIVE_SET = 0,
+    PILOT_SETS_FIELD_CANDIDATE_SET,
+    PILOT_SETS_FIELD_NEIGHBOR_SET,
+};
+
+#define PILOT_SETS_MAX_LEN (sizeof (((DMCmdPilotSetsRsp *) NULL)->sets))
+
+static const QcdmResultField pilot_sets_fields[] = {
+    [PILOT_SETS_FIELD_ACTIVE_SET]    = { PILOT_SETS_CMD_ACTIVE_SET, QCDM_RESULT_FIELD_U8_ARRAY, PILOT_SETS_MAX_LEN },
+    [PILOT_SETS_FIELD_CANDIDATE_SET] = { PILOT_SETS_CMD_CANDIDATE_SET, QCDM_RESULT_FIELD_U8_ARRAY, PILOT_SETS_MAX_LEN },
+    [PILOT_SETS_FIELD_NEIGHBOR_SET]  = { PILOT_SETS_CMD_NEIGHBOR_SET, QCDM_RESULT_FIELD_U8_ARRAY, PILOT_SETS_MAX_LEN },
+};
+
+static int
+set_num_to_field (u_int32_t num)
 {
     if (num == QCDM_CMD_PILOT_SETS_TYPE_ACTIVE)
-        return PILOT_SETS_CMD_ACTIVE_SET;
+        return PILOT_SETS_FIELD_ACTIVE_SET;
     if (num == QCDM_CMD_PILOT_SETS_TYPE_CANDIDATE)
-        return PILOT_SETS_CMD_CANDIDATE_SET;
+        return PILOT_SETS_FIELD_CANDIDATE_SET;
     if (num == QCDM_CMD_PILOT_SETS_TYPE_NEIGHBOR)
-        return PILOT_SETS_CMD_NEIGHBOR_SET;
-    return NULL;
+        return PILOT_SETS_FIELD_NEIGHBOR_SET;
+    return -1;
 }
 
 QcdmResult *
@@ -632,38 +673,37 @@ qcdm_cmd_pilot_sets_result (const char *buf, size_t len, int *out_error)
 {
     QcdmResult *result = NULL;
     DMCmdPilotSetsRsp *rsp = (DMCmdPilotSetsRsp *) buf;
-    size_t sets_len;
+    size_t n_sets;
 
     qcdm_return_val_if_fail (buf != NULL, NULL);
 
     if (!check_command (buf, len, DIAG_CMD_PILOT_SETS, sizeof (DMCmdPilotSetsRsp), out_error))
         return NULL;
 
-    result = qcdm_result_new ();
-
-    sets_len = rsp->active_count * sizeof (DMCmdPilotSetsSet);
-    if (sets_len > 0) {
-        qcdm_result_add_u8_array (result,
-                                  PILOT_SETS_CMD_ACTIVE_SET,
-                                  (const u_int8_t *) &rsp->sets[0],
-                                  sets_len);
+    n_sets = rsp->active_count + rsp->candidate_count + rsp->neighbor_count;
+    if (n_sets > ARRAY_LEN (rsp->sets)) {
+        qcdm_err (0, "Too many pilot sets (%zu)", n_sets);
+        if (out_error)
+            *out_error = -QCDM_ERROR_RESPONSE_MALFORMED;
+        return NULL;
     }
 
-    sets_len = rsp->candidate_count * sizeof (DMCmdPilotSetsSet);
-    if (sets_len > 0) {
-        qcdm_result_add_u8_array (result,
-                                  PILOT_SETS_CMD_ACTIVE_SET,
-                                  (const u_int8_t *) &rsp->sets[rsp->active_count],
-                                  sets_len);
-    }
+    result = qcdm_result_new_fixed (pilot_sets_fields, ARRAY_LEN (pilot_sets_fields));
+    if (!result)
+        return NULL;
 
-    sets_len = rsp->neighbor_count * sizeof (DMCmdPilotSetsSet);
-    if (sets_len > 0) {
-        qcdm_result_add_u8_array (result,
-                                  PILOT_SETS_CMD_ACTIVE_SET,
-                                  (const u_int8_t *) &rsp->sets[rsp->active_count + rsp->candidate_count],
-                                  sets_len);
-    }
+    qcdm_result_set_u8_array (result,
+                              PILOT_SETS_FIELD_ACTIVE_SET,
+                              (const u_int8_t *) &rsp->sets[0],
+                              rsp->active_count * sizeof (DMCmdPilotSetsSet));
+    qcdm_result_set_u8_array (result,
+                              PILOT_SETS_FIELD_CANDIDATE_SET,
+                              (const u_int8_t *) &rsp->sets[rsp->active_count],
+                              rsp->candidate_count * sizeof (DMCmdPilotSetsSet));
+    qcdm_result_set_u8_array (result,
+                              PILOT_SETS_FIELD_NEIGHBOR_SET,
+                              (const u_int8_t *) &rsp->sets[rsp->active_count + rsp->candidate_count],
+                              rsp->neighbor_count * sizeof (DMCmdPilotSetsSet));
 
     return result;
 }
@@ -673,16 +713,16 @@ qcdm_cmd_pilot_sets_result_get_num (QcdmResult *result,
                                     u_int32_t set_type,
                                     u_int32_t *out_num)
 {
-    const char *set_name;
+    int field;
     const u_int8_t *array = NULL;
     size_t array_len = 0;
 
     qcdm_return_val_if_fail (result != NULL, FALSE);
 
-    set_name = set_num_to_str (set_type);
-    qcdm_return_val_if_fail (set_name != NULL, FALSE);
+    field = set_num_to_field (set_type);
+    qcdm_return_val_if_fail (field >= 0, FALSE);
 
-    if (!qcdm_result_get_u8_array (result, set_name, &array, &array_len))
+    if (qcdm_result_get_u8_array_at (result, field, &array, &array_len) < 0)
         return FALSE;
 
     *out_num = array_len / sizeof (DMCmdPilotSetsSet);
@@ -697,17 +737,17 @@ qcdm_cmd_pilot_sets_result_get_pilot (QcdmResult *result,
                                       u_int32_t *out_ecio,
                                       float *out_db)
 {
-    const char *set_name;
+    int field;
     DMCmdPilotSetsSet *set;
     const u_int8_t *array = NULL;
     size_t array_len = 0;
 
     qcdm_return_val_if_fail (result != NULL, FALSE);
 
-    set_name = set_num_to_str (set_type);
-    qcdm_return_val_if_fail (set_name != NULL, FALSE);
+    field = set_num_to_field (set_type);
+    qcdm_return_val_if_fail (field >= 0, FALSE);
 
-    if (!qcdm_result_get_u8_array (result, set_name, &array, &array_len))
+    if (qcdm_result_get_u8_array_at (result, field, &array, &array_len) < 0)
         return FALSE;
 
     qcdm_return_val_if_fail (num < array_len / sizeof (DMCmdPilotSetsSet), FALSE);
@@ -1190,6 +1230,19 @@ qcdm_cmd_cm_subsys_state_info_new (char *buf, size_t len)
     return dm_encapsulate_buffer (cmdbuf, sizeof (*cmd), sizeof (cmdbuf), buf, len);
 }
 
+static const QcdmResultField cm_subsys_state_info_fields[] = {
+    [QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_CALL_STATE]             = { QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_CALL_STATE, QCDM_RESULT_FIELD_U32 },
+    [QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_OPERATING_MODE]         = { QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_OPERATING_MODE, QCDM_RESULT_FIELD_U32 },
+    [QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_SYSTEM_MODE]            = { QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_SYSTEM_MODE, QCDM_RESULT_FIELD_U32 },
+    [QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_MODE_PREF]              = { QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_MODE_PREF, QCDM_RESULT_FIELD_U32 },
+    [QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_BAND_PREF]              = { QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_BAND_PREF, QCDM_RESULT_FIELD_U32 },
+    [QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_ROAM_PREF]              = { QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_ROAM_PREF, QCDM_RESULT_FIELD_U32 },
+    [QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_SERVICE_DOMAIN_PREF]    = { QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_SERVICE_DOMAIN_PREF, QCDM_RESULT_FIELD_U32 },
+    [QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_ACQ_ORDER_PREF]         = { QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_ACQ_ORDER_PREF, QCDM_RESULT_FIELD_U32 },
+    [QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_HYBRID_PREF]            = { QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_HYBRID_PREF, QCDM_RESULT_FIELD_U32 },
+    [QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_NETWORK_SELECTION_PREF] = { QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_NETWORK_SELECTION_PREF, QCDM_RESULT_FIELD_U32 },
+};
+
 QcdmResult *
 qcdm_cmd_cm_subsys_state_info_result (const char *buf, size_t len, int *out_error)
 {
@@ -1209,36 +1262,38 @@ qcdm_cmd_cm_subsys_state_info_result (const char *buf, size_t len, int *out_erro
         return NULL;
     }
 
-    result = qcdm_result_new ();
+    result = qcdm_result_new_fixed (cm_subsys_state_info_fields, ARRAY_LEN (cm_subsys_state_info_fields));
+    if (!result)
+        return NULL;
 
     tmp_num = (u_int32_t) le32toh (rsp->call_state);
-    qcdm_result_add_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_CALL_STATE, tmp_num);
+    qcdm_result_set_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_CALL_STATE, tmp_num);
 
     tmp_num = (u_int32_t) le32toh (rsp->oper_mode);
-    qcdm_result_add_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_OPERATING_MODE, tmp_num);
+    qcdm_result_set_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_OPERATING_MODE, tmp_num);
 
     tmp_num = (u_int32_t) le32toh (rsp->system_mode);
-    qcdm_result_add_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_SYSTEM_MODE, tmp_num);
+    qcdm_result_set_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_SYSTEM_MODE, tmp_num);
 
     tmp_num = (u_int32_t) le32toh (rsp->mode_pref);
-    qcdm_result_add_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_MODE_PREF, tmp_num);
+    qcdm_result_set_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_MODE_PREF, tmp_num);
 
     tmp_num = (u_int32_t) le32toh (rsp->band_pref);
-    qcdm_result_add_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_BAND_PREF, tmp_num);
+    qcdm_result_set_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_BAND_PREF, tmp_num);
 
-    qcdm_result_add_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_ROAM_PREF, roam_pref);
+    qcdm_result_set_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_ROAM_PREF, roam_pref);
 
     tmp_num = (u_int32_t) le32toh (rsp->srv_domain_pref);
-    qcdm_result_add_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_SERVICE_DOMAIN_PREF, tmp_num);
+    qcdm_result_set_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_SERVICE_DOMAIN_PREF, tmp_num);
 
     tmp_num = (u_int32_t) le32toh (rsp->acq_order_pref);
-    qcdm_result_add_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_ACQ_ORDER_PREF, tmp_num);
+    qcdm_result_set_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_ACQ_ORDER_PREF, tmp_num);
 
     tmp_num = (u_int32_t) le32toh (rsp->hybrid_pref);
-    qcdm_result_add_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_HYBRID_PREF, tmp_num);
+    qcdm_result_set_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_HYBRID_PREF, tmp_num);
 
     tmp_num = (u_int32_t) le32toh (rsp->network_sel_mode_pref);
-    qcdm_result_add_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_NETWORK_SELECTION_PREF, tmp_num);
+    qcdm_result_set_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_NETWORK_SELECTION_PREF, tmp_num);
 
     return result;
 }
@@ -1262,6 +1317,18 @@ qcdm_cmd_hdr_subsys_state_info_new (char *buf, size_t len)
     return dm_encapsulate_buffer (cmdbuf, sizeof (*cmd), sizeof (cmdbuf), buf, len);
 }
 
+static const QcdmResultField hdr_subsys_state_info_fields[] = {
+    [QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_AT_STATE]           = { QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_AT_STATE, QCDM_RESULT_FIELD_U8 },
+    [QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_SESSION_STATE]      = { QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_SESSION_STATE, QCDM_RESULT_FIELD_U8 },
+    [QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_ALMP_STATE]         = { QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_ALMP_STATE, QCDM_RESULT_FIELD_U8 },
+    [QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_INIT_STATE]         = { QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_INIT_STATE, QCDM_RESULT_FIELD_U8 },
+    [QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_IDLE_STATE]         = { QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_IDLE_STATE, QCDM_RESULT_FIELD_U8 },
+    [QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_CONNECTED_STATE]    = { QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_CONNECTED_STATE, QCDM_RESULT_FIELD_U8 },
+    [QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_ROUTE_UPDATE_STATE] = { QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_ROUTE_UPDATE_STATE, QCDM_RESULT_FIELD_U8 },
+    [QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_OVERHEAD_MSG_STATE] = { QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_OVERHEAD_MSG_STATE, QCDM_RESULT_FIELD_U8 },
+    [QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_HDR_HYBRID_MODE]    = { QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_HDR_HYBRID_MODE, QCDM_RESULT_FIELD_U8 },
+};
+
 QcdmResult *
 qcdm_cmd_hdr_subsys_state_info_result (const char *buf, size_t len, int *out_error)
 {
@@ -1273,17 +1340,19 @@ qcdm_cmd_hdr_subsys_state_info_result (const char *buf, size_t len, int *out_err
     if (!check_command (buf, len, DIAG_CMD_SUBSYS, sizeof (DMCmdSubsysHDRStateInfoRsp), out_error))
         return NULL;
 
-    result = qcdm_result_new ();
+    result = qcdm_result_new_fixed (hdr_subsys_state_info_fields, ARRAY_LEN (hdr_subsys_state_info_fields));
+    if (!result)
+        return NULL;
 
-    qcdm_result_add_u8 (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_AT_STATE, rsp->at_state);
-    qcdm_result_add_u8 (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_SESSION_STATE, rsp->session_state);
-    qcdm_result_add_u8 (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_ALMP_STATE, rsp->almp_state);
-    qcdm_result_add_u8 (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_INIT_STATE, rsp->init_state);
-    qcdm_result_add_u8 (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_IDLE_STATE, rsp->idle_state);
-    qcdm_result_add_u8 (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_CONNECTED_STATE, rsp->connected_state);
-    qcdm_result_add_u8 (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_ROUTE_UPDATE_STATE, rsp->route_update_state);
-    qcdm_result_add_u8 (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_OVERHEAD_MSG_STATE, rsp->overhead_msg_state);
-    qcdm_result_add_u8 (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_HDR_HYBRID_MODE, rsp->hdr_hybrid_mode);
+    qcdm_result_set_u8 (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_AT_STATE, rsp->at_state);
+    qcdm_result_set_u8 (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_SESSION_STATE, rsp->session_state);
+    qcdm_result_set_u8 (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_ALMP_STATE, rsp->almp_state);
+    qcdm_result_set_u8 (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_INIT_STATE, rsp->init_state);
+    qcdm_result_set_u8 (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_IDLE_STATE, rsp->idle_state);
+    qcdm_result_set_u8 (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_CONNECTED_STATE, rsp->connected_state);
+    qcdm_result_set_u8 (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_ROUTE_UPDATE_STATE, rsp->route_update_state);
+    qcdm_result_set_u8 (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_OVERHEAD_MSG_STATE, rsp->overhead_msg_state);
+    qcdm_result_set_u8 (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_HDR_HYBRID_MODE, rsp->hdr_hybrid_mode);
 
     return result;
 }
@@ -135,6 +135,19 @@ enum {
 #define QCDM_CMD_CDMA_STATUS_ITEM_SID             "sid"
 #define QCDM_CMD_CDMA_STATUS_ITEM_NID             "nid"
 
+/* Indexes of the items above, for qcdm_result_get_*_at() */
+enum {
+    QCDM_CMD_CDMA_STATUS_FIELD_ESN = 0,
+    QCDM_CMD_CDMA_STATUS_FIELD_RF_MODE,
+    QCDM_CMD_CDMA_STATUS_FIELD_RX_STATE,
+    QCDM_CMD_CDMA_STATUS_FIELD_ENTRY_REASON,
+    QCDM_CMD_CDMA_STATUS_FIELD_CURRENT_CHANNEL,
+    QCDM_CMD_CDMA_STATUS_FIELD_CODE_CHANNEL,
+    QCDM_CMD_CDMA_STATUS_FIELD_PILOT_BASE,
+    QCDM_CMD_CDMA_STATUS_FIELD_SID,
+    QCDM_CMD_CDMA_STATUS_FIELD_NID,
+};
+
 size_t      qcdm_cmd_cdma_status_new    (char *buf, size_t len);
 
 QcdmResult *qcdm_cmd_cdma_status_result (const char *buf,
@@ -201,6 +214,17 @@ enum {
 /* The protocol revision currently in-use.  One of QCDM_STATUS_SNAPSHOT_STATE_* */
 #define QCDM_CMD_STATUS_SNAPSHOT_ITEM_STATE              "state"
 
+/* Indexes of the items above, for qcdm_result_get_*_at() */
+enum {
+    QCDM_CMD_STATUS_SNAPSHOT_FIELD_ESN = 0,
+    QCDM_CMD_STATUS_SNAPSHOT_FIELD_HOME_MCC,
+    QCDM_CMD_STATUS_SNAPSHOT_FIELD_BAND_CLASS,
+    QCDM_CMD_STATUS_SNAPSHOT_FIELD_BASE_STATION_PREV,
+    QCDM_CMD_STATUS_SNAPSHOT_FIELD_MOBILE_PREV,
+    QCDM_CMD_STATUS_SNAPSHOT_FIELD_PREV_IN_USE,
+    QCDM_CMD_STATUS_SNAPSHOT_FIELD_STATE,
+};
+
 size_t      qcdm_cmd_status_snapshot_new    (char *buf, size_t len);
 
 QcdmResult *qcdm_cmd_status_snapshot_result (const char *buf,
@@ -431,6 +455,20 @@ enum {
 #define QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_HYBRID_PREF            "hybrid-pref"
 #define QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_NETWORK_SELECTION_PREF "network-selection-pref"
 
+/* Indexes of the items above, for qcdm_result_get_*_at() */
+enum {
+    QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_CALL_STATE = 0,
+    QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_OPERATING_MODE,
+    QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_SYSTEM_MODE,
+    QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_MODE_PREF,
+    QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_BAND_PREF,
+    QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_ROAM_PREF,
+    QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_SERVICE_DOMAIN_PREF,
+    QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_ACQ_ORDER_PREF,
+    QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_HYBRID_PREF,
+    QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_NETWORK_SELECTION_PREF,
+};
+
 size_t      qcdm_cmd_cm_subsys_state_info_new    (char *buf, size_t len);
 
 QcdmResult *qcdm_cmd_cm_subsys_state_info_result (const char *buf,
@@ -514,6 +552,19 @@ enum {
 #define QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_OVERHEAD_MSG_STATE "overhead-msg-state"
 #define QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_HDR_HYBRID_MODE    "hdr-hybrid-mode"
 
+/* Indexes of the items above, for qcdm_result_get_*_at() */
+enum {
+    QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_AT_STATE = 0,
+    QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_SESSION_STATE,
+    QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_ALMP_STATE,
+    QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_INIT_STATE,
+    QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_IDLE_STATE,
+    QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_CONNECTED_STATE,
+    QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_ROUTE_UPDATE_STATE,
+    QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_OVERHEAD_MSG_STATE,
+    QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_HDR_HYBRID_MODE,
+};
+
 size_t      qcdm_cmd_hdr_subsys_state_info_new    (char *buf, size_t len);
 
 QcdmResult *qcdm_cmd_hdr_subsys_state_info_result (const char *buf,
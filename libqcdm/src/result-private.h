@@ -22,6 +22,23 @@
 
 QcdmResult *qcdm_result_new (void);
 
+/* Field types of a fixed-layout result */
+#define QCDM_RESULT_FIELD_STRING    1
+#define QCDM_RESULT_FIELD_U8        2
+#define QCDM_RESULT_FIELD_U32       3
+#define QCDM_RESULT_FIELD_U8_ARRAY  4
+#define QCDM_RESULT_FIELD_U16_ARRAY 5
+
+typedef struct {
+    const char *key;
+    u_int8_t type;
+    /* Strings: max length without the terminator; arrays: max elements */
+    u_int16_t max_len;
+} QcdmResultField;
+
+QcdmResult *qcdm_result_new_fixed (const QcdmResultField *fields,
+                                   size_t n_fields);
+
 void qcdm_result_add_string (QcdmResult *result,
                              const char *key,
                              const char *str);
@@ -49,5 +66,32 @@ void qcdm_result_add_u32    (QcdmResult *result,
                              const char *key,
                              u_int32_t num);
 
+void qcdm_result_set_string    (QcdmResult *result,
+                                size_t idx,
+                                const char *str);
+
+void qcdm_result_set_u8        (QcdmResult *result,
+                                size_t idx,
+                                u_int8_t num);
+
+void qcdm_result_set_u32       (QcdmResult *result,
+                                size_t idx,
+                                u_int32_t num);
+
+void qcdm_result_set_u8_array  (QcdmResult *result,
+                                size_t idx,
+                                const u_int8_t *array,
+                                size_t array_len);
+
+int qcdm_result_get_u8_array_at (QcdmResult *result,
+                                 size_t idx,
+                                 const u_int8_t **out_val,
+                                 size_t *out_len);
+
+void qcdm_result_set_u16_array (QcdmResult *result,
+                                size_t idx,
+                                const u_int16_t *array,
+                                size_t array_len);
+
 #endif  /* LIBQCDM_RESULT_PRIVATE_H */
 
@@ -28,11 +28,11 @@ typedef struct Val Val;
 
 typedef enum {
     VAL_TYPE_NONE = 0,
-    VAL_TYPE_STRING = 1,
-    VAL_TYPE_U8 = 2,
-    VAL_TYPE_U32 = 3,
-    VAL_TYPE_U8_ARRAY = 4,
-    VAL_TYPE_U16_ARRAY = 5,
+    VAL_TYPE_STRING = QCDM_RESULT_FIELD_STRING,
+    VAL_TYPE_U8 = QCDM_RESULT_FIELD_U8,
+    VAL_TYPE_U32 = QCDM_RESULT_FIELD_U32,
+    VAL_TYPE_U8_ARRAY = QCDM_RESULT_FIELD_U8_ARRAY,
+    VAL_TYPE_U16_ARRAY = QCDM_RESULT_FIELD_U16_ARRAY,
 } ValType;
 
 struct Val {
@@ -180,9 +180,27 @@ val_new_u16_array (const char *key, const u_int16_t *array, size_t array_len)
 
 /*********************************************************/
 
+/* Value of one field of a fixed-layout result */
+typedef struct {
+    u_int8_t set;
+    u_int32_t len;     /* string length or number of array elements */
+    u_int32_t offset;  /* string/array storage, relative to QcdmResult->data */
+    union {
+        u_int8_t u8;
+        u_int32_t u32;
+    } u;
+} Slot;
+
 struct QcdmResult {
     u_int32_t refcount;
     Val *first;
+
+    /* Fixed-layout results only; slots and data live in the same allocation
+     * as the result itself */
+    const QcdmResultField *fields;
+    size_t n_fields;
+    Slot *slots;
+    u_int8_t *data;
 };
 
 QcdmResult *
@@ -196,6 +214,71 @@ qcdm_result_new (void)
     return r;
 }
 
+static size_t
+field_storage_size (const QcdmResultField *field)
+{
+    size_t sz;
+
+    switch (field->type) {
+    case QCDM_RESULT_FIELD_STRING:
+        sz = field->max_len + 1;
+        break;
+    case QCDM_RESULT_FIELD_U8_ARRAY:
+        sz = field->max_len;
+        break;
+    case QCDM_RESULT_FIELD_U16_ARRAY:
+        sz = field->max_len * sizeof (u_int16_t);
+        break;
+    default:
+        return 0;
+    }
+
+    /* Keep every field's storage aligned for the wider array types */
+    return (sz + 3) & ~((size_t) 3);
+}
+
+/**
+ * qcdm_result_new_fixed:
+ * @fields: static descriptors of the result's fields
+ * @n_fields: number of elements in @fields
+ *
+ * Creates a result whose fields are known up-front.  All values, including
+ * string and array contents, are stored in a single allocation and may be
+ * retrieved by index with the qcdm_result_get_*_at() functions, or by key
+ * with the usual accessors.
+ *
+ * Returns: a new #QcdmResult, or %NULL on allocation failure.
+ **/
+QcdmResult *
+qcdm_result_new_fixed (const QcdmResultField *fields, size_t n_fields)
+{
+    QcdmResult *r;
+    size_t i, data_len = 0;
+
+    qcdm_return_val_if_fail (fields != NULL, NULL);
+    qcdm_return_val_if_fail (n_fields > 0, NULL);
+
+    for (i = 0; i < n_fields; i++)
+        data_len += field_storage_size (&fields[i]);
+
+    r = calloc (1, sizeof (QcdmResult) + (n_fields * sizeof (Slot)) + data_len);
+    if (r == NULL)
+        return NULL;
+
+    r->refcount = 1;
+    r->fields = fields;
+    r->n_fields = n_fields;
+    r->slots = (Slot *) (r + 1);
+    r->data = (u_int8_t *) (r->slots + n_fields);
+
+    for (i = 0, data_len = 0; i < n_fields; i++) {
+        r->slots[i].offset = data_len;
+        data_len += field_storage_size (&fields[i]);
+    }
+
+    return r;
+}
+
 QcdmResult *
 qcdm_result_ref (QcdmResult *r)
 {
@@ -232,6 +315,29 @@ qcdm_result_unref (QcdmResult *r)
         qcdm_result_free (r);
 }
 
+/* Returns the index of the fixed field named @key, or -1 */
+static int
+find_field (QcdmResult *r, const char *key)
+{
+    size_t i;
+
+    for (i = 0; i < r->n_fields; i++) {
+        if (strcmp (r->fields[i].key, key) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static Slot *
+get_slot (QcdmResult *r, size_t idx, ValType expected_type)
+{
+    qcdm_return_val_if_fail (r->fields != NULL, NULL);
+    qcdm_return_val_if_fail (idx < r->n_fields, NULL);
+    qcdm_return_val_if_fail (r->fields[idx].type == expected_type, NULL);
+
+    return &r->slots[idx];
+}
+
 static Val *
 find_val (QcdmResult *r, const char *key, ValType expected_type)
 {
@@ -274,6 +380,7 @@ qcdm_result_get_string (QcdmResult *r,
                        const char **out_val)
 {
     Val *v;
+    int idx;
 
     qcdm_return_val_if_fail (r != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (r->refcount > 0, -QCDM_ERROR_INVALID_ARGUMENTS);
@@ -281,6 +388,10 @@ qcdm_result_get_string (QcdmResult *r,
     qcdm_return_val_if_fail (out_val != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (*out_val == NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
 
+    idx = find_field (r, key);
+    if (idx >= 0)
+        return qcdm_result_get_string_at (r, idx, out_val);
+
     v = find_val (r, key, VAL_TYPE_STRING);
     if (v == NULL)
         return -QCDM_ERROR_VALUE_NOT_FOUND;
@@ -312,12 +423,17 @@ qcdm_result_get_u8  (QcdmResult *r,
                     u_int8_t *out_val)
 {
     Val *v;
+    int idx;
 
     qcdm_return_val_if_fail (r != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (r->refcount > 0, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (key != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (out_val != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
 
+    idx = find_field (r, key);
+    if (idx >= 0)
+        return qcdm_result_get_u8_at (r, idx, out_val);
+
     v = find_val (r, key, VAL_TYPE_U8);
     if (v == NULL)
         return -QCDM_ERROR_VALUE_NOT_FOUND;
@@ -353,6 +469,7 @@ qcdm_result_get_u8_array (QcdmResult *r,
                           size_t *out_len)
 {
     Val *v;
+    int idx;
 
     qcdm_return_val_if_fail (r != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (r->refcount > 0, -QCDM_ERROR_INVALID_ARGUMENTS);
@@ -360,6 +477,10 @@ qcdm_result_get_u8_array (QcdmResult *r,
     qcdm_return_val_if_fail (out_val != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (out_len != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
 
+    idx = find_field (r, key);
+    if (idx >= 0)
+        return qcdm_result_get_u8_array_at (r, idx, out_val, out_len);
+
     v = find_val (r, key, VAL_TYPE_U8_ARRAY);
     if (v == NULL)
         return -QCDM_ERROR_VALUE_NOT_FOUND;
@@ -392,12 +513,17 @@ qcdm_result_get_u32 (QcdmResult *r,
                     u_int32_t *out_val)
 {
     Val *v;
+    int idx;
 
     qcdm_return_val_if_fail (r != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (r->refcount > 0, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (key != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (out_val != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
 
+    idx = find_field (r, key);
+    if (idx >= 0)
+        return qcdm_result_get_u32_at (r, idx, out_val);
+
     v = find_val (r, key, VAL_TYPE_U32);
     if (v == NULL)
         return -QCDM_ERROR_VALUE_NOT_FOUND;
@@ -433,6 +559,7 @@ qcdm_result_get_u16_array (QcdmResult *r,
                            size_t *out_len)
 {
     Val *v;
+    int idx;
 
     qcdm_return_val_if_fail (r != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (r->refcount > 0, -QCDM_ERROR_INVALID_ARGUMENTS);
@@ -440,6 +567,10 @@ qcdm_result_get_u16_array (QcdmResult *r,
     qcdm_return_val_if_fail (out_val != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (out_len != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
 
+    idx = find_field (r, key);
+    if (idx >= 0)
+        return qcdm_result_get_u16_array_at (r, idx, out_val, out_len);
+
     v = find_val (r, key, VAL_TYPE_U16_ARRAY);
     if (v == NULL)
         return -QCDM_ERROR_VALUE_NOT_FOUND;
@@ -449,3 +580,214 @@ qcdm_result_get_u16_array (QcdmResult *r,
     return 0;
 }
 
+
+/*********************************************************/
+/* Fixed-layout results */
+
+void
+qcdm_result_set_string (QcdmResult *r,
+                        size_t idx,
+                        const char *str)
+{
+    Slot *s;
+    size_t len;
+
+    qcdm_return_if_fail (r != NULL);
+    qcdm_return_if_fail (str != NULL);
+
+    s = get_slot (r, idx, VAL_TYPE_STRING);
+    qcdm_return_if_fail (s != NULL);
+
+    len = strlen (str);
+    qcdm_return_if_fail (len <= r->fields[idx].max_len);
+
+    memcpy (r->data + s->offset, str, len + 1);
+    s->len = len;
+    s->set = 1;
+}
+
+int
+qcdm_result_get_string_at (QcdmResult *r,
+                           size_t idx,
+                           const char **out_val)
+{
+    Slot *s;
+
+    qcdm_return_val_if_fail (r != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
+    qcdm_return_val_if_fail (r->refcount > 0, -QCDM_ERROR_INVALID_ARGUMENTS);
+    qcdm_return_val_if_fail (out_val != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
+    qcdm_return_val_if_fail (*out_val == NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
+
+    s = get_slot (r, idx, VAL_TYPE_STRING);
+    if (s == NULL)
+        return -QCDM_ERROR_INVALID_ARGUMENTS;
+    if (!s->set)
+        return -QCDM_ERROR_VALUE_NOT_FOUND;
+
+    *out_val = (const char *) (r->data + s->offset);
+    return 0;
+}
+
+void
+qcdm_result_set_u8 (QcdmResult *r,
+                    size_t idx,
+                    u_int8_t num)
+{
+    Slot *s;
+
+    qcdm_return_if_fail (r != NULL);
+
+    s = get_slot (r, idx, VAL_TYPE_U8);
+    qcdm_return_if_fail (s != NULL);
+
+    s->u.u8 = num;
+    s->set = 1;
+}
+
+int
+qcdm_result_get_u8_at (QcdmResult *r,
+                       size_t idx,
+                       u_int8_t *out_val)
+{
+    Slot *s;
+
+    qcdm_return_val_if_fail (r != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
+    qcdm_return_val_if_fail (r->refcount > 0, -QCDM_ERROR_INVALID_ARGUMENTS);
+    qcdm_return_val_if_fail (out_val != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
+
+    s = get_slot (r, idx, VAL_TYPE_U8);
+    if (s == NULL)
+        return -QCDM_ERROR_INVALID_ARGUMENTS;
+    if (!s->set)
+        return -QCDM_ERROR_VALUE_NOT_FOUND;
+
+    *out_val = s->u.u8;
+    return 0;
+}
+
+void
+qcdm_result_set_u32 (QcdmResult *r,
+                     size_t idx,
+                     u_int32_t num)
+{
+    Slot *s;
+
+    qcdm_return_if_fail (r != NULL);
+
+    s = get_slot (r, idx, VAL_TYPE_U32);
+    qcdm_return_if_fail (s != NULL);
+
+    s->u.u32 = num;
+    s->set = 1;
+}
+
+int
+qcdm_result_get_u32_at (QcdmResult *r,
+                        size_t idx,
+                        u_int32_t *out_val)
+{
+    Slot *s;
+
+    qcdm_return_val_if_fail (r != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
+    qcdm_return_val_if_fail (r->refcount > 0, -QCDM_ERROR_INVALID_ARGUMENTS);
+    qcdm_return_val_if_fail (out_val != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
+
+    s = get_slot (r, idx, VAL_TYPE_U32);
+    if (s == NULL)
+        return -QCDM_ERROR_INVALID_ARGUMENTS;
+    if (!s->set)
+        return -QCDM_ERROR_VALUE_NOT_FOUND;
+
+    *out_val = s->u.u32;
+    return 0;
+}
+
+void
+qcdm_result_set_u8_array (QcdmResult *r,
+                          size_t idx,
+                          const u_int8_t *array,
+                          size_t array_len)
+{
+    Slot *s;
+
+    qcdm_return_if_fail (r != NULL);
+    qcdm_return_if_fail (array != NULL || array_len == 0);
+
+    s = get_slot (r, idx, VAL_TYPE_U8_ARRAY);
+    qcdm_return_if_fail (s != NULL);
+    qcdm_return_if_fail (array_len <= r->fields[idx].max_len);
+
+    if (array_len)
+        memcpy (r->data + s->offset, array, array_len);
+    s->len = array_len;
+    s->set = 1;
+}
+
+int
+qcdm_result_get_u8_array_at (QcdmResult *r,
+                             size_t idx,
+                             const u_int8_t **out_val,
+                             size_t *out_len)
+{
+    Slot *s;
+
+    qcdm_return_val_if_fail (r != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
+    qcdm_return_val_if_fail (r->refcount > 0, -QCDM_ERROR_INVALID_ARGUMENTS);
+    qcdm_return_val_if_fail (out_val != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
+    qcdm_return_val_if_fail (out_len != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
+
+    s = get_slot (r, idx, VAL_TYPE_U8_ARRAY);
+    if (s == NULL)
+        return -QCDM_ERROR_INVALID_ARGUMENTS;
+    if (!s->set)
+        return -QCDM_ERROR_VALUE_NOT_FOUND;
+
+    *out_val = r->data + s->offset;
+    *out_len = s->len;
+    return 0;
+}
+
+void
+qcdm_result_set_u16_array (QcdmResult *r,
+                           size_t idx,
+                           const u_int16_t *array,
+                           size_t array_len)
+{
+    Slot *s;
+
+    qcdm_return_if_fail (r != NULL);
+    qcdm_return_if_fail (array != NULL || array_len == 0);
+
+    s = get_slot (r, idx, VAL_TYPE_U16_ARRAY);
+    qcdm_return_if_fail (s != NULL);
+    qcdm_return_if_fail (array_len <= r->fields[idx].max_len);
+
+    if (array_len)
+        memcpy (r->data + s->offset, array, array_len * sizeof (u_int16_t));
+    s->len = array_len;
+    s->set = 1;
+}
+
+int
+qcdm_result_get_u16_array_at (QcdmResult *r,
+                              size_t idx,
+                              const u_int16_t **out_val,
+                              size_t *out_len)
+{
+    Slot *s;
+
+    qcdm_return_val_if_fail (r != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
+    qcdm_return_val_if_fail (r->refcount > 0, -QCDM_ERROR_INVALID_ARGUMENTS);
+    qcdm_return_val_if_fail (out_val != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
+    qcdm_return_val_if_fail (out_len != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
+
+    s = get_slot (r, idx, VAL_TYPE_U16_ARRAY);
+    if (s == NULL)
+        return -QCDM_ERROR_INVALID_ARGUMENTS;
+    if (!s->set)
+        return -QCDM_ERROR_VALUE_NOT_FOUND;
+
+    *out_val = (const u_int16_t *) (r->data + s->offset);
+    *out_len = s->len;
+    return 0;
+}
@@ -39,6 +39,26 @@ int qcdm_result_get_u16_array  (QcdmResult *result,
                                 const u_int16_t **out_val,
                                 size_t *out_len);
 
+/* Indexed accessors for results with a fixed layout; the index of each field
+ * is given by the QCDM_CMD_*_FIELD_* values of the command */
+
+int qcdm_result_get_string_at     (QcdmResult *r,
+                                   size_t idx,
+                                   const char **out_val);
+
+int qcdm_result_get_u8_at         (QcdmResult *r,
+                                   size_t idx,
+                                   u_int8_t *out_val);
+
+int qcdm_result_get_u32_at        (QcdmResult *r,
+                                   size_t idx,
+                                   u_int32_t *out_val);
+
+int qcdm_result_get_u16_array_at  (QcdmResult *r,
+                                   size_t idx,
+                                   const u_int16_t **out_val,
+                                   size_t *out_len);
+
 QcdmResult *qcdm_result_ref    (QcdmResult *r);
 
 void       qcdm_result_unref   (QcdmResult *r);
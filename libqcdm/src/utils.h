@@ -32,8 +32,15 @@ typedef u_int8_t qcdmbool;
 #define DIAG_CONTROL_CHAR 0x7E
 #define DIAG_TRAILER_LEN  3
 
+/* Running the CRC over a frame followed by its own CRC always ends up with
+ * this value (before the final complement) */
+#define DM_CRC16_SEED    0xFFFF
+#define DM_CRC16_RESIDUE 0xF0B8
+
 u_int16_t dm_crc16 (const char *buffer, size_t len);
 
+u_int16_t dm_crc16_update (u_int16_t crc, const char *buffer, size_t len);
+
 size_t dm_escape (const char *inbuf,
                   size_t inbuf_len,
                   char *outbuf,
@@ -21,6 +21,7 @@
 void test_escape1 (void *f, void *data);
 void test_escape2 (void *f, void *data);
 void test_escape_unescape (void *f, void *data);
+void test_escape_throughput (void *f, void *data);
 
 #endif  /* TEST_QCDM_ESCAPING_H */
 
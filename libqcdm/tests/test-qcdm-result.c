@@ -21,6 +21,7 @@
 #include "test-qcdm-result.h"
 #include "result.h"
 #include "result-private.h"
+#include "errors.h"
 
 #define TEST_TAG "test"
 
@@ -85,3 +86,73 @@ test_result_uint8_array (void *f, void *data)
     g_assert_cmpint (memcmp (tmp, array, tmp_len), ==, 0);
 }
 
+
+enum {
+    FIXED_FIELD_STRING = 0,
+    FIXED_FIELD_U8,
+    FIXED_FIELD_U32,
+    FIXED_FIELD_U8_ARRAY,
+    FIXED_FIELD_U16_ARRAY,
+};
+
+static const QcdmResultField fixed_fields[] = {
+    [FIXED_FIELD_STRING]    = { "string", QCDM_RESULT_FIELD_STRING, 8 },
+    [FIXED_FIELD_U8]        = { "u8", QCDM_RESULT_FIELD_U8 },
+    [FIXED_FIELD_U32]       = { "u32", QCDM_RESULT_FIELD_U32 },
+    [FIXED_FIELD_U8_ARRAY]  = { "u8-array", QCDM_RESULT_FIELD_U8_ARRAY, 6 },
+    [FIXED_FIELD_U16_ARRAY] = { "u16-array", QCDM_RESULT_FIELD_U16_ARRAY, 3 },
+};
+
+void
+test_result_fixed (void *f, void *data)
+{
+    u_int8_t array8[] = { 0, 1, 255, 32, 128, 127 };
+    u_int16_t array16[] = { 0x1234, 0xFFFF, 7 };
+    const char *str = NULL;
+    guint8 num8 = 0;
+    guint32 num32 = 0;
+    const u_int8_t *tmp8 = NULL;
+    const u_int16_t *tmp16 = NULL;
+    size_t tmp_len = 0;
+    QcdmResult *result;
+
+    result = qcdm_result_new_fixed (fixed_fields, G_N_ELEMENTS (fixed_fields));
+    g_assert (result);
+
+    /* Nothing set yet */
+    g_assert_cmpint (qcdm_result_get_u32_at (result, FIXED_FIELD_U32, &num32), ==, -QCDM_ERROR_VALUE_NOT_FOUND);
+
+    qcdm_result_set_string (result, FIXED_FIELD_STRING, "8c3fa21b");
+    qcdm_result_set_u8 (result, FIXED_FIELD_U8, 0x1E);
+    qcdm_result_set_u32 (result, FIXED_FIELD_U32, 0xDEADBEEF);
+    qcdm_result_set_u8_array (result, FIXED_FIELD_U8_ARRAY, array8, sizeof (array8));
+    qcdm_result_set_u16_array (result, FIXED_FIELD_U16_ARRAY, array16, G_N_ELEMENTS (array16));
+
+    /* Indexed accessors */
+    g_assert_cmpint (qcdm_result_get_string_at (result, FIXED_FIELD_STRING, &str), ==, 0);
+    g_assert_cmpstr (str, ==, "8c3fa21b");
+    g_assert_cmpint (qcdm_result_get_u8_at (result, FIXED_FIELD_U8, &num8), ==, 0);
+    g_assert_cmpint (num8, ==, 0x1E);
+    g_assert_cmpint (qcdm_result_get_u32_at (result, FIXED_FIELD_U32, &num32), ==, 0);
+    g_assert_cmpuint (num32, ==, 0xDEADBEEF);
+    g_assert_cmpint (qcdm_result_get_u8_array_at (result, FIXED_FIELD_U8_ARRAY, &tmp8, &tmp_len), ==, 0);
+    g_assert_cmpint (tmp_len, ==, sizeof (array8));
+    g_assert_cmpint (memcmp (tmp8, array8, tmp_len), ==, 0);
+    g_assert_cmpint (qcdm_result_get_u16_array_at (result, FIXED_FIELD_U16_ARRAY, &tmp16, &tmp_len), ==, 0);
+    g_assert_cmpint (tmp_len, ==, G_N_ELEMENTS (array16));
+    g_assert_cmpint (memcmp (tmp16, array16, sizeof (array16)), ==, 0);
+
+    /* Keyed accessors still work on fixed results */
+    str = NULL;
+    num8 = 0;
+    num32 = 0;
+    g_assert_cmpint (qcdm_result_get_string (result, "string", &str), ==, 0);
+    g_assert_cmpstr (str, ==, "8c3fa21b");
+    g_assert_cmpint (qcdm_result_get_u8 (result, "u8", &num8), ==, 0);
+    g_assert_cmpint (num8, ==, 0x1E);
+    g_assert_cmpint (qcdm_result_get_u32 (result, "u32", &num32), ==, 0);
+    g_assert_cmpuint (num32, ==, 0xDEADBEEF);
+    g_assert_cmpint (qcdm_result_get_u32 (result, "foobar", &num32), ==, -QCDM_ERROR_VALUE_NOT_FOUND);
+
+    qcdm_result_unref (result);
+}
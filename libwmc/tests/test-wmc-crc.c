@@ -63,3 +63,54 @@ test_crc16_1 (void *f, void *data)
     g_assert (crc == expected);
 }
 
+static guint16
+crc16_bitwise (const char *buf, gsize len)
+{
+    guint16 crc = 0xFFFF;
+    guint i;
+
+    while (len--) {
+        crc ^= (guint8) *buf++;
+        for (i = 0; i < 8; i++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : (crc >> 1);
+    }
+    return ~crc;
+}
+
+#define CRC_PERF_BUF_LEN (64 * 1024)
+
+void
+test_crc16_throughput (void *f, void *data)
+{
+    char *buf;
+    gsize len, offset;
+    GTimer *timer;
+    guint i, iterations;
+    volatile guint16 crc = 0;
+    double mibs;
+
+    buf = g_malloc (CRC_PERF_BUF_LEN);
+    for (i = 0; i < CRC_PERF_BUF_LEN; i++)
+        buf[i] = g_random_int_range (0, 256);
+
+    /* Every tail length and alignment must match the byte-at-a-time CRC */
+    for (offset = 0; offset < 8; offset++) {
+        for (len = 0; len < 64; len++)
+            g_assert_cmpuint (wmc_crc16 (buf + offset, len, 0), ==, crc16_bitwise (buf + offset, len));
+    }
+    g_assert_cmpuint (wmc_crc16 (buf, CRC_PERF_BUF_LEN, 0), ==, crc16_bitwise (buf, CRC_PERF_BUF_LEN));
+
+    if (g_test_perf ()) {
+        iterations = 1000;
+        timer = g_timer_new ();
+        for (i = 0; i < iterations; i++)
+            crc ^= wmc_crc16 (buf, CRC_PERF_BUF_LEN, 0);
+        g_timer_stop (timer);
+        mibs = (double) CRC_PERF_BUF_LEN * iterations / (1024 * 1024);
+        mibs /= g_timer_elapsed (timer, NULL);
+        g_test_maximized_result (mibs, "CRC-16 throughput: %.1f MiB/s", mibs);
+        g_timer_destroy (timer);
+    }
+
+    g_free (buf);
+}
@@ -163,3 +163,61 @@ test_escape_unescape_ctrl (void *f, void *data)
     g_assert (memcmp (unescaped, data_ctrl_src, unlen) == 0);
 }
 
+#define ESCAPE_PERF_BUF_LEN (64 * 1024)
+
+void
+test_escape_throughput (void *f, void *data)
+{
+    char *buf, *escaped, *unescaped;
+    gsize len, unlen, needed;
+    GTimer *timer;
+    guint i, iterations;
+    wmcbool escaping = FALSE;
+    double mibs;
+
+    /* Mostly plain data with the occasional byte that needs escaping */
+    buf = g_malloc (ESCAPE_PERF_BUF_LEN);
+    for (i = 0; i < ESCAPE_PERF_BUF_LEN; i++) {
+        if (g_random_int_range (0, 64) == 0)
+            buf[i] = g_random_boolean () ? 0x7E : 0x7D;
+        else
+            buf[i] = g_random_int_range (0x21, 0x7D);
+    }
+
+    needed = ESCAPE_PERF_BUF_LEN + 1;
+    for (i = 0; i < ESCAPE_PERF_BUF_LEN; i++) {
+        if (buf[i] == 0x7E || buf[i] == 0x7D)
+            needed++;
+    }
+
+    escaped = g_malloc (ESCAPE_PERF_BUF_LEN * 2);
+    unescaped = g_malloc (ESCAPE_PERF_BUF_LEN * 2);
+
+    /* Output must have room for the escaped data plus the trailer */
+    g_assert_cmpuint (hdlc_escape (buf, ESCAPE_PERF_BUF_LEN, FALSE, escaped, needed - 1), ==, 0);
+    len = hdlc_escape (buf, ESCAPE_PERF_BUF_LEN, FALSE, escaped, needed);
+    g_assert_cmpuint (len, ==, needed - 1);
+
+    unlen = hdlc_unescape (escaped, len, unescaped, ESCAPE_PERF_BUF_LEN * 2, &escaping);
+    g_assert_cmpuint (unlen, ==, ESCAPE_PERF_BUF_LEN);
+    g_assert (memcmp (unescaped, buf, unlen) == 0);
+    g_assert (escaping == FALSE);
+
+    if (g_test_perf ()) {
+        iterations = 1000;
+        timer = g_timer_new ();
+        for (i = 0; i < iterations; i++) {
+            len = hdlc_escape (buf, ESCAPE_PERF_BUF_LEN, FALSE, escaped, ESCAPE_PERF_BUF_LEN * 2);
+            hdlc_unescape (escaped, len, unescaped, ESCAPE_PERF_BUF_LEN * 2, &escaping);
+        }
+        g_timer_stop (timer);
+        mibs = (double) ESCAPE_PERF_BUF_LEN * iterations / (1024 * 1024);
+        mibs /= g_timer_elapsed (timer, NULL);
+        g_test_maximized_result (mibs, "Escape + unescape throughput: %.1f MiB/s", mibs);
+        g_timer_destroy (timer);
+    }
+
+    g_free (buf);
+    g_free (escaped);
+    g_free (unescaped);
+}
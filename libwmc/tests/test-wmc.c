@@ -86,11 +86,13 @@ int main (int argc, char **argv)
     suite = g_test_get_root ();
     g_test_suite_add (suite, TESTCASE (test_crc16_1, NULL));
     g_test_suite_add (suite, TESTCASE (test_crc16_2, NULL));
+    g_test_suite_add (suite, TESTCASE (test_crc16_throughput, NULL));
     g_test_suite_add (suite, TESTCASE (test_escape1, NULL));
     g_test_suite_add (suite, TESTCASE (test_escape2, NULL));
     g_test_suite_add (suite, TESTCASE (test_escape_ctrl, NULL));
     g_test_suite_add (suite, TESTCASE (test_escape_unescape, NULL));
     g_test_suite_add (suite, TESTCASE (test_escape_unescape_ctrl, NULL));
+    g_test_suite_add (suite, TESTCASE (test_escape_throughput, NULL));
     g_test_suite_add (suite, TESTCASE (test_utils_decapsulate_basic_buffer, NULL));
     g_test_suite_add (suite, TESTCASE (test_utils_encapsulate_basic_buffer, NULL));
     g_test_suite_add (suite, TESTCASE (test_utils_decapsulate_sierra_cns, NULL));
@@ -124,7 +124,8 @@ cache_port_mode (MMDevice *device,
 
 static void
 getportmode_ready (MMAtSerialPort *port,
-                   GString *response,
+                   const gchar *response,
+                   gsize response_len,
                    GError *error,
                    HuaweiCustomInitContext *ctx)
 {
@@ -151,10 +152,10 @@ getportmode_ready (MMAtSerialPort *port,
 
         /* Results are cached in the parent device object */
         device = mm_port_probe_peek_device (ctx->probe);
-        cache_port_mode (device, response->str, "PCUI:", TAG_HUAWEI_PCUI_PORT);
-        cache_port_mode (device, response->str, "MDM:",  TAG_HUAWEI_MODEM_PORT);
-        cache_port_mode (device, response->str, "NDIS:", TAG_HUAWEI_NDIS_PORT);
-        cache_port_mode (device, response->str, "DIAG:", TAG_HUAWEI_DIAG_PORT);
+        cache_port_mode (device, response, "PCUI:", TAG_HUAWEI_PCUI_PORT);
+        cache_port_mode (device, response, "MDM:",  TAG_HUAWEI_MODEM_PORT);
+        cache_port_mode (device, response, "NDIS:", TAG_HUAWEI_NDIS_PORT);
+        cache_port_mode (device, response, "DIAG:", TAG_HUAWEI_DIAG_PORT);
         g_object_set_data (G_OBJECT (device), TAG_GETPORTMODE_SUPPORTED, GUINT_TO_POINTER (TRUE));
 
         /* Mark port as being AT already */
@@ -167,7 +168,8 @@ getportmode_ready (MMAtSerialPort *port,
 
 static void
 curc_ready (MMAtSerialPort *port,
-            GString *response,
+            const gchar *response,
+            gsize response_len,
             GError *error,
             HuaweiCustomInitContext *ctx)
 {
@@ -31,6 +31,7 @@
 #include "mm-broadband-bearer-novatel-lte.h"
 #include "mm-log.h"
 #include "mm-modem-helpers.h"
+#include "mm-poll-scheduler.h"
 
 #define CONNECTION_CHECK_TIMEOUT_SEC 5
 #define QMISTATUS_TAG "$NWQMISTATUS:"
@@ -39,7 +40,7 @@ G_DEFINE_TYPE (MMBroadbandBearerNovatelLte, mm_broadband_bearer_novatel_lte, MM_
 
 struct _MMBroadbandBearerNovatelLtePrivate {
     /* timeout id for checking whether we're still connected */
-    guint connection_poller;
+    MMPollTask *connection_poller;
 };
 
 /*****************************************************************************/
@@ -150,17 +151,24 @@ poll_connection_ready (MMBaseModem *modem,
     if (!result) {
         mm_warn ("QMI connection status failed: %s", error->message);
         g_error_free (error);
+        if (bearer->priv->connection_poller)
+            mm_poll_scheduler_task_done (bearer->priv->connection_poller);
         return;
     }
 
+    if (!bearer->priv->connection_poller)
+        return;
+
+    mm_poll_scheduler_task_done (bearer->priv->connection_poller);
+
     if (is_qmistatus_disconnected (result)) {
         mm_bearer_report_disconnection (MM_BEARER (bearer));
-        g_source_remove (bearer->priv->connection_poller);
-        bearer->priv->connection_poller = 0;
+        mm_poll_scheduler_remove (bearer->priv->connection_poller);
+        bearer->priv->connection_poller = NULL;
     }
 }
 
-static gboolean
+static void
 poll_connection (MMBroadbandBearerNovatelLte *bearer)
 {
     MMBaseModem *modem = NULL;
@@ -176,8 +184,6 @@ poll_connection (MMBroadbandBearerNovatelLte *bearer)
         (GAsyncReadyCallback)poll_connection_ready,
         bearer);
     g_object_unref (modem);
-
-    return TRUE;
 }
 
 static void
@@ -204,8 +210,9 @@ connect_3gpp_qmistatus_ready (MMBaseModem *modem,
         MMBearerIpConfig *config;
 
         mm_dbg("Connected");
-        ctx->self->priv->connection_poller = g_timeout_add_seconds (CONNECTION_CHECK_TIMEOUT_SEC,
-                                                                    (GSourceFunc)poll_connection,
+        ctx->self->priv->connection_poller = mm_poll_scheduler_add ("novatel-connection-status",
+                                                                    CONNECTION_CHECK_TIMEOUT_SEC,
+                                                                    (MMPollTaskFn)poll_connection,
                                                                     ctx->self);
         config = mm_bearer_ip_config_new ();
         mm_bearer_ip_config_set_method (config, MM_BEARER_IP_METHOD_DHCP);
@@ -439,8 +446,8 @@ disconnect_3gpp (MMBroadbandBearer *self,
     MMBroadbandBearerNovatelLte *bearer = MM_BROADBAND_BEARER_NOVATEL_LTE (self);
 
     if (bearer->priv->connection_poller) {
-        g_source_remove (bearer->priv->connection_poller);
-        bearer->priv->connection_poller = 0;
+        mm_poll_scheduler_remove (bearer->priv->connection_poller);
+        bearer->priv->connection_poller = NULL;
     }
 
     ctx = detailed_disconnect_context_new (self, modem, primary, secondary,
@@ -502,7 +509,7 @@ mm_broadband_bearer_novatel_lte_init (MMBroadbandBearerNovatelLte *self)
                                               MM_TYPE_BROADBAND_BEARER_NOVATEL_LTE,
                                               MMBroadbandBearerNovatelLtePrivate);
 
-    self->priv->connection_poller = 0;
+    self->priv->connection_poller = NULL;
 }
 
 static void
@@ -511,7 +518,7 @@ finalize (GObject *object)
     MMBroadbandBearerNovatelLte *self = MM_BROADBAND_BEARER_NOVATEL_LTE (object);
 
     if (self->priv->connection_poller)
-        g_source_remove (self->priv->connection_poller);
+        mm_poll_scheduler_remove (self->priv->connection_poller);
 
     G_OBJECT_CLASS (mm_broadband_bearer_novatel_lte_parent_class)->finalize (object);
 }
@@ -75,7 +75,8 @@ static void sierra_custom_init_step (SierraCustomInitContext *ctx);
 
 static void
 gcap_ready (MMAtSerialPort *port,
-            GString *response,
+            const gchar *response,
+            gsize response_len,
             GError *error,
             SierraCustomInitContext *ctx)
 {
@@ -94,23 +95,23 @@ gcap_ready (MMAtSerialPort *port,
      * or fail PPP.  So we whitelist modems that are known to allow PPP on the
      * secondary APP ports.
      */
-    if (strstr (response->str, "APP1")) {
+    if (strstr (response, "APP1")) {
         g_object_set_data (G_OBJECT (ctx->probe), TAG_SIERRA_APP_PORT, GUINT_TO_POINTER (TRUE));
 
         /* PPP-on-APP1-port whitelist */
-        if (strstr (response->str, "C885") || strstr (response->str, "USB 306"))
+        if (strstr (response, "C885") || strstr (response, "USB 306"))
             g_object_set_data (G_OBJECT (ctx->probe), TAG_SIERRA_APP1_PPP_OK, GUINT_TO_POINTER (TRUE));
 
         /* For debugging: let users figure out if their device supports PPP
          * on the APP1 port or not.
          */
         if (getenv ("MM_SIERRA_APP1_PPP_OK")) {
-            mm_dbg ("Sierra: APP1 PPP OK '%s'", response->str);
+            mm_dbg ("Sierra: APP1 PPP OK '%s'", response);
             g_object_set_data (G_OBJECT (ctx->probe), TAG_SIERRA_APP1_PPP_OK, GUINT_TO_POINTER (TRUE));
         }
-    } else if (strstr (response->str, "APP2") ||
-               strstr (response->str, "APP3") ||
-               strstr (response->str, "APP4")) {
+    } else if (strstr (response, "APP2") ||
+               strstr (response, "APP3") ||
+               strstr (response, "APP4")) {
         /* Additional APP ports don't support most AT commands, so they cannot
          * be used as the primary port.
          */
@@ -67,7 +67,8 @@ static void x22x_custom_init_step (X22xCustomInitContext *ctx);
 
 static void
 gmr_ready (MMAtSerialPort *port,
-           GString *response,
+           const gchar *response,
+           gsize response_len,
            GError *error,
            X22xCustomInitContext *ctx)
 {
@@ -80,7 +81,7 @@ gmr_ready (MMAtSerialPort *port,
     }
 
     /* Note the lack of a ':' on the GMR; the X200 doesn't send one */
-    p = mm_strip_tag (response->str, "AT+GMR");
+    p = mm_strip_tag (response, "AT+GMR");
     if (p && *p != 'L') {
         /* X200 modems have a GMR firmware revision that starts with 'L', and
          * as far as I can tell X060s devices have a revision starting with 'C'.
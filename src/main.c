@@ -22,12 +22,15 @@
 #include <stdlib.h>
 
 #include <gio/gio.h>
+#include <glib-unix.h>
 
 #include "ModemManager.h"
 
 #include "mm-manager.h"
 #include "mm-log.h"
 #include "mm-context.h"
+#include "mm-serial-trace.h"
+#include "mm-port-probe-cache.h"
 
 #if !defined(MM_DIST_VERSION)
 # define MM_DIST_VERSION VERSION
@@ -68,6 +71,24 @@ setup_signals (void)
     sigaction (SIGINT, &action, NULL);
 }
 
+static gboolean
+dump_serial_trace_cb (gpointer unused)
+{
+    const gchar *path;
+    GError *error = NULL;
+
+    path = mm_context_get_serial_trace_file ();
+    if (!path)
+        mm_warn ("Cannot dump serial trace: no trace file given");
+    else if (!mm_serial_trace_dump_to_file (path, &error)) {
+        mm_warn ("Couldn't dump serial trace: %s", error->message);
+        g_error_free (error);
+    } else
+        mm_info ("Serial trace dumped to '%s'", path);
+
+    return TRUE;
+}
+
 static void
 bus_acquired_cb (GDBusConnection *connection,
                  const gchar *name,
@@ -139,8 +160,23 @@ main (int argc, char *argv[])
         exit (1);
     }
 
+    if (!mm_log_setup_buffering (mm_context_get_log_flush_interval (),
+                                 mm_context_get_log_flush_size (),
+                                 mm_context_get_log_flush_level (),
+                                 &err)) {
+        g_warning ("Failed to set up log buffering: %s", err->message);
+        g_error_free (err);
+        exit (1);
+    }
+
     setup_signals ();
 
+    mm_serial_trace_setup (mm_context_get_serial_trace_size ());
+    g_unix_signal_add (SIGUSR2, dump_serial_trace_cb, NULL);
+
+    if (mm_context_get_probe_cache_file ())
+        mm_port_probe_cache_setup (mm_context_get_probe_cache_file ());
+
     mm_info ("ModemManager (version " MM_DIST_VERSION ") starting...");
 
     /* Acquire name, don't allow replacement */
@@ -194,6 +230,9 @@ main (int argc, char *argv[])
 
     mm_info ("ModemManager is shut down");
 
+    mm_serial_trace_shutdown ();
+    mm_port_probe_cache_shutdown ();
+
     mm_log_shutdown ();
 
     return 0;
@@ -41,6 +41,8 @@ typedef struct {
     GDestroyNotify response_parser_notify;
 
     GSList *unsolicited_msg_handlers;
+    /* Handlers with a literal prefix, indexed by its first bytes */
+    GHashTable *unsolicited_msg_index;
 
     MMAtPortFlag flags;
 
@@ -94,19 +96,22 @@ mm_at_serial_port_set_response_parser (MMAtSerialPort *self,
 }
 
 void
-mm_at_serial_port_remove_echo (GByteArray *response)
+mm_at_serial_port_remove_echo (MMSerialBuffer *response)
 {
+    const guint8 *data;
+    gsize len;
     guint i;
 
-    if (response->len <= 2)
+    data = mm_serial_buffer_peek (response, &len);
+    if (len <= 2)
         return;
 
-    for (i = 0; i < (response->len - 1); i++) {
+    for (i = 0; i < (len - 1); i++) {
         /* If there is any content before the first
          * <CR><LF>, assume it's echo or garbage, and skip it */
-        if (response->data[i] == '\r' && response->data[i + 1] == '\n') {
+        if (data[i] == '\r' && data[i + 1] == '\n') {
             if (i > 0)
-                g_byte_array_remove_range (response, 0, i);
+                mm_serial_buffer_consume (response, i);
             /* else, good, we're already started with <CR><LF> */
             break;
         }
@@ -114,12 +119,14 @@ mm_at_serial_port_remove_echo (GByteArray *response)
 }
 
 static gboolean
-parse_response (MMSerialPort *port, GByteArray *response, GError **error)
+parse_response (MMSerialPort *port, MMSerialBuffer *response, GError **error)
 {
     MMAtSerialPort *self = MM_AT_SERIAL_PORT (port);
     MMAtSerialPortPrivate *priv = MM_AT_SERIAL_PORT_GET_PRIVATE (self);
-    gboolean found;
-    GString *string;
+    const guint8 *data;
+    gsize len;
+    gsize reply_start = 0;
+    gsize reply_len = 0;
 
     g_return_val_if_fail (priv->response_parser_fn != NULL, FALSE);
 
@@ -127,41 +134,49 @@ parse_response (MMSerialPort *port, GByteArray *response, GError **error)
     if (priv->remove_echo)
         mm_at_serial_port_remove_echo (response);
 
-    /* Construct the string that AT-parsing functions expect */
-    string = g_string_sized_new (response->len + 1);
-    g_string_append_len (string, (const char *) response->data, response->len);
-
-    /* Parse it */
-    found = priv->response_parser_fn (priv->response_parser_user_data, string, error);
-
-    /* And copy it back into the response array after the parser has removed
-     * matches and cleaned it up.
-     */
-    if (response->len)
-        g_byte_array_remove_range (response, 0, response->len);
-    g_byte_array_append (response, (const guint8 *) string->str, string->len);
-    g_string_free (string, TRUE);
-    return found;
+    /* Parse it in place; the parser just tells us where the reply is */
+    data = mm_serial_buffer_peek (response, &len);
+    if (!priv->response_parser_fn (priv->response_parser_user_data,
+                                   (const gchar *) data, len,
+                                   &reply_start, &reply_len,
+                                   error))
+        return FALSE;
+
+    g_assert (reply_start + reply_len <= len);
+
+    /* Leave only the reply in the buffer, dropping the final result code and
+     * the surrounding <CR><LF>s. Removing from the end is cheap, and removing
+     * from the beginning just advances the read index. */
+    mm_serial_buffer_remove_range (response,
+                                   reply_start + reply_len,
+                                   len - reply_start - reply_len);
+    mm_serial_buffer_consume (response, reply_start);
+    return TRUE;
 }
 
 static gsize
 handle_response (MMSerialPort *port,
-                 GByteArray *response,
+                 MMSerialBuffer *response,
                  GError *error,
                  GCallback callback,
                  gpointer callback_data)
 {
     MMAtSerialPort *self = MM_AT_SERIAL_PORT (port);
     MMAtSerialResponseFn response_callback = (MMAtSerialResponseFn) callback;
-    GString *string;
+    const guint8 *data;
+    gsize len;
 
-    /* Convert to a string and call the callback */
-    string = g_string_sized_new (response->len + 1);
-    g_string_append_len (string, (const char *) response->data, response->len);
-    response_callback (self, string, error, callback_data);
-    g_string_free (string, TRUE);
+    /* No response at all, e.g. if the port got closed */
+    if (!response) {
+        response_callback (self, NULL, 0, error, callback_data);
+        return 0;
+    }
+
+    /* The callback gets a borrowed view of the buffer */
+    data = mm_serial_buffer_peek (response, &len);
+    response_callback (self, (const gchar *) data, len, error, callback_data);
 
-    return response->len;
+    return len;
 }
 
 /*****************************************************************************/
@@ -171,8 +186,76 @@ typedef struct {
     MMAtSerialUnsolicitedMsgFn callback;
     gpointer user_data;
     GDestroyNotify notify;
+
+    /* Literal text the regex matches right after a <CR><LF>, if any */
+    gchar *prefix;
+    gsize prefix_len;
+    /* Whether the prefix was found in the data being parsed */
+    gboolean candidate;
 } MMAtUnsolicitedMsgHandler;
 
+/* Number of prefix bytes used as key in the index */
+#define UNSOLICITED_MSG_KEY_LEN 3
+
+#define UNSOLICITED_MSG_KEY(str)                \
+    GUINT_TO_POINTER (((guint8) (str)[0])       | \
+                      ((guint8) (str)[1] << 8)  | \
+                      ((guint8) (str)[2] << 16))
+
+gchar *
+mm_at_serial_port_get_unsolicited_msg_prefix (GRegex *regex)
+{
+    const gchar *p;
+    GString *prefix;
+
+    g_return_val_if_fail (regex != NULL, NULL);
+
+    /* Literals wouldn't match byte by byte with these */
+    if (g_regex_get_compile_flags (regex) & (G_REGEX_CASELESS | G_REGEX_EXTENDED))
+        return NULL;
+
+    /* Only unsolicited messages starting a line can be indexed; and don't
+     * bother with alternations, the prefix may not apply to all branches */
+    p = g_regex_get_pattern (regex);
+    if (!g_str_has_prefix (p, "\\r\\n") || strchr (p, '|'))
+        return NULL;
+    p += 4;
+
+    prefix = g_string_new (NULL);
+    while (*p) {
+        gchar c;
+
+        if (*p == '\\') {
+            /* Escaped punctuation is a literal, anything else (\d, \s...)
+             * is not */
+            if (!g_ascii_ispunct (p[1]))
+                break;
+            c = p[1];
+            p += 2;
+        } else if (strchr (".[]()^$?*+{}", *p) || !g_ascii_isprint (*p))
+            break;
+        else
+            c = *p++;
+
+        /* The character may not be there at all */
+        if (*p == '?' || *p == '*' || *p == '{')
+            break;
+
+        g_string_append_c (prefix, c);
+
+        /* It is there, but we don't know how many times */
+        if (*p == '+')
+            break;
+    }
+
+    if (prefix->len < UNSOLICITED_MSG_KEY_LEN) {
+        g_string_free (prefix, TRUE);
+        return NULL;
+    }
+
+    return g_string_free (prefix, FALSE);
+}
+
 static gint
 unsolicited_msg_handler_cmp (MMAtUnsolicitedMsgHandler *handler,
                              GRegex *regex)
@@ -181,6 +264,28 @@ unsolicited_msg_handler_cmp (MMAtUnsolicitedMsgHandler *handler,
                       g_regex_get_pattern (regex));
 }
 
+static void
+unsolicited_msg_index_add (MMAtSerialPortPrivate *priv,
+                           MMAtUnsolicitedMsgHandler *handler)
+{
+    gpointer key;
+    GSList *list;
+
+    if (!priv->unsolicited_msg_index)
+        priv->unsolicited_msg_index = g_hash_table_new_full (g_direct_hash,
+                                                             g_direct_equal,
+                                                             NULL,
+                                                             (GDestroyNotify) g_slist_free);
+
+    key = UNSOLICITED_MSG_KEY (handler->prefix);
+    list = g_hash_table_lookup (priv->unsolicited_msg_index, key);
+    if (list)
+        /* Not the head, so the list stored in the table is still valid */
+        list = g_slist_append (list, handler);
+    else
+        g_hash_table_insert (priv->unsolicited_msg_index, key, g_slist_append (NULL, handler));
+}
+
 void
 mm_at_serial_port_add_unsolicited_msg_handler (MMAtSerialPort *self,
                                                GRegex *regex,
@@ -206,9 +311,14 @@ mm_at_serial_port_add_unsolicited_msg_handler (MMAtSerialPort *self,
         if (handler->notify)
             handler->notify (handler->user_data);
     } else {
-        handler = g_slice_new (MMAtUnsolicitedMsgHandler);
+        handler = g_slice_new0 (MMAtUnsolicitedMsgHandler);
         priv->unsolicited_msg_handlers = g_slist_append (priv->unsolicited_msg_handlers, handler);
         handler->regex = g_regex_ref (regex);
+        handler->prefix = mm_at_serial_port_get_unsolicited_msg_prefix (regex);
+        if (handler->prefix) {
+            handler->prefix_len = strlen (handler->prefix);
+            unsolicited_msg_index_add (priv, handler);
+        }
     }
 
     handler->callback = callback;
@@ -216,65 +326,178 @@ mm_at_serial_port_add_unsolicited_msg_handler (MMAtSerialPort *self,
     handler->notify = notify;
 }
 
+/* Flag the indexed handlers whose prefix follows any <CR><LF> in the data;
+ * the others cannot match. */
+static void
+unsolicited_msg_find_candidates (MMAtSerialPortPrivate *priv,
+                                 const gchar *data,
+                                 gsize len)
+{
+    const gchar *end = data + len;
+    const gchar *p;
+    GSList *iter;
+
+    for (iter = priv->unsolicited_msg_handlers; iter; iter = iter->next)
+        ((MMAtUnsolicitedMsgHandler *) iter->data)->candidate = FALSE;
+
+    if (!priv->unsolicited_msg_index)
+        return;
+
+    for (p = memchr (data, '\r', len); p; p = memchr (p + 1, '\r', end - p - 1)) {
+        const gchar *line;
+
+        line = p + 2;
+        if (line + UNSOLICITED_MSG_KEY_LEN > end)
+            break;
+        if (p[1] != '\n')
+            continue;
+
+        for (iter = g_hash_table_lookup (priv->unsolicited_msg_index, UNSOLICITED_MSG_KEY (line));
+             iter;
+             iter = iter->next) {
+            MMAtUnsolicitedMsgHandler *handler = (MMAtUnsolicitedMsgHandler *) iter->data;
+
+            if (!handler->candidate &&
+                handler->prefix_len <= (gsize) (end - line) &&
+                memcmp (line, handler->prefix, handler->prefix_len) == 0)
+                handler->candidate = TRUE;
+        }
+    }
+}
+
+/* Keep the matches sorted, and reject those overlapping a previous one: that
+ * text was already processed (and would have been removed) by an earlier
+ * handler */
 static gboolean
-remove_eval_cb (const GMatchInfo *match_info,
-                GString *result,
-                gpointer user_data)
+unsolicited_msg_add_match (GArray *matches,
+                           gsize start,
+                           gsize end)
 {
-    int *result_len = (int *) user_data;
-    int start;
-    int end;
+    MMSerialBufferRange range;
+    guint i;
 
-    if (g_match_info_fetch_pos  (match_info, 0, &start, &end))
-        *result_len -= (end - start);
+    for (i = 0; i < matches->len; i++) {
+        MMSerialBufferRange *existing = &g_array_index (matches, MMSerialBufferRange, i);
+
+        if (start < existing->offset + existing->len && end > existing->offset)
+            return FALSE;
+        if (end <= existing->offset)
+            break;
+    }
 
-    return FALSE;
+    range.offset = start;
+    range.len = end - start;
+    g_array_insert_val (matches, i, range);
+    return TRUE;
 }
 
+/* Commands resetting the device state, which invalidate every cached reply */
+static const gchar *reset_commands[] = {
+    "Z", "&F", "+CFUN", NULL
+};
+
+/* Unsolicited messages reporting a change in the replies of other commands */
+static const struct {
+    const gchar *unsolicited;
+    const gchar *invalidates[3];
+} unsolicited_invalidations[] = {
+    { "+CREG:",  { "AT+CREG?",  "AT+COPS?", NULL } },
+    { "+CGREG:", { "AT+CGREG?", "AT+COPS?", NULL } },
+    { "+CEREG:", { "AT+CEREG?", "AT+COPS?", NULL } },
+    { "+CIEV:",  { "AT+CIND?",  "AT+CSQ",   NULL } },
+};
+
+/* Commands changing the replies of other commands, besides their own read
+ * command (e.g. AT+COPS=2 deregisters, so AT+CREG? changes too) */
+static const struct {
+    const gchar *command;
+    const gchar *invalidates[5];
+} command_invalidations[] = {
+    { "+COPS=",  { "AT+CREG?", "AT+CGREG?", "AT+CEREG?", "AT+COPS?", NULL } },
+    { "+CGATT=", { "AT+CREG?", "AT+CGREG?", "AT+CEREG?", "AT+COPS?", NULL } },
+};
+
 static void
-parse_unsolicited (MMSerialPort *port, GByteArray *response)
+unsolicited_msg_invalidate_cached_replies (MMAtSerialPort *self,
+                                           const gchar *msg,
+                                           gsize len)
+{
+    guint i, j;
+
+    while (len && (*msg == '\r' || *msg == '\n')) {
+        msg++;
+        len--;
+    }
+
+    for (i = 0; i < G_N_ELEMENTS (unsolicited_invalidations); i++) {
+        gsize prefix_len = strlen (unsolicited_invalidations[i].unsolicited);
+
+        if (len < prefix_len || memcmp (msg, unsolicited_invalidations[i].unsolicited, prefix_len) != 0)
+            continue;
+
+        for (j = 0; unsolicited_invalidations[i].invalidates[j]; j++)
+            mm_at_serial_port_invalidate_cached_replies (self, unsolicited_invalidations[i].invalidates[j]);
+        return;
+    }
+}
+
+static void
+parse_unsolicited (MMSerialPort *port, MMSerialBuffer *response)
 {
     MMAtSerialPort *self = MM_AT_SERIAL_PORT (port);
     MMAtSerialPortPrivate *priv = MM_AT_SERIAL_PORT_GET_PRIVATE (self);
+    GArray *matches = NULL;
+    const gchar *data;
+    gsize len;
     GSList *iter;
 
     /* Remove echo */
     if (priv->remove_echo)
         mm_at_serial_port_remove_echo (response);
 
+    data = (const gchar *) mm_serial_buffer_peek (response, &len);
+    if (!len)
+        return;
+
+    unsolicited_msg_find_candidates (priv, data, len);
+
+    /* All handlers run on the same data, so that the buffer is compacted once
+     * at the end instead of after each handler with matches */
     for (iter = priv->unsolicited_msg_handlers; iter; iter = iter->next) {
         MMAtUnsolicitedMsgHandler *handler = (MMAtUnsolicitedMsgHandler *) iter->data;
         GMatchInfo *match_info;
-        gboolean matches;
-
-        matches = g_regex_match_full (handler->regex,
-                                      (const char *) response->data,
-                                      response->len,
-                                      0, 0, &match_info, NULL);
-        if (handler->callback) {
-            while (g_match_info_matches (match_info)) {
-                handler->callback (self, match_info, handler->user_data);
-                g_match_info_next (match_info, NULL);
-            }
-        }
 
-        g_match_info_free (match_info);
+        if (handler->prefix && !handler->candidate)
+            continue;
+
+        g_regex_match_full (handler->regex, data, len, 0, 0, &match_info, NULL);
+        while (g_match_info_matches (match_info)) {
+            gint start;
+            gint end;
 
-        if (matches) {
-            /* Remove matches */
-            char *str;
-            int result_len = response->len;
+            if (!g_match_info_fetch_pos (match_info, 0, &start, &end))
+                break;
 
-            str = g_regex_replace_eval (handler->regex,
-                                        (const char *) response->data,
-                                        response->len,
-                                        0, 0,
-                                        remove_eval_cb, &result_len, NULL);
+            if (!matches)
+                matches = g_array_new (FALSE, FALSE, sizeof (MMSerialBufferRange));
 
-            g_byte_array_remove_range (response, 0, response->len);
-            g_byte_array_append (response, (const guint8 *) str, result_len);
-            g_free (str);
+            if (start == end || unsolicited_msg_add_match (matches, start, end)) {
+                unsolicited_msg_invalidate_cached_replies (self, data + start, end - start);
+                if (handler->callback)
+                    handler->callback (self, match_info, handler->user_data);
+            }
+
+            g_match_info_next (match_info, NULL);
         }
+
+        g_match_info_free (match_info);
+    }
+
+    if (matches) {
+        mm_serial_buffer_remove_ranges (response,
+                                        (MMSerialBufferRange *) matches->data,
+                                        matches->len);
+        g_array_free (matches, TRUE);
     }
 }
 
@@ -308,16 +531,154 @@ at_command_to_byte_array (const char *command, gboolean is_raw)
     return buf;
 }
 
+/* Commands which don't follow the default priority. All the background ones
+ * are periodic polls which don't change the state of the device, and their
+ * replies are reused during the given number of seconds, unless invalidated
+ * earlier by an unsolicited message or by a command changing the same
+ * setting. */
+static const struct {
+    const gchar *command;
+    MMSerialCommandPriority priority;
+    guint cache_ttl;
+} command_priorities[] = {
+    { "+CMGS",   MM_SERIAL_COMMAND_PRIORITY_INTERACTIVE, 0 },
+    { "+CMGW",   MM_SERIAL_COMMAND_PRIORITY_INTERACTIVE, 0 },
+    { "+CMSS",   MM_SERIAL_COMMAND_PRIORITY_INTERACTIVE, 0 },
+    { "+CMGR",   MM_SERIAL_COMMAND_PRIORITY_INTERACTIVE, 0 },
+    { "+CMGD",   MM_SERIAL_COMMAND_PRIORITY_INTERACTIVE, 0 },
+    { "+CUSD",   MM_SERIAL_COMMAND_PRIORITY_INTERACTIVE, 0 },
+    { "+CPIN=",  MM_SERIAL_COMMAND_PRIORITY_INTERACTIVE, 0 },
+    { "+CLCK=",  MM_SERIAL_COMMAND_PRIORITY_INTERACTIVE, 0 },
+    { "+CPWD=",  MM_SERIAL_COMMAND_PRIORITY_INTERACTIVE, 0 },
+    { "+CSQ",    MM_SERIAL_COMMAND_PRIORITY_BACKGROUND,  3 },
+    { "+CIND?",  MM_SERIAL_COMMAND_PRIORITY_BACKGROUND,  3 },
+    { "+CBC",    MM_SERIAL_COMMAND_PRIORITY_BACKGROUND,  10 },
+    { "+CREG?",  MM_SERIAL_COMMAND_PRIORITY_BACKGROUND,  5 },
+    { "+CGREG?", MM_SERIAL_COMMAND_PRIORITY_BACKGROUND,  5 },
+    { "+CEREG?", MM_SERIAL_COMMAND_PRIORITY_BACKGROUND,  5 },
+    { "+COPS?",  MM_SERIAL_COMMAND_PRIORITY_BACKGROUND,  5 },
+};
+
+/* Execution commands which just report information */
+static const gchar *read_only_commands[] = {
+    "+CGSN", "+GSN", "+CGMI", "+GMI", "+CGMM", "+GMM", "+CGMR", "+GMR", "+CIMI", "I", NULL
+};
+
+static void
+classify_command (const GByteArray *buf,
+                  MMSerialCommandPriority *priority,
+                  guint *cache_ttl,
+                  gboolean *read_only)
+{
+    const gchar *cmd;
+    gsize len;
+    guint i;
+
+    *priority = MM_SERIAL_COMMAND_PRIORITY_DEFAULT;
+    *cache_ttl = 0;
+    *read_only = FALSE;
+
+    /* Skip the leading AT and trailing <CR> */
+    if (buf->len < 3)
+        return;
+    cmd = (const gchar *) buf->data + 2;
+    len = buf->len - 3;
+    if (len == 0)
+        return;
+
+    for (i = 0; i < G_N_ELEMENTS (command_priorities); i++) {
+        gsize prefix_len = strlen (command_priorities[i].command);
+
+        if (len >= prefix_len &&
+            g_ascii_strncasecmp (cmd, command_priorities[i].command, prefix_len) == 0) {
+            *priority = command_priorities[i].priority;
+            *cache_ttl = command_priorities[i].cache_ttl;
+            break;
+        }
+    }
+
+    /* Read and test commands, and background polls */
+    if (cmd[len - 1] == '?' || *priority == MM_SERIAL_COMMAND_PRIORITY_BACKGROUND) {
+        *read_only = TRUE;
+        return;
+    }
+
+    for (i = 0; read_only_commands[i]; i++) {
+        if (strlen (read_only_commands[i]) == len &&
+            g_ascii_strncasecmp (cmd, read_only_commands[i], len) == 0) {
+            *read_only = TRUE;
+            return;
+        }
+    }
+}
+
+/* A command changing the device state makes stale the cached replies of the
+ * commands reading the same setting */
+static void
+invalidate_cached_replies_for_command (MMAtSerialPort *self,
+                                       const GByteArray *buf)
+{
+    const guint8 *cmd;
+    gsize len;
+    guint i, j;
+
+    /* Skip the leading AT and trailing <CR> */
+    if (buf->len < 3)
+        return;
+    cmd = buf->data + 2;
+    len = buf->len - 3;
+
+    for (i = 0; i < G_N_ELEMENTS (command_invalidations); i++) {
+        gsize prefix_len = strlen (command_invalidations[i].command);
+
+        if (len < prefix_len ||
+            g_ascii_strncasecmp ((const gchar *) cmd, command_invalidations[i].command, prefix_len) != 0)
+            continue;
+
+        for (j = 0; command_invalidations[i].invalidates[j]; j++)
+            mm_at_serial_port_invalidate_cached_replies (self, command_invalidations[i].invalidates[j]);
+    }
+
+    for (i = 0; reset_commands[i]; i++) {
+        if (len >= strlen (reset_commands[i]) &&
+            g_ascii_strncasecmp ((const gchar *) cmd, reset_commands[i], strlen (reset_commands[i])) == 0) {
+            mm_serial_port_invalidate_cached_replies (MM_SERIAL_PORT (self), (const guint8 *) "AT", 2);
+            return;
+        }
+    }
+
+    /* e.g. AT+COPS=... invalidates AT+COPS? */
+    for (i = 0; i < len && cmd[i] != '=' && cmd[i] != ';'; i++);
+    if (i < len && cmd[i] == '=')
+        mm_serial_port_invalidate_cached_replies (MM_SERIAL_PORT (self), buf->data, 2 + i);
+}
+
 void
-mm_at_serial_port_queue_command (MMAtSerialPort *self,
-                                 const char *command,
-                                 guint32 timeout_seconds,
-                                 gboolean is_raw,
-                                 GCancellable *cancellable,
-                                 MMAtSerialResponseFn callback,
-                                 gpointer user_data)
+mm_at_serial_port_invalidate_cached_replies (MMAtSerialPort *self,
+                                             const gchar *command)
+{
+    g_return_if_fail (MM_IS_AT_SERIAL_PORT (self));
+    g_return_if_fail (command != NULL);
+
+    mm_serial_port_invalidate_cached_replies (MM_SERIAL_PORT (self),
+                                              (const guint8 *) command,
+                                              strlen (command));
+}
+
+static void
+queue_command (MMAtSerialPort *self,
+               const char *command,
+               gboolean cached,
+               guint32 timeout_seconds,
+               gboolean is_raw,
+               GCancellable *cancellable,
+               MMAtSerialResponseFn callback,
+               gpointer user_data)
 {
     GByteArray *buf;
+    MMSerialCommandPriority priority = MM_SERIAL_COMMAND_PRIORITY_DEFAULT;
+    guint cache_ttl = 0;
+    gboolean read_only = FALSE;
 
     g_return_if_fail (self != NULL);
     g_return_if_fail (MM_IS_AT_SERIAL_PORT (self));
@@ -326,13 +687,47 @@ mm_at_serial_port_queue_command (MMAtSerialPort *self,
     buf = at_command_to_byte_array (command, is_raw);
     g_return_if_fail (buf != NULL);
 
-    mm_serial_port_queue_command (MM_SERIAL_PORT (self),
-                                  buf,
-                                  TRUE,
-                                  timeout_seconds,
-                                  cancellable,
-                                  (MMSerialResponseFn) callback,
-                                  user_data);
+    /* Raw data completes the command just run (e.g. the PDU after the
+     * AT+CMGS prompt), so nothing else may be sent before it */
+    if (is_raw)
+        priority = MM_SERIAL_COMMAND_PRIORITY_CONTINUATION;
+    else {
+        classify_command (buf, &priority, &cache_ttl, &read_only);
+        if (!read_only)
+            invalidate_cached_replies_for_command (self, buf);
+    }
+
+    /* Replies explicitly requested to be cached are kept forever, others only
+     * for a while if the command allows it */
+    if (cached)
+        cache_ttl = 0;
+    else if (cache_ttl)
+        cached = TRUE;
+
+    /* Identical queries queued at the same time are sent only once */
+    mm_serial_port_queue_command_full (MM_SERIAL_PORT (self),
+                                       buf,
+                                       TRUE,
+                                       cached,
+                                       cache_ttl,
+                                       priority,
+                                       read_only,
+                                       timeout_seconds,
+                                       cancellable,
+                                       (MMSerialResponseFn) callback,
+                                       user_data);
+}
+
+void
+mm_at_serial_port_queue_command (MMAtSerialPort *self,
+                                 const char *command,
+                                 guint32 timeout_seconds,
+                                 gboolean is_raw,
+                                 GCancellable *cancellable,
+                                 MMAtSerialResponseFn callback,
+                                 gpointer user_data)
+{
+    queue_command (self, command, FALSE, timeout_seconds, is_raw, cancellable, callback, user_data);
 }
 
 void
@@ -344,22 +739,7 @@ mm_at_serial_port_queue_command_cached (MMAtSerialPort *self,
                                         MMAtSerialResponseFn callback,
                                         gpointer user_data)
 {
-    GByteArray *buf;
-
-    g_return_if_fail (self != NULL);
-    g_return_if_fail (MM_IS_AT_SERIAL_PORT (self));
-    g_return_if_fail (command != NULL);
-
-    buf = at_command_to_byte_array (command, is_raw);
-    g_return_if_fail (buf != NULL);
-
-    mm_serial_port_queue_command_cached (MM_SERIAL_PORT (self),
-                                         buf,
-                                         TRUE,
-                                         timeout_seconds,
-                                         cancellable,
-                                         (MMSerialResponseFn) callback,
-                                         user_data);
+    queue_command (self, command, TRUE, timeout_seconds, is_raw, cancellable, callback, user_data);
 }
 
 static void
@@ -481,11 +861,15 @@ finalize (GObject *object)
             handler->notify (handler->user_data);
 
         g_regex_unref (handler->regex);
+        g_free (handler->prefix);
         g_slice_free (MMAtUnsolicitedMsgHandler, handler);
         priv->unsolicited_msg_handlers = g_slist_delete_link (priv->unsolicited_msg_handlers,
                                                               priv->unsolicited_msg_handlers);
     }
 
+    if (priv->unsolicited_msg_index)
+        g_hash_table_destroy (priv->unsolicited_msg_index);
+
     if (priv->response_parser_notify)
         priv->response_parser_notify (priv->response_parser_user_data);
 
@@ -52,16 +52,25 @@ typedef enum { /*< underscore_name=mm_at_port_flag >*/
     MM_AT_PORT_FLAG_GPS_CONTROL = 1 << 3,
 } MMAtPortFlag;
 
+/* Parsers get a view of the received data and, when a complete reply is
+ * found, return its bounds within it (without the final result code) instead
+ * of modifying the data. */
 typedef gboolean (*MMAtSerialResponseParserFn) (gpointer user_data,
-                                                GString *response,
+                                                const gchar *response,
+                                                gsize response_len,
+                                                gsize *reply_start,
+                                                gsize *reply_len,
                                                 GError **error);
 
 typedef void (*MMAtSerialUnsolicitedMsgFn) (MMAtSerialPort *port,
                                             GMatchInfo *match_info,
                                             gpointer user_data);
 
+/* The response is NUL-terminated and only valid during the callback; it may
+ * be NULL if the command couldn't be sent at all. */
 typedef void (*MMAtSerialResponseFn)     (MMAtSerialPort *port,
-                                          GString *response,
+                                          const gchar *response,
+                                          gsize response_len,
                                           GError *error,
                                           gpointer user_data);
 
@@ -90,6 +99,9 @@ void     mm_at_serial_port_set_response_parser (MMAtSerialPort *self,
                                                 gpointer user_data,
                                                 GDestroyNotify notify);
 
+/* Periodic polls such as AT+CSQ or AT+CREG? are answered from a reply cache
+ * for a few seconds; replies get dropped earlier on related unsolicited
+ * messages, on commands changing the same setting, and on resets. */
 void     mm_at_serial_port_queue_command     (MMAtSerialPort *self,
                                               const char *command,
                                               guint32 timeout_seconds,
@@ -106,6 +118,10 @@ void     mm_at_serial_port_queue_command_cached (MMAtSerialPort *self,
                                                  MMAtSerialResponseFn callback,
                                                  gpointer user_data);
 
+/* Drops the cached replies of all the commands starting with @command */
+void     mm_at_serial_port_invalidate_cached_replies (MMAtSerialPort *self,
+                                                      const gchar *command);
+
 /*
  * Convert a string into a quoted and escaped string. Returns a new
  * allocated string. Follows ITU V.250 5.4.2.2 "String constants".
@@ -113,7 +129,8 @@ void     mm_at_serial_port_queue_command_cached (MMAtSerialPort *self,
 gchar   *mm_at_serial_port_quote_string (const char *string);
 
 /* Just for unit tests */
-void mm_at_serial_port_remove_echo (GByteArray *response);
+void mm_at_serial_port_remove_echo (MMSerialBuffer *response);
+gchar *mm_at_serial_port_get_unsolicited_msg_prefix (GRegex *regex);
 
 void     mm_at_serial_port_set_flags (MMAtSerialPort *self,
                                       MMAtPortFlag flags);
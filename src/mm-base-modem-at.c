@@ -145,7 +145,8 @@ mm_base_modem_at_sequence_full_finish (MMBaseModem *self,
 
 static void
 at_sequence_parse_response (MMAtSerialPort *port,
-                            GString *response,
+                            const gchar *response,
+                            gsize response_len,
                             GError *error,
                             AtSequenceContext *ctx)
 {
@@ -176,7 +177,7 @@ at_sequence_parse_response (MMAtSerialPort *port,
             ctx->self,
             ctx->response_processor_context,
             ctx->current->command,
-            response ? response->str : NULL,
+            response,
             next->command ? FALSE : TRUE,  /* Last command in sequence? */
             error,
             &result,
@@ -462,7 +463,8 @@ mm_base_modem_at_command_full_finish (MMBaseModem *self,
 
 static void
 at_command_parse_response (MMAtSerialPort *port,
-                           GString *response,
+                           const gchar *response,
+                           gsize response_len,
                            GError *error,
                            AtCommandContext *ctx)
 {
@@ -478,9 +480,9 @@ at_command_parse_response (MMAtSerialPort *port,
         g_simple_async_result_set_from_error (ctx->result, error);
 
     /* Valid string response */
-    else if (response && response->str)
+    else if (response)
         g_simple_async_result_set_op_res_gpointer (ctx->result,
-                                                   g_strdup (response->str),
+                                                   g_strndup (response, response_len),
                                                    g_free);
 
     /* No response */
@@ -37,6 +37,7 @@ G_DEFINE_TYPE (MMBearerQmi, mm_bearer_qmi, MM_TYPE_BEARER);
 
 struct _MMBearerQmiPrivate {
     /* State kept while connected */
+    MMQmiPort *qmi;
     QmiClientWds *client_ipv4;
     QmiClientWds *client_ipv6;
     MMPort *data;
@@ -118,10 +119,15 @@ connect_context_complete_and_free (ConnectContext *ctx)
         g_error_free (ctx->error_ipv4);
     if (ctx->error_ipv6)
         g_error_free (ctx->error_ipv6);
-    if (ctx->client_ipv4)
+    /* Clients not kept by the bearer go back to the pool */
+    if (ctx->client_ipv4) {
+        mm_qmi_port_recycle_client (ctx->qmi, QMI_CLIENT (ctx->client_ipv4));
         g_object_unref (ctx->client_ipv4);
-    if (ctx->client_ipv6)
+    }
+    if (ctx->client_ipv6) {
+        mm_qmi_port_recycle_client (ctx->qmi, QMI_CLIENT (ctx->client_ipv6));
         g_object_unref (ctx->client_ipv6);
+    }
     g_object_unref (ctx->data);
     g_object_unref (ctx->qmi);
     g_object_unref (ctx->cancellable);
@@ -482,29 +488,27 @@ set_ip_family_ready (QmiClientWds *client,
 }
 
 static void
-qmi_port_allocate_client_ready (MMQmiPort *qmi,
-                                GAsyncResult *res,
-                                ConnectContext *ctx)
+qmi_port_acquire_client_ready (MMQmiPort *qmi,
+                               GAsyncResult *res,
+                               ConnectContext *ctx)
 {
     GError *error = NULL;
+    QmiClient *client;
 
     g_assert (ctx->running_ipv4 || ctx->running_ipv6);
     g_assert (!(ctx->running_ipv4 && ctx->running_ipv6));
 
-    if (!mm_qmi_port_allocate_client_finish (qmi, res, &error)) {
+    client = mm_qmi_port_acquire_client_finish (qmi, res, &error);
+    if (!client) {
         g_simple_async_result_take_error (ctx->result, error);
         connect_context_complete_and_free (ctx);
         return;
     }
 
     if (ctx->running_ipv4)
-        ctx->client_ipv4 = QMI_CLIENT_WDS (mm_qmi_port_get_client (qmi,
-                                                                   QMI_SERVICE_WDS,
-                                                                   MM_QMI_PORT_FLAG_WDS_IPV4));
+        ctx->client_ipv4 = QMI_CLIENT_WDS (client);
     else
-        ctx->client_ipv6 = QMI_CLIENT_WDS (mm_qmi_port_get_client (qmi,
-                                                                   QMI_SERVICE_WDS,
-                                                                   MM_QMI_PORT_FLAG_WDS_IPV6));
+        ctx->client_ipv6 = QMI_CLIENT_WDS (client);
 
     /* Keep on */
     ctx->step++;
@@ -554,6 +558,7 @@ connect_context_step (ConnectContext *ctx)
         if (!mm_qmi_port_is_open (ctx->qmi)) {
             mm_qmi_port_open (ctx->qmi,
                               TRUE,
+                              FALSE,
                               ctx->cancellable,
                               (GAsyncReadyCallback)qmi_port_open_ready,
                               ctx);
@@ -578,27 +583,15 @@ connect_context_step (ConnectContext *ctx)
         /* Just fall down */
         ctx->step++;
 
-    case CONNECT_STEP_WDS_CLIENT_IPV4: {
-        QmiClient *client;
-
-        client = mm_qmi_port_get_client (ctx->qmi,
-                                         QMI_SERVICE_WDS,
-                                         MM_QMI_PORT_FLAG_WDS_IPV4);
-        if (!client) {
-            mm_dbg ("Allocating IPv4-specific WDS client");
-            mm_qmi_port_allocate_client (ctx->qmi,
-                                         QMI_SERVICE_WDS,
-                                         MM_QMI_PORT_FLAG_WDS_IPV4,
-                                         ctx->cancellable,
-                                         (GAsyncReadyCallback)qmi_port_allocate_client_ready,
-                                         ctx);
-            return;
-        }
-
-        ctx->client_ipv4 = QMI_CLIENT_WDS (client);
-        /* Just fall down */
-        ctx->step++;
-    }
+    case CONNECT_STEP_WDS_CLIENT_IPV4:
+        mm_dbg ("Acquiring IPv4-specific WDS client");
+        mm_qmi_port_acquire_client (ctx->qmi,
+                                    QMI_SERVICE_WDS,
+                                    MM_QMI_PORT_FLAG_WDS_IPV4,
+                                    ctx->cancellable,
+                                    (GAsyncReadyCallback)qmi_port_acquire_client_ready,
+                                    ctx);
+        return;
 
     case CONNECT_STEP_IP_FAMILY_IPV4:
         /* If client is new enough, select IP family */
@@ -654,27 +647,15 @@ connect_context_step (ConnectContext *ctx)
         /* Just fall down */
         ctx->step++;
 
-    case CONNECT_STEP_WDS_CLIENT_IPV6: {
-        QmiClient *client;
-
-        client = mm_qmi_port_get_client (ctx->qmi,
-                                         QMI_SERVICE_WDS,
-                                         MM_QMI_PORT_FLAG_WDS_IPV6);
-        if (!client) {
-            mm_dbg ("Allocating IPv6-specific WDS client");
-            mm_qmi_port_allocate_client (ctx->qmi,
-                                         QMI_SERVICE_WDS,
-                                         MM_QMI_PORT_FLAG_WDS_IPV6,
-                                         ctx->cancellable,
-                                         (GAsyncReadyCallback)qmi_port_allocate_client_ready,
-                                         ctx);
-            return;
-        }
-
-        ctx->client_ipv6 = QMI_CLIENT_WDS (client);
-        /* Just fall down */
-        ctx->step++;
-    }
+    case CONNECT_STEP_WDS_CLIENT_IPV6:
+        mm_dbg ("Acquiring IPv6-specific WDS client");
+        mm_qmi_port_acquire_client (ctx->qmi,
+                                    QMI_SERVICE_WDS,
+                                    MM_QMI_PORT_FLAG_WDS_IPV6,
+                                    ctx->cancellable,
+                                    (GAsyncReadyCallback)qmi_port_acquire_client_ready,
+                                    ctx);
+        return;
 
     case CONNECT_STEP_IP_FAMILY_IPV6:
 
@@ -752,19 +733,25 @@ connect_context_step (ConnectContext *ctx)
             /* Keep connection related data */
             g_assert (ctx->self->priv->data == NULL);
             ctx->self->priv->data = g_object_ref (ctx->data);
+            g_assert (ctx->self->priv->qmi == NULL);
+            ctx->self->priv->qmi = g_object_ref (ctx->qmi);
 
             g_assert (ctx->self->priv->packet_data_handle_ipv4 == 0);
             g_assert (ctx->self->priv->client_ipv4 == NULL);
             if (ctx->packet_data_handle_ipv4) {
                 ctx->self->priv->packet_data_handle_ipv4 = ctx->packet_data_handle_ipv4;
-                ctx->self->priv->client_ipv4 = g_object_ref (ctx->client_ipv4);
+                /* The bearer owns the client until disconnected */
+                ctx->self->priv->client_ipv4 = ctx->client_ipv4;
+                ctx->client_ipv4 = NULL;
             }
 
             g_assert (ctx->self->priv->packet_data_handle_ipv6 == 0);
             g_assert (ctx->self->priv->client_ipv6 == NULL);
             if (ctx->packet_data_handle_ipv6) {
                 ctx->self->priv->packet_data_handle_ipv6 = ctx->packet_data_handle_ipv6;
-                ctx->self->priv->client_ipv6 = g_object_ref (ctx->client_ipv6);
+                /* The bearer owns the client until disconnected */
+                ctx->self->priv->client_ipv6 = ctx->client_ipv6;
+                ctx->client_ipv6 = NULL;
             }
 
             /* Build IP config; always DHCP based */
@@ -985,6 +972,19 @@ disconnect_finish (MMBearer *self,
     return !g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (res), error);
 }
 
+static void
+recycle_client (MMBearerQmi *self,
+                QmiClientWds **client)
+{
+    if (!*client)
+        return;
+
+    /* Keep the CID around for the next connection */
+    if (self->priv->qmi)
+        mm_qmi_port_recycle_client (self->priv->qmi, QMI_CLIENT (*client));
+    g_clear_object (client);
+}
+
 static void
 reset_bearer_connection (MMBearerQmi *self,
                          gboolean reset_ipv4,
@@ -992,12 +992,12 @@ reset_bearer_connection (MMBearerQmi *self,
 {
     if (reset_ipv4) {
         self->priv->packet_data_handle_ipv4 = 0;
-        g_clear_object (&self->priv->client_ipv4);
+        recycle_client (self, &self->priv->client_ipv4);
     }
 
     if (reset_ipv6) {
         self->priv->packet_data_handle_ipv6 = 0;
-        g_clear_object (&self->priv->client_ipv6);
+        recycle_client (self, &self->priv->client_ipv6);
     }
 
     if (!self->priv->packet_data_handle_ipv4 &&
@@ -1007,6 +1007,7 @@ reset_bearer_connection (MMBearerQmi *self,
             mm_port_set_connected (self->priv->data, FALSE);
             g_clear_object (&self->priv->data);
         }
+        g_clear_object (&self->priv->qmi);
     }
 }
 
@@ -1214,6 +1215,7 @@ dispose (GObject *object)
     g_clear_object (&self->priv->data);
     g_clear_object (&self->priv->client_ipv4);
     g_clear_object (&self->priv->client_ipv6);
+    g_clear_object (&self->priv->qmi);
 
     G_OBJECT_CLASS (mm_bearer_qmi_parent_class)->dispose (object);
 }
@@ -7125,8 +7125,6 @@ typedef struct {
     MMBroadbandModem *self;
     GSimpleAsyncResult *result;
     MMQmiPort *qmi;
-    QmiService services[32];
-    guint service_index;
 } InitializationStartedContext;
 
 static void
@@ -7184,44 +7182,6 @@ parent_initialization_started (InitializationStartedContext *ctx)
         ctx);
 }
 
-static void allocate_next_client (InitializationStartedContext *ctx);
-
-static void
-qmi_port_allocate_client_ready (MMQmiPort *qmi,
-                                GAsyncResult *res,
-                                InitializationStartedContext *ctx)
-{
-    GError *error = NULL;
-
-    if (!mm_qmi_port_allocate_client_finish (qmi, res, &error)) {
-        mm_dbg ("Couldn't allocate client for service '%s': %s",
-                qmi_service_get_string (ctx->services[ctx->service_index]),
-                error->message);
-        g_error_free (error);
-    }
-
-    ctx->service_index++;
-    allocate_next_client (ctx);
-}
-
-static void
-allocate_next_client (InitializationStartedContext *ctx)
-{
-    if (ctx->services[ctx->service_index] == QMI_SERVICE_UNKNOWN) {
-        /* Done we are, launch parent's callback */
-        parent_initialization_started (ctx);
-        return;
-    }
-
-    /* Otherwise, allocate next client */
-    mm_qmi_port_allocate_client (ctx->qmi,
-                                 ctx->services[ctx->service_index],
-                                 MM_QMI_PORT_FLAG_DEFAULT,
-                                 NULL,
-                                 (GAsyncReadyCallback)qmi_port_allocate_client_ready,
-                                 ctx);
-}
-
 static void
 qmi_port_open_ready (MMQmiPort *qmi,
                      GAsyncResult *res,
@@ -7235,7 +7195,8 @@ qmi_port_open_ready (MMQmiPort *qmi,
         return;
     }
 
-    allocate_next_client (ctx);
+    /* Port open already allocated the clients we need */
+    parent_initialization_started (ctx);
 }
 
 static void
@@ -7269,15 +7230,9 @@ initialization_started (MMBroadbandModem *self,
         return;
     }
 
-    /* Setup services to open */
-    ctx->services[0] = QMI_SERVICE_DMS;
-    ctx->services[1] = QMI_SERVICE_NAS;
-    ctx->services[2] = QMI_SERVICE_WMS;
-    ctx->services[3] = QMI_SERVICE_PDS;
-    ctx->services[4] = QMI_SERVICE_UNKNOWN;
-
     /* Now open our QMI port */
     mm_qmi_port_open (ctx->qmi,
+                      TRUE,
                       TRUE,
                       NULL,
                       (GAsyncReadyCallback)qmi_port_open_ready,
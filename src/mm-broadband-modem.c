@@ -5327,11 +5327,11 @@ hdr_subsys_state_info_ready (MMQcdmSerialPort *port,
 
     /* Build results */
     results = g_new0 (HdrStateResults, 1);
-    qcdm_result_get_u8 (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_HDR_HYBRID_MODE, &results->hybrid_mode);
+    qcdm_result_get_u8_at (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_HDR_HYBRID_MODE, &results->hybrid_mode);
     results->session_state = QCDM_CMD_HDR_SUBSYS_STATE_INFO_SESSION_STATE_CLOSED;
-    qcdm_result_get_u8 (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_SESSION_STATE, &results->session_state);
+    qcdm_result_get_u8_at (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_SESSION_STATE, &results->session_state);
     results->almp_state = QCDM_CMD_HDR_SUBSYS_STATE_INFO_ALMP_STATE_INACTIVE;
-    qcdm_result_get_u8 (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_ALMP_STATE, &results->almp_state);
+    qcdm_result_get_u8_at (result, QCDM_CMD_HDR_SUBSYS_STATE_INFO_FIELD_ALMP_STATE, &results->almp_state);
     qcdm_result_unref (result);
 
     g_simple_async_result_set_op_res_gpointer (ctx->result, results, (GDestroyNotify)g_free);
@@ -5454,8 +5454,8 @@ cm_subsys_state_info_ready (MMQcdmSerialPort *port,
 
     /* Build results */
     results = g_new0 (CallManagerStateResults, 1);
-    qcdm_result_get_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_OPERATING_MODE, &results->operating_mode);
-    qcdm_result_get_u32 (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_SYSTEM_MODE, &results->system_mode);
+    qcdm_result_get_u32_at (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_OPERATING_MODE, &results->operating_mode);
+    qcdm_result_get_u32_at (result, QCDM_CMD_CM_SUBSYS_STATE_INFO_FIELD_SYSTEM_MODE, &results->system_mode);
     qcdm_result_unref (result);
 
     g_simple_async_result_set_op_res_gpointer (ctx->result, results, (GDestroyNotify)g_free);
@@ -5719,9 +5719,9 @@ qcdm_cdma_status_ready (MMQcdmSerialPort *port,
         return;
     }
 
-    qcdm_result_get_u32 (result, QCDM_CMD_CDMA_STATUS_ITEM_RX_STATE, &rxstate);
-    qcdm_result_get_u32 (result, QCDM_CMD_CDMA_STATUS_ITEM_SID, &sid);
-    qcdm_result_get_u32 (result, QCDM_CMD_CDMA_STATUS_ITEM_NID, &nid);
+    qcdm_result_get_u32_at (result, QCDM_CMD_CDMA_STATUS_FIELD_RX_STATE, &rxstate);
+    qcdm_result_get_u32_at (result, QCDM_CMD_CDMA_STATUS_FIELD_SID, &sid);
+    qcdm_result_get_u32_at (result, QCDM_CMD_CDMA_STATUS_FIELD_NID, &nid);
     qcdm_result_unref (result);
 
     /* 99999 means unknown/no service */
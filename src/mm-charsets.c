@@ -19,6 +19,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
 
 #define _LIBMM_INSIDE_MM
 #include <libmm-glib.h>
@@ -110,6 +111,75 @@ charset_iconv_from (MMModemCharset charset)
     return NULL;
 }
 
+/*****************************************************************************/
+/* Cached iconv descriptors
+ *
+ * Opening an iconv descriptor is much more expensive than the conversion of
+ * the short strings we usually deal with, so descriptors are opened once and
+ * kept around. Only a handful of different conversions are ever done, so a
+ * short list is enough. The charset names must be static strings.
+ */
+
+typedef struct {
+    const gchar *to;
+    const gchar *from;
+    GIConv cd;
+} Converter;
+
+static GArray *converters;
+
+static GIConv
+get_converter (const gchar *to,
+               const gchar *from)
+{
+    Converter converter;
+    guint i;
+
+    if (G_UNLIKELY (!converters))
+        converters = g_array_new (FALSE, FALSE, sizeof (Converter));
+
+    for (i = 0; i < converters->len; i++) {
+        Converter *iter = &g_array_index (converters, Converter, i);
+
+        if (g_str_equal (iter->to, to) && g_str_equal (iter->from, from)) {
+            /* Reset any shift state left by the last conversion */
+            if (iter->cd != (GIConv) -1)
+                g_iconv (iter->cd, NULL, NULL, NULL, NULL);
+            return iter->cd;
+        }
+    }
+
+    /* Failures are kept as well, so that they're not retried */
+    converter.to = to;
+    converter.from = from;
+    converter.cd = g_iconv_open (to, from);
+    g_array_append_val (converters, converter);
+
+    return converter.cd;
+}
+
+/* Same as g_convert(), but with a cached descriptor */
+static gchar *
+convert (const gchar *str,
+         gssize len,
+         const gchar *to,
+         const gchar *from,
+         gsize *bytes_read,
+         gsize *bytes_written,
+         GError **error)
+{
+    GIConv cd;
+
+    if (to && from) {
+        cd = get_converter (to, from);
+        if (cd != (GIConv) -1)
+            return g_convert_with_iconv (str, len, cd, bytes_read, bytes_written, error);
+    }
+
+    /* Let g_convert() report the error */
+    return g_convert (str, len, to, from, bytes_read, bytes_written, error);
+}
+
 gboolean
 mm_modem_charset_byte_array_append (GByteArray *array,
                                     const char *utf8,
@@ -127,7 +197,7 @@ mm_modem_charset_byte_array_append (GByteArray *array,
     iconv_to = charset_iconv_to (charset);
     g_return_val_if_fail (iconv_to != NULL, FALSE);
 
-    converted = g_convert (utf8, -1, iconv_to, "UTF-8", NULL, &written, &error);
+    converted = convert (utf8, -1, iconv_to, "UTF-8", NULL, &written, &error);
     if (!converted) {
         if (error) {
             g_warning ("%s: failed to convert '%s' to %s character set: (%d) %s",
@@ -151,34 +221,19 @@ mm_modem_charset_byte_array_append (GByteArray *array,
 char *
 mm_modem_charset_hex_to_utf8 (const char *src, MMModemCharset charset)
 {
-    char *unconverted, *converted;
-    const char *iconv_from;
-    gsize unconverted_len = 0;
-    GError *error = NULL;
+    gchar *converted;
+    gsize size;
 
     g_return_val_if_fail (src != NULL, NULL);
     g_return_val_if_fail (charset != MM_MODEM_CHARSET_UNKNOWN, NULL);
 
-    iconv_from = charset_iconv_from (charset);
-    g_return_val_if_fail (iconv_from != NULL, FALSE);
-
-    unconverted = mm_utils_hexstr2bin (src, &unconverted_len);
-    if (!unconverted)
+    size = MM_MODEM_CHARSET_HEX_TO_UTF8_MAX_SIZE (strlen (src));
+    converted = g_malloc (size);
+    if (mm_modem_charset_hex_to_utf8_buf (src, charset, converted, size) < 0) {
+        g_free (converted);
         return NULL;
-
-    if (charset == MM_MODEM_CHARSET_UTF8 || charset == MM_MODEM_CHARSET_IRA)
-        return unconverted;
-
-    converted = g_convert (unconverted, unconverted_len,
-                           "UTF-8//TRANSLIT", iconv_from,
-                           NULL, NULL, &error);
-    if (!converted || error) {
-        g_clear_error (&error);
-        converted = NULL;
     }
 
-    g_free (unconverted);
-
     return converted;
 }
 
@@ -200,9 +255,9 @@ mm_modem_charset_utf8_to_hex (const char *src, MMModemCharset charset)
     if (charset == MM_MODEM_CHARSET_UTF8 || charset == MM_MODEM_CHARSET_IRA)
         return g_strdup (src);
 
-    converted = g_convert (src, strlen (src),
-                           iconv_to, "UTF-8//TRANSLIT",
-                           NULL, &converted_len, &error);
+    converted = convert (src, strlen (src),
+                         iconv_to, "UTF-8//TRANSLIT",
+                         NULL, &converted_len, &error);
     if (!converted || error) {
         g_clear_error (&error);
         g_free (converted);
@@ -462,6 +517,173 @@ mm_charset_utf8_to_unpacked_gsm (const char *utf8, guint32 *out_len)
     return g_byte_array_free (gsm, FALSE);
 }
 
+/*****************************************************************************/
+/* Hex-encoded strings straight to UTF-8 */
+
+/* Bytes decoded from hex before being given to iconv at once */
+#define HEX_CHUNK_SIZE 64
+
+static gssize
+hex_to_utf8_raw (const gchar *hex,
+                 gsize hex_len,
+                 gchar *out,
+                 gsize out_size)
+{
+    gsize i;
+
+    if ((hex_len / 2) >= out_size)
+        return -1;
+
+    for (i = 0; i < hex_len; i += 2) {
+        gint c;
+
+        c = mm_utils_hex2byte (&hex[i]);
+        if (c < 0)
+            return -1;
+        out[i / 2] = c;
+    }
+    out[hex_len / 2] = '\0';
+
+    return hex_len / 2;
+}
+
+static gssize
+hex_to_utf8_gsm (const gchar *hex,
+                 gsize hex_len,
+                 gchar *out,
+                 gsize out_size)
+{
+    gsize i, o;
+
+    for (i = 0, o = 0; i < hex_len; i += 2) {
+        guint8 uchars[4];
+        guint8 ulen = 0;
+        gint c;
+
+        c = mm_utils_hex2byte (&hex[i]);
+        if (c < 0)
+            return -1;
+
+        if (c == GSM_ESCAPE_CHAR) {
+            /* Extended alphabet, decode next char */
+            if (i + 2 < hex_len) {
+                gint next;
+
+                next = mm_utils_hex2byte (&hex[i + 2]);
+                if (next < 0)
+                    return -1;
+                ulen = gsm_ext_char_to_utf8 (next, uchars);
+                if (ulen)
+                    i += 2;
+            }
+        } else if (c < GSM_DEF_ALPHABET_SIZE) {
+            /* Default alphabet */
+            ulen = gsm_def_char_to_utf8 (c, uchars);
+        }
+
+        if (!ulen) {
+            uchars[0] = '?';
+            ulen = 1;
+        }
+
+        if (o + ulen >= out_size)
+            return -1;
+        memcpy (&out[o], uchars, ulen);
+        o += ulen;
+    }
+    out[o] = '\0';
+
+    return o;
+}
+
+static gssize
+hex_to_utf8_iconv (const gchar *hex,
+                   gsize hex_len,
+                   const gchar *iconv_from,
+                   gchar *out,
+                   gsize out_size)
+{
+    gchar chunk[HEX_CHUNK_SIZE];
+    gsize chunk_len = 0;
+    gchar *outp = out;
+    gsize outleft = out_size - 1;
+    GIConv cd;
+    gsize i = 0;
+
+    cd = get_converter ("UTF-8//TRANSLIT", iconv_from);
+    if (cd == (GIConv) -1)
+        return -1;
+
+    while (i < hex_len || chunk_len) {
+        gchar *inp;
+        gsize inleft;
+
+        /* Fill the chunk after whatever was left from the previous one */
+        while (chunk_len < sizeof (chunk) && i < hex_len) {
+            gint c;
+
+            c = mm_utils_hex2byte (&hex[i]);
+            if (c < 0)
+                return -1;
+            chunk[chunk_len++] = c;
+            i += 2;
+        }
+
+        inp = chunk;
+        inleft = chunk_len;
+        if (g_iconv (cd, &inp, &inleft, &outp, &outleft) == (gsize) -1) {
+            /* A character split between chunks is completed with the next one */
+            if (errno != EINVAL || i == hex_len || inleft == sizeof (chunk))
+                return -1;
+        }
+
+        memmove (chunk, inp, inleft);
+        chunk_len = inleft;
+    }
+
+    /* Write out any pending shift sequence */
+    if (g_iconv (cd, NULL, NULL, &outp, &outleft) == (gsize) -1)
+        return -1;
+
+    *outp = '\0';
+    return outp - out;
+}
+
+gssize
+mm_modem_charset_hex_to_utf8_buf (const gchar *hex,
+                                  MMModemCharset charset,
+                                  gchar *out,
+                                  gsize out_size)
+{
+    const gchar *iconv_from;
+    gsize hex_len;
+
+    g_return_val_if_fail (hex != NULL, -1);
+    g_return_val_if_fail (out != NULL, -1);
+    g_return_val_if_fail (out_size > 0, -1);
+
+    /* Length must be a multiple of 2 */
+    hex_len = strlen (hex);
+    if (hex_len % 2)
+        return -1;
+
+    switch (charset) {
+    case MM_MODEM_CHARSET_UTF8:
+    case MM_MODEM_CHARSET_IRA:
+        return hex_to_utf8_raw (hex, hex_len, out, out_size);
+    case MM_MODEM_CHARSET_GSM:
+        return hex_to_utf8_gsm (hex, hex_len, out, out_size);
+    case MM_MODEM_CHARSET_UNKNOWN:
+    case MM_MODEM_CHARSET_HEX:
+        return -1;
+    default:
+        iconv_from = charset_iconv_from (charset);
+        if (!iconv_from)
+            return -1;
+        return hex_to_utf8_iconv (hex, hex_len, iconv_from, out, out_size);
+    }
+}
+
 static gboolean
 gsm_is_subset (gunichar c, const char *utf8, gsize ulen, guint *out_clen)
 {
@@ -636,40 +858,125 @@ mm_charset_get_encoded_len (const char *utf8,
     return len;
 }
 
-guint8 *
-gsm_unpack (const guint8 *gsm,
-            guint32 num_septets,
-            guint8 start_offset,  /* in _bits_ */
-            guint32 *out_unpacked_len)
-{
-    GByteArray *unpacked;
-    int i;
+/* The bulk loops below handle 8 septets, i.e. 7 octets, at a time in a
+ * 64-bit word, and fall back to handling one septet at a time for the
+ * remainder. */
 
-    unpacked = g_byte_array_sized_new (num_septets + 1);
+guint32
+gsm_unpack_into (const guint8 *gsm,
+                 guint32 num_septets,
+                 guint8 start_offset,  /* in _bits_ */
+                 guint8 *out)
+{
+    guint32 in_len, need, pos, i;
+    guint8 offset;
+
+    /* Skip whole octets before the first septet */
+    gsm += start_offset / 8;
+    offset = start_offset % 8;
+
+    /* Only read up to the octet holding the last bit of the last septet */
+    in_len = (offset + (num_septets * 7) + 7) / 8;
+    /* Unless aligned, the 8th septet spills into the 8th octet */
+    need = offset ? 8 : 7;
+
+    for (i = 0, pos = 0; num_septets - i >= 8 && pos + need <= in_len; i += 8, pos += 7) {
+        guint64 word = 0;
+        guint k;
+
+        memcpy (&word, &gsm[pos], need);
+        word = GUINT64_FROM_LE (word) >> offset;
+        for (k = 0; k < 8; k++)
+            out[i + k] = (word >> (k * 7)) & 0x7F;
+    }
 
-    for (i = 0; i < num_septets; i++) {
-        guint8 bits_here, bits_in_next, octet, offset, c;
+    for (; i < num_septets; i++) {
+        guint8 bits_here, bits_in_next, octet, c;
         guint32 start_bit;
 
-        start_bit = start_offset + (i * 7); /* Overall bit offset of char in buffer */
-        offset = start_bit % 8;  /* Offset to start of char in this byte */
-        bits_here = offset ? (8 - offset) : 7;
+        start_bit = offset + (i * 7); /* Overall bit offset of char in buffer */
+        bits_here = (start_bit % 8) ? (8 - (start_bit % 8)) : 7;
         bits_in_next = 7 - bits_here;
 
         /* Grab bits in the current byte */
         octet = gsm[start_bit / 8];
-        c = (octet >> offset) & (0xFF >> (8 - bits_here));
+        c = (octet >> (start_bit % 8)) & (0xFF >> (8 - bits_here));
 
         /* Grab any bits that spilled over to next byte */
         if (bits_in_next) {
             octet = gsm[(start_bit / 8) + 1];
             c |= (octet & (0xFF >> (8 - bits_in_next))) << bits_here;
         }
-        g_byte_array_append (unpacked, &c, 1);
+        out[i] = c;
     }
 
-    *out_unpacked_len = unpacked->len;
-    return g_byte_array_free (unpacked, FALSE);
+    return num_septets;
+}
+
+guint8 *
+gsm_unpack (const guint8 *gsm,
+            guint32 num_septets,
+            guint8 start_offset,  /* in _bits_ */
+            guint32 *out_unpacked_len)
+{
+    guint8 *unpacked;
+
+    unpacked = g_malloc (num_septets + 1);
+    *out_unpacked_len = gsm_unpack_into (gsm, num_septets, start_offset, unpacked);
+    return unpacked;
+}
+
+guint32
+gsm_packed_len (guint32 num_septets,
+                guint8 start_offset)
+{
+    return ((num_septets * 7) + start_offset + 7) / 8;
+}
+
+guint32
+gsm_pack_into (const guint8 *src,
+               guint32 src_len,
+               guint8 start_offset,
+               guint8 *out)
+{
+    guint64 acc;
+    guint nbits;
+    guint32 i, o;
+
+    g_return_val_if_fail (start_offset < 8, 0);
+
+    /* Pending bits not yet written, the leading ones are left unset */
+    acc = 0;
+    nbits = start_offset;
+
+    for (i = 0, o = 0; src_len - i >= 8; i += 8, o += 7) {
+        guint64 word = 0;
+        guint k;
+
+        for (k = 0; k < 8; k++)
+            word |= ((guint64) (src[i + k] & 0x7F)) << (k * 7);
+
+        /* Never more than 7 bits pending, so the 56 new ones always fit */
+        acc |= word << nbits;
+        word = GUINT64_TO_LE (acc);
+        memcpy (&out[o], &word, 7);
+        acc >>= 56;
+    }
+
+    for (; i < src_len; i++) {
+        acc |= ((guint64) (src[i] & 0x7F)) << nbits;
+        nbits += 7;
+        if (nbits >= 8) {
+            out[o++] = acc & 0xFF;
+            acc >>= 8;
+            nbits -= 8;
+        }
+    }
+
+    if (nbits)
+        out[o++] = acc & 0xFF;
+
+    return o;
 }
 
 guint8 *
@@ -679,29 +986,14 @@ gsm_pack (const guint8 *src,
           guint32 *out_packed_len)
 {
     guint8 *packed;
-    guint octet = 0, lshift, plen;
-    int i = 0;
+    guint plen;
 
     g_return_val_if_fail (start_offset < 8, NULL);
 
-    plen = (src_len * 7) + start_offset; /* total length in bits */
-    if (plen % 8)
-        plen += 8;
-    plen /= 8;  /* now in bytes */
-
+    plen = gsm_packed_len (src_len, start_offset);
     packed = g_malloc0 (plen);
-
-    for (i = 0, lshift = start_offset; i < src_len; i++) {
-        packed[octet] |= (src[i] & 0x7F) << lshift;
-        if (lshift > 1) {
-            /* Grab the lost bits and add to next octet */
-            g_assert (octet + 1 < plen);
-            packed[octet + 1] = (src[i] & 0x7F) >> (8 - lshift);
-        }
-        if (lshift)
-            octet++;
-        lshift = lshift ? lshift - 1 : 7;
-    }
+    if (plen)
+        gsm_pack_into (src, src_len, start_offset, packed);
 
     if (out_packed_len)
         *out_packed_len = plen;
@@ -739,9 +1031,9 @@ mm_charset_take_and_convert_to_utf8 (gchar *str, MMModemCharset charset)
         GError *error = NULL;
 
         iconv_from = charset_iconv_from (charset);
-        utf8 = g_convert (str, strlen (str),
-                          "UTF-8//TRANSLIT", iconv_from,
-                          NULL, NULL, &error);
+        utf8 = convert (str, strlen (str),
+                        "UTF-8//TRANSLIT", iconv_from,
+                        NULL, NULL, &error);
         if (!utf8 || error) {
             g_clear_error (&error);
             utf8 = NULL;
@@ -782,9 +1074,9 @@ mm_charset_take_and_convert_to_utf8 (gchar *str, MMModemCharset charset)
          * the partial conversion length to re-convert the part of the string
          * that is UTF-8, if any.
          */
-        utf8 = g_convert (str, strlen (str),
-                          "UTF-8//TRANSLIT", "UTF-8//TRANSLIT",
-                          &bread, &bwritten, NULL);
+        utf8 = convert (str, strlen (str),
+                        "UTF-8//TRANSLIT", "UTF-8//TRANSLIT",
+                        &bread, &bwritten, NULL);
 
         /* Valid conversion, or we didn't get enough valid UTF-8 */
         if (utf8 || (bwritten <= 2)) {
@@ -796,9 +1088,9 @@ mm_charset_take_and_convert_to_utf8 (gchar *str, MMModemCharset charset)
          * location and get what we can.
          */
         str[bread] = '\0';
-        utf8 = g_convert (str, strlen (str),
-                          "UTF-8//TRANSLIT", "UTF-8//TRANSLIT",
-                          NULL, NULL, NULL);
+        utf8 = convert (str, strlen (str),
+                        "UTF-8//TRANSLIT", "UTF-8//TRANSLIT",
+                        NULL, NULL, NULL);
         g_free (str);
         break;
     }
@@ -862,9 +1154,9 @@ mm_utf8_take_and_convert_to_charset (gchar *str,
         GError *error = NULL;
 
         iconv_to = charset_iconv_from (charset);
-        encoded = g_convert (str, strlen (str),
-                             iconv_to, "UTF-8",
-                             NULL, NULL, &error);
+        encoded = convert (str, strlen (str),
+                           iconv_to, "UTF-8",
+                           NULL, NULL, &error);
         if (!encoded || error) {
             g_clear_error (&error);
             encoded = NULL;
@@ -881,9 +1173,9 @@ mm_utf8_take_and_convert_to_charset (gchar *str,
         gchar *hex;
 
         iconv_to = charset_iconv_from (charset);
-        encoded = g_convert (str, strlen (str),
-                             iconv_to, "UTF-8",
-                             NULL, &encoded_len, &error);
+        encoded = convert (str, strlen (str),
+                           iconv_to, "UTF-8",
+                           NULL, &encoded_len, &error);
         if (!encoded || error) {
             g_clear_error (&error);
             encoded = NULL;
@@ -48,6 +48,19 @@ gboolean mm_modem_charset_byte_array_append (GByteArray *array,
  */
 char *mm_modem_charset_hex_to_utf8 (const char *src, MMModemCharset charset);
 
+/* Same as above, but writing the NUL-terminated UTF-8 string into a buffer
+ * given by the caller, without any intermediate copy. Returns the length of
+ * the string, or -1 if the input is invalid or doesn't fit in @out_size.
+ * A buffer of MM_MODEM_CHARSET_HEX_TO_UTF8_MAX_SIZE (strlen (hex)) bytes is
+ * always big enough.
+ */
+#define MM_MODEM_CHARSET_HEX_TO_UTF8_MAX_SIZE(hex_len) ((((hex_len) / 2) * 3) + 1)
+
+gssize mm_modem_charset_hex_to_utf8_buf (const gchar *hex,
+                                         MMModemCharset charset,
+                                         gchar *out,
+                                         gsize out_size);
+
 /* Take a string in UTF-8 and convert it to the given charset in hex
  * representation.
  */
@@ -72,6 +85,22 @@ guint8 *gsm_pack (const guint8 *src,
                   guint8 start_offset,  /* in bits */
                   guint32 *out_packed_len);
 
+/* Same as above, but writing into a buffer given by the caller, which must
+ * hold at least @num_septets bytes when unpacking, or gsm_packed_len() bytes
+ * when packing. Both return the number of bytes written. */
+guint32 gsm_unpack_into (const guint8 *gsm,
+                         guint32 num_septets,
+                         guint8 start_offset,  /* in bits */
+                         guint8 *out);
+
+guint32 gsm_packed_len (guint32 num_septets,
+                        guint8 start_offset);  /* in bits */
+
+guint32 gsm_pack_into (const guint8 *src,
+                       guint32 src_len,
+                       guint8 start_offset,  /* in bits */
+                       guint8 *out);
+
 gchar *mm_charset_take_and_convert_to_utf8 (gchar *str, MMModemCharset charset);
 
 gchar *mm_utf8_take_and_convert_to_charset (gchar *str,
@@ -23,6 +23,13 @@ static const gchar *log_level;
 static const gchar *log_file;
 static gboolean show_ts;
 static gboolean rel_ts;
+static gint log_flush_interval;
+static gint log_flush_size = 64 * 1024;
+static const gchar *log_flush_level;
+static gint serial_trace_size = 256 * 1024;
+static const gchar *serial_trace_file;
+static gboolean fast_probing;
+static const gchar *probe_cache_file;
 
 static const GOptionEntry entries[] = {
     { "debug", 0, 0, G_OPTION_ARG_NONE, &debug, "Run with extended debugging capabilities", NULL },
@@ -30,6 +37,13 @@ static const GOptionEntry entries[] = {
     { "log-file", 0, 0, G_OPTION_ARG_STRING, &log_file, "Path to log file", NULL },
     { "timestamps", 0, 0, G_OPTION_ARG_NONE, &show_ts, "Show timestamps in log output", NULL },
     { "relative-timestamps", 0, 0, G_OPTION_ARG_NONE, &rel_ts, "Use relative timestamps (from MM start)", NULL },
+    { "log-flush-interval", 0, 0, G_OPTION_ARG_INT, &log_flush_interval, "Buffer log file writes, flushing them every given milliseconds (0 to write each line right away)", "0" },
+    { "log-flush-size", 0, 0, G_OPTION_ARG_INT, &log_flush_size, "Flush buffered log file writes when this many bytes are pending", "65536" },
+    { "log-flush-level", 0, 0, G_OPTION_ARG_STRING, &log_flush_level, "Flush buffered log file writes right away on messages of this level or higher: one of [ERR, WARN, INFO, DEBUG]", "WARN" },
+    { "serial-trace-size", 0, 0, G_OPTION_ARG_INT, &serial_trace_size, "Size of the buffer keeping the most recent serial port traffic (0 to disable)", "262144" },
+    { "serial-trace-file", 0, 0, G_OPTION_ARG_FILENAME, &serial_trace_file, "Path where to dump the serial port traffic on SIGUSR2", NULL },
+    { "fast-probing", 0, 0, G_OPTION_ARG_NONE, &fast_probing, "Once a port of a device replies to AT, probe the remaining ones with a single quick AT attempt", NULL },
+    { "probe-cache-file", 0, 0, G_OPTION_ARG_FILENAME, &probe_cache_file, "Path to the file where to keep port probing results across restarts", NULL },
     { NULL }
 };
 
@@ -63,6 +77,48 @@ mm_context_get_relative_timestamps (void)
     return rel_ts;
 }
 
+guint
+mm_context_get_log_flush_interval (void)
+{
+    return (guint) MAX (log_flush_interval, 0);
+}
+
+guint
+mm_context_get_log_flush_size (void)
+{
+    return (guint) MAX (log_flush_size, 0);
+}
+
+const gchar *
+mm_context_get_log_flush_level (void)
+{
+    return log_flush_level;
+}
+
+guint
+mm_context_get_serial_trace_size (void)
+{
+    return (guint) MAX (serial_trace_size, 0);
+}
+
+const gchar *
+mm_context_get_serial_trace_file (void)
+{
+    return serial_trace_file;
+}
+
+gboolean
+mm_context_get_fast_probing (void)
+{
+    return fast_probing;
+}
+
+const gchar *
+mm_context_get_probe_cache_file (void)
+{
+    return probe_cache_file;
+}
+
 void
 mm_context_init (gint argc,
                  gchar **argv)
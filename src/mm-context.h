@@ -26,5 +26,12 @@ const gchar *mm_context_get_log_level           (void);
 const gchar *mm_context_get_log_file            (void);
 gboolean     mm_context_get_timestamps          (void);
 gboolean     mm_context_get_relative_timestamps (void);
+guint        mm_context_get_log_flush_interval  (void);
+guint        mm_context_get_log_flush_size      (void);
+const gchar *mm_context_get_log_flush_level     (void);
+guint        mm_context_get_serial_trace_size   (void);
+const gchar *mm_context_get_serial_trace_file   (void);
+gboolean     mm_context_get_fast_probing        (void);
+const gchar *mm_context_get_probe_cache_file    (void);
 
 #endif /* MM_CONTEXT_H */
@@ -68,6 +68,9 @@ struct _MMDevicePrivate {
 
     /* When exported, a reference to the object manager */
     GDBusObjectManagerServer *object_manager;
+
+    /* Time when the first port was detected */
+    gint64 creation_time;
 };
 
 /*****************************************************************************/
@@ -392,6 +395,10 @@ export_modem (MMDevice *self)
     mm_dbg ("Exported modem '%s' at path '%s'",
             g_udev_device_get_sysfs_path (self->priv->udev_device),
             path);
+    mm_info ("Modem '%s' with '%u' ports exported %.3fs after the first port was detected",
+             path,
+             g_list_length (self->priv->port_probes),
+             (g_get_monotonic_time () - self->priv->creation_time) / (gdouble) G_USEC_PER_SEC);
 
     /* Once connected, dump additional debug info about the modem */
     mm_dbg ("(%s): '%s' modem, VID 0x%04X PID 0x%04X (%s)",
@@ -610,6 +617,7 @@ mm_device_init (MMDevice *self)
     self->priv = G_TYPE_INSTANCE_GET_PRIVATE ((self),
                                               MM_TYPE_DEVICE,
                                               MMDevicePrivate);
+    self->priv->creation_time = g_get_monotonic_time ();
 }
 
 static void
@@ -70,7 +70,7 @@ remove_eval_cb (const GMatchInfo *match_info,
 
 static gboolean
 parse_response (MMSerialPort *port,
-                GByteArray *response,
+                MMSerialBuffer *response,
                 GError **error)
 {
     MMGpsSerialPort *self = MM_GPS_SERIAL_PORT (port);
@@ -78,22 +78,27 @@ parse_response (MMSerialPort *port,
     GMatchInfo *match_info;
     gchar *str;
     gint result_len;
+    const guint8 *data;
+    gsize len;
     guint i;
 
-    for (i = 0; i < response->len; i++) {
+    data = mm_serial_buffer_peek (response, &len);
+    for (i = 0; i < len; i++) {
         /* If there is any content before the first $,
          * assume it's garbage, and skip it */
-        if (response->data[i] == '$') {
-            if (i > 0)
-                g_byte_array_remove_range (response, 0, i);
+        if (data[i] == '$') {
+            if (i > 0) {
+                mm_serial_buffer_consume (response, i);
+                data = mm_serial_buffer_peek (response, &len);
+            }
             /* else, good, we're already started with $ */
             break;
         }
     }
 
     matches = g_regex_match_full (self->priv->known_traces_regex,
-                                  (const gchar *) response->data,
-                                  response->len,
+                                  (const gchar *) data,
+                                  len,
                                   0, 0, &match_info, NULL);
 
     if (self->priv->callback) {
@@ -115,15 +120,15 @@ parse_response (MMSerialPort *port,
         return FALSE;
 
     /* Remove matches */
-    result_len = response->len;
+    result_len = len;
     str = g_regex_replace_eval (self->priv->known_traces_regex,
-                                (const char *) response->data,
-                                response->len,
+                                (const char *) data,
+                                len,
                                 0, 0,
                                 remove_eval_cb, &result_len, NULL);
 
-    g_byte_array_remove_range (response, 0, response->len);
-    g_byte_array_append (response, (const guint8 *) str, result_len);
+    mm_serial_buffer_clear (response);
+    mm_serial_buffer_append (response, (const guint8 *) str, result_len);
     g_free (str);
 
     return TRUE;
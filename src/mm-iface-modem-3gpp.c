@@ -27,6 +27,7 @@
 #include "mm-modem-helpers.h"
 #include "mm-error-helpers.h"
 #include "mm-log.h"
+#include "mm-poll-scheduler.h"
 
 #define REGISTRATION_CHECK_TIMEOUT_SEC 30
 
@@ -1120,15 +1121,15 @@ mm_iface_modem_3gpp_update_ps_registration_state (MMIfaceModem3gpp *self,
 /*****************************************************************************/
 
 typedef struct {
-    guint timeout_source;
+    MMPollTask *task;
     gboolean running;
 } RegistrationCheckContext;
 
 static void
 registration_check_context_free (RegistrationCheckContext *ctx)
 {
-    if (ctx->timeout_source)
-        g_source_remove (ctx->timeout_source);
+    if (ctx->task)
+        mm_poll_scheduler_remove (ctx->task);
     g_free (ctx);
 }
 
@@ -1147,11 +1148,13 @@ periodic_registration_checks_ready (MMIfaceModem3gpp *self,
 
     /* Remove the running tag */
     ctx = g_object_get_qdata (G_OBJECT (self), registration_check_context_quark);
-    if (ctx)
+    if (ctx) {
         ctx->running = FALSE;
+        mm_poll_scheduler_task_done (ctx->task);
+    }
 }
 
-static gboolean
+static void
 periodic_registration_check (MMIfaceModem3gpp *self)
 {
     RegistrationCheckContext *ctx;
@@ -1165,7 +1168,6 @@ periodic_registration_check (MMIfaceModem3gpp *self)
             (GAsyncReadyCallback)periodic_registration_checks_ready,
             NULL);
     }
-    return TRUE;
 }
 
 static void
@@ -1201,9 +1203,10 @@ periodic_registration_check_enable (MMIfaceModem3gpp *self)
     /* Create context and keep it as object data */
     mm_dbg ("Periodic 3GPP registration checks enabled");
     ctx = g_new0 (RegistrationCheckContext, 1);
-    ctx->timeout_source = g_timeout_add_seconds (REGISTRATION_CHECK_TIMEOUT_SEC,
-                                                 (GSourceFunc)periodic_registration_check,
-                                                 self);
+    ctx->task = mm_poll_scheduler_add ("3gpp-registration",
+                                       REGISTRATION_CHECK_TIMEOUT_SEC,
+                                       (MMPollTaskFn)periodic_registration_check,
+                                       self);
     g_object_set_qdata_full (G_OBJECT (self),
                              registration_check_context_quark,
                              ctx,
@@ -24,6 +24,7 @@
 #include "mm-base-modem.h"
 #include "mm-modem-helpers.h"
 #include "mm-log.h"
+#include "mm-poll-scheduler.h"
 
 #define REGISTRATION_CHECK_TIMEOUT_SEC 30
 
@@ -1082,15 +1083,15 @@ mm_iface_modem_cdma_update_cdma1x_registration_state (MMIfaceModemCdma *self,
 /*****************************************************************************/
 
 typedef struct {
-    guint timeout_source;
+    MMPollTask *task;
     gboolean running;
 } RegistrationCheckContext;
 
 static void
 registration_check_context_free (RegistrationCheckContext *ctx)
 {
-    if (ctx->timeout_source)
-        g_source_remove (ctx->timeout_source);
+    if (ctx->task)
+        mm_poll_scheduler_remove (ctx->task);
     g_free (ctx);
 }
 
@@ -1109,11 +1110,13 @@ periodic_registration_checks_ready (MMIfaceModemCdma *self,
 
     /* Remove the running tag */
     ctx = g_object_get_qdata (G_OBJECT (self), registration_check_context_quark);
-    if (ctx)
+    if (ctx) {
         ctx->running = FALSE;
+        mm_poll_scheduler_task_done (ctx->task);
+    }
 }
 
-static gboolean
+static void
 periodic_registration_check (MMIfaceModemCdma *self)
 {
     RegistrationCheckContext *ctx;
@@ -1127,7 +1130,6 @@ periodic_registration_check (MMIfaceModemCdma *self)
             (GAsyncReadyCallback)periodic_registration_checks_ready,
             NULL);
     }
-    return TRUE;
 }
 
 static void
@@ -1163,9 +1165,10 @@ periodic_registration_check_enable (MMIfaceModemCdma *self)
     /* Create context and keep it as object data */
     mm_dbg ("Periodic CDMA registration checks enabled");
     ctx = g_new0 (RegistrationCheckContext, 1);
-    ctx->timeout_source = g_timeout_add_seconds (REGISTRATION_CHECK_TIMEOUT_SEC,
-                                                 (GSourceFunc)periodic_registration_check,
-                                                 self);
+    ctx->task = mm_poll_scheduler_add ("cdma-registration",
+                                       REGISTRATION_CHECK_TIMEOUT_SEC,
+                                       (MMPollTaskFn)periodic_registration_check,
+                                       self);
     g_object_set_qdata_full (G_OBJECT (self),
                              registration_check_context_quark,
                              ctx,
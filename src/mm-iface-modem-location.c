@@ -23,6 +23,7 @@
 #include "mm-log.h"
 
 #define MM_LOCATION_GPS_REFRESH_TIME_SECS 30
+#define MM_LOCATION_GPS_STREAMING_MIN_INTERVAL_MS 100
 
 #define LOCATION_CONTEXT_TAG "location-context-tag"
 
@@ -46,6 +47,11 @@ typedef struct {
     MMLocationGpsNmea *location_gps_nmea;
     time_t location_gps_raw_last_time;
     MMLocationGpsRaw *location_gps_raw;
+    /* GPS fix streaming */
+    MMNmeaFix gps_stream_fix;
+    MMNmeaFix gps_stream_last_fix;
+    gint64 gps_stream_last_time;
+    guint gps_stream_timeout_id;
     /* CDMA BS location */
     MMLocationCdmaBs *location_cdma_bs;
 } LocationContext;
@@ -53,6 +59,8 @@ typedef struct {
 static void
 location_context_free (LocationContext *ctx)
 {
+    if (ctx->gps_stream_timeout_id)
+        g_source_remove (ctx->gps_stream_timeout_id);
     if (ctx->location_3gpp)
         g_object_unref (ctx->location_3gpp);
     if (ctx->location_gps_nmea)
@@ -90,6 +98,8 @@ get_location_context (MMIfaceModemLocation *self)
     if (!ctx) {
         /* Create context and keep it as object data */
         ctx = g_new0 (LocationContext, 1);
+        mm_nmea_fix_init (&ctx->gps_stream_fix);
+        mm_nmea_fix_init (&ctx->gps_stream_last_fix);
 
         g_object_set_qdata_full (
             G_OBJECT (self),
@@ -205,6 +215,82 @@ build_location_dictionary (GVariant *previous,
 
 /*****************************************************************************/
 
+static void
+emit_gps_fix (MmGdbusModemLocation *skeleton,
+              LocationContext *ctx)
+{
+    MMNmeaFix *fix = &ctx->gps_stream_fix;
+
+    /* Skip fixes equal to the last one sent */
+    if (mm_nmea_fix_equal (fix, &ctx->gps_stream_last_fix))
+        return;
+
+    ctx->gps_stream_last_fix = *fix;
+    ctx->gps_stream_last_time = g_get_monotonic_time ();
+
+    /* Nothing to report until we know where we are */
+    if (fix->latitude == MM_LOCATION_LATITUDE_UNKNOWN ||
+        fix->longitude == MM_LOCATION_LONGITUDE_UNKNOWN)
+        return;
+
+    mm_gdbus_modem_location_emit_gps_fix (skeleton,
+                                          fix->utc_time,
+                                          fix->latitude,
+                                          fix->longitude,
+                                          fix->altitude,
+                                          fix->n_satellites,
+                                          fix->hdop);
+}
+
+static gboolean
+gps_stream_timeout_cb (MMIfaceModemLocation *self)
+{
+    MmGdbusModemLocation *skeleton;
+    LocationContext *ctx;
+
+    ctx = get_location_context (self);
+    ctx->gps_stream_timeout_id = 0;
+
+    g_object_get (self,
+                  MM_IFACE_MODEM_LOCATION_DBUS_SKELETON, &skeleton,
+                  NULL);
+    if (!skeleton)
+        return FALSE;
+
+    if (mm_gdbus_modem_location_get_gps_streaming_interval (skeleton) &&
+        mm_gdbus_modem_location_get_signals_location (skeleton))
+        emit_gps_fix (skeleton, ctx);
+
+    g_object_unref (skeleton);
+    return FALSE;
+}
+
+static void
+stream_gps_fix (MMIfaceModemLocation *self,
+                MmGdbusModemLocation *skeleton,
+                LocationContext *ctx)
+{
+    gint64 interval;
+    gint64 elapsed;
+
+    /* If an emission is already scheduled, it will take the latest fix */
+    if (ctx->gps_stream_timeout_id)
+        return;
+
+    interval = (gint64) mm_gdbus_modem_location_get_gps_streaming_interval (skeleton) * 1000;
+    elapsed = g_get_monotonic_time () - ctx->gps_stream_last_time;
+    if (ctx->gps_stream_last_time && elapsed < interval) {
+        ctx->gps_stream_timeout_id = g_timeout_add ((interval - elapsed) / 1000 + 1,
+                                                    (GSourceFunc)gps_stream_timeout_cb,
+                                                    self);
+        return;
+    }
+
+    emit_gps_fix (skeleton, ctx);
+}
+
+/*****************************************************************************/
+
 static void
 notify_gps_location_update (MMIfaceModemLocation *self,
                             MmGdbusModemLocation *skeleton,
@@ -235,9 +321,16 @@ mm_iface_modem_location_gps_update (MMIfaceModemLocation *self,
 {
     MmGdbusModemLocation *skeleton;
     LocationContext *ctx;
+    MMNmeaSentence sentence;
     gboolean update_nmea = FALSE;
     gboolean update_raw = FALSE;
 
+    /* Tokenize the trace once, for all the GPS location sources */
+    if (!mm_nmea_sentence_parse (nmea_trace, &sentence)) {
+        mm_dbg ("Ignoring invalid NMEA trace: '%s'", nmea_trace);
+        return;
+    }
+
     ctx = get_location_context (self);
     g_object_get (self,
                   MM_IFACE_MODEM_LOCATION_DBUS_SKELETON, &skeleton,
@@ -247,7 +340,7 @@ mm_iface_modem_location_gps_update (MMIfaceModemLocation *self,
 
     if (mm_gdbus_modem_location_get_enabled (skeleton) & MM_MODEM_LOCATION_SOURCE_GPS_NMEA) {
         g_assert (ctx->location_gps_nmea != NULL);
-        if (mm_location_gps_nmea_add_trace (ctx->location_gps_nmea, nmea_trace) &&
+        if (mm_location_gps_nmea_add_sentence (ctx->location_gps_nmea, &sentence) &&
             (ctx->location_gps_nmea_last_time == 0 ||
              time (NULL) - ctx->location_gps_nmea_last_time >= MM_LOCATION_GPS_REFRESH_TIME_SECS)) {
             ctx->location_gps_nmea_last_time = time (NULL);
@@ -257,7 +350,7 @@ mm_iface_modem_location_gps_update (MMIfaceModemLocation *self,
 
     if (mm_gdbus_modem_location_get_enabled (skeleton) & MM_MODEM_LOCATION_SOURCE_GPS_RAW) {
         g_assert (ctx->location_gps_raw != NULL);
-        if (mm_location_gps_raw_add_trace (ctx->location_gps_raw, nmea_trace) &&
+        if (mm_location_gps_raw_add_sentence (ctx->location_gps_raw, &sentence) &&
             (ctx->location_gps_raw_last_time == 0 ||
              time (NULL) - ctx->location_gps_raw_last_time >= MM_LOCATION_GPS_REFRESH_TIME_SECS)) {
             ctx->location_gps_raw_last_time = time (NULL);
@@ -271,6 +364,14 @@ mm_iface_modem_location_gps_update (MMIfaceModemLocation *self,
                                     update_nmea ? ctx->location_gps_nmea : NULL,
                                     update_raw ? ctx->location_gps_raw : NULL);
 
+    /* Stream the fix, if requested */
+    if (mm_gdbus_modem_location_get_gps_streaming_interval (skeleton) &&
+        mm_gdbus_modem_location_get_signals_location (skeleton) &&
+        (mm_gdbus_modem_location_get_enabled (skeleton) & (MM_MODEM_LOCATION_SOURCE_GPS_NMEA |
+                                                           MM_MODEM_LOCATION_SOURCE_GPS_RAW)) &&
+        mm_nmea_fix_update (&ctx->gps_stream_fix, &sentence))
+        stream_gps_fix (self, skeleton, ctx);
+
     g_object_unref (skeleton);
 }
 
@@ -888,6 +989,116 @@ handle_setup (MmGdbusModemLocation *skeleton,
 
 /*****************************************************************************/
 
+typedef struct {
+    MmGdbusModemLocation *skeleton;
+    GDBusMethodInvocation *invocation;
+    MMIfaceModemLocation *self;
+    guint32 interval;
+} HandleSetupGpsStreamingContext;
+
+static void
+handle_setup_gps_streaming_context_free (HandleSetupGpsStreamingContext *ctx)
+{
+    g_object_unref (ctx->skeleton);
+    g_object_unref (ctx->invocation);
+    g_object_unref (ctx->self);
+    g_free (ctx);
+}
+
+static void
+handle_setup_gps_streaming_auth_ready (MMBaseModem *self,
+                                       GAsyncResult *res,
+                                       HandleSetupGpsStreamingContext *ctx)
+{
+    GError *error = NULL;
+    MMModemState modem_state;
+    LocationContext *location_ctx;
+
+    if (!mm_base_modem_authorize_finish (self, res, &error)) {
+        g_dbus_method_invocation_take_error (ctx->invocation, error);
+        handle_setup_gps_streaming_context_free (ctx);
+        return;
+    }
+
+    modem_state = MM_MODEM_STATE_UNKNOWN;
+    g_object_get (self,
+                  MM_IFACE_MODEM_STATE, &modem_state,
+                  NULL);
+    if (modem_state < MM_MODEM_STATE_ENABLED) {
+        g_dbus_method_invocation_return_error (ctx->invocation,
+                                               MM_CORE_ERROR,
+                                               MM_CORE_ERROR_WRONG_STATE,
+                                               "Cannot setup GPS streaming: "
+                                               "device not yet enabled");
+        handle_setup_gps_streaming_context_free (ctx);
+        return;
+    }
+
+    if (!(mm_gdbus_modem_location_get_capabilities (ctx->skeleton) & (MM_MODEM_LOCATION_SOURCE_GPS_NMEA |
+                                                                       MM_MODEM_LOCATION_SOURCE_GPS_RAW))) {
+        g_dbus_method_invocation_return_error (ctx->invocation,
+                                               MM_CORE_ERROR,
+                                               MM_CORE_ERROR_UNSUPPORTED,
+                                               "Cannot setup GPS streaming: "
+                                               "GPS location not supported");
+        handle_setup_gps_streaming_context_free (ctx);
+        return;
+    }
+
+    if (ctx->interval && ctx->interval < MM_LOCATION_GPS_STREAMING_MIN_INTERVAL_MS) {
+        g_dbus_method_invocation_return_error (ctx->invocation,
+                                               MM_CORE_ERROR,
+                                               MM_CORE_ERROR_INVALID_ARGS,
+                                               "Cannot setup GPS streaming: "
+                                               "interval must be at least %u ms",
+                                               MM_LOCATION_GPS_STREAMING_MIN_INTERVAL_MS);
+        handle_setup_gps_streaming_context_free (ctx);
+        return;
+    }
+
+    if (ctx->interval)
+        mm_dbg ("Streaming GPS fixes every %u ms", ctx->interval);
+    else
+        mm_dbg ("Disabling GPS fix streaming");
+
+    /* Start afresh, so that the first fix gets sent right away */
+    location_ctx = get_location_context (ctx->self);
+    if (location_ctx->gps_stream_timeout_id) {
+        g_source_remove (location_ctx->gps_stream_timeout_id);
+        location_ctx->gps_stream_timeout_id = 0;
+    }
+    mm_nmea_fix_init (&location_ctx->gps_stream_last_fix);
+    location_ctx->gps_stream_last_time = 0;
+
+    mm_gdbus_modem_location_set_gps_streaming_interval (ctx->skeleton, ctx->interval);
+    mm_gdbus_modem_location_complete_setup_gps_streaming (ctx->skeleton, ctx->invocation);
+    handle_setup_gps_streaming_context_free (ctx);
+}
+
+static gboolean
+handle_setup_gps_streaming (MmGdbusModemLocation *skeleton,
+                            GDBusMethodInvocation *invocation,
+                            guint32 interval,
+                            MMIfaceModemLocation *self)
+{
+    HandleSetupGpsStreamingContext *ctx;
+
+    ctx = g_new (HandleSetupGpsStreamingContext, 1);
+    ctx->skeleton = g_object_ref (skeleton);
+    ctx->invocation = g_object_ref (invocation);
+    ctx->self = g_object_ref (self);
+    ctx->interval = interval;
+
+    mm_base_modem_authorize (MM_BASE_MODEM (self),
+                             invocation,
+                             MM_AUTHORIZATION_DEVICE_CONTROL,
+                             (GAsyncReadyCallback)handle_setup_gps_streaming_auth_ready,
+                             ctx);
+    return TRUE;
+}
+
+/*****************************************************************************/
+
 typedef struct {
     MmGdbusModemLocation *skeleton;
     GDBusMethodInvocation *invocation;
@@ -1036,6 +1247,7 @@ interface_disabling_step (DisablingContext *ctx)
 
     case DISABLING_STEP_LAST:
         /* We are done without errors! */
+        mm_gdbus_modem_location_set_gps_streaming_interval (ctx->skeleton, 0);
         clear_location_context (ctx->self);
         g_simple_async_result_set_op_res_gboolean (ctx->result, TRUE);
         disabling_context_complete_and_free (ctx);
@@ -1328,6 +1540,10 @@ interface_initialization_step (InitializationContext *ctx)
                           "handle-setup",
                           G_CALLBACK (handle_setup),
                           ctx->self);
+        g_signal_connect (ctx->skeleton,
+                          "handle-setup-gps-streaming",
+                          G_CALLBACK (handle_setup_gps_streaming),
+                          ctx->self);
         g_signal_connect (ctx->skeleton,
                           "handle-get-location",
                           G_CALLBACK (handle_get_location),
@@ -1373,6 +1589,7 @@ mm_iface_modem_location_initialize (MMIfaceModemLocation *self,
         mm_gdbus_modem_location_set_capabilities (skeleton, MM_MODEM_LOCATION_SOURCE_NONE);
         mm_gdbus_modem_location_set_enabled (skeleton, MM_MODEM_LOCATION_SOURCE_NONE);
         mm_gdbus_modem_location_set_signals_location (skeleton, FALSE);
+        mm_gdbus_modem_location_set_gps_streaming_interval (skeleton, 0);
         mm_gdbus_modem_location_set_location (skeleton,
                                               build_location_dictionary (NULL, NULL, NULL, NULL, NULL));
 
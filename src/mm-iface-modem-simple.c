@@ -995,6 +995,9 @@ handle_get_status (MmGdbusModemSimple *skeleton,
     MMSimpleStatus *status = NULL;
     GVariant *dictionary;
 
+    /* The client is interested in the signal quality, keep it fresh */
+    mm_iface_modem_signal_quality_watched (MM_IFACE_MODEM (self));
+
     g_object_get (self,
                   MM_IFACE_MODEM_SIMPLE_STATUS, &status,
                   NULL);
@@ -26,9 +26,13 @@
 #include "mm-bearer-list.h"
 #include "mm-log.h"
 #include "mm-context.h"
+#include "mm-poll-scheduler.h"
 
 #define SIGNAL_QUALITY_RECENT_TIMEOUT_SEC     60
 #define SIGNAL_QUALITY_CHECK_TIMEOUT_SEC      30
+#define SIGNAL_QUALITY_CHECK_MAX_TIMEOUT_SEC  240
+#define SIGNAL_QUALITY_CHECK_WATCHED_TIMEOUT_SEC 10
+#define SIGNAL_QUALITY_WATCHED_TIMEOUT_SEC    60
 #define ACCESS_TECHNOLOGIES_CHECK_TIMEOUT_SEC 30
 
 #define STATE_UPDATE_CONTEXT_TAG              "state-update-context-tag"
@@ -731,15 +735,15 @@ mm_iface_modem_update_access_technologies (MMIfaceModem *self,
 /*****************************************************************************/
 
 typedef struct {
-    guint timeout_source;
+    MMPollTask *task;
     gboolean running;
 } AccessTechnologiesCheckContext;
 
 static void
 access_technologies_check_context_free (AccessTechnologiesCheckContext *ctx)
 {
-    if (ctx->timeout_source)
-        g_source_remove (ctx->timeout_source);
+    if (ctx->task)
+        mm_poll_scheduler_remove (ctx->task);
     g_free (ctx);
 }
 
@@ -767,11 +771,13 @@ access_technologies_check_ready (MMIfaceModem *self,
      * mm_iface_modem_shutdown when this function is invoked as a callback of
      * load_access_technologies. */
     ctx = g_object_get_qdata (G_OBJECT (self), access_technologies_check_context_quark);
-    if (ctx)
+    if (ctx) {
         ctx->running = FALSE;
+        mm_poll_scheduler_task_done (ctx->task);
+    }
 }
 
-static gboolean
+static void
 periodic_access_technologies_check (MMIfaceModem *self)
 {
     AccessTechnologiesCheckContext *ctx;
@@ -787,8 +793,6 @@ periodic_access_technologies_check (MMIfaceModem *self)
             (GAsyncReadyCallback)access_technologies_check_ready,
             NULL);
     }
-
-    return TRUE;
 }
 
 static void
@@ -838,9 +842,10 @@ periodic_access_technologies_check_enable (MMIfaceModem *self)
     /* Create context and keep it as object data */
     mm_dbg ("Periodic access technology checks enabled");
     ctx = g_new0 (AccessTechnologiesCheckContext, 1);
-    ctx->timeout_source = g_timeout_add_seconds (ACCESS_TECHNOLOGIES_CHECK_TIMEOUT_SEC,
-                                                 (GSourceFunc)periodic_access_technologies_check,
-                                                 self);
+    ctx->task = mm_poll_scheduler_add ("access-technologies",
+                                       ACCESS_TECHNOLOGIES_CHECK_TIMEOUT_SEC,
+                                       (MMPollTaskFn)periodic_access_technologies_check,
+                                       self);
     g_object_set_qdata_full (G_OBJECT (self),
                              access_technologies_check_context_quark,
                              ctx,
@@ -852,9 +857,41 @@ periodic_access_technologies_check_enable (MMIfaceModem *self)
 
 /*****************************************************************************/
 
+/* Signal quality checks are scheduled adaptively:
+ *  - They're skipped while the modem keeps reporting the signal quality
+ *    with unsolicited messages.
+ *  - The interval between checks doubles each time the value doesn't change,
+ *    up to SIGNAL_QUALITY_CHECK_MAX_TIMEOUT_SEC, and goes back to
+ *    SIGNAL_QUALITY_CHECK_TIMEOUT_SEC as soon as it changes.
+ *  - While clients are asking for the signal quality, checks are run at
+ *    least every SIGNAL_QUALITY_CHECK_WATCHED_TIMEOUT_SEC.
+ */
+typedef struct {
+    MMPollTask *task;
+    gboolean running;
+    /* Current interval between checks, in seconds */
+    guint interval;
+    guint last_signal_quality;
+    time_t last_unsolicited;
+    time_t last_watched;
+} SignalQualityCheckContext;
+
+static SignalQualityCheckContext *
+get_signal_quality_check_context (MMIfaceModem *self)
+{
+    if (G_UNLIKELY (!signal_quality_check_context_quark))
+        signal_quality_check_context_quark = (g_quark_from_static_string (
+                                                  SIGNAL_QUALITY_CHECK_CONTEXT_TAG));
+
+    return g_object_get_qdata (G_OBJECT (self), signal_quality_check_context_quark);
+}
+
+/*****************************************************************************/
+
 typedef struct {
     time_t last_update;
     guint recent_timeout_source;
+    guint recent_timeout;
 } SignalQualityUpdateContext;
 
 static void
@@ -885,6 +922,8 @@ expire_signal_quality (MMIfaceModem *self)
     MmGdbusModem *skeleton = NULL;
     SignalQualityUpdateContext *ctx;
 
+    ctx = g_object_get_qdata (G_OBJECT (self), signal_quality_update_context_quark);
+
     g_object_get (self,
                   MM_IFACE_MODEM_DBUS_SKELETON, &skeleton,
                   NULL);
@@ -904,7 +943,7 @@ expire_signal_quality (MMIfaceModem *self)
         if (recent) {
             mm_dbg ("Signal quality value not updated in %us, "
                     "marking as not being recent",
-                    SIGNAL_QUALITY_RECENT_TIMEOUT_SEC);
+                    ctx->recent_timeout);
             mm_gdbus_modem_set_signal_quality (skeleton,
                                                g_variant_new ("(ub)",
                                                               signal_quality,
@@ -915,7 +954,6 @@ expire_signal_quality (MMIfaceModem *self)
     }
 
     /* Remove source id */
-    ctx = g_object_get_qdata (G_OBJECT (self), signal_quality_update_context_quark);
     ctx->recent_timeout_source = 0;
     return FALSE;
 }
@@ -926,6 +964,7 @@ update_signal_quality (MMIfaceModem *self,
                        gboolean expire)
 {
     SignalQualityUpdateContext *ctx;
+    SignalQualityCheckContext *check_ctx;
     MmGdbusModem *skeleton = NULL;
     const gchar *dbus_path;
 
@@ -976,12 +1015,20 @@ update_signal_quality (MMIfaceModem *self,
         ctx->recent_timeout_source = 0;
     }
 
-    /* If we got a new expirable value, setup new timeout */
-    if (expire)
+    /* If we got a new expirable value, setup new timeout. When checks are
+     * backed off because the value is stable, keep it recent until the
+     * next one. */
+    if (expire) {
+        ctx->recent_timeout = SIGNAL_QUALITY_RECENT_TIMEOUT_SEC;
+        check_ctx = get_signal_quality_check_context (self);
+        if (check_ctx)
+            ctx->recent_timeout = MAX (ctx->recent_timeout,
+                                       check_ctx->interval + SIGNAL_QUALITY_CHECK_TIMEOUT_SEC);
         ctx->recent_timeout_source = (g_timeout_add_seconds (
-                                          SIGNAL_QUALITY_RECENT_TIMEOUT_SEC,
+                                          ctx->recent_timeout,
                                           (GSourceFunc)expire_signal_quality,
                                           self));
+    }
 
     g_object_unref (skeleton);
 }
@@ -990,24 +1037,45 @@ void
 mm_iface_modem_update_signal_quality (MMIfaceModem *self,
                                       guint signal_quality)
 {
+    SignalQualityCheckContext *ctx;
+
+    /* Values reported here come from unsolicited messages, so periodic
+     * checks aren't needed while they keep coming */
+    ctx = get_signal_quality_check_context (self);
+    if (ctx) {
+        ctx->last_unsolicited = time (NULL);
+        if (signal_quality != ctx->last_signal_quality) {
+            ctx->last_signal_quality = signal_quality;
+            ctx->interval = SIGNAL_QUALITY_CHECK_TIMEOUT_SEC;
+        }
+    }
+
     update_signal_quality (self, signal_quality, TRUE);
 }
 
 /*****************************************************************************/
 
-typedef struct {
-    guint timeout_source;
-    gboolean running;
-} SignalQualityCheckContext;
-
 static void
 signal_quality_check_context_free (SignalQualityCheckContext *ctx)
 {
-    if (ctx->timeout_source)
-        g_source_remove (ctx->timeout_source);
+    if (ctx->task)
+        mm_poll_scheduler_remove (ctx->task);
     g_free (ctx);
 }
 
+static void
+signal_quality_check_schedule (MMIfaceModem *self,
+                               SignalQualityCheckContext *ctx)
+{
+    guint timeout;
+
+    timeout = ctx->interval;
+    if (time (NULL) - ctx->last_watched < SIGNAL_QUALITY_WATCHED_TIMEOUT_SEC)
+        timeout = MIN (timeout, SIGNAL_QUALITY_CHECK_WATCHED_TIMEOUT_SEC);
+
+    mm_poll_scheduler_set_interval (ctx->task, timeout);
+}
+
 static void
 signal_quality_check_ready (MMIfaceModem *self,
                             GAsyncResult *res)
@@ -1016,42 +1084,85 @@ signal_quality_check_ready (MMIfaceModem *self,
     guint signal_quality;
     SignalQualityCheckContext *ctx;
 
+    /* Note that the context may have been removed by mm_iface_modem_shutdown
+     * when this function is invoked as a callback of load_signal_quality. */
+    ctx = g_object_get_qdata (G_OBJECT (self), signal_quality_check_context_quark);
+
     signal_quality = MM_IFACE_MODEM_GET_INTERFACE (self)->load_signal_quality_finish (self,
                                                                                       res,
                                                                                       &error);
     if (error) {
         mm_dbg ("Couldn't refresh signal quality: '%s'", error->message);
         g_error_free (error);
-    } else
+    } else {
+        if (ctx) {
+            /* Back off while the value is stable */
+            if (signal_quality == ctx->last_signal_quality)
+                ctx->interval = MIN (ctx->interval * 2, SIGNAL_QUALITY_CHECK_MAX_TIMEOUT_SEC);
+            else
+                ctx->interval = SIGNAL_QUALITY_CHECK_TIMEOUT_SEC;
+            ctx->last_signal_quality = signal_quality;
+        }
         update_signal_quality (self, signal_quality, TRUE);
+    }
 
-    /* Remove the running tag. Note that the context may have been removed by
-     * mm_iface_modem_shutdown when this function is invoked as a callback of
-     * load_signal_quality. */
-    ctx = g_object_get_qdata (G_OBJECT (self), signal_quality_check_context_quark);
-    if (ctx)
+    /* Remove the running tag, and schedule the next check now that we know
+     * whether the value changed */
+    if (ctx) {
         ctx->running = FALSE;
+        mm_poll_scheduler_task_done (ctx->task);
+        signal_quality_check_schedule (self, ctx);
+    }
 }
 
-static gboolean
+static void
 periodic_signal_quality_check (MMIfaceModem *self)
 {
     SignalQualityCheckContext *ctx;
 
     ctx = g_object_get_qdata (G_OBJECT (self), signal_quality_check_context_quark);
 
+    if (time (NULL) - ctx->last_unsolicited < SIGNAL_QUALITY_RECENT_TIMEOUT_SEC)
+        mm_dbg ("Skipping signal quality check: unsolicited reports being received");
     /* Only launch a new one if not one running already OR if the last one run
      * was more than 15s ago. */
-    if (!ctx->running ||
-        (time (NULL) - get_last_signal_quality_update_time (self) > 15)) {
+    else if (!ctx->running ||
+             (time (NULL) - get_last_signal_quality_update_time (self) > 15)) {
         ctx->running = TRUE;
         MM_IFACE_MODEM_GET_INTERFACE (self)->load_signal_quality (
             self,
             (GAsyncReadyCallback)signal_quality_check_ready,
             NULL);
+        /* Rescheduled once the check is done */
+        return;
     }
 
-    return TRUE;
+    signal_quality_check_schedule (self, ctx);
+}
+
+void
+mm_iface_modem_signal_quality_watched (MMIfaceModem *self)
+{
+    SignalQualityCheckContext *ctx;
+    time_t now;
+
+    ctx = get_signal_quality_check_context (self);
+    if (!ctx)
+        return;
+
+    now = time (NULL);
+    if (now - ctx->last_watched >= SIGNAL_QUALITY_WATCHED_TIMEOUT_SEC) {
+        ctx->last_watched = now;
+
+        /* Check right away if the value we have is already too old */
+        if (now - get_last_signal_quality_update_time (self) > SIGNAL_QUALITY_CHECK_WATCHED_TIMEOUT_SEC)
+            periodic_signal_quality_check (self);
+        else
+            signal_quality_check_schedule (self, ctx);
+        return;
+    }
+
+    ctx->last_watched = now;
 }
 
 static void
@@ -1084,11 +1195,7 @@ periodic_signal_quality_check_enable (MMIfaceModem *self)
         return;
     }
 
-    if (G_UNLIKELY (!signal_quality_check_context_quark))
-        signal_quality_check_context_quark = (g_quark_from_static_string (
-                                                  SIGNAL_QUALITY_CHECK_CONTEXT_TAG));
-
-    ctx = g_object_get_qdata (G_OBJECT (self), signal_quality_check_context_quark);
+    ctx = get_signal_quality_check_context (self);
 
     /* If context is already there, we're already enabled */
     if (ctx) {
@@ -1099,9 +1206,11 @@ periodic_signal_quality_check_enable (MMIfaceModem *self)
     /* Create context and keep it as object data */
     mm_dbg ("Periodic signal quality checks enabled");
     ctx = g_new0 (SignalQualityCheckContext, 1);
-    ctx->timeout_source = g_timeout_add_seconds (SIGNAL_QUALITY_CHECK_TIMEOUT_SEC,
-                                                 (GSourceFunc)periodic_signal_quality_check,
-                                                 self);
+    ctx->interval = SIGNAL_QUALITY_CHECK_TIMEOUT_SEC;
+    ctx->task = mm_poll_scheduler_add ("signal-quality",
+                                       ctx->interval,
+                                       (MMPollTaskFn)periodic_signal_quality_check,
+                                       self);
     g_object_set_qdata_full (G_OBJECT (self),
                              signal_quality_check_context_quark,
                              ctx,
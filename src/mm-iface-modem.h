@@ -406,6 +406,10 @@ void mm_iface_modem_update_access_technologies (MMIfaceModem *self,
 void mm_iface_modem_update_signal_quality (MMIfaceModem *self,
                                            guint signal_quality);
 
+/* Allow reporting that clients are actively asking for the signal quality, so
+ * that it gets checked more often for a while */
+void mm_iface_modem_signal_quality_watched (MMIfaceModem *self);
+
 /* Allow setting allowed modes */
 void     mm_iface_modem_set_allowed_modes        (MMIfaceModem *self,
                                                   MMModemMode allowed,
@@ -19,8 +19,11 @@
 #include <syslog.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -45,6 +48,32 @@ static GTimeVal rel_start = { 0, 0 };
 static int logfd = -1;
 static gboolean func_loc = FALSE;
 
+/* Buffered log file writing.
+ *
+ * Lines are pushed to a lock-free queue (a stack where producers prepend with
+ * compare-and-exchange, and which the single consumer takes as a whole) and
+ * written in batches by a dedicated thread, with a single fsync() per batch.
+ */
+typedef struct _LogEntry LogEntry;
+struct _LogEntry {
+    LogEntry *next;
+    gsize len;
+    char str[1];
+};
+
+/* Max number of lines per writev() call */
+#define LOG_BATCH_IOV 64
+
+static GThread *writer_thread;
+static volatile gint writer_exit;
+static int writer_wakeup[2] = { -1, -1 };
+static guint flush_interval_ms;
+static guint flush_size;
+static guint32 flush_levels;
+/* LogEntry list, newest entry first */
+static volatile gpointer queue_head;
+static volatile gint queue_size;
+
 typedef struct {
     guint32 num;
     const char *name;
@@ -58,6 +87,160 @@ static const LogDesc level_descs[] = {
     { 0, NULL }
 };
 
+static void
+log_writer_wakeup (void)
+{
+    const char c = 0;
+    ssize_t ign;
+
+    /* If the pipe is full the writer is already due to wake up */
+    ign = write (writer_wakeup[1], &c, 1);
+    if (ign) {} /* whatever; really shut up about unused result */
+}
+
+static void
+log_queue_push (const char *str,
+                gsize len,
+                gboolean flush)
+{
+    LogEntry *entry;
+    LogEntry *head;
+    gint pending;
+
+    entry = g_malloc (G_STRUCT_OFFSET (LogEntry, str) + len);
+    memcpy (entry->str, str, len);
+    entry->len = len;
+
+    do {
+        head = g_atomic_pointer_get (&queue_head);
+        entry->next = head;
+    } while (!g_atomic_pointer_compare_and_exchange (&queue_head, head, entry));
+
+    /* May be transiently negative if the writer took the entry already */
+    pending = g_atomic_int_add (&queue_size, (gint) len) + (gint) len;
+    if (flush || (pending > 0 && (guint) pending >= flush_size))
+        log_writer_wakeup ();
+}
+
+/* Takes all the queued entries, oldest first. Only uses atomic operations,
+ * so it can be called from a signal handler. */
+static LogEntry *
+log_queue_take_all (void)
+{
+    LogEntry *head;
+    LogEntry *ordered = NULL;
+
+    do {
+        head = g_atomic_pointer_get (&queue_head);
+    } while (head && !g_atomic_pointer_compare_and_exchange (&queue_head, head, NULL));
+
+    while (head) {
+        LogEntry *next = head->next;
+
+        head->next = ordered;
+        ordered = head;
+        head = next;
+    }
+
+    return ordered;
+}
+
+static void
+log_queue_flush (void)
+{
+    LogEntry *entries;
+    gsize written = 0;
+
+    entries = log_queue_take_all ();
+    if (!entries)
+        return;
+
+    while (entries) {
+        struct iovec iov[LOG_BATCH_IOV];
+        LogEntry *next;
+        guint n = 0;
+        ssize_t ign;
+
+        for (next = entries; next && n < LOG_BATCH_IOV; next = next->next, n++) {
+            iov[n].iov_base = next->str;
+            iov[n].iov_len = next->len;
+            written += next->len;
+        }
+
+        ign = writev (logfd, iov, n);
+        if (ign) {} /* whatever; really shut up about unused result */
+
+        while (entries != next) {
+            LogEntry *done = entries;
+
+            entries = entries->next;
+            g_free (done);
+        }
+    }
+
+    g_atomic_int_add (&queue_size, - (gint) written);
+    fsync (logfd);
+}
+
+static gpointer
+log_writer_thread (gpointer unused)
+{
+    struct pollfd pfd;
+
+    pfd.fd = writer_wakeup[0];
+    pfd.events = POLLIN;
+
+    while (!g_atomic_int_get (&writer_exit)) {
+        pfd.revents = 0;
+        if (poll (&pfd, 1, flush_interval_ms) > 0 && (pfd.revents & POLLIN)) {
+            char drain[64];
+
+            while (read (writer_wakeup[0], drain, sizeof (drain)) > 0);
+        }
+        log_queue_flush ();
+    }
+
+    /* Whatever got queued while exiting */
+    log_queue_flush ();
+    return NULL;
+}
+
+static void
+log_crash_handler (int signo)
+{
+    LogEntry *entry;
+    ssize_t ign;
+
+    /* Don't lose the lines that may explain the crash. Entries are not freed,
+     * as that is not safe here. */
+    for (entry = log_queue_take_all (); entry; entry = entry->next) {
+        ign = write (logfd, entry->str, entry->len);
+        if (ign) {} /* whatever; really shut up about unused result */
+    }
+    fsync (logfd);
+
+    /* The default action was restored when entering the handler */
+    raise (signo);
+}
+
+static void
+log_file_write (const char *str,
+                gsize len,
+                gboolean flush)
+{
+    ssize_t ign;
+
+    if (writer_thread) {
+        log_queue_push (str, len, flush);
+        return;
+    }
+
+    ign = write (logfd, str, len);
+    if (ign) {} /* whatever; really shut up about unused result */
+
+    fsync (logfd);  /* Make sure output is dumped to disk immediately */
+}
+
 void
 _mm_log (const char *loc,
          const char *func,
@@ -72,7 +255,6 @@ _mm_log (const char *loc,
     char msgbuf[512] = { 0 };
     int syslog_priority = LOG_INFO;
     const char *prefix = NULL;
-    ssize_t ign;
 
     if (!(log_level & level))
         return;
@@ -120,12 +302,8 @@ _mm_log (const char *loc,
 
         if (logfd < 0)
             syslog (syslog_priority, "%s", msgbuf);
-        else {
-            ign = write (logfd, msgbuf, strlen (msgbuf));
-            if (ign) {} /* whatever; really shut up about unused result */
-
-            fsync (logfd);  /* Make sure output is dumped to disk immediately */
-        }
+        else
+            log_file_write (msgbuf, strlen (msgbuf), !!(level & flush_levels));
     }
 
     g_free (msg);
@@ -138,7 +316,6 @@ log_handler (const gchar *log_domain,
              gpointer ignored)
 {
     int syslog_priority;
-    ssize_t ign;
 
     switch (level) {
     case G_LOG_LEVEL_ERROR:
@@ -164,29 +341,35 @@ log_handler (const gchar *log_domain,
 
     if (logfd < 0)
         syslog (syslog_priority, "%s", message);
-    else {
-        ign = write (logfd, message, strlen (message));
-        if (ign) {} /* whatever; really shut up about unused result */
-    }
+    else
+        log_file_write (message, strlen (message), syslog_priority <= LOG_WARNING);
 }
 
-gboolean
-mm_log_set_level (const char *level, GError **error)
+static gboolean
+parse_level (const char *level,
+             guint32 *num,
+             GError **error)
 {
-    gboolean found = FALSE;
     const LogDesc *diter;
 
     for (diter = &level_descs[0]; diter->name; diter++) {
         if (!strcasecmp (diter->name, level)) {
-            log_level = diter->num;
-            found = TRUE;
-            break;
+            *num = diter->num;
+            return TRUE;
         }
     }
 
-    if (!found)
-        g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_INVALID_ARGS,
-                     "Unknown log level '%s'", level);
+    g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_INVALID_ARGS,
+                 "Unknown log level '%s'", level);
+    return FALSE;
+}
+
+gboolean
+mm_log_set_level (const char *level, GError **error)
+{
+    gboolean found;
+
+    found = parse_level (level, &log_level, error);
 
 #if defined WITH_QMI
     qmi_utils_set_traces_enabled (log_level & LOGL_DEBUG ? TRUE : FALSE);
@@ -246,6 +429,63 @@ mm_log_setup (const char *level,
     return TRUE;
 }
 
+gboolean
+mm_log_setup_buffering (guint interval_ms,
+                        guint size,
+                        const char *level,
+                        GError **error)
+{
+    struct sigaction action;
+    GError *inner_error = NULL;
+    const int crash_signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+    guint i;
+
+    g_return_val_if_fail (writer_thread == NULL, FALSE);
+
+    /* Only log files are buffered, and only if asked to */
+    if (logfd < 0 || interval_ms == 0)
+        return TRUE;
+
+    flush_levels = LOGL_WARN | LOGL_ERR;
+    if (level && strlen (level) && !parse_level (level, &flush_levels, error))
+        return FALSE;
+
+    flush_interval_ms = interval_ms;
+    flush_size = size;
+
+    if (pipe (writer_wakeup) < 0) {
+        g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
+                     "Couldn't create log writer pipe: (%d) %s",
+                     errno, strerror (errno));
+        return FALSE;
+    }
+    fcntl (writer_wakeup[0], F_SETFL, O_NONBLOCK);
+    fcntl (writer_wakeup[1], F_SETFL, O_NONBLOCK);
+
+#if GLIB_CHECK_VERSION (2,32,0)
+    writer_thread = g_thread_try_new ("mm-log", log_writer_thread, NULL, &inner_error);
+#else
+    writer_thread = g_thread_create (log_writer_thread, NULL, TRUE, &inner_error);
+#endif
+    if (!writer_thread) {
+        g_propagate_prefixed_error (error, inner_error, "Couldn't create log writer thread: ");
+        close (writer_wakeup[0]);
+        close (writer_wakeup[1]);
+        writer_wakeup[0] = writer_wakeup[1] = -1;
+        return FALSE;
+    }
+
+    /* Write whatever is queued if we crash */
+    memset (&action, 0, sizeof (action));
+    sigemptyset (&action.sa_mask);
+    action.sa_handler = log_crash_handler;
+    action.sa_flags = SA_RESETHAND | SA_NODEFER;
+    for (i = 0; i < G_N_ELEMENTS (crash_signals); i++)
+        sigaction (crash_signals[i], &action, NULL);
+
+    return TRUE;
+}
+
 void
 mm_log_usr1 (void)
 {
@@ -254,6 +494,17 @@ mm_log_usr1 (void)
 void
 mm_log_shutdown (void)
 {
+    if (writer_thread) {
+        g_atomic_int_set (&writer_exit, TRUE);
+        log_writer_wakeup ();
+        g_thread_join (writer_thread);
+        writer_thread = NULL;
+
+        close (writer_wakeup[0]);
+        close (writer_wakeup[1]);
+        writer_wakeup[0] = writer_wakeup[1] = -1;
+    }
+
     if (logfd < 0)
         closelog ();
     else
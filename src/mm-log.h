@@ -56,6 +56,14 @@ gboolean mm_log_setup (const char *level,
                        gboolean debug_func_loc,
                        GError **error);
 
+/* Buffer log file writes in a separate thread, flushing them every
+ * 'interval_ms', whenever 'size' bytes are pending, or right away for
+ * messages of the given level or higher (WARN if NULL). */
+gboolean mm_log_setup_buffering (guint interval_ms,
+                                 guint size,
+                                 const char *level,
+                                 GError **error);
+
 void mm_log_usr1 (void);
 
 void mm_log_shutdown (void);
@@ -32,6 +32,8 @@
 #include "mm-auth.h"
 #include "mm-plugin.h"
 #include "mm-log.h"
+#include "mm-serial-trace.h"
+#include "mm-uevent-queue.h"
 
 static void initable_iface_init (GInitableIface *iface);
 
@@ -57,6 +59,11 @@ struct _MMManagerPrivate {
     MMPluginManager *plugin_manager;
     /* The container of devices being prepared */
     GHashTable *devices;
+    /* Port sysfs path to the device owning it */
+    GHashTable *ports;
+    /* Udev events waiting to be processed in the next batch */
+    MMUeventQueue *uevents;
+    guint uevent_batch_id;
     /* The Object Manager server */
     GDBusObjectManagerServer *object_manager;
 };
@@ -84,17 +91,8 @@ static MMDevice *
 find_device_by_port (MMManager *manager,
                      GUdevDevice *port)
 {
-    GHashTableIter iter;
-    gpointer key, value;
-
-    g_hash_table_iter_init (&iter, manager->priv->devices);
-    while (g_hash_table_iter_next (&iter, &key, &value)) {
-        MMDevice *candidate = MM_DEVICE (value);
-
-        if (mm_device_owns_port (candidate, port))
-            return candidate;
-    }
-    return NULL;
+    return g_hash_table_lookup (manager->priv->ports,
+                                g_udev_device_get_sysfs_path (port));
 }
 
 static MMDevice *
@@ -112,6 +110,25 @@ find_device_by_udev_device (MMManager *manager,
     return find_device_by_sysfs_path (manager, g_udev_device_get_sysfs_path (udev_device));
 }
 
+static gboolean
+port_owned_by_device (const gchar *port_path,
+                      MMDevice *owner,
+                      MMDevice *device)
+{
+    return owner == device;
+}
+
+static void
+remove_device (MMManager *self,
+               MMDevice *device)
+{
+    /* Ports of the device are no longer reachable */
+    g_hash_table_foreach_remove (self->priv->ports,
+                                 (GHRFunc)port_owned_by_device,
+                                 device);
+    g_hash_table_remove (self->priv->devices, mm_device_get_path (device));
+}
+
 /*****************************************************************************/
 
 typedef struct {
@@ -152,19 +169,67 @@ find_device_support_ready (MMPluginManager *plugin_manager,
     find_device_support_context_free (ctx);
 }
 
+static void
+physdev_unref (GUdevDevice *physdev)
+{
+    if (physdev)
+        g_object_unref (physdev);
+}
+
+static GHashTable *
+physdev_cache_new (void)
+{
+    return g_hash_table_new_full (g_str_hash,
+                                  g_str_equal,
+                                  g_free,
+                                  (GDestroyNotify)physdev_unref);
+}
+
+/* If a cache is given, every device walked through is stored in it together
+ * with the physical device found, so that the walk for other ports of the
+ * same device stops as soon as it reaches a known parent. */
 static GUdevDevice *
-find_physical_device (GUdevDevice *child)
+find_physical_device (GUdevDevice *child,
+                      GHashTable *cache)
 {
     GUdevDevice *iter, *old = NULL;
     GUdevDevice *physdev = NULL;
+    GPtrArray *visited = NULL;
     const char *subsys, *type;
     guint32 i = 0;
     gboolean is_usb = FALSE, is_pci = FALSE, is_pcmcia = FALSE, is_platform = FALSE;
 
     g_return_val_if_fail (child != NULL, NULL);
 
+    if (cache)
+        visited = g_ptr_array_new ();
+
     iter = g_object_ref (child);
     while (iter && i++ < 8) {
+        const gchar *path;
+
+        path = visited ? g_udev_device_get_sysfs_path (iter) : NULL;
+        if (path) {
+            gchar *key;
+            GUdevDevice *cached;
+
+            /* The result from here on also depends on the bus types already
+             * found in the children */
+            key = g_strdup_printf ("%c%c%c%c:%s",
+                                   is_usb ? 'u' : '-',
+                                   is_pcmcia ? 'c' : '-',
+                                   is_platform ? 'f' : '-',
+                                   is_pci ? 'p' : '-',
+                                   path);
+            if (g_hash_table_lookup_extended (cache, key, NULL, (gpointer *)&cached)) {
+                g_free (key);
+                physdev = cached ? g_object_ref (cached) : NULL;
+                g_object_unref (iter);
+                break;
+            }
+            g_ptr_array_add (visited, key);
+        }
+
         subsys = g_udev_device_get_subsystem (iter);
         if (subsys) {
             if (is_usb || g_str_has_prefix (subsys, "usb")) {
@@ -211,12 +276,21 @@ find_physical_device (GUdevDevice *child)
         g_object_unref (old);
     }
 
+    if (visited) {
+        for (i = 0; i < visited->len; i++)
+            g_hash_table_insert (cache,
+                                 g_ptr_array_index (visited, i),
+                                 physdev ? g_object_ref (physdev) : NULL);
+        g_ptr_array_free (visited, TRUE);
+    }
+
     return physdev;
 }
 
 static void
 device_added (MMManager *manager,
-              GUdevDevice *port)
+              GUdevDevice *port,
+              GHashTable *physdev_cache)
 {
     MMDevice *device;
     const char *subsys, *name, *physdev_path, *physdev_subsys;
@@ -250,7 +324,7 @@ device_added (MMManager *manager,
      * that "owns" all the ports of the device, like the USB device or the PCI
      * device the provides each tty or network port.
      */
-    physdev = find_physical_device (port);
+    physdev = find_physical_device (port, physdev_cache);
     if (!physdev) {
         /* Warn about it, but filter out some common ports that we know don't have
          * anything to do with mobile broadband.
@@ -310,6 +384,9 @@ device_added (MMManager *manager,
 
     /* Grab the port in the existing device. */
     mm_device_grab_port (device, port);
+    g_hash_table_insert (manager->priv->ports,
+                         g_strdup (g_udev_device_get_sysfs_path (port)),
+                         device);
 
 out:
     if (physdev)
@@ -339,12 +416,14 @@ device_removed (MMManager *self,
                      name,
                      g_udev_device_get_sysfs_path (mm_device_peek_udev_device (device)));
             mm_device_release_port (device, udev_device);
+            g_hash_table_remove (self->priv->ports,
+                                 g_udev_device_get_sysfs_path (udev_device));
 
             /* If port probe list gets empty, remove the device object iself */
             if (!mm_device_peek_port_probe_list (device)) {
                 mm_dbg ("Removing empty device '%s'", mm_device_get_path (device));
                 mm_device_remove_modem (device);
-                g_hash_table_remove (self->priv->devices, mm_device_get_path (device));
+                remove_device (self, device);
             }
         }
 
@@ -363,7 +442,7 @@ device_removed (MMManager *self,
     if (device) {
         mm_dbg ("Removing device '%s'", mm_device_get_path (device));
         mm_device_remove_modem (device);
-        g_hash_table_remove (self->priv->devices, mm_device_get_path (device));
+        remove_device (self, device);
         return;
     }
 
@@ -371,6 +450,89 @@ device_removed (MMManager *self,
      * TODO: Cancel every possible supports check in this port. */
 }
 
+/*****************************************************************************/
+/* Udev events are not processed right away, but batched during a short time
+ * window. Several events for the same port (e.g. 'add' and 'change') end up
+ * in a single one, a port added and removed within the window is never even
+ * looked at, and the physical devices are resolved once per batch. Events are
+ * otherwise processed in the order they came, so that e.g. a replugged port
+ * isn't dropped along with the removal of its old parent device. Whether a
+ * removed device is known is only checked when processing the remove, after
+ * the adds queued before it. */
+
+#define UEVENT_BATCH_TIMEOUT_MS 100
+
+typedef struct {
+    MMManager *self;
+    GHashTable *physdev_cache;
+} ProcessUeventContext;
+
+static void
+process_uevent (GObject *device,
+                gboolean added,
+                ProcessUeventContext *ctx)
+{
+    if (added)
+        device_added (ctx->self, G_UDEV_DEVICE (device), ctx->physdev_cache);
+    else
+        device_removed (ctx->self, G_UDEV_DEVICE (device));
+}
+
+static void
+process_pending_uevents (MMManager *self)
+{
+    ProcessUeventContext ctx;
+    guint n_processed;
+    guint n_cancelled;
+
+    if (self->priv->uevent_batch_id) {
+        g_source_remove (self->priv->uevent_batch_id);
+        self->priv->uevent_batch_id = 0;
+    }
+
+    ctx.self = self;
+    ctx.physdev_cache = physdev_cache_new ();
+    n_processed = mm_uevent_queue_flush (self->priv->uevents,
+                                         (MMUeventQueueFn)process_uevent,
+                                         &ctx,
+                                         &n_cancelled);
+    g_hash_table_unref (ctx.physdev_cache);
+
+    if (n_processed || n_cancelled)
+        mm_dbg ("Processed '%u' udev events ('%u' add/remove pairs cancelled)",
+                n_processed,
+                n_cancelled);
+}
+
+static gboolean
+uevent_batch_cb (MMManager *self)
+{
+    self->priv->uevent_batch_id = 0;
+    process_pending_uevents (self);
+    return FALSE;
+}
+
+static void
+queue_uevent (MMManager *self,
+              GUdevDevice *device,
+              gboolean added)
+{
+    const gchar *path;
+
+    path = g_udev_device_get_sysfs_path (device);
+    g_return_if_fail (path != NULL);
+
+    if (added)
+        mm_uevent_queue_add (self->priv->uevents, path, G_OBJECT (device));
+    else
+        mm_uevent_queue_remove (self->priv->uevents, path, G_OBJECT (device));
+
+    if (!self->priv->uevent_batch_id)
+        self->priv->uevent_batch_id = g_timeout_add (UEVENT_BATCH_TIMEOUT_MS,
+                                                     (GSourceFunc)uevent_batch_cb,
+                                                     self);
+}
+
 static void
 handle_uevent (GUdevClient *client,
                const char *action,
@@ -394,31 +556,37 @@ handle_uevent (GUdevClient *client,
     name = g_udev_device_get_name (device);
     if (   (g_str_equal (action, "add") || g_str_equal (action, "move") || g_str_equal (action, "change"))
         && (!g_str_has_prefix (subsys, "usb") || (name && g_str_has_prefix (name, "cdc-wdm"))))
-        device_added (self, device);
+        queue_uevent (self, device, TRUE);
     else if (g_str_equal (action, "remove"))
-        device_removed (self, device);
+        queue_uevent (self, device, FALSE);
 }
 
 void
 mm_manager_start (MMManager *manager)
 {
     GList *devices, *iter;
+    GHashTable *physdev_cache;
 
     g_return_if_fail (manager != NULL);
     g_return_if_fail (MM_IS_MANAGER (manager));
 
+    /* Don't let older events be processed after the scan */
+    process_pending_uevents (manager);
+
     mm_dbg ("Starting device scan...");
 
+    physdev_cache = physdev_cache_new ();
+
     devices = g_udev_client_query_by_subsystem (manager->priv->udev, "tty");
     for (iter = devices; iter; iter = g_list_next (iter)) {
-        device_added (manager, G_UDEV_DEVICE (iter->data));
+        device_added (manager, G_UDEV_DEVICE (iter->data), physdev_cache);
         g_object_unref (G_OBJECT (iter->data));
     }
     g_list_free (devices);
 
     devices = g_udev_client_query_by_subsystem (manager->priv->udev, "net");
     for (iter = devices; iter; iter = g_list_next (iter)) {
-        device_added (manager, G_UDEV_DEVICE (iter->data));
+        device_added (manager, G_UDEV_DEVICE (iter->data), physdev_cache);
         g_object_unref (G_OBJECT (iter->data));
     }
     g_list_free (devices);
@@ -429,7 +597,7 @@ mm_manager_start (MMManager *manager)
 
         name = g_udev_device_get_name (G_UDEV_DEVICE (iter->data));
         if (name && g_str_has_prefix (name, "cdc-wdm"))
-            device_added (manager, G_UDEV_DEVICE (iter->data));
+            device_added (manager, G_UDEV_DEVICE (iter->data), physdev_cache);
         g_object_unref (G_OBJECT (iter->data));
     }
     g_list_free (devices);
@@ -441,11 +609,13 @@ mm_manager_start (MMManager *manager)
 
         name = g_udev_device_get_name (G_UDEV_DEVICE (iter->data));
         if (name && g_str_has_prefix (name, "cdc-wdm"))
-            device_added (manager, G_UDEV_DEVICE (iter->data));
+            device_added (manager, G_UDEV_DEVICE (iter->data), physdev_cache);
         g_object_unref (G_OBJECT (iter->data));
     }
     g_list_free (devices);
 
+    g_hash_table_unref (physdev_cache);
+
     mm_dbg ("Finished device scan...");
 }
 
@@ -629,6 +799,65 @@ handle_scan_devices (MmGdbusOrgFreedesktopModemManager1 *manager,
     return TRUE;
 }
 
+typedef struct {
+    MMManager *self;
+    GDBusMethodInvocation *invocation;
+} DumpSerialTraceContext;
+
+static void
+dump_serial_trace_context_free (DumpSerialTraceContext *ctx)
+{
+    g_object_unref (ctx->invocation);
+    g_object_unref (ctx->self);
+    g_free (ctx);
+}
+
+static void
+dump_serial_trace_auth_ready (MMAuthProvider *authp,
+                              GAsyncResult *res,
+                              DumpSerialTraceContext *ctx)
+{
+    GError *error = NULL;
+
+    if (!mm_auth_provider_authorize_finish (authp, res, &error))
+        g_dbus_method_invocation_take_error (ctx->invocation, error);
+    else {
+        GByteArray *trace;
+
+        trace = mm_serial_trace_dump ();
+        mm_gdbus_org_freedesktop_modem_manager1_complete_dump_serial_trace (
+            MM_GDBUS_ORG_FREEDESKTOP_MODEM_MANAGER1 (ctx->self),
+            ctx->invocation,
+            g_variant_new_from_data (G_VARIANT_TYPE ("ay"),
+                                     trace->data,
+                                     trace->len,
+                                     TRUE,
+                                     (GDestroyNotify) g_byte_array_unref,
+                                     trace));
+    }
+
+    dump_serial_trace_context_free (ctx);
+}
+
+static gboolean
+handle_dump_serial_trace (MmGdbusOrgFreedesktopModemManager1 *manager,
+                          GDBusMethodInvocation *invocation)
+{
+    DumpSerialTraceContext *ctx;
+
+    ctx = g_new (DumpSerialTraceContext, 1);
+    ctx->self = g_object_ref (manager);
+    ctx->invocation = g_object_ref (invocation);
+
+    mm_auth_provider_authorize (ctx->self->priv->authp,
+                                invocation,
+                                MM_AUTHORIZATION_MANAGER_CONTROL,
+                                ctx->self->priv->authp_cancellable,
+                                (GAsyncReadyCallback)dump_serial_trace_auth_ready,
+                                ctx);
+    return TRUE;
+}
+
 MMManager *
 mm_manager_new (GDBusConnection *connection,
                 GError **error)
@@ -697,6 +926,10 @@ mm_manager_init (MMManager *manager)
 
     /* Setup internal lists of device objects */
     priv->devices = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+    priv->ports = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    /* Setup batching of udev events */
+    priv->uevents = mm_uevent_queue_new ();
 
     /* Setup UDev client */
     priv->udev = g_udev_client_new (subsys);
@@ -714,6 +947,10 @@ mm_manager_init (MMManager *manager)
                       "handle-scan-devices",
                       G_CALLBACK (handle_scan_devices),
                       NULL);
+    g_signal_connect (manager,
+                      "handle-dump-serial-trace",
+                      G_CALLBACK (handle_dump_serial_trace),
+                      NULL);
 }
 
 static gboolean
@@ -748,6 +985,11 @@ finalize (GObject *object)
 {
     MMManagerPrivate *priv = MM_MANAGER (object)->priv;
 
+    if (priv->uevent_batch_id)
+        g_source_remove (priv->uevent_batch_id);
+    mm_uevent_queue_free (priv->uevents);
+
+    g_hash_table_destroy (priv->ports);
     g_hash_table_destroy (priv->devices);
 
     if (priv->udev)
@@ -0,0 +1,199 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#include "mm-plugin-index.h"
+
+struct _MMPluginIndex {
+    /* Each table goes from the key to a GArray of plugin positions */
+    GHashTable *by_product;
+    GHashTable *by_vendor;
+    GHashTable *by_driver;
+    GHashTable *by_udev_tag;
+    /* Plugins without mandatory filters */
+    GArray *unindexed;
+    guint n_positions;
+};
+
+#define PRODUCT_KEY(vendor, product) \
+    GUINT_TO_POINTER (((guint) (vendor) << 16) | (guint) (product))
+
+MMPluginIndex *
+mm_plugin_index_new (void)
+{
+    MMPluginIndex *self;
+
+    self = g_slice_new0 (MMPluginIndex);
+    self->by_product = g_hash_table_new_full (g_direct_hash,
+                                              g_direct_equal,
+                                              NULL,
+                                              (GDestroyNotify)g_array_unref);
+    self->by_vendor = g_hash_table_new_full (g_direct_hash,
+                                             g_direct_equal,
+                                             NULL,
+                                             (GDestroyNotify)g_array_unref);
+    self->by_driver = g_hash_table_new_full (g_str_hash,
+                                             g_str_equal,
+                                             g_free,
+                                             (GDestroyNotify)g_array_unref);
+    self->by_udev_tag = g_hash_table_new_full (g_str_hash,
+                                               g_str_equal,
+                                               g_free,
+                                               (GDestroyNotify)g_array_unref);
+    self->unindexed = g_array_new (FALSE, FALSE, sizeof (guint));
+    return self;
+}
+
+void
+mm_plugin_index_free (MMPluginIndex *self)
+{
+    g_hash_table_unref (self->by_product);
+    g_hash_table_unref (self->by_vendor);
+    g_hash_table_unref (self->by_driver);
+    g_hash_table_unref (self->by_udev_tag);
+    g_array_unref (self->unindexed);
+    g_slice_free (MMPluginIndex, self);
+}
+
+/*****************************************************************************/
+
+static void
+index_add (GHashTable *table,
+           gpointer key,
+           GDestroyNotify key_free,
+           guint position)
+{
+    GArray *positions;
+
+    positions = g_hash_table_lookup (table, key);
+    if (!positions) {
+        positions = g_array_new (FALSE, FALSE, sizeof (guint));
+        g_hash_table_insert (table, key, positions);
+    } else if (key_free)
+        key_free (key);
+
+    /* The same key may be listed more than once in a plugin */
+    if (positions->len &&
+        g_array_index (positions, guint, positions->len - 1) == position)
+        return;
+
+    g_array_append_val (positions, position);
+}
+
+void
+mm_plugin_index_add (MMPluginIndex *self,
+                     guint position,
+                     const gchar **drivers,
+                     const guint16 *vendor_ids,
+                     const mm_uint16_pair *product_ids,
+                     const gchar **udev_tags)
+{
+    guint i;
+
+    self->n_positions = MAX (self->n_positions, position + 1);
+
+    /* Any of the mandatory filters is enough to find the plugin, so just use
+     * the one expected to be more selective */
+    if (product_ids) {
+        for (i = 0; product_ids[i].l; i++)
+            index_add (self->by_product,
+                       PRODUCT_KEY (product_ids[i].l, product_ids[i].r),
+                       NULL,
+                       position);
+    } else if (vendor_ids) {
+        for (i = 0; vendor_ids[i]; i++)
+            index_add (self->by_vendor,
+                       GUINT_TO_POINTER ((guint) vendor_ids[i]),
+                       NULL,
+                       position);
+    } else if (drivers) {
+        for (i = 0; drivers[i]; i++)
+            index_add (self->by_driver,
+                       g_strdup (drivers[i]),
+                       g_free,
+                       position);
+    } else if (udev_tags) {
+        for (i = 0; udev_tags[i]; i++)
+            index_add (self->by_udev_tag,
+                       g_strdup (udev_tags[i]),
+                       g_free,
+                       position);
+    } else
+        g_array_append_val (self->unindexed, position);
+}
+
+guint
+mm_plugin_index_get_n_positions (MMPluginIndex *self)
+{
+    return self->n_positions;
+}
+
+/*****************************************************************************/
+
+static void
+mark_candidates (GArray *positions,
+                 gboolean *candidates)
+{
+    guint i;
+
+    if (!positions)
+        return;
+
+    for (i = 0; i < positions->len; i++)
+        candidates[g_array_index (positions, guint, i)] = TRUE;
+}
+
+void
+mm_plugin_index_lookup (MMPluginIndex *self,
+                        const gchar **drivers,
+                        guint16 vendor,
+                        guint16 product,
+                        MMPluginIndexHasUdevTagFn has_udev_tag,
+                        gpointer user_data,
+                        gboolean *candidates)
+{
+    guint i;
+
+    mark_candidates (self->unindexed, candidates);
+
+    if (vendor) {
+        mark_candidates (g_hash_table_lookup (self->by_vendor,
+                                              GUINT_TO_POINTER ((guint) vendor)),
+                         candidates);
+        if (product)
+            mark_candidates (g_hash_table_lookup (self->by_product,
+                                                  PRODUCT_KEY (vendor, product)),
+                             candidates);
+    }
+
+    if (drivers) {
+        for (i = 0; drivers[i]; i++)
+            mark_candidates (g_hash_table_lookup (self->by_driver, drivers[i]),
+                             candidates);
+    }
+
+    /* There are just a few different udev tags, so check each one in the
+     * port instead of going through the port properties */
+    if (has_udev_tag && g_hash_table_size (self->by_udev_tag)) {
+        GHashTableIter iter;
+        const gchar *udev_tag;
+        GArray *positions;
+
+        g_hash_table_iter_init (&iter, self->by_udev_tag);
+        while (g_hash_table_iter_next (&iter, (gpointer *)&udev_tag, (gpointer *)&positions)) {
+            if (has_udev_tag (udev_tag, user_data))
+                mark_candidates (positions, candidates);
+        }
+    }
+}
@@ -0,0 +1,64 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#ifndef MM_PLUGIN_INDEX_H
+#define MM_PLUGIN_INDEX_H
+
+#include <glib.h>
+
+#include "mm-private-boxed-types.h"
+
+/* Index of plugins by their mandatory pre-probing filters.
+ *
+ * Each plugin is identified by its position in the plugin list, and gets
+ * indexed by the most selective of the filters a port must pass to be
+ * supported by it. Looking up a port gives the set of plugins which may
+ * support it, which is always a superset of the plugins passing all the
+ * pre-probing filters, so the full filters still need to be applied to the
+ * candidates.
+ */
+
+typedef struct _MMPluginIndex MMPluginIndex;
+
+MMPluginIndex *mm_plugin_index_new  (void);
+void           mm_plugin_index_free (MMPluginIndex *self);
+
+/* Registers the plugin at the given position. Only the filters which are
+ * mandatory for the plugin must be given, the others must be NULL. All
+ * arrays are 0 or NULL terminated. */
+void  mm_plugin_index_add (MMPluginIndex *self,
+                           guint position,
+                           const gchar **drivers,
+                           const guint16 *vendor_ids,
+                           const mm_uint16_pair *product_ids,
+                           const gchar **udev_tags);
+
+/* Number of items needed in the candidates array given in lookups */
+guint mm_plugin_index_get_n_positions (MMPluginIndex *self);
+
+typedef gboolean (*MMPluginIndexHasUdevTagFn) (const gchar *udev_tag,
+                                               gpointer user_data);
+
+/* Sets to TRUE the items of @candidates for the plugins which may support a
+ * port with the given drivers, IDs and udev tags. */
+void  mm_plugin_index_lookup (MMPluginIndex *self,
+                              const gchar **drivers,
+                              guint16 vendor,
+                              guint16 product,
+                              MMPluginIndexHasUdevTagFn has_udev_tag,
+                              gpointer user_data,
+                              gboolean *candidates);
+
+#endif /* MM_PLUGIN_INDEX_H */
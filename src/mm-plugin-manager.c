@@ -28,10 +28,14 @@
 #include "mm-plugin-manager.h"
 #include "mm-plugin.h"
 #include "mm-log.h"
+#include "mm-context.h"
 
 /* Default time to defer probing checks */
 #define DEFER_TIMEOUT_SECS 3
 
+/* Time to defer probing checks in fast probing mode */
+#define FAST_DEFER_TIMEOUT_SECS 1
+
 /* Time to wait for other ports to appear once the first port is exposed */
 #define MIN_PROBING_TIME_SECS 2
 
@@ -48,6 +52,9 @@ struct _MMPluginManagerPrivate {
     GList *plugins;
     /* Last, the generic plugin. */
     MMPlugin *generic;
+    /* Index of the plugins in the list by their pre-probing filters, so that
+     * we don't need to run them all for every port */
+    MMPluginIndex *index;
 };
 
 /*****************************************************************************/
@@ -60,6 +67,8 @@ typedef struct {
     guint timeout_id;
     gulong grabbed_id;
     gulong released_id;
+    gint64 start_time;
+    guint n_probed_ports;
 
     GList *running_probes;
 } FindDeviceSupportContext;
@@ -67,6 +76,7 @@ typedef struct {
 typedef struct {
     FindDeviceSupportContext *parent_ctx;
     GUdevDevice *port;
+    gint64 start_time;
 
     GList *plugins;
     GList *current;
@@ -101,6 +111,11 @@ find_device_support_context_complete_and_free (FindDeviceSupportContext *ctx)
 {
     g_assert (ctx->timeout_id == 0);
 
+    mm_info ("(Plugin Manager) [%s] support check finished in %.3fs (%u ports probed)",
+             mm_device_get_path (ctx->device),
+             (g_get_monotonic_time () - ctx->start_time) / (gdouble) G_USEC_PER_SEC,
+             ctx->n_probed_ports);
+
     /* Set async operation result */
     if (!mm_device_peek_plugin (ctx->device)) {
         g_simple_async_result_set_error (ctx->result,
@@ -137,6 +152,11 @@ port_probe_context_finished (PortProbeContext *port_probe_ctx)
 {
     FindDeviceSupportContext *ctx = port_probe_ctx->parent_ctx;
 
+    mm_dbg ("(Plugin Manager) [%s] port probing finished in %.3fs",
+            g_udev_device_get_name (port_probe_ctx->port),
+            (g_get_monotonic_time () - port_probe_ctx->start_time) / (gdouble) G_USEC_PER_SEC);
+    ctx->n_probed_ports++;
+
     if (!port_probe_ctx->best_plugin) {
         gboolean cancel_remaining;
         GList *l;
@@ -375,7 +395,9 @@ plugin_supports_port_ready (MMPlugin *plugin,
         }
 
         /* Schedule checking support */
-        port_probe_ctx->defer_id = g_timeout_add_seconds (DEFER_TIMEOUT_SECS,
+        port_probe_ctx->defer_id = g_timeout_add_seconds ((mm_context_get_fast_probing () ?
+                                                           FAST_DEFER_TIMEOUT_SECS :
+                                                           DEFER_TIMEOUT_SECS),
                                                           (GSourceFunc)deferred_support_check_idle,
                                                           port_probe_ctx);
         return;
@@ -432,18 +454,49 @@ port_probe_context_step (PortProbeContext *port_probe_ctx)
                              port_probe_ctx);
 }
 
+static gboolean
+port_has_udev_tag (const gchar *udev_tag,
+                   GUdevDevice *port)
+{
+    return g_udev_device_get_property_as_boolean (port, udev_tag);
+}
+
 static GList *
 build_plugins_list (MMPluginManager *self,
                     MMDevice *device,
                     GUdevDevice *port)
 {
+    static const gchar *virtual_drivers[] = { "virtual", NULL };
     GList *list = NULL;
     GList *l;
     gboolean supported_found = FALSE;
-
-    for (l = self->priv->plugins; l && !supported_found; l = g_list_next (l)) {
+    gboolean *candidates;
+    guint i;
+
+    /* Find which plugins may pass the pre-probing filters; virtual ports are
+     * filtered as if they had a 'virtual' driver */
+    candidates = g_new0 (gboolean, mm_plugin_index_get_n_positions (self->priv->index));
+    mm_plugin_index_lookup (self->priv->index,
+                            mm_device_get_drivers (device),
+                            mm_device_get_vendor (device),
+                            mm_device_get_product (device),
+                            (MMPluginIndexHasUdevTagFn)port_has_udev_tag,
+                            port,
+                            candidates);
+    mm_plugin_index_lookup (self->priv->index,
+                            virtual_drivers,
+                            0,
+                            0,
+                            NULL,
+                            NULL,
+                            candidates);
+
+    for (l = self->priv->plugins, i = 0; l && !supported_found; l = g_list_next (l), i++) {
         MMPluginSupportsHint hint;
 
+        if (!candidates[i])
+            continue;
+
         hint = mm_plugin_discard_port_early (MM_PLUGIN (l->data), device, port);
         switch (hint) {
         case MM_PLUGIN_SUPPORTS_HINT_UNSUPPORTED:
@@ -472,6 +525,8 @@ build_plugins_list (MMPluginManager *self,
         }
     }
 
+    g_free (candidates);
+
     /* Add the generic plugin at the end of the list */
     if (self->priv->generic)
         list = g_list_append (list, g_object_ref (self->priv->generic));
@@ -499,6 +554,7 @@ device_port_grabbed_cb (MMDevice *device,
     port_probe_ctx = g_slice_new0 (PortProbeContext);
     port_probe_ctx->parent_ctx = ctx;
     port_probe_ctx->port = g_object_ref (port);
+    port_probe_ctx->start_time = g_get_monotonic_time ();
 
     /* Setup plugins to probe and first one to check */
     port_probe_ctx->plugins = build_plugins_list (ctx->self, device, port);
@@ -560,6 +616,7 @@ mm_plugin_manager_find_device_support (MMPluginManager *self,
                                              callback,
                                              user_data,
                                              mm_plugin_manager_find_device_support);
+    ctx->start_time = g_get_monotonic_time ();
 
     /* Connect to device port grabbed/released notifications */
     ctx->grabbed_id = g_signal_connect (device,
@@ -651,6 +708,8 @@ load_plugins (MMPluginManager *self,
     GDir *dir = NULL;
     const gchar *fname;
     gchar *plugindir_display = NULL;
+    GList *l;
+    guint i;
 
 	if (!g_module_supported ()) {
         g_set_error (error,
@@ -702,6 +761,11 @@ load_plugins (MMPluginManager *self,
     if (!self->priv->generic)
         mm_warn ("Generic plugin not loaded");
 
+    /* Index the vendor specific plugins by their position in the list */
+    self->priv->index = mm_plugin_index_new ();
+    for (l = self->priv->plugins, i = 0; l; l = g_list_next (l), i++)
+        mm_plugin_add_to_index (MM_PLUGIN (l->data), self->priv->index, i);
+
     /* Treat as error if we don't find any plugin */
     if (!self->priv->plugins && !self->priv->generic) {
         g_set_error (error,
@@ -763,6 +827,11 @@ dispose (GObject *object)
     }
     g_clear_object (&self->priv->generic);
 
+    if (self->priv->index) {
+        mm_plugin_index_free (self->priv->index);
+        self->priv->index = NULL;
+    }
+
     G_OBJECT_CLASS (mm_plugin_manager_parent_class)->dispose (object);
 }
 
@@ -781,6 +781,27 @@ mm_plugin_discard_port_early (MMPlugin *self,
     return MM_PLUGIN_SUPPORTS_HINT_MAYBE;
 }
 
+void
+mm_plugin_add_to_index (MMPlugin *self,
+                        MMPluginIndex *index,
+                        guint position)
+{
+    gboolean ids_mandatory;
+
+    /* Vendor/product ID filters are not mandatory if the plugin may end up
+     * matching vendor/product strings instead; see apply_pre_probing_filters() */
+    ids_mandatory = (!self->priv->vendor_strings &&
+                     !self->priv->product_strings &&
+                     !self->priv->forbidden_product_strings);
+
+    mm_plugin_index_add (index,
+                         position,
+                         (const gchar **) self->priv->drivers,
+                         ids_mandatory ? self->priv->vendor_ids : NULL,
+                         ids_mandatory ? self->priv->product_ids : NULL,
+                         (const gchar **) self->priv->udev_tags);
+}
+
 /*****************************************************************************/
 
 MMBaseModem *
@@ -26,6 +26,7 @@
 #include "mm-port.h"
 #include "mm-port-probe.h"
 #include "mm-device.h"
+#include "mm-plugin-index.h"
 
 #define MM_PLUGIN_GENERIC_NAME "Generic"
 #define MM_PLUGIN_MAJOR_VERSION 4
@@ -116,6 +117,11 @@ MMPluginSupportsHint mm_plugin_discard_port_early (MMPlugin *plugin,
                                                    MMDevice *device,
                                                    GUdevDevice *port);
 
+/* Registers the plugin in the pre-probing filter index */
+void mm_plugin_add_to_index (MMPlugin *plugin,
+                             MMPluginIndex *index,
+                             guint position);
+
 void                   mm_plugin_supports_port        (MMPlugin *plugin,
                                                        MMDevice *device,
                                                        GUdevDevice *port,
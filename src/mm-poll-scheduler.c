@@ -0,0 +1,320 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#include "mm-poll-scheduler.h"
+#include "mm-log.h"
+
+/* All intervals are a multiple of this */
+#define TICK_SECS 5
+
+#define STATS_LOG_INTERVAL_SECS 600
+
+struct _MMPollTask {
+    gchar *name;
+    guint interval;
+    /* Next time to run, in scheduler seconds */
+    gint64 due;
+    MMPollTaskFn fn;
+    gpointer user_data;
+    /* Monotonic time when the last run started, 0 once done */
+    gint64 run_start;
+    /* Due in the tick being processed */
+    gboolean pending;
+};
+
+typedef struct {
+    const gchar *name;
+    guint64 n_runs;
+    /* Runs while the previous one wasn't done yet */
+    guint64 n_overlapped;
+    guint64 total_us;
+    guint64 max_us;
+} PollTaskStats;
+
+static GList *tasks;
+static GHashTable *stats;
+static guint tick_id;
+static gint64 tick_due;
+static gint64 next_stats_log;
+
+static gint64
+now_secs (void)
+{
+    return g_get_monotonic_time () / G_USEC_PER_SEC;
+}
+
+static guint
+align_interval (guint interval)
+{
+    return MAX (TICK_SECS, ((interval + TICK_SECS - 1) / TICK_SECS) * TICK_SECS);
+}
+
+static gint64
+next_due (MMPollTask *task,
+          gint64 now)
+{
+    return ((now / task->interval) + 1) * task->interval;
+}
+
+static PollTaskStats *
+get_stats (const gchar *name)
+{
+    PollTaskStats *task_stats;
+
+    if (G_UNLIKELY (!stats))
+        stats = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+    task_stats = g_hash_table_lookup (stats, name);
+    if (!task_stats) {
+        gchar *key;
+
+        key = g_strdup (name);
+        task_stats = g_new0 (PollTaskStats, 1);
+        task_stats->name = key;
+        g_hash_table_insert (stats, key, task_stats);
+    }
+
+    return task_stats;
+}
+
+/*****************************************************************************/
+
+static gboolean tick_cb (gpointer unused);
+
+static void
+reschedule (void)
+{
+    GList *l;
+    gint64 first = G_MAXINT64;
+
+    for (l = tasks; l; l = g_list_next (l))
+        first = MIN (first, ((MMPollTask *) l->data)->due);
+
+    if (tick_id) {
+        if (first == tick_due)
+            return;
+        g_source_remove (tick_id);
+        tick_id = 0;
+    }
+
+    if (!tasks)
+        return;
+
+    tick_due = first;
+    tick_id = g_timeout_add_seconds ((guint) MAX (first - now_secs (), 0), tick_cb, NULL);
+}
+
+static void
+run_task (MMPollTask *task)
+{
+    PollTaskStats *task_stats;
+
+    task_stats = get_stats (task->name);
+    task_stats->n_runs++;
+    /* Keep accounting the previous run if not done yet */
+    if (task->run_start)
+        task_stats->n_overlapped++;
+    else
+        task->run_start = g_get_monotonic_time ();
+
+    task->fn (task->user_data);
+}
+
+static void
+run_due (gint64 now)
+{
+    GList *due = NULL;
+    GList *l;
+
+    /* Timeouts in seconds may fire a bit early, so be lenient */
+    for (l = tasks; l; l = g_list_next (l)) {
+        MMPollTask *task = l->data;
+
+        if (task->due <= now + 1) {
+            task->due = next_due (task, MAX (now, task->due));
+            task->pending = TRUE;
+            due = g_list_prepend (due, task);
+        }
+    }
+
+    /* Running a task may remove others, or add new ones which may even reuse
+     * the memory of removed ones, so only run those still flagged */
+    due = g_list_reverse (due);
+    for (l = due; l; l = g_list_next (l)) {
+        MMPollTask *task = l->data;
+
+        if (g_list_find (tasks, task) && task->pending) {
+            task->pending = FALSE;
+            run_task (task);
+        }
+    }
+    g_list_free (due);
+
+    if (now >= next_stats_log) {
+        mm_poll_scheduler_log_stats ();
+        next_stats_log = now + STATS_LOG_INTERVAL_SECS;
+    }
+}
+
+static gboolean
+tick_cb (gpointer unused)
+{
+    tick_id = 0;
+    run_due (now_secs ());
+    reschedule ();
+    return FALSE;
+}
+
+void
+mm_poll_scheduler_run_due (gint64 now)
+{
+    run_due (now);
+    reschedule ();
+}
+
+/*****************************************************************************/
+
+MMPollTask *
+mm_poll_scheduler_add (const gchar *name,
+                       guint interval_secs,
+                       MMPollTaskFn fn,
+                       gpointer user_data)
+{
+    MMPollTask *task;
+
+    g_return_val_if_fail (name != NULL, NULL);
+    g_return_val_if_fail (fn != NULL, NULL);
+
+    task = g_slice_new0 (MMPollTask);
+    task->name = g_strdup (name);
+    task->interval = align_interval (interval_secs);
+    task->due = next_due (task, now_secs ());
+    task->fn = fn;
+    task->user_data = user_data;
+
+    if (!next_stats_log)
+        next_stats_log = now_secs () + STATS_LOG_INTERVAL_SECS;
+
+    tasks = g_list_prepend (tasks, task);
+    reschedule ();
+    return task;
+}
+
+void
+mm_poll_scheduler_remove (MMPollTask *task)
+{
+    g_return_if_fail (task != NULL);
+
+    mm_poll_scheduler_task_done (task);
+
+    tasks = g_list_remove (tasks, task);
+    g_free (task->name);
+    g_slice_free (MMPollTask, task);
+
+    reschedule ();
+}
+
+void
+mm_poll_scheduler_set_interval (MMPollTask *task,
+                                guint interval_secs)
+{
+    g_return_if_fail (task != NULL);
+
+    interval_secs = align_interval (interval_secs);
+    if (interval_secs == task->interval)
+        return;
+
+    task->interval = interval_secs;
+    task->due = next_due (task, now_secs ());
+    reschedule ();
+}
+
+void
+mm_poll_scheduler_task_done (MMPollTask *task)
+{
+    PollTaskStats *task_stats;
+    guint64 cost;
+
+    g_return_if_fail (task != NULL);
+
+    if (!task->run_start)
+        return;
+
+    cost = (guint64) (g_get_monotonic_time () - task->run_start);
+    task->run_start = 0;
+
+    task_stats = get_stats (task->name);
+    task_stats->total_us += cost;
+    task_stats->max_us = MAX (task_stats->max_us, cost);
+}
+
+/*****************************************************************************/
+
+static gint
+stats_cmp_by_total (const PollTaskStats *a,
+                    const PollTaskStats *b)
+{
+    return (a->total_us < b->total_us) - (a->total_us > b->total_us);
+}
+
+void
+mm_poll_scheduler_log_stats (void)
+{
+    GList *list;
+    GList *l;
+
+    if (!stats || !g_hash_table_size (stats))
+        return;
+
+    mm_dbg ("Periodic tasks (%u scheduled), by total cost:", g_list_length (tasks));
+
+    list = g_list_sort (g_hash_table_get_values (stats), (GCompareFunc)stats_cmp_by_total);
+    for (l = list; l; l = g_list_next (l)) {
+        PollTaskStats *task_stats = l->data;
+
+        mm_dbg ("  %s: %" G_GUINT64_FORMAT " runs (%" G_GUINT64_FORMAT " overlapped), "
+                "total %" G_GUINT64_FORMAT "ms, avg %" G_GUINT64_FORMAT "ms, max %" G_GUINT64_FORMAT "ms",
+                task_stats->name,
+                task_stats->n_runs,
+                task_stats->n_overlapped,
+                task_stats->total_us / 1000,
+                task_stats->n_runs ? (task_stats->total_us / task_stats->n_runs) / 1000 : 0,
+                task_stats->max_us / 1000);
+    }
+    g_list_free (list);
+}
+
+gboolean
+mm_poll_scheduler_get_stats (const gchar *name,
+                             guint64 *n_runs,
+                             guint64 *n_overlapped,
+                             guint64 *total_us)
+{
+    PollTaskStats *task_stats;
+
+    g_return_val_if_fail (name != NULL, FALSE);
+
+    task_stats = stats ? g_hash_table_lookup (stats, name) : NULL;
+    if (!task_stats)
+        return FALSE;
+
+    if (n_runs)
+        *n_runs = task_stats->n_runs;
+    if (n_overlapped)
+        *n_overlapped = task_stats->n_overlapped;
+    if (total_us)
+        *total_us = task_stats->total_us;
+    return TRUE;
+}
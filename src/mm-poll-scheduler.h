@@ -0,0 +1,60 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#ifndef MM_POLL_SCHEDULER_H
+#define MM_POLL_SCHEDULER_H
+
+#include <glib.h>
+
+/* Daemon-wide scheduler of periodic polling tasks.
+ *
+ * Intervals are rounded up to a multiple of a common tick, and each task runs
+ * whenever the time is a multiple of its interval. Tasks with the same
+ * interval, even in different modems, therefore run together in a single
+ * wakeup, as do tasks with different intervals whenever their periods meet.
+ *
+ * The time between a task being run and it reporting itself done is
+ * accounted per task name, and a summary of which tasks cost the most is
+ * logged regularly.
+ */
+
+typedef struct _MMPollTask MMPollTask;
+
+typedef void (* MMPollTaskFn) (gpointer user_data);
+
+/* The task doesn't run right away, only when its first period ends */
+MMPollTask *mm_poll_scheduler_add          (const gchar *name,
+                                            guint interval_secs,
+                                            MMPollTaskFn fn,
+                                            gpointer user_data);
+void        mm_poll_scheduler_remove       (MMPollTask *task);
+void        mm_poll_scheduler_set_interval (MMPollTask *task,
+                                            guint interval_secs);
+
+/* To be called when the asynchronous operation launched by the task is
+ * finished; tasks which never call it are accounted as costless */
+void        mm_poll_scheduler_task_done    (MMPollTask *task);
+
+void        mm_poll_scheduler_log_stats    (void);
+gboolean    mm_poll_scheduler_get_stats    (const gchar *name,
+                                            guint64 *n_runs,
+                                            guint64 *n_overlapped,
+                                            guint64 *total_us);
+
+/* Runs the tasks due at the given monotonic time in seconds, as if the tick
+ * had fired then; only meant to be used by tests */
+void        mm_poll_scheduler_run_due      (gint64 now_secs);
+
+#endif /* MM_POLL_SCHEDULER_H */
@@ -0,0 +1,264 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#include "mm-port-probe-cache.h"
+#include "mm-log.h"
+
+#define CACHE_GROUP   "Cache"
+#define CACHE_VERSION 1
+
+/* Time to wait before writing changes, so that all the ports of a device
+ * end up being written at once */
+#define SAVE_TIMEOUT_SECS 5
+
+static gchar *cache_path;
+static GHashTable *cache;
+static guint save_id;
+
+static void
+cache_entry_free (MMPortProbeCacheEntry *entry)
+{
+    g_free (entry->vendor);
+    g_free (entry->product);
+    g_slice_free (MMPortProbeCacheEntry, entry);
+}
+
+static MMPortProbeCacheEntry *
+cache_entry_dup (const MMPortProbeCacheEntry *entry)
+{
+    MMPortProbeCacheEntry *copy;
+
+    copy = g_slice_dup (MMPortProbeCacheEntry, entry);
+    copy->vendor = g_strdup (entry->vendor);
+    copy->product = g_strdup (entry->product);
+    return copy;
+}
+
+static gboolean
+cache_entry_equal (const MMPortProbeCacheEntry *a,
+                   const MMPortProbeCacheEntry *b)
+{
+    return (a->flags == b->flags &&
+            a->is_at == b->is_at &&
+            a->is_qcdm == b->is_qcdm &&
+            a->is_qmi == b->is_qmi &&
+            a->is_icera == b->is_icera &&
+            g_strcmp0 (a->vendor, b->vendor) == 0 &&
+            g_strcmp0 (a->product, b->product) == 0);
+}
+
+/*****************************************************************************/
+
+static void
+load_cache (void)
+{
+    GKeyFile *key_file;
+    GError *error = NULL;
+    gchar **groups;
+    guint i;
+
+    key_file = g_key_file_new ();
+    if (!g_key_file_load_from_file (key_file, cache_path, G_KEY_FILE_NONE, &error)) {
+        if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+            mm_warn ("Couldn't load probe cache from '%s': %s", cache_path, error->message);
+        g_error_free (error);
+        g_key_file_free (key_file);
+        return;
+    }
+
+    if (g_key_file_get_integer (key_file, CACHE_GROUP, "Version", NULL) != CACHE_VERSION) {
+        mm_info ("Ignoring probe cache from '%s': unknown version", cache_path);
+        g_key_file_free (key_file);
+        return;
+    }
+
+    groups = g_key_file_get_groups (key_file, NULL);
+    for (i = 0; groups[i]; i++) {
+        MMPortProbeCacheEntry *entry;
+
+        if (g_str_equal (groups[i], CACHE_GROUP))
+            continue;
+
+        entry = g_slice_new0 (MMPortProbeCacheEntry);
+        entry->flags = (guint32) g_key_file_get_integer (key_file, groups[i], "Flags", NULL);
+        entry->is_at = g_key_file_get_boolean (key_file, groups[i], "IsAt", NULL);
+        entry->is_qcdm = g_key_file_get_boolean (key_file, groups[i], "IsQcdm", NULL);
+        entry->is_qmi = g_key_file_get_boolean (key_file, groups[i], "IsQmi", NULL);
+        entry->is_icera = g_key_file_get_boolean (key_file, groups[i], "IsIcera", NULL);
+        entry->vendor = g_key_file_get_string (key_file, groups[i], "Vendor", NULL);
+        entry->product = g_key_file_get_string (key_file, groups[i], "Product", NULL);
+        g_hash_table_insert (cache, g_strdup (groups[i]), entry);
+    }
+    g_strfreev (groups);
+    g_key_file_free (key_file);
+
+    mm_dbg ("Loaded '%u' entries from probe cache '%s'",
+            g_hash_table_size (cache),
+            cache_path);
+}
+
+static void
+save_cache (void)
+{
+    GKeyFile *key_file;
+    GHashTableIter iter;
+    const gchar *key;
+    MMPortProbeCacheEntry *entry;
+    gchar *data;
+    gsize data_len;
+    GError *error = NULL;
+
+    key_file = g_key_file_new ();
+    g_key_file_set_integer (key_file, CACHE_GROUP, "Version", CACHE_VERSION);
+
+    g_hash_table_iter_init (&iter, cache);
+    while (g_hash_table_iter_next (&iter, (gpointer *)&key, (gpointer *)&entry)) {
+        g_key_file_set_integer (key_file, key, "Flags", (gint) entry->flags);
+        g_key_file_set_boolean (key_file, key, "IsAt", entry->is_at);
+        g_key_file_set_boolean (key_file, key, "IsQcdm", entry->is_qcdm);
+        g_key_file_set_boolean (key_file, key, "IsQmi", entry->is_qmi);
+        g_key_file_set_boolean (key_file, key, "IsIcera", entry->is_icera);
+        if (entry->vendor)
+            g_key_file_set_string (key_file, key, "Vendor", entry->vendor);
+        if (entry->product)
+            g_key_file_set_string (key_file, key, "Product", entry->product);
+    }
+
+    data = g_key_file_to_data (key_file, &data_len, NULL);
+    if (!g_file_set_contents (cache_path, data, data_len, &error)) {
+        mm_warn ("Couldn't save probe cache to '%s': %s", cache_path, error->message);
+        g_error_free (error);
+    }
+
+    g_free (data);
+    g_key_file_free (key_file);
+}
+
+static gboolean
+save_cache_cb (gpointer unused)
+{
+    save_id = 0;
+    save_cache ();
+    return FALSE;
+}
+
+static void
+schedule_save (void)
+{
+    if (!save_id)
+        save_id = g_timeout_add_seconds (SAVE_TIMEOUT_SECS, save_cache_cb, NULL);
+}
+
+/*****************************************************************************/
+
+void
+mm_port_probe_cache_setup (const gchar *path)
+{
+    g_return_if_fail (path != NULL);
+
+    mm_port_probe_cache_shutdown ();
+
+    cache_path = g_strdup (path);
+    cache = g_hash_table_new_full (g_str_hash,
+                                   g_str_equal,
+                                   g_free,
+                                   (GDestroyNotify)cache_entry_free);
+    load_cache ();
+}
+
+void
+mm_port_probe_cache_shutdown (void)
+{
+    if (!cache)
+        return;
+
+    if (save_id) {
+        g_source_remove (save_id);
+        save_id = 0;
+        save_cache ();
+    }
+
+    g_hash_table_unref (cache);
+    cache = NULL;
+    g_free (cache_path);
+    cache_path = NULL;
+}
+
+gboolean
+mm_port_probe_cache_is_enabled (void)
+{
+    return !!cache;
+}
+
+gboolean
+mm_port_probe_cache_lookup (const gchar *key,
+                            MMPortProbeCacheEntry *entry)
+{
+    MMPortProbeCacheEntry *found;
+
+    g_return_val_if_fail (key != NULL, FALSE);
+    g_return_val_if_fail (entry != NULL, FALSE);
+
+    if (!cache)
+        return FALSE;
+
+    found = g_hash_table_lookup (cache, key);
+    if (!found)
+        return FALSE;
+
+    *entry = *found;
+    entry->vendor = g_strdup (found->vendor);
+    entry->product = g_strdup (found->product);
+    return TRUE;
+}
+
+void
+mm_port_probe_cache_entry_clear (MMPortProbeCacheEntry *entry)
+{
+    g_free (entry->vendor);
+    entry->vendor = NULL;
+    g_free (entry->product);
+    entry->product = NULL;
+}
+
+void
+mm_port_probe_cache_store (const gchar *key,
+                           const MMPortProbeCacheEntry *entry)
+{
+    MMPortProbeCacheEntry *current;
+
+    g_return_if_fail (key != NULL);
+    g_return_if_fail (entry != NULL);
+
+    if (!cache)
+        return;
+
+    /* Avoid rewriting the file if nothing changed */
+    current = g_hash_table_lookup (cache, key);
+    if (current && cache_entry_equal (current, entry))
+        return;
+
+    g_hash_table_replace (cache, g_strdup (key), cache_entry_dup (entry));
+    schedule_save ();
+}
+
+void
+mm_port_probe_cache_invalidate (const gchar *key)
+{
+    g_return_if_fail (key != NULL);
+
+    if (cache && g_hash_table_remove (cache, key))
+        schedule_save ();
+}
@@ -0,0 +1,56 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#ifndef MM_PORT_PROBE_CACHE_H
+#define MM_PORT_PROBE_CACHE_H
+
+#include <glib.h>
+
+/* On-disk cache of port probing results.
+ *
+ * Entries are keyed by a string built from the USB VID/PID, the interface
+ * number and the kernel driver of the port, so that results can be reused
+ * across daemon restarts and device re-enumerations. Changes are written
+ * back to disk shortly after they happen.
+ */
+
+typedef struct {
+    /* Mask of MMPortProbeFlag values with the known results */
+    guint32 flags;
+    gboolean is_at;
+    gboolean is_qcdm;
+    gboolean is_qmi;
+    gboolean is_icera;
+    gchar *vendor;
+    gchar *product;
+} MMPortProbeCacheEntry;
+
+/* Loads the cache from the given file, which doesn't need to exist yet */
+void     mm_port_probe_cache_setup      (const gchar *path);
+/* Writes any pending change to disk and disables the cache */
+void     mm_port_probe_cache_shutdown   (void);
+
+gboolean mm_port_probe_cache_is_enabled (void);
+
+/* Fills in a copy of the cached entry, to be cleared when no longer needed */
+gboolean mm_port_probe_cache_lookup     (const gchar *key,
+                                         MMPortProbeCacheEntry *entry);
+void     mm_port_probe_cache_entry_clear (MMPortProbeCacheEntry *entry);
+
+void     mm_port_probe_cache_store      (const gchar *key,
+                                         const MMPortProbeCacheEntry *entry);
+void     mm_port_probe_cache_invalidate (const gchar *key);
+
+#endif /* MM_PORT_PROBE_CACHE_H */
@@ -35,6 +35,8 @@
 #include "libqcdm/src/errors.h"
 #include "mm-qcdm-serial-port.h"
 #include "mm-daemon-enums-types.h"
+#include "mm-context.h"
+#include "mm-port-probe-cache.h"
 
 #if defined WITH_QMI
 #include "mm-qmi-port.h"
@@ -54,6 +56,11 @@
  *   |----> QMI Version Info check
  */
 
+/* Timeout of the single AT probe sent in fast probing mode when another port
+ * of the same device already replied to AT, or when validating results found
+ * in the probe cache */
+#define AT_QUICK_PROBE_TIMEOUT_SECS 1
+
 G_DEFINE_TYPE (MMPortProbe, mm_port_probe, G_TYPE_OBJECT)
 
 enum {
@@ -95,6 +102,11 @@ typedef struct {
     const MMPortProbeAtCommand *at_custom_probe;
     /* Current group of AT commands to be sent */
     const MMPortProbeAtCommand *at_commands;
+    /* Whether the current AT command is the last quick probe */
+    gboolean at_quick;
+    /* Cached results, to be applied once the quick AT probe confirms them */
+    gboolean has_cached;
+    MMPortProbeCacheEntry cached;
     /* Current AT Result processor */
     void (* at_result_processor) (MMPortProbe *self,
                                   GVariant *result);
@@ -120,6 +132,12 @@ struct _MMPortProbePrivate {
     gboolean is_icera;
     gboolean is_qmi;
 
+    /* Key in the probe cache, or NULL if the port can't be cached */
+    gchar *cache_key;
+    /* Whether the AT results come from real probing, so that they can be
+     * cached; they may also be just assumed (e.g. in single AT devices) */
+    gboolean at_probed;
+
     /* Current probing task. Only one can be available at a time */
     PortProbeRunTask *task;
 };
@@ -295,6 +313,8 @@ port_probe_run_task_free (PortProbeRunTask *task)
     }
 #endif
 
+    mm_port_probe_cache_entry_clear (&task->cached);
+
     if (task->cancellable)
         g_object_unref (task->cancellable);
     if (task->at_probing_cancellable)
@@ -401,6 +421,7 @@ wdm_probe_qmi (MMPortProbe *self)
     /* Create a port and try to open it */
     task->qmi_port = mm_qmi_port_new (g_udev_device_get_name (self->priv->port));
     mm_qmi_port_open (task->qmi_port,
+                      FALSE,
                       FALSE,
                       NULL,
                       (GAsyncReadyCallback)qmi_port_open_ready,
@@ -672,26 +693,72 @@ serial_probe_at_vendor_result_processor (MMPortProbe *self,
     mm_port_probe_set_result_at_vendor (self, NULL);
 }
 
+static gboolean
+serial_probe_at_check_cached (MMPortProbe *self,
+                              gboolean is_at)
+{
+    PortProbeRunTask *task = self->priv->task;
+
+    task->has_cached = FALSE;
+
+    if (task->cached.is_at == is_at) {
+        mm_dbg ("(%s/%s) cached probing results confirmed",
+                g_udev_device_get_subsystem (self->priv->port),
+                g_udev_device_get_name (self->priv->port));
+        self->priv->at_probed = TRUE;
+        mm_port_probe_set_result_at (self, is_at);
+        if (is_at) {
+            if (task->cached.flags & MM_PORT_PROBE_AT_VENDOR)
+                mm_port_probe_set_result_at_vendor (self, task->cached.vendor);
+            if (task->cached.flags & MM_PORT_PROBE_AT_PRODUCT)
+                mm_port_probe_set_result_at_product (self, task->cached.product);
+            if (task->cached.flags & MM_PORT_PROBE_AT_ICERA)
+                mm_port_probe_set_result_at_icera (self, task->cached.is_icera);
+        }
+        return TRUE;
+    }
+
+    mm_dbg ("(%s/%s) cached probing results don't match, invalidating",
+            g_udev_device_get_subsystem (self->priv->port),
+            g_udev_device_get_name (self->priv->port));
+    mm_port_probe_cache_invalidate (self->priv->cache_key);
+
+    /* If the quick probe got no reply, the port may just have been too slow;
+     * leave the AT result unset so that the full AT probing is run */
+    return !is_at;
+}
+
 static void
 serial_probe_at_result_processor (MMPortProbe *self,
                                   GVariant *result)
 {
+    PortProbeRunTask *task = self->priv->task;
+    gboolean is_at = FALSE;
+
     if (result) {
         /* If any result given, it must be a boolean */
         g_assert (g_variant_is_of_type (result, G_VARIANT_TYPE_BOOLEAN));
+        is_at = g_variant_get_boolean (result);
+    }
 
-        if (g_variant_get_boolean (result)) {
-            mm_port_probe_set_result_at (self, TRUE);
-            return;
-        }
+    /* Results of cancelled AT probings are just assumed */
+    if (g_cancellable_is_cancelled (task->at_probing_cancellable)) {
+        mm_port_probe_set_result_at (self, is_at);
+        return;
     }
 
-    mm_port_probe_set_result_at (self, FALSE);
+    if (task->has_cached &&
+        serial_probe_at_check_cached (self, is_at))
+        return;
+
+    self->priv->at_probed = TRUE;
+    mm_port_probe_set_result_at (self, is_at);
 }
 
 static void
 serial_probe_at_parse_response (MMAtSerialPort *port,
-                                GString *response,
+                                const gchar *response,
+                                gsize response_len,
                                 GError *error,
                                 MMPortProbe *self)
 {
@@ -716,15 +783,16 @@ serial_probe_at_parse_response (MMAtSerialPort *port,
     /* Early-abort AT probing if we get a response that indicates this is
      * certainly not an AT-capable port.
      */
-    if (response && is_non_at_response ((const guint8 *) response->str, response->len)) {
+    if (response && is_non_at_response ((const guint8 *) response, response_len)) {
         task->at_result_processor (self, NULL);
+        self->priv->at_probed = TRUE;
         mm_port_probe_set_result_at (self, FALSE);
         serial_probe_schedule (self);
         return;
     }
 
     if (!task->at_commands->response_processor (task->at_commands->command,
-                                                response ? response->str : NULL,
+                                                response,
                                                 !!task->at_commands[1].command,
                                                 error,
                                                 &result,
@@ -744,9 +812,9 @@ serial_probe_at_parse_response (MMAtSerialPort *port,
             return;
         }
 
-        /* Go on to next command */
+        /* Go on to next command, unless this was the only quick probe */
         task->at_commands++;
-        if (!task->at_commands->command) {
+        if (task->at_quick || !task->at_commands->command) {
             /* Was it the last command in the group? If so,
              * end this partial probing */
             task->at_result_processor (self, NULL);
@@ -791,10 +859,34 @@ serial_probe_at (MMPortProbe *self)
         return FALSE;
     }
 
+    /* Just give the port a single short chance if we're only validating the
+     * cached results or if, in fast probing mode, another port of the device
+     * already replied to AT. Ports which are neither AT nor QCDM would
+     * otherwise make us wait for all the retries of the probing group to
+     * time out. */
+    if (!task->at_quick &&
+        task->at_result_processor == serial_probe_at_result_processor &&
+        !task->at_custom_probe) {
+        if (task->has_cached) {
+            mm_dbg ("(%s/%s) probing results found in cache, quick AT probing",
+                    g_udev_device_get_subsystem (self->priv->port),
+                    g_udev_device_get_name (self->priv->port));
+            task->at_quick = TRUE;
+        } else if (mm_context_get_fast_probing () &&
+                   mm_port_probe_list_has_at_port (mm_device_peek_port_probe_list (self->priv->device))) {
+            mm_dbg ("(%s/%s) AT port already found in device, quick AT probing",
+                    g_udev_device_get_subsystem (self->priv->port),
+                    g_udev_device_get_name (self->priv->port));
+            task->at_quick = TRUE;
+        }
+    }
+
     mm_at_serial_port_queue_command (
         MM_AT_SERIAL_PORT (task->serial),
         task->at_commands->command,
-        task->at_commands->timeout,
+        (task->at_quick ?
+         MIN (task->at_commands->timeout, AT_QUICK_PROBE_TIMEOUT_SECS) :
+         task->at_commands->timeout),
         FALSE,
         task->at_probing_cancellable,
         (MMAtSerialResponseFn)serial_probe_at_parse_response,
@@ -873,6 +965,7 @@ serial_probe_schedule (MMPortProbe *self)
     /* Cleanup */
     task->at_result_processor = NULL;
     task->at_commands = NULL;
+    task->at_quick = FALSE;
 
     /* AT check requested and not already probed? */
     if ((task->flags & MM_PORT_PROBE_AT) &&
@@ -935,11 +1028,16 @@ serial_flash_done (MMSerialPort *port,
 
 static void
 serial_buffer_full (MMSerialPort *serial,
-                    GByteArray *buffer,
+                    MMSerialBuffer *buffer,
                     MMPortProbe *self)
 {
-    if (is_non_at_response (buffer->data, buffer->len)) {
+    const guint8 *data;
+    gsize len;
+
+    data = mm_serial_buffer_peek (buffer, &len);
+    if (is_non_at_response (data, len)) {
         mm_serial_port_close (serial);
+        self->priv->at_probed = TRUE;
         mm_port_probe_set_result_at (self, FALSE);
         serial_probe_schedule (self);
     }
@@ -1067,6 +1165,85 @@ mm_port_probe_run_cancel (MMPortProbe *self)
     return FALSE;
 }
 
+/***************************************************************/
+/* Probe cache */
+
+static gchar *
+port_probe_build_cache_key (MMPortProbe *self)
+{
+    const gchar *ifnum;
+    const gchar *driver;
+
+    /* Only USB ports get cached, as we need the interface number to tell
+     * the ports of a device apart */
+    ifnum = g_udev_device_get_property (self->priv->port, "ID_USB_INTERFACE_NUM");
+    driver = mm_device_utils_get_port_driver (self->priv->port);
+    if (!ifnum || !driver ||
+        (!mm_device_get_vendor (self->priv->device) &&
+         !mm_device_get_product (self->priv->device)))
+        return NULL;
+
+    return g_strdup_printf ("%04x:%04x:%s:%s:%s",
+                            mm_device_get_vendor (self->priv->device),
+                            mm_device_get_product (self->priv->device),
+                            ifnum,
+                            g_udev_device_get_subsystem (self->priv->port),
+                            driver);
+}
+
+static void
+port_probe_cache_lookup (MMPortProbe *self)
+{
+    PortProbeRunTask *task = self->priv->task;
+
+    if (!mm_port_probe_cache_is_enabled ())
+        return;
+
+    if (!self->priv->cache_key)
+        self->priv->cache_key = port_probe_build_cache_key (self);
+
+    /* Only the results of the default AT probing are cached, and only if we
+     * really need them */
+    if (!self->priv->cache_key ||
+        task->at_custom_probe ||
+        !(task->flags & MM_PORT_PROBE_AT))
+        return;
+
+    if (!mm_port_probe_cache_lookup (self->priv->cache_key, &task->cached))
+        return;
+
+    /* Cached entry without AT results? Useless then */
+    if (!(task->cached.flags & MM_PORT_PROBE_AT)) {
+        mm_port_probe_cache_entry_clear (&task->cached);
+        return;
+    }
+
+    task->has_cached = TRUE;
+}
+
+static void
+port_probe_cache_store (MMPortProbe *self)
+{
+    MMPortProbeCacheEntry entry;
+
+    /* Only store results of real AT probings */
+    if (!self->priv->cache_key ||
+        !(self->priv->flags & MM_PORT_PROBE_AT) ||
+        !self->priv->at_probed)
+        return;
+
+    entry.flags = self->priv->flags;
+    entry.is_at = self->priv->is_at;
+    entry.is_qcdm = self->priv->is_qcdm;
+    entry.is_qmi = self->priv->is_qmi;
+    entry.is_icera = self->priv->is_icera;
+    entry.vendor = self->priv->vendor;
+    entry.product = self->priv->product;
+    mm_port_probe_cache_store (self->priv->cache_key, &entry);
+}
+
+/***************************************************************/
+
 gboolean
 mm_port_probe_run_finish (MMPortProbe *self,
                           GAsyncResult *result,
@@ -1083,6 +1260,9 @@ mm_port_probe_run_finish (MMPortProbe *self,
     else
         res = g_simple_async_result_get_op_res_gboolean (G_SIMPLE_ASYNC_RESULT (result));
 
+    if (res)
+        port_probe_cache_store (self);
+
     /* Cleanup probing task */
     if (self->priv->task) {
         port_probe_run_task_free (self->priv->task);
@@ -1147,6 +1327,9 @@ mm_port_probe_run (MMPortProbe *self,
     /* Setup internal cancellable */
     task->cancellable = g_cancellable_new ();
 
+    /* Look for previous results of this same port */
+    port_probe_cache_lookup (self);
+
     probe_list_str = mm_port_probe_flag_build_string_from_mask (task->flags);
     mm_info ("(%s/%s) launching port probing: '%s'",
              g_udev_device_get_subsystem (self->priv->port),
@@ -1486,6 +1669,7 @@ finalize (GObject *object)
 
     g_free (self->priv->vendor);
     g_free (self->priv->product);
+    g_free (self->priv->cache_key);
 
     G_OBJECT_CLASS (mm_port_probe_parent_class)->finalize (object);
 }
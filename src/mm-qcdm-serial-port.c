@@ -26,105 +26,310 @@
 #include "libqcdm/src/com.h"
 #include "libqcdm/src/utils.h"
 #include "libqcdm/src/errors.h"
+#include "libqcdm/src/dm-commands.h"
 #include "mm-log.h"
 
 G_DEFINE_TYPE (MMQcdmSerialPort, mm_qcdm_serial_port, MM_TYPE_SERIAL_PORT)
 
 #define MM_QCDM_SERIAL_PORT_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), MM_TYPE_QCDM_SERIAL_PORT, MMQcdmSerialPortPrivate))
 
+/* Longest unescaped frame we accept; DIAG log packets can go well over 1K */
+#define QCDM_FRAME_MAX_LEN 65536
+
+/* Log packets waiting to be dispatched; older ones are dropped when full */
+#define LOG_QUEUE_LEN 128
+
+typedef struct {
+    guint16 log_code;
+    guint64 timestamp;
+    GByteArray *payload;
+} LogPacket;
+
+typedef struct {
+    MMQcdmSerialLogFn callback;
+    gpointer user_data;
+    GDestroyNotify notify;
+} LogHandler;
+
 typedef struct {
-    gboolean foo;
+    /* Incremental deframer state. Positions are stream offsets, as given by
+     * mm_serial_buffer_get_offset(), so that they survive data being consumed
+     * from the response buffer. */
+    guint64 frame_start;
+    guint64 scan;
+    gboolean escaping;
+    guint16 crc;
+    /* Unescaped frame, including the CRC until the frame is complete */
+    GByteArray *frame;
+    gboolean frame_complete;
+    const gchar *frame_error;
+
+    /* Log handlers, indexed by log code */
+    GHashTable *log_handlers;
+    /* Ring of received log packets; payloads are reused */
+    LogPacket log_queue[LOG_QUEUE_LEN];
+    guint log_queue_head;
+    guint log_queue_len;
+    guint log_dropped;
+    guint log_dispatch_id;
 } MMQcdmSerialPortPrivate;
 
 
 /*****************************************************************************/
 
+static void
+deframer_reset (MMQcdmSerialPortPrivate *priv,
+                guint64 position)
+{
+    priv->frame_start = position;
+    priv->scan = position;
+    priv->escaping = FALSE;
+    priv->crc = DM_CRC16_SEED;
+    priv->frame_complete = FALSE;
+    priv->frame_error = NULL;
+    g_byte_array_set_size (priv->frame, 0);
+}
+
+static void
+deframer_finish_frame (MMQcdmSerialPortPrivate *priv)
+{
+    priv->frame_complete = TRUE;
+
+    if (priv->frame_error)
+        return;
+
+    if (priv->escaping ||
+        priv->frame->len < 2 ||
+        priv->crc != DM_CRC16_RESIDUE) {
+        priv->frame_error = "Failed to unescape QCDM packet.";
+        return;
+    }
+
+    /* Drop the CRC */
+    g_byte_array_set_size (priv->frame, priv->frame->len - 2);
+}
+
+/* Scans the bytes received since the last call, unescaping them and updating
+ * the CRC on the way, so that each byte is looked at only once however small
+ * the reads are. Returns TRUE once a whole frame is available. Like
+ * dm_decapsulate_buffer(), frames are whatever there is up to a 0x7E marker,
+ * and markers following less than 3 bytes are skipped. */
 static gboolean
-find_qcdm_start (GByteArray *response, gsize *start)
+deframer_scan (MMQcdmSerialPort *self,
+               MMSerialBuffer *response)
 {
-    int i, last = -1;
-
-    /* Look for 3 bytes and a QCDM frame marker, ie enough data for a valid
-     * frame.  There will usually be three cases here; (1) a QCDM frame
-     * starting with data and terminated by 0x7E, and (2) a QCDM frame starting
-     * with 0x7E and ending with 0x7E, and (3) a non-QCDM frame that still
-     * uses HDLC framing (like Sierra CnS) that starts and ends with 0x7E.
-     */
-    for (i = 0; i < response->len; i++) {
-        if (response->data[i] == 0x7E) {
-            if (i > last + 3) {
-                /* Got a full QCDM frame; 3 non-0x7E bytes and a terminator */
-                if (start)
-                    *start = last + 1;
-                return TRUE;
+    MMQcdmSerialPortPrivate *priv = MM_QCDM_SERIAL_PORT_GET_PRIVATE (self);
+    const guint8 *data;
+    gsize len;
+    guint64 offset;
+    gsize i;
+    gsize unescaped_start;
+
+    data = mm_serial_buffer_peek (response, &len);
+    offset = mm_serial_buffer_get_offset (response);
+
+    /* Start afresh if the data we were looking at is gone, either because
+     * the last frame was consumed or because the buffer got flushed */
+    if (priv->frame_start < offset || priv->scan > offset + len)
+        deframer_reset (priv, offset);
+
+    if (priv->frame_complete)
+        return TRUE;
+
+    unescaped_start = priv->frame->len;
+    for (i = priv->scan - offset; i < len; i++) {
+        guint8 c = data[i];
+
+        if (c == DIAG_CONTROL_CHAR) {
+            /* Not enough data for a frame; skip it */
+            if (offset + i < priv->frame_start + 3) {
+                deframer_reset (priv, offset + i + 1);
+                unescaped_start = 0;
+                continue;
             }
 
-            /* Save position of the last QCDM frame marker */
-            last = i;
+            priv->crc = dm_crc16_update (priv->crc,
+                                         (const char *) &priv->frame->data[unescaped_start],
+                                         priv->frame->len - unescaped_start);
+            priv->scan = offset + i + 1;
+            deframer_finish_frame (priv);
+            return TRUE;
+        }
+
+        if (priv->frame->len >= QCDM_FRAME_MAX_LEN) {
+            /* Keep looking for the end of the frame, but just to discard it */
+            priv->frame_error = "QCDM packet too long.";
+            continue;
         }
+
+        if (priv->escaping) {
+            c ^= 0x20;
+            priv->escaping = FALSE;
+        } else if (c == 0x7D) {
+            priv->escaping = TRUE;
+            continue;
+        }
+        g_byte_array_append (priv->frame, &c, 1);
     }
+
+    /* Keep the CRC up to date with what we unescaped so far */
+    if (!priv->frame_error)
+        priv->crc = dm_crc16_update (priv->crc,
+                                     (const char *) &priv->frame->data[unescaped_start],
+                                     priv->frame->len - unescaped_start);
+    priv->scan = offset + len;
     return FALSE;
 }
 
+/*****************************************************************************/
+
 static gboolean
-parse_response (MMSerialPort *port, GByteArray *response, GError **error)
+log_dispatch (MMQcdmSerialPort *self)
+{
+    MMQcdmSerialPortPrivate *priv = MM_QCDM_SERIAL_PORT_GET_PRIVATE (self);
+    guint n;
+
+    priv->log_dispatch_id = 0;
+
+    if (priv->log_dropped) {
+        mm_dbg ("(%s): dropped %u QCDM log packets",
+                mm_port_get_device (MM_PORT (self)),
+                priv->log_dropped);
+        priv->log_dropped = 0;
+    }
+
+    g_object_ref (self);
+
+    /* Only dispatch what is queued now; anything received from a handler
+     * gets dispatched in the next round */
+    for (n = priv->log_queue_len; n > 0 && priv->log_queue_len > 0; n--) {
+        LogPacket *packet = &priv->log_queue[priv->log_queue_head];
+        LogHandler *handler;
+
+        priv->log_queue_head = (priv->log_queue_head + 1) % LOG_QUEUE_LEN;
+        priv->log_queue_len--;
+
+        /* The handler may have gone away since the packet was queued */
+        handler = g_hash_table_lookup (priv->log_handlers,
+                                       GUINT_TO_POINTER (packet->log_code));
+        if (handler)
+            handler->callback (self,
+                               packet->log_code,
+                               packet->timestamp,
+                               packet->payload->data,
+                               packet->payload->len,
+                               handler->user_data);
+    }
+
+    g_object_unref (self);
+    return FALSE;
+}
+
+static void
+log_queue_push (MMQcdmSerialPort *self,
+                const DMCmdLog *log,
+                gsize len)
 {
-    return find_qcdm_start (response, NULL);
+    MMQcdmSerialPortPrivate *priv = MM_QCDM_SERIAL_PORT_GET_PRIVATE (self);
+    LogPacket *packet;
+
+    if (priv->log_queue_len == LOG_QUEUE_LEN) {
+        /* Drop the oldest packet rather than stall the port */
+        priv->log_queue_head = (priv->log_queue_head + 1) % LOG_QUEUE_LEN;
+        priv->log_queue_len--;
+        priv->log_dropped++;
+    }
+
+    packet = &priv->log_queue[(priv->log_queue_head + priv->log_queue_len) % LOG_QUEUE_LEN];
+    priv->log_queue_len++;
+
+    packet->log_code = GUINT16_FROM_LE (log->log_code);
+    packet->timestamp = GUINT64_FROM_LE (log->timestamp);
+    if (!packet->payload)
+        packet->payload = g_byte_array_sized_new (len - sizeof (DMCmdLog));
+    g_byte_array_set_size (packet->payload, 0);
+    g_byte_array_append (packet->payload, log->data, len - sizeof (DMCmdLog));
+
+    if (!priv->log_dispatch_id)
+        priv->log_dispatch_id = g_idle_add ((GSourceFunc) log_dispatch, self);
+}
+
+/* Log packets are sent by the device whenever it feels like it once logging
+ * was enabled with a log config command, so take them out of the buffer
+ * before they get mistaken for the reply to the command in flight. When no
+ * command is in flight, any other frame is garbage, so drop it instead of
+ * stopping there, or the log packets behind it would be flushed with it. */
+static void
+parse_unsolicited (MMSerialPort *port, MMSerialBuffer *response)
+{
+    MMQcdmSerialPort *self = MM_QCDM_SERIAL_PORT (port);
+    MMQcdmSerialPortPrivate *priv = MM_QCDM_SERIAL_PORT_GET_PRIVATE (self);
+
+    while (deframer_scan (self, response)) {
+        const DMCmdLog *log = (const DMCmdLog *) priv->frame->data;
+
+        if (priv->frame_error ||
+            priv->frame->len < sizeof (DMCmdLog) ||
+            log->code != DIAG_CMD_LOG) {
+            /* May be the reply; log packets after it are extracted once the
+             * reply is consumed */
+            if (mm_serial_port_is_waiting_reply (port))
+                break;
+            mm_dbg ("(%s) dropping unexpected QCDM frame",
+                    mm_port_get_device (MM_PORT (port)));
+        } else if (priv->log_handlers &&
+                   g_hash_table_lookup (priv->log_handlers,
+                                        GUINT_TO_POINTER (GUINT16_FROM_LE (log->log_code))))
+            log_queue_push (self, log, priv->frame->len);
+
+        /* The deframer restarts after the consumed data on the next scan */
+        mm_serial_buffer_consume (response,
+                                  (gsize) (priv->scan - mm_serial_buffer_get_offset (response)));
+    }
+}
+
+static gboolean
+parse_response (MMSerialPort *port, MMSerialBuffer *response, GError **error)
+{
+    return deframer_scan (MM_QCDM_SERIAL_PORT (port), response);
 }
 
 static gsize
 handle_response (MMSerialPort *port,
-                 GByteArray *response,
+                 MMSerialBuffer *response,
                  GError *error,
                  GCallback callback,
                  gpointer callback_data)
 {
+    MMQcdmSerialPortPrivate *priv = MM_QCDM_SERIAL_PORT_GET_PRIVATE (port);
     MMQcdmSerialResponseFn response_callback = (MMQcdmSerialResponseFn) callback;
     GByteArray *unescaped = NULL;
     GError *dm_error = NULL;
     gsize used = 0;
-    gsize start = 0;
-    gboolean success = FALSE;
-    qcdmbool more = FALSE;
-    gsize unescaped_len = 0;
 
     if (error)
         goto callback;
 
-    /* Get the offset into the buffer of where the QCDM frame starts */
-    if (!find_qcdm_start (response, &start)) {
+    /* Cached replies are put in the buffer without being parsed, so scan
+     * here as well; this is a no-op if the frame was already found. Note
+     * that all the callbacks waiting for the same reply get the same frame,
+     * which is only dropped once the buffer is consumed. */
+    if (!deframer_scan (MM_QCDM_SERIAL_PORT (port), response)) {
         g_set_error_literal (&dm_error,
                              MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
                              "Failed to parse QCDM packet.");
         /* Discard the unparsable data */
-        used = response->len;
+        used = mm_serial_buffer_get_len (response);
         goto callback;
     }
 
-    /* FIXME: don't munge around with byte array internals */
-    unescaped = g_byte_array_sized_new (1024);
-    success = dm_decapsulate_buffer ((const char *) (response->data + start),
-                                     response->len - start,
-                                     (char *) unescaped->data,
-                                     1024,
-                                     &unescaped_len,
-                                     &used,
-                                     &more);
-    if (!success) {
+    used = (gsize) (priv->scan - mm_serial_buffer_get_offset (response));
+    if (priv->frame_error)
         g_set_error_literal (&dm_error,
                              MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
-                             "Failed to unescape QCDM packet.");
-        g_byte_array_free (unescaped, TRUE);
-        unescaped = NULL;
-    } else if (more) {
-        /* Need more data; we shouldn't have gotten here since the parse
-         * function checks for the end-of-frame marker, but whatever.
-         */
-        return 0;
-    } else {
-        /* Successfully decapsulated the DM command */
-        unescaped->len = (guint) unescaped_len;
-    }
+                             priv->frame_error);
+    else
+        unescaped = priv->frame;
 
 callback:
     response_callback (MM_QCDM_SERIAL_PORT (port),
@@ -132,11 +337,9 @@ callback:
                        dm_error ? dm_error : error,
                        callback_data);
 
-    if (unescaped)
-        g_byte_array_free (unescaped, TRUE);
     g_clear_error (&dm_error);
 
-    return start + used;
+    return used;
 }
 
 /*****************************************************************************/
@@ -185,6 +388,49 @@ mm_qcdm_serial_port_queue_command_cached (MMQcdmSerialPort *self,
                                          user_data);
 }
 
+static void
+log_handler_free (LogHandler *handler)
+{
+    if (handler->notify)
+        handler->notify (handler->user_data);
+    g_slice_free (LogHandler, handler);
+}
+
+void
+mm_qcdm_serial_port_add_log_handler (MMQcdmSerialPort *self,
+                                     guint16 log_code,
+                                     MMQcdmSerialLogFn callback,
+                                     gpointer user_data,
+                                     GDestroyNotify notify)
+{
+    MMQcdmSerialPortPrivate *priv;
+    LogHandler *handler;
+
+    g_return_if_fail (MM_IS_QCDM_SERIAL_PORT (self));
+
+    priv = MM_QCDM_SERIAL_PORT_GET_PRIVATE (self);
+
+    if (!callback) {
+        if (priv->log_handlers)
+            g_hash_table_remove (priv->log_handlers, GUINT_TO_POINTER (log_code));
+        return;
+    }
+
+    if (!priv->log_handlers)
+        priv->log_handlers = g_hash_table_new_full (g_direct_hash,
+                                                    g_direct_equal,
+                                                    NULL,
+                                                    (GDestroyNotify) log_handler_free);
+
+    handler = g_slice_new (LogHandler);
+    handler->callback = callback;
+    handler->user_data = user_data;
+    handler->notify = notify;
+
+    /* Replaces any previous handler of the same log code */
+    g_hash_table_insert (priv->log_handlers, GUINT_TO_POINTER (log_code), handler);
+}
+
 static void
 debug_log (MMSerialPort *port, const char *prefix, const char *buf, gsize len)
 {
@@ -251,11 +497,42 @@ mm_qcdm_serial_port_new_fd (int fd)
 static void
 mm_qcdm_serial_port_init (MMQcdmSerialPort *self)
 {
+    MMQcdmSerialPortPrivate *priv = MM_QCDM_SERIAL_PORT_GET_PRIVATE (self);
+
+    priv->frame = g_byte_array_new ();
+    deframer_reset (priv, 0);
+}
+
+static void
+dispose (GObject *object)
+{
+    MMQcdmSerialPortPrivate *priv = MM_QCDM_SERIAL_PORT_GET_PRIVATE (object);
+
+    if (priv->log_dispatch_id) {
+        g_source_remove (priv->log_dispatch_id);
+        priv->log_dispatch_id = 0;
+    }
+
+    if (priv->log_handlers) {
+        g_hash_table_destroy (priv->log_handlers);
+        priv->log_handlers = NULL;
+    }
+
+    G_OBJECT_CLASS (mm_qcdm_serial_port_parent_class)->dispose (object);
 }
 
 static void
 finalize (GObject *object)
 {
+    MMQcdmSerialPortPrivate *priv = MM_QCDM_SERIAL_PORT_GET_PRIVATE (object);
+    guint i;
+
+    g_byte_array_free (priv->frame, TRUE);
+    for (i = 0; i < LOG_QUEUE_LEN; i++) {
+        if (priv->log_queue[i].payload)
+            g_byte_array_free (priv->log_queue[i].payload, TRUE);
+    }
+
     G_OBJECT_CLASS (mm_qcdm_serial_port_parent_class)->finalize (object);
 }
 
@@ -268,8 +545,10 @@ mm_qcdm_serial_port_class_init (MMQcdmSerialPortClass *klass)
     g_type_class_add_private (object_class, sizeof (MMQcdmSerialPortPrivate));
 
     /* Virtual methods */
+    object_class->dispose = dispose;
     object_class->finalize = finalize;
 
+    port_class->parse_unsolicited = parse_unsolicited;
     port_class->parse_response = parse_response;
     port_class->handle_response = handle_response;
     port_class->config_fd = config_fd;
@@ -37,6 +37,15 @@ typedef void (*MMQcdmSerialResponseFn)     (MMQcdmSerialPort *port,
                                             GError *error,
                                             gpointer user_data);
 
+/* Called for every DIAG log packet with a subscribed log code; the payload
+ * is only valid during the call */
+typedef void (*MMQcdmSerialLogFn)          (MMQcdmSerialPort *port,
+                                            guint16 log_code,
+                                            guint64 timestamp,
+                                            const guint8 *payload,
+                                            gsize payload_len,
+                                            gpointer user_data);
+
 struct _MMQcdmSerialPort {
     MMSerialPort parent;
 };
@@ -65,4 +74,15 @@ void     mm_qcdm_serial_port_queue_command_cached (MMQcdmSerialPort *self,
                                                    MMQcdmSerialResponseFn callback,
                                                    gpointer user_data);
 
+/* Subscribes to the DIAG log packets with the given log code (one of
+ * DM_LOG_ITEM_*), replacing any previous handler of that code; a NULL
+ * callback unsubscribes.  Logging of the code must also be enabled in the
+ * device, e.g. with qcdm_cmd_log_config_set_mask_new().
+ */
+void     mm_qcdm_serial_port_add_log_handler (MMQcdmSerialPort *self,
+                                              guint16 log_code,
+                                              MMQcdmSerialLogFn callback,
+                                              gpointer user_data,
+                                              GDestroyNotify notify);
+
 #endif /* MM_QCDM_SERIAL_PORT_H */
@@ -30,12 +30,27 @@ typedef struct {
     QmiService service;
     QmiClient *client;
     MMQmiPortFlag flag;
+    gboolean in_use;
 } ServiceInfo;
 
 struct _MMQmiPortPrivate {
     gboolean opening;
     QmiDevice *qmi_device;
     GList *services;
+    /* Clients handed out with acquire() and given back with recycle() */
+    GList *pool;
+};
+
+/* Clients allocated right after opening the device, so that no operation
+ * needs to wait for (or fail because of) a missing client later on. The WDS
+ * entry seeds the pool so that the first connection doesn't need to allocate
+ * a new CID. */
+static const ServiceInfo preallocated_clients[] = {
+    { QMI_SERVICE_DMS, NULL, MM_QMI_PORT_FLAG_DEFAULT,  FALSE },
+    { QMI_SERVICE_NAS, NULL, MM_QMI_PORT_FLAG_DEFAULT,  FALSE },
+    { QMI_SERVICE_WMS, NULL, MM_QMI_PORT_FLAG_DEFAULT,  FALSE },
+    { QMI_SERVICE_PDS, NULL, MM_QMI_PORT_FLAG_DEFAULT,  FALSE },
+    { QMI_SERVICE_WDS, NULL, MM_QMI_PORT_FLAG_WDS_IPV4, FALSE },
 };
 
 /*****************************************************************************/
@@ -71,6 +86,29 @@ mm_qmi_port_get_client (MMQmiPort *self,
 
 /*****************************************************************************/
 
+/* The port may get closed, and even reopened, while a client is being
+ * allocated; in that case the client belongs to a device no longer in use,
+ * and must not be handed out. */
+static gboolean
+drop_stale_client (MMQmiPort *self,
+                   QmiDevice *qmi_device,
+                   ServiceInfo *info)
+{
+    if (self->priv->qmi_device == qmi_device)
+        return FALSE;
+
+    mm_dbg ("Dropping client for service '%s' allocated in a closed QMI device",
+            qmi_service_get_string (info->service));
+    qmi_device_release_client (qmi_device,
+                               info->client,
+                               QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID,
+                               3, NULL, NULL, NULL);
+    g_clear_object (&info->client);
+    return TRUE;
+}
+
+/*****************************************************************************/
+
 typedef struct {
     MMQmiPort *self;
     GSimpleAsyncResult *result;
@@ -111,6 +149,11 @@ allocate_client_ready (QmiDevice *qmi_device,
                         "Couldn't create client for service '%s': ",
                         qmi_service_get_string (ctx->info->service));
         g_simple_async_result_take_error (ctx->result, error);
+    } else if (drop_stale_client (ctx->self, qmi_device, ctx->info)) {
+        g_simple_async_result_set_error (ctx->result,
+                                         MM_CORE_ERROR,
+                                         MM_CORE_ERROR_WRONG_STATE,
+                                         "QMI device closed while allocating client");
     } else {
         g_simple_async_result_set_op_res_gboolean (ctx->result, TRUE);
         /* Move the service info to our internal list */
@@ -163,11 +206,158 @@ mm_qmi_port_allocate_client (MMQmiPort *self,
 
 /*****************************************************************************/
 
+typedef struct {
+    MMQmiPort *self;
+    GSimpleAsyncResult *result;
+    ServiceInfo *info;
+} AcquireClientContext;
+
+static void
+acquire_client_context_complete_and_free (AcquireClientContext *ctx)
+{
+    g_simple_async_result_complete_in_idle (ctx->result);
+    if (ctx->info) {
+        g_assert (ctx->info->client == NULL);
+        g_free (ctx->info);
+    }
+    g_object_unref (ctx->result);
+    g_object_unref (ctx->self);
+    g_free (ctx);
+}
+
+QmiClient *
+mm_qmi_port_acquire_client_finish (MMQmiPort *self,
+                                   GAsyncResult *res,
+                                   GError **error)
+{
+    if (g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (res), error))
+        return NULL;
+
+    return QMI_CLIENT (g_object_ref (g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (res))));
+}
+
+static void
+acquire_client_allocate_ready (QmiDevice *qmi_device,
+                               GAsyncResult *res,
+                               AcquireClientContext *ctx)
+{
+    GError *error = NULL;
+
+    ctx->info->client = qmi_device_allocate_client_finish (qmi_device, res, &error);
+    if (!ctx->info->client) {
+        g_prefix_error (&error,
+                        "Couldn't create client for service '%s': ",
+                        qmi_service_get_string (ctx->info->service));
+        g_simple_async_result_take_error (ctx->result, error);
+    } else if (drop_stale_client (ctx->self, qmi_device, ctx->info)) {
+        g_simple_async_result_set_error (ctx->result,
+                                         MM_CORE_ERROR,
+                                         MM_CORE_ERROR_WRONG_STATE,
+                                         "QMI device closed while allocating client");
+    } else {
+        g_simple_async_result_set_op_res_gpointer (ctx->result,
+                                                   g_object_ref (ctx->info->client),
+                                                   (GDestroyNotify)g_object_unref);
+        /* Move the service info to the pool, already in use */
+        ctx->info->in_use = TRUE;
+        ctx->self->priv->pool = g_list_prepend (ctx->self->priv->pool, ctx->info);
+        ctx->info = NULL;
+    }
+
+    acquire_client_context_complete_and_free (ctx);
+}
+
+void
+mm_qmi_port_acquire_client (MMQmiPort *self,
+                            QmiService service,
+                            MMQmiPortFlag flag,
+                            GCancellable *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer user_data)
+{
+    AcquireClientContext *ctx;
+    GList *l;
+
+    ctx = g_new0 (AcquireClientContext, 1);
+    ctx->self = g_object_ref (self);
+    ctx->result = g_simple_async_result_new (G_OBJECT (self),
+                                             callback,
+                                             user_data,
+                                             mm_qmi_port_acquire_client);
+
+    if (!self->priv->qmi_device) {
+        g_simple_async_result_set_error (ctx->result,
+                                         MM_CORE_ERROR,
+                                         MM_CORE_ERROR_WRONG_STATE,
+                                         "QMI device not open");
+        acquire_client_context_complete_and_free (ctx);
+        return;
+    }
+
+    /* Reuse an idle client if we have one */
+    for (l = self->priv->pool; l; l = g_list_next (l)) {
+        ServiceInfo *info = l->data;
+
+        if (!info->in_use &&
+            info->service == service &&
+            info->flag == flag) {
+            mm_dbg ("Reusing client for service '%s' (cid %u)",
+                    qmi_service_get_string (service),
+                    qmi_client_get_cid (info->client));
+            info->in_use = TRUE;
+            g_simple_async_result_set_op_res_gpointer (ctx->result,
+                                                       g_object_ref (info->client),
+                                                       (GDestroyNotify)g_object_unref);
+            acquire_client_context_complete_and_free (ctx);
+            return;
+        }
+    }
+
+    /* Otherwise, grow the pool */
+    ctx->info = g_new0 (ServiceInfo, 1);
+    ctx->info->service = service;
+    ctx->info->flag = flag;
+
+    qmi_device_allocate_client (self->priv->qmi_device,
+                                service,
+                                QMI_CID_NONE,
+                                10,
+                                cancellable,
+                                (GAsyncReadyCallback)acquire_client_allocate_ready,
+                                ctx);
+}
+
+void
+mm_qmi_port_recycle_client (MMQmiPort *self,
+                            QmiClient *client)
+{
+    GList *l;
+
+    g_return_if_fail (MM_IS_QMI_PORT (self));
+    g_return_if_fail (QMI_IS_CLIENT (client));
+
+    /* If the port got closed in the meantime the client is no longer in the
+     * pool; its CID was already released, so nothing else to do. */
+    for (l = self->priv->pool; l; l = g_list_next (l)) {
+        ServiceInfo *info = l->data;
+
+        if (info->client == client) {
+            g_warn_if_fail (info->in_use);
+            info->in_use = FALSE;
+            return;
+        }
+    }
+}
+
+/*****************************************************************************/
+
 typedef struct {
     MMQmiPort *self;
     gboolean set_data_format;
+    gboolean preallocate_clients;
     GSimpleAsyncResult *result;
     GCancellable *cancellable;
+    guint n_pending_clients;
 } PortOpenContext;
 
 static void
@@ -189,23 +379,96 @@ mm_qmi_port_open_finish (MMQmiPort *self,
     return !g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (res), error);
 }
 
+typedef struct {
+    PortOpenContext *ctx;
+    ServiceInfo *info;
+} PreallocateClientContext;
+
+static void
+preallocate_client_ready (QmiDevice *qmi_device,
+                          GAsyncResult *res,
+                          PreallocateClientContext *pctx)
+{
+    PortOpenContext *ctx = pctx->ctx;
+    ServiceInfo *info = pctx->info;
+    GError *error = NULL;
+
+    g_free (pctx);
+
+    info->client = qmi_device_allocate_client_finish (qmi_device, res, &error);
+    if (!info->client) {
+        /* Not fatal; operations needing this service will just fail */
+        mm_dbg ("Couldn't allocate client for service '%s': %s",
+                qmi_service_get_string (info->service),
+                error->message);
+        g_error_free (error);
+        g_free (info);
+    } else if (drop_stale_client (ctx->self, qmi_device, info)) {
+        g_free (info);
+    } else if (info->service == QMI_SERVICE_WDS) {
+        /* WDS clients are handed out per bearer from the pool */
+        ctx->self->priv->pool = g_list_prepend (ctx->self->priv->pool, info);
+    } else
+        ctx->self->priv->services = g_list_prepend (ctx->self->priv->services, info);
+
+    g_assert (ctx->n_pending_clients > 0);
+    if (--ctx->n_pending_clients > 0)
+        return;
+
+    /* All done */
+    ctx->self->priv->opening = FALSE;
+    if (ctx->self->priv->qmi_device != qmi_device)
+        g_simple_async_result_set_error (ctx->result,
+                                         MM_CORE_ERROR,
+                                         MM_CORE_ERROR_WRONG_STATE,
+                                         "QMI device closed while opening");
+    else
+        g_simple_async_result_set_op_res_gboolean (ctx->result, TRUE);
+    port_open_context_complete_and_free (ctx);
+}
+
 static void
 qmi_device_open_ready (QmiDevice *qmi_device,
                        GAsyncResult *res,
                        PortOpenContext *ctx)
 {
     GError *error = NULL;
-
-    /* Reset the opening flag */
-    ctx->self->priv->opening = FALSE;
+    guint i;
 
     if (!qmi_device_open_finish (qmi_device, res, &error)) {
+        ctx->self->priv->opening = FALSE;
         g_clear_object (&ctx->self->priv->qmi_device);
         g_simple_async_result_take_error (ctx->result, error);
-    } else
+        port_open_context_complete_and_free (ctx);
+        return;
+    }
+
+    /* When just probing, there's no point in allocating clients; and only the
+     * port used by the modem itself needs them all */
+    if (!ctx->set_data_format || !ctx->preallocate_clients) {
+        ctx->self->priv->opening = FALSE;
         g_simple_async_result_set_op_res_gboolean (ctx->result, TRUE);
+        port_open_context_complete_and_free (ctx);
+        return;
+    }
 
-    port_open_context_complete_and_free (ctx);
+    /* Allocate all clients at once, instead of one after the other */
+    ctx->n_pending_clients = G_N_ELEMENTS (preallocated_clients);
+    for (i = 0; i < G_N_ELEMENTS (preallocated_clients); i++) {
+        PreallocateClientContext *pctx;
+
+        pctx = g_new (PreallocateClientContext, 1);
+        pctx->ctx = ctx;
+        pctx->info = g_memdup (&preallocated_clients[i], sizeof (ServiceInfo));
+
+        qmi_device_allocate_client (qmi_device,
+                                    pctx->info->service,
+                                    QMI_CID_NONE,
+                                    10,
+                                    ctx->cancellable,
+                                    (GAsyncReadyCallback)preallocate_client_ready,
+                                    pctx);
+    }
 }
 
 static void
@@ -238,6 +501,7 @@ qmi_device_new_ready (GObject *unused,
 void
 mm_qmi_port_open (MMQmiPort *self,
                   gboolean set_data_format,
+                  gboolean preallocate_clients,
                   GCancellable *cancellable,
                   GAsyncReadyCallback callback,
                   gpointer user_data)
@@ -251,6 +515,7 @@ mm_qmi_port_open (MMQmiPort *self,
     ctx = g_new0 (PortOpenContext, 1);
     ctx->self = g_object_ref (self);
     ctx->set_data_format = set_data_format;
+    ctx->preallocate_clients = preallocate_clients;
     ctx->result = g_simple_async_result_new (G_OBJECT (self),
                                              callback,
                                              user_data,
@@ -294,19 +559,13 @@ mm_qmi_port_is_open (MMQmiPort *self)
     return !!self->priv->qmi_device;
 }
 
-void
-mm_qmi_port_close (MMQmiPort *self)
+static void
+release_clients (MMQmiPort *self,
+                 GList **services)
 {
     GList *l;
-    GError *error = NULL;
-
-    g_return_if_fail (MM_IS_QMI_PORT (self));
 
-    if (!self->priv->qmi_device)
-        return;
-
-    /* Release all allocated clients */
-    for (l = self->priv->services; l; l = g_list_next (l)) {
+    for (l = *services; l; l = g_list_next (l)) {
         ServiceInfo *info = l->data;
 
         mm_dbg ("Releasing client for service '%s'...", qmi_service_get_string (info->service));
@@ -316,8 +575,24 @@ mm_qmi_port_close (MMQmiPort *self)
                                    3, NULL, NULL, NULL);
         g_clear_object (&info->client);
     }
-    g_list_free_full (self->priv->services, (GDestroyNotify)g_free);
-    self->priv->services = NULL;
+    g_list_free_full (*services, (GDestroyNotify)g_free);
+    *services = NULL;
+}
+
+void
+mm_qmi_port_close (MMQmiPort *self)
+{
+    GError *error = NULL;
+
+    g_return_if_fail (MM_IS_QMI_PORT (self));
+
+    if (!self->priv->qmi_device)
+        return;
+
+    /* Release all allocated clients, including the pooled ones; CIDs are
+     * only given back to the device here */
+    release_clients (self, &self->priv->services);
+    release_clients (self, &self->priv->pool);
 
     /* Close and release the device */
     if (!qmi_device_close (self->priv->qmi_device, &error)) {
@@ -348,20 +623,28 @@ mm_qmi_port_init (MMQmiPort *self)
 }
 
 static void
-dispose (GObject *object)
+clear_clients (GList **services)
 {
-    MMQmiPort *self = MM_QMI_PORT (object);
     GList *l;
 
-    /* Deallocate all clients */
-    for (l = self->priv->services; l; l = g_list_next (l)) {
+    for (l = *services; l; l = g_list_next (l)) {
         ServiceInfo *info = l->data;
 
         if (info->client)
             g_object_unref (info->client);
     }
-    g_list_free_full (self->priv->services, (GDestroyNotify)g_free);
-    self->priv->services = NULL;
+    g_list_free_full (*services, (GDestroyNotify)g_free);
+    *services = NULL;
+}
+
+static void
+dispose (GObject *object)
+{
+    MMQmiPort *self = MM_QMI_PORT (object);
+
+    /* Deallocate all clients */
+    clear_clients (&self->priv->services);
+    clear_clients (&self->priv->pool);
 
     /* Clear device object */
     g_clear_object (&self->priv->qmi_device);
@@ -48,8 +48,12 @@ GType mm_qmi_port_get_type (void);
 
 MMQmiPort *mm_qmi_port_new (const gchar *name);
 
+/* If requested, and unless just probing (i.e. set_data_format FALSE), opening
+ * the port also allocates the DMS, NAS, WMS and PDS clients, and seeds the WDS
+ * pool. Only the port used by the modem itself should request it. */
 void     mm_qmi_port_open        (MMQmiPort *self,
                                   gboolean set_data_format,
+                                  gboolean preallocate_clients,
                                   GCancellable *cancellable,
                                   GAsyncReadyCallback callback,
                                   gpointer user_data);
@@ -82,4 +86,19 @@ QmiClient *mm_qmi_port_get_client  (MMQmiPort *self,
                                     QmiService service,
                                     MMQmiPortFlag flag);
 
+/* Pooled clients, e.g. per-bearer WDS clients. Acquiring reuses an idle
+ * client with the same service and flag, or allocates a new one; recycling
+ * gives it back to the pool without releasing the CID. */
+void       mm_qmi_port_acquire_client        (MMQmiPort *self,
+                                              QmiService service,
+                                              MMQmiPortFlag flag,
+                                              GCancellable *cancellable,
+                                              GAsyncReadyCallback callback,
+                                              gpointer user_data);
+QmiClient *mm_qmi_port_acquire_client_finish (MMQmiPort *self,
+                                              GAsyncResult *res,
+                                              GError **error);
+void       mm_qmi_port_recycle_client        (MMQmiPort *self,
+                                              QmiClient *client);
+
 #endif /* MM_QMI_PORT_H */
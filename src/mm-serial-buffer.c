@@ -0,0 +1,245 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#include <string.h>
+
+#include "mm-serial-buffer.h"
+
+struct _MMSerialBuffer {
+    /* Storage has 'capacity + 1' bytes; the extra one is always available to
+     * NUL-terminate the contiguous view */
+    guint8 *data;
+    gsize capacity;
+    gsize head;
+    gsize len;
+    /* Number of bytes ever removed from the front */
+    guint64 offset;
+};
+
+MMSerialBuffer *
+mm_serial_buffer_new (gsize capacity)
+{
+    MMSerialBuffer *self;
+
+    g_return_val_if_fail (capacity > 0, NULL);
+
+    self = g_slice_new0 (MMSerialBuffer);
+    self->data = g_malloc (capacity + 1);
+    self->capacity = capacity;
+    return self;
+}
+
+void
+mm_serial_buffer_free (MMSerialBuffer *self)
+{
+    g_return_if_fail (self != NULL);
+
+    g_free (self->data);
+    g_slice_free (MMSerialBuffer, self);
+}
+
+gsize
+mm_serial_buffer_get_len (const MMSerialBuffer *self)
+{
+    return self->len;
+}
+
+guint64
+mm_serial_buffer_get_offset (const MMSerialBuffer *self)
+{
+    return self->offset;
+}
+
+/* Move the buffered data to the beginning of a new storage of the given
+ * capacity, so that it is no longer wrapped around the end. */
+static void
+linearize (MMSerialBuffer *self,
+           gsize new_capacity)
+{
+    guint8 *data;
+    gsize first;
+
+    g_assert (new_capacity >= self->len);
+
+    data = g_malloc (new_capacity + 1);
+    first = MIN (self->len, self->capacity - self->head);
+    memcpy (data, self->data + self->head, first);
+    memcpy (data + first, self->data, self->len - first);
+
+    g_free (self->data);
+    self->data = data;
+    self->capacity = new_capacity;
+    self->head = 0;
+}
+
+const guint8 *
+mm_serial_buffer_peek (MMSerialBuffer *self,
+                       gsize *len)
+{
+    /* Only need to move data around if it wrapped */
+    if (self->head + self->len > self->capacity)
+        linearize (self, self->capacity);
+
+    self->data[self->head + self->len] = '\0';
+    if (len)
+        *len = self->len;
+    return self->data + self->head;
+}
+
+guint8 *
+mm_serial_buffer_reserve (MMSerialBuffer *self,
+                          gsize wanted,
+                          gsize *available)
+{
+    gsize tail;
+
+    g_return_val_if_fail (wanted > 0, NULL);
+    g_return_val_if_fail (available != NULL, NULL);
+
+    /* Restart from the beginning when empty, it avoids wrapping */
+    if (self->len == 0)
+        self->head = 0;
+
+    /* Not enough room? Grow. This only happens if the port is not doing spew
+     * control and the device keeps sending data that nobody consumes. */
+    if (self->capacity - self->len < wanted)
+        linearize (self, MAX (self->capacity * 2, self->len + wanted));
+
+    tail = self->head + self->len;
+    if (tail >= self->capacity) {
+        /* Already wrapped; free space is between tail and head */
+        tail -= self->capacity;
+        *available = self->head - tail;
+    } else {
+        /* Free space until the end of the storage */
+        *available = self->capacity - tail;
+    }
+
+    *available = MIN (*available, wanted);
+    return self->data + tail;
+}
+
+void
+mm_serial_buffer_commit (MMSerialBuffer *self,
+                         gsize len)
+{
+    g_return_if_fail (self->len + len <= self->capacity);
+
+    self->len += len;
+}
+
+void
+mm_serial_buffer_append (MMSerialBuffer *self,
+                         const guint8 *data,
+                         gsize len)
+{
+    while (len > 0) {
+        guint8 *p;
+        gsize available;
+
+        p = mm_serial_buffer_reserve (self, len, &available);
+        memcpy (p, data, available);
+        mm_serial_buffer_commit (self, available);
+        data += available;
+        len -= available;
+    }
+}
+
+void
+mm_serial_buffer_consume (MMSerialBuffer *self,
+                          gsize len)
+{
+    len = MIN (len, self->len);
+
+    self->offset += len;
+    self->head = (self->head + len) % self->capacity;
+    self->len -= len;
+    if (self->len == 0)
+        self->head = 0;
+}
+
+void
+mm_serial_buffer_remove_range (MMSerialBuffer *self,
+                               gsize offset,
+                               gsize len)
+{
+    guint8 *p;
+
+    g_return_if_fail (offset <= self->len);
+
+    len = MIN (len, self->len - offset);
+    if (len == 0)
+        return;
+
+    if (offset == 0) {
+        mm_serial_buffer_consume (self, len);
+        return;
+    }
+
+    p = (guint8 *) mm_serial_buffer_peek (self, NULL);
+
+    /* Move whichever side of the removed range is shorter */
+    if (offset < self->len - offset - len) {
+        memmove (p + len, p, offset);
+        self->head += len;
+    } else
+        memmove (p + offset, p + offset + len, self->len - offset - len);
+    self->len -= len;
+}
+
+void
+mm_serial_buffer_remove_ranges (MMSerialBuffer *self,
+                                const MMSerialBufferRange *ranges,
+                                guint n_ranges)
+{
+    guint8 *p;
+    gsize read = 0;
+    gsize write = 0;
+    guint i;
+
+    if (n_ranges == 0)
+        return;
+
+    p = (guint8 *) mm_serial_buffer_peek (self, NULL);
+
+    for (i = 0; i < n_ranges; i++) {
+        gsize keep;
+
+        g_return_if_fail (ranges[i].offset >= read);
+        g_return_if_fail (ranges[i].offset + ranges[i].len <= self->len);
+
+        /* Move the data between the previous range and this one */
+        keep = ranges[i].offset - read;
+        if (write != read)
+            memmove (p + write, p + read, keep);
+        write += keep;
+        read = ranges[i].offset + ranges[i].len;
+    }
+
+    /* And whatever is left after the last range */
+    if (write != read)
+        memmove (p + write, p + read, self->len - read);
+    self->len = write + (self->len - read);
+    if (self->len == 0)
+        self->head = 0;
+}
+
+void
+mm_serial_buffer_clear (MMSerialBuffer *self)
+{
+    self->offset += self->len;
+    self->head = 0;
+    self->len = 0;
+}
@@ -0,0 +1,77 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#ifndef MM_SERIAL_BUFFER_H
+#define MM_SERIAL_BUFFER_H
+
+#include <glib.h>
+
+/* Ring buffer used to hold the data received from a serial port.
+ *
+ * Data is read straight into the buffer (see mm_serial_buffer_reserve() and
+ * mm_serial_buffer_commit()) and consuming it from the front just advances
+ * the read index, so no memmove() is needed for each processed response.
+ *
+ * Parsers access the data through mm_serial_buffer_peek(), which always
+ * returns a contiguous and NUL-terminated view of the buffered data.
+ */
+typedef struct _MMSerialBuffer MMSerialBuffer;
+
+typedef struct {
+    gsize offset;
+    gsize len;
+} MMSerialBufferRange;
+
+MMSerialBuffer *mm_serial_buffer_new          (gsize capacity);
+void            mm_serial_buffer_free         (MMSerialBuffer *self);
+
+gsize           mm_serial_buffer_get_len      (const MMSerialBuffer *self);
+
+/* Returns the position of the first buffered byte in the whole stream, i.e.
+ * how many bytes were ever consumed or cleared. Parsers can use it to keep
+ * their own position across reads. Removing ranges which don't start at the
+ * front doesn't change it. */
+guint64         mm_serial_buffer_get_offset   (const MMSerialBuffer *self);
+
+/* Returns a contiguous, NUL-terminated view of the buffered data. The view
+ * is valid until the buffer is next modified. */
+const guint8   *mm_serial_buffer_peek         (MMSerialBuffer *self,
+                                               gsize *len);
+
+/* Returns a pointer to a contiguous block of free space at the end of the
+ * buffer, of at most 'wanted' bytes, so that it can be filled directly (e.g.
+ * by read()). The buffer is grown if it doesn't have 'wanted' free bytes. */
+guint8         *mm_serial_buffer_reserve      (MMSerialBuffer *self,
+                                               gsize wanted,
+                                               gsize *available);
+void            mm_serial_buffer_commit       (MMSerialBuffer *self,
+                                               gsize len);
+
+void            mm_serial_buffer_append       (MMSerialBuffer *self,
+                                               const guint8 *data,
+                                               gsize len);
+void            mm_serial_buffer_consume      (MMSerialBuffer *self,
+                                               gsize len);
+void            mm_serial_buffer_remove_range (MMSerialBuffer *self,
+                                               gsize offset,
+                                               gsize len);
+/* Removes several ranges at once, moving each kept byte only once. Ranges
+ * must be sorted by offset and must not overlap. */
+void            mm_serial_buffer_remove_ranges (MMSerialBuffer *self,
+                                                const MMSerialBufferRange *ranges,
+                                                guint n_ranges);
+void            mm_serial_buffer_clear        (MMSerialBuffer *self);
+
+#endif /* MM_SERIAL_BUFFER_H */
@@ -21,62 +21,35 @@
 #include "mm-serial-parsers.h"
 #include "mm-log.h"
 
-/* Clean up the response by removing control characters like <CR><LF> etc */
+/* Clean up the response by skipping control characters like <CR><LF> etc,
+ * updating the bounds of the reply within the response */
 static void
-response_clean (GString *response)
+response_clean (const gchar *response,
+                gsize *start,
+                gsize *end)
 {
-    char *s;
-
     /* Ends with one or more '<CR><LF>' */
-    s = response->str + response->len - 1;
-    while ((s > response->str) && (*s == '\n') && (*(s - 1) == '\r')) {
-        g_string_truncate (response, response->len - 2);
-        s -= 2;
-    }
+    while ((*end - *start >= 2) && (response[*end - 1] == '\n') && (response[*end - 2] == '\r'))
+        *end -= 2;
 
     /* Contains duplicate '<CR><CR>' */
-    s = response->str;
-    while ((response->len >= 2) && (*s == '\r') && (*(s + 1) == '\r')) {
-        g_string_erase (response, 0, 1);
-        s = response->str;
-    }
+    while ((*end - *start >= 2) && (response[*start] == '\r') && (response[*start + 1] == '\r'))
+        *start += 1;
 
     /* Starts with one or more '<CR><LF>' */
-    s = response->str;
-    while ((response->len >= 2) && (*s == '\r') && (*(s + 1) == '\n')) {
-        g_string_erase (response, 0, 2);
-        s = response->str;
-    }
-}
-
-
-static gboolean
-remove_eval_cb (const GMatchInfo *match_info,
-                GString *result,
-                gpointer user_data)
-{
-    int *result_len = (int *) user_data;
-    int start;
-    int end;
-
-    if (g_match_info_fetch_pos  (match_info, 0, &start, &end))
-        *result_len -= (end - start);
-
-    return TRUE;
+    while ((*end - *start >= 2) && (response[*start] == '\r') && (response[*start + 1] == '\n'))
+        *start += 2;
 }
 
-static void
-remove_matches (GRegex *r, GString *string)
+/* Skip NUL bytes if they are found leading the response */
+static gsize
+skip_leading_nuls (const gchar *response,
+                   gsize response_len)
 {
-    char *str;
-    int result_len = string->len;
-
-    str = g_regex_replace_eval (r, string->str, string->len, 0, 0,
-                                remove_eval_cb, &result_len, NULL);
+    gsize start;
 
-    g_string_truncate (string, 0);
-    g_string_append_len (string, str, result_len);
-    g_free (str);
+    for (start = 0; start < response_len && response[start] == '\0'; start++);
+    return start;
 }
 
 typedef struct {
@@ -140,57 +113,73 @@ mm_serial_parser_v1_set_custom_regex (gpointer data,
 }
 
 gboolean
-mm_serial_parser_v1_parse (gpointer data,
-                           GString *response,
-                           GError **error)
+mm_serial_parser_v1_parse_regex (gpointer data,
+                                 const gchar *response,
+                                 gsize response_len,
+                                 gsize *reply_start,
+                                 gsize *reply_len,
+                                 GError **error)
 {
     MMSerialParserV1 *parser = (MMSerialParserV1 *) data;
     GMatchInfo *match_info;
     GError *local_error = NULL;
     gboolean found = FALSE;
     char *str = NULL;
+    const gchar *view;
+    gsize len;
+    gsize start;
+    gsize end;
 
     g_return_val_if_fail (parser != NULL, FALSE);
     g_return_val_if_fail (response != NULL, FALSE);
 
-    /* Skip NUL bytes if they are found leading the response */
-    while (response->len > 0 && response->str[0] == '\0')
-        g_string_erase (response, 0, 1);
-
-    if (G_UNLIKELY (!response->len))
+    start = skip_leading_nuls (response, response_len);
+    if (G_UNLIKELY (start == response_len))
         return FALSE;
 
+    view = response + start;
+    len = response_len - start;
+    end = response_len;
+
     /* First, check for successful responses */
 
     /* Custom successful replies first, if any */
     if (parser->regex_custom_successful) {
         found = g_regex_match_full (parser->regex_custom_successful,
-                                    response->str, response->len,
+                                    view, len,
                                     0, 0, NULL, NULL);
     }
 
     if (!found) {
         found = g_regex_match_full (parser->regex_ok,
-                                    response->str, response->len,
-                                    0, 0, NULL, NULL);
-        if (found)
-            remove_matches (parser->regex_ok, response);
+                                    view, len,
+                                    0, 0, &match_info, NULL);
+        if (found) {
+            gint ok_start;
+
+            /* Skip the match, which is anchored to the end */
+            if (g_match_info_fetch_pos (match_info, 0, &ok_start, NULL))
+                end = start + ok_start;
+        }
+        g_match_info_free (match_info);
     }
 
     if (!found) {
         found = g_regex_match_full (parser->regex_connect,
-                                    response->str, response->len,
+                                    view, len,
                                     0, 0, NULL, NULL);
     }
 
     if (!found) {
         found = g_regex_match_full (parser->regex_sms,
-                                    response->str, response->len,
+                                    view, len,
                                     0, 0, NULL, NULL);
     }
 
     if (found) {
-        response_clean (response);
+        response_clean (response, &start, &end);
+        *reply_start = start;
+        *reply_len = end - start;
         return TRUE;
     }
 
@@ -199,7 +188,7 @@ mm_serial_parser_v1_parse (gpointer data,
     /* Custom error matches first, if any */
     if (parser->regex_custom_error) {
         found = g_regex_match_full (parser->regex_custom_error,
-                                    response->str, response->len,
+                                    view, len,
                                     0, 0, &match_info, NULL);
         if (found) {
             str = g_match_info_fetch (match_info, 1);
@@ -212,7 +201,7 @@ mm_serial_parser_v1_parse (gpointer data,
 
     /* Numeric CME errors */
     found = g_regex_match_full (parser->regex_cme_error,
-                                response->str, response->len,
+                                view, len,
                                 0, 0, &match_info, NULL);
     if (found) {
         str = g_match_info_fetch (match_info, 1);
@@ -224,7 +213,7 @@ mm_serial_parser_v1_parse (gpointer data,
 
     /* Numeric CMS errors */
     found = g_regex_match_full (parser->regex_cms_error,
-                                response->str, response->len,
+                                view, len,
                                 0, 0, &match_info, NULL);
     if (found) {
         str = g_match_info_fetch (match_info, 1);
@@ -236,7 +225,7 @@ mm_serial_parser_v1_parse (gpointer data,
 
     /* String CME errors */
     found = g_regex_match_full (parser->regex_cme_error_str,
-                                response->str, response->len,
+                                view, len,
                                 0, 0, &match_info, NULL);
     if (found) {
         str = g_match_info_fetch (match_info, 1);
@@ -248,7 +237,7 @@ mm_serial_parser_v1_parse (gpointer data,
 
     /* String CMS errors */
     found = g_regex_match_full (parser->regex_cms_error_str,
-                                response->str, response->len,
+                                view, len,
                                 0, 0, &match_info, NULL);
     if (found) {
         str = g_match_info_fetch (match_info, 1);
@@ -260,7 +249,7 @@ mm_serial_parser_v1_parse (gpointer data,
 
     /* Motorola EZX errors */
     found = g_regex_match_full (parser->regex_ezx_error,
-                                response->str, response->len,
+                                view, len,
                                 0, 0, &match_info, NULL);
     if (found) {
         str = g_match_info_fetch (match_info, 1);
@@ -272,7 +261,7 @@ mm_serial_parser_v1_parse (gpointer data,
 
     /* Last resort; unknown error */
     found = g_regex_match_full (parser->regex_unknown_error,
-                                response->str, response->len,
+                                view, len,
                                 0, 0, &match_info, NULL);
     if (found) {
         local_error = mm_mobile_equipment_error_for_code (MM_MOBILE_EQUIPMENT_ERROR_UNKNOWN);
@@ -282,21 +271,22 @@ mm_serial_parser_v1_parse (gpointer data,
 
     /* Connection failures */
     found = g_regex_match_full (parser->regex_connect_failed,
-                                response->str, response->len,
+                                view, len,
                                 0, 0, &match_info, NULL);
     if (found) {
         MMConnectionError code;
 
-        str = g_match_info_fetch (match_info, 1);
+        /* Each alternative has its own group, so look at the whole match */
+        str = g_match_info_fetch (match_info, 0);
         g_assert (str);
 
-        if (!strcmp (str, "NO CARRIER"))
+        if (strstr (str, "NO CARRIER"))
             code = MM_CONNECTION_ERROR_NO_CARRIER;
-        else if (!strcmp (str, "BUSY"))
+        else if (strstr (str, "BUSY"))
             code = MM_CONNECTION_ERROR_BUSY;
-        else if (!strcmp (str, "NO ANSWER"))
+        else if (strstr (str, "NO ANSWER"))
             code = MM_CONNECTION_ERROR_NO_ANSWER;
-        else if (!strcmp (str, "NO DIALTONE"))
+        else if (strstr (str, "NO DIALTONE"))
             code = MM_CONNECTION_ERROR_NO_DIALTONE;
         else {
             /* uhm... make something up (yes, ok, lie!). */
@@ -309,8 +299,11 @@ mm_serial_parser_v1_parse (gpointer data,
 done:
     g_free (str);
     g_match_info_free (match_info);
-    if (found)
-        response_clean (response);
+    if (found) {
+        response_clean (response, &start, &end);
+        *reply_start = start;
+        *reply_len = end - start;
+    }
 
     if (local_error) {
         mm_dbg ("Got failure code %d: %s", local_error->code, local_error->message);
@@ -320,6 +313,350 @@ done:
     return found;
 }
 
+/*****************************************************************************/
+/* Final result code scanner
+ *
+ * Recognizes the same final result codes as the regular expressions above,
+ * but without running one regex after the other on the whole response: the
+ * codes anchored to the end of the response are checked just in the last
+ * line, and those which may show up anywhere (CONNECT, which may be followed
+ * by data straight away, ERROR and the connection failures) are looked for
+ * in a single pass over the start of each line.
+ *
+ * Two cases are handled differently than by the regular expressions: BUSY
+ * and NO ANSWER are only matched at the start of a line, not anywhere in
+ * the response (e.g. in the text of a SMS), and +CME/+CMS ERROR without a
+ * value are final, reported as unknown errors, instead of being left to
+ * time out.
+ */
+
+typedef enum {
+    FINAL_RESULT_NONE,
+    FINAL_RESULT_OK,
+    FINAL_RESULT_CONNECT,
+    FINAL_RESULT_SMS_PROMPT,
+    FINAL_RESULT_CME_ERROR,
+    FINAL_RESULT_CMS_ERROR,
+    FINAL_RESULT_EZX_ERROR,
+    FINAL_RESULT_UNKNOWN_ERROR,
+    FINAL_RESULT_CONNECTION_ERROR,
+} FinalResult;
+
+#define IS_CRLF(str, i) ((str)[i] == '\r' && (str)[(i) + 1] == '\n')
+
+static gboolean
+line_has_prefix (const gchar *line,
+                 gsize line_len,
+                 const gchar *prefix,
+                 gsize prefix_len)
+{
+    return (line_len >= prefix_len && !memcmp (line, prefix, prefix_len));
+}
+
+static gboolean
+line_has_suffix (const gchar *line,
+                 gsize line_len,
+                 const gchar *suffix,
+                 gsize suffix_len)
+{
+    return (line_len >= suffix_len && !memcmp (line + line_len - suffix_len, suffix, suffix_len));
+}
+
+#define LINE_HAS_PREFIX(line, len, prefix) line_has_prefix (line, len, prefix, sizeof (prefix) - 1)
+#define LINE_HAS_SUFFIX(line, len, suffix) line_has_suffix (line, len, suffix, sizeof (suffix) - 1)
+
+/* Single forward pass over the start of every line, looking for the result
+ * codes which are also accepted when they are not in the last line */
+static FinalResult
+find_result_in_line_starts (const gchar *str,
+                            gsize len,
+                            const gchar **value,
+                            gsize *value_len)
+{
+    const gchar *p = str;
+    const gchar *end = str + len;
+    FinalResult result = FINAL_RESULT_NONE;
+
+    while ((p = memchr (p, '\r', end - p)) != NULL) {
+        const gchar *line;
+        gsize line_len;
+
+        if (end - p < 2 || p[1] != '\n') {
+            p++;
+            continue;
+        }
+
+        line = p + 2;
+        line_len = end - line;
+        p = line;
+        if (line_len == 0)
+            break;
+
+        switch (line[0]) {
+        case 'C':
+            /* CONNECT may be followed by data right away, so as soon as
+             * the line is complete we're done */
+            if (LINE_HAS_PREFIX (line, line_len, "CONNECT")) {
+                const gchar *lf;
+
+                lf = memchr (line + 7, '\n', line_len - 7);
+                if (lf && lf > line + 7 && *(lf - 1) == '\r')
+                    return FINAL_RESULT_CONNECT;
+            }
+            break;
+        case 'E':
+            if (LINE_HAS_PREFIX (line, line_len, "ERROR"))
+                result = FINAL_RESULT_UNKNOWN_ERROR;
+            break;
+        case 'N':
+            if (result == FINAL_RESULT_NONE &&
+                (LINE_HAS_PREFIX (line, line_len, "NO CARRIER") ||
+                 LINE_HAS_PREFIX (line, line_len, "NO ANSWER") ||
+                 LINE_HAS_PREFIX (line, line_len, "NO DIALTONE"))) {
+                *value = line;
+                *value_len = line_len;
+                result = FINAL_RESULT_CONNECTION_ERROR;
+            }
+            break;
+        case 'B':
+            if (result == FINAL_RESULT_NONE &&
+                LINE_HAS_PREFIX (line, line_len, "BUSY")) {
+                *value = line;
+                *value_len = line_len;
+                result = FINAL_RESULT_CONNECTION_ERROR;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    return result;
+}
+
+/* Skips the whitespace after an error prefix, returning the error value
+ * in 'value' and whether it is a number */
+static gboolean
+error_value_is_numeric (const gchar *line,
+                        gsize line_len,
+                        gsize prefix_len,
+                        const gchar **value,
+                        gsize *value_len)
+{
+    gsize i;
+
+    for (i = prefix_len; i < line_len && g_ascii_isspace (line[i]); i++);
+    *value = &line[i];
+    *value_len = line_len - i;
+
+    for (; i < line_len; i++) {
+        if (!g_ascii_isdigit (line[i]))
+            return FALSE;
+    }
+    return (*value_len > 0);
+}
+
+/* Looks for the result codes expected in the last line */
+static FinalResult
+find_result_in_last_line (const gchar *str,
+                          gsize len,
+                          const gchar **value,
+                          gsize *value_len,
+                          gboolean *numeric)
+{
+    const gchar *ezx_value;
+    gsize ezx_value_len;
+    gsize end;
+    gsize i;
+
+    if (len < 2 || !IS_CRLF (str, len - 2))
+        return FINAL_RESULT_NONE;
+    end = len - 2;
+
+    /* Errors with a value need a full "<CR><LF>...<CR><LF>" last line */
+    for (i = end; i > 0 && str[i - 1] != '\n' && str[i - 1] != '\r'; i--);
+    if (i >= 2 && IS_CRLF (str, i - 2)) {
+        const gchar *line = &str[i];
+        gsize line_len = end - i;
+
+        if (LINE_HAS_PREFIX (line, line_len, "+CME ERROR:")) {
+            *numeric = error_value_is_numeric (line, line_len, 11, value, value_len);
+            return FINAL_RESULT_CME_ERROR;
+        }
+
+        if (LINE_HAS_PREFIX (line, line_len, "+CMS ERROR:")) {
+            *numeric = error_value_is_numeric (line, line_len, 11, value, value_len);
+            return FINAL_RESULT_CMS_ERROR;
+        }
+
+        if (LINE_HAS_PREFIX (line, line_len, "MODEM ERROR:") &&
+            error_value_is_numeric (line, line_len, 12, &ezx_value, &ezx_value_len))
+            return FINAL_RESULT_EZX_ERROR;
+    }
+
+    if (LINE_HAS_SUFFIX (str, end, "COMMAND NOT SUPPORT"))
+        return FINAL_RESULT_UNKNOWN_ERROR;
+
+    return FINAL_RESULT_NONE;
+}
+
+static FinalResult
+find_final_result (const gchar *str,
+                   gsize len,
+                   gsize *ok_start,
+                   const gchar **value,
+                   gsize *value_len,
+                   gboolean *numeric)
+{
+    FinalResult line_starts_result;
+    FinalResult last_line_result;
+    gsize end;
+
+    /* Ends with "<CR><LF>OK", followed by one or more <CR><LF> */
+    end = len;
+    while (end >= 2 && IS_CRLF (str, end - 2))
+        end -= 2;
+    if (end < len && end >= 4 && !memcmp (&str[end - 4], "\r\nOK", 4)) {
+        *ok_start = end - 4;
+        return FINAL_RESULT_OK;
+    }
+
+    line_starts_result = find_result_in_line_starts (str, len, value, value_len);
+    if (line_starts_result == FINAL_RESULT_CONNECT)
+        return FINAL_RESULT_CONNECT;
+
+    /* Ends with "<CR><LF>>", followed by optional whitespace */
+    end = len;
+    while (end > 0 && g_ascii_isspace (str[end - 1]))
+        end--;
+    if (end >= 3 && str[end - 1] == '>' && IS_CRLF (str, end - 3))
+        return FINAL_RESULT_SMS_PROMPT;
+
+    /* Errors with a value in the last line take precedence */
+    last_line_result = find_result_in_last_line (str, len, value, value_len, numeric);
+    if (last_line_result != FINAL_RESULT_NONE)
+        return last_line_result;
+
+    return line_starts_result;
+}
+
+static GError *
+connection_error_for_line (const gchar *line,
+                           gsize line_len)
+{
+    MMConnectionError code;
+
+    if (LINE_HAS_PREFIX (line, line_len, "BUSY"))
+        code = MM_CONNECTION_ERROR_BUSY;
+    else if (LINE_HAS_PREFIX (line, line_len, "NO ANSWER"))
+        code = MM_CONNECTION_ERROR_NO_ANSWER;
+    else if (LINE_HAS_PREFIX (line, line_len, "NO DIALTONE"))
+        code = MM_CONNECTION_ERROR_NO_DIALTONE;
+    else
+        code = MM_CONNECTION_ERROR_NO_CARRIER;
+
+    return mm_connection_error_for_code (code);
+}
+
+static gboolean
+parse_scanner (const gchar *response,
+               gsize start,
+               gsize end,
+               gsize *reply_start,
+               gsize *reply_len,
+               GError **error)
+{
+    GError *local_error = NULL;
+    FinalResult result;
+    const gchar *value = NULL;
+    gsize value_len = 0;
+    gsize ok_start = 0;
+    gboolean numeric = FALSE;
+    gchar *str;
+
+    result = find_final_result (response + start, end - start,
+                                &ok_start, &value, &value_len, &numeric);
+
+    switch (result) {
+    case FINAL_RESULT_NONE:
+        return FALSE;
+    case FINAL_RESULT_OK:
+        end = start + ok_start;
+        break;
+    case FINAL_RESULT_CONNECT:
+    case FINAL_RESULT_SMS_PROMPT:
+        break;
+    case FINAL_RESULT_CME_ERROR:
+        str = g_strndup (value, value_len);
+        if (numeric)
+            local_error = mm_mobile_equipment_error_for_code (atoi (str));
+        else if (value_len > 0)
+            local_error = mm_mobile_equipment_error_for_string (str);
+        else
+            local_error = mm_mobile_equipment_error_for_code (MM_MOBILE_EQUIPMENT_ERROR_UNKNOWN);
+        g_free (str);
+        break;
+    case FINAL_RESULT_CMS_ERROR:
+        str = g_strndup (value, value_len);
+        if (numeric)
+            local_error = mm_message_error_for_code (atoi (str));
+        else if (value_len > 0)
+            local_error = mm_message_error_for_string (str);
+        else
+            local_error = mm_message_error_for_code (MM_MESSAGE_ERROR_UNKNOWN);
+        g_free (str);
+        break;
+    case FINAL_RESULT_EZX_ERROR:
+    case FINAL_RESULT_UNKNOWN_ERROR:
+        local_error = mm_mobile_equipment_error_for_code (MM_MOBILE_EQUIPMENT_ERROR_UNKNOWN);
+        break;
+    case FINAL_RESULT_CONNECTION_ERROR:
+        local_error = connection_error_for_line (value, value_len);
+        break;
+    }
+
+    response_clean (response, &start, &end);
+    *reply_start = start;
+    *reply_len = end - start;
+
+    if (local_error) {
+        mm_dbg ("Got failure code %d: %s", local_error->code, local_error->message);
+        g_propagate_error (error, local_error);
+    }
+
+    return TRUE;
+}
+
+gboolean
+mm_serial_parser_v1_parse (gpointer data,
+                           const gchar *response,
+                           gsize response_len,
+                           gsize *reply_start,
+                           gsize *reply_len,
+                           GError **error)
+{
+    MMSerialParserV1 *parser = (MMSerialParserV1 *) data;
+    gsize start;
+
+    g_return_val_if_fail (parser != NULL, FALSE);
+    g_return_val_if_fail (response != NULL, FALSE);
+
+    /* Custom replies can only be matched by the regex based parser */
+    if (parser->regex_custom_successful || parser->regex_custom_error)
+        return mm_serial_parser_v1_parse_regex (parser,
+                                                response, response_len,
+                                                reply_start, reply_len,
+                                                error);
+
+    start = skip_leading_nuls (response, response_len);
+    if (G_UNLIKELY (start == response_len))
+        return FALSE;
+
+    return parse_scanner (response, start, response_len,
+                          reply_start, reply_len,
+                          error);
+}
+
 gboolean
 mm_serial_parser_v1_is_known_error (const GError *error)
 {
@@ -23,9 +23,21 @@ void     mm_serial_parser_v1_set_custom_regex (gpointer data,
                                                GRegex *successful,
                                                GRegex *error);
 gboolean mm_serial_parser_v1_parse            (gpointer parser,
-                                               GString *response,
+                                               const gchar *response,
+                                               gsize response_len,
+                                               gsize *reply_start,
+                                               gsize *reply_len,
                                                GError **error);
 void     mm_serial_parser_v1_destroy          (gpointer parser);
+
+/* Just for unit tests and benchmarks; the GRegex based parser, which
+ * mm_serial_parser_v1_parse() falls back to when custom regexes are set */
+gboolean mm_serial_parser_v1_parse_regex      (gpointer parser,
+                                               const gchar *response,
+                                               gsize response_len,
+                                               gsize *reply_start,
+                                               gsize *reply_len,
+                                               GError **error);
 gboolean mm_serial_parser_v1_is_known_error   (const GError *error);
 
 #endif /* MM_SERIAL_PARSERS_H */
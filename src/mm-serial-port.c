@@ -32,6 +32,7 @@
 #include <mm-errors-types.h>
 
 #include "mm-serial-port.h"
+#include "mm-serial-trace.h"
 #include "mm-log.h"
 
 static gboolean mm_serial_port_queue_process (gpointer data);
@@ -66,6 +67,16 @@ static guint signals[LAST_SIGNAL] = { 0 };
 
 #define SERIAL_BUF_SIZE 2048
 
+/* Room for a full read on top of a full (spew-controlled) buffer */
+#define SERIAL_BUF_CAPACITY (2 * SERIAL_BUF_SIZE)
+
+/* When a send delay is configured, commands are written in chunks at most
+ * this often, with as many bytes as the delay allows since the last one */
+#define PACED_WRITE_INTERVAL_MS 10
+
+/* Maximum size of the cached replies, commands included */
+#define REPLY_CACHE_MAX_SIZE 16384
+
 #define MM_SERIAL_PORT_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), MM_TYPE_SERIAL_PORT, MMSerialPortPrivate))
 
 typedef struct {
@@ -73,9 +84,10 @@ typedef struct {
     gboolean forced_close;
     int fd;
     GHashTable *reply_cache;
+    MMSerialPortReplyCacheStats reply_cache_stats;
     GIOChannel *channel;
     GQueue *queue;
-    GByteArray *response;
+    MMSerialBuffer *response;
 
     struct termios old_t;
 
@@ -99,21 +111,85 @@ typedef struct {
 
     guint flash_id;
     guint connected_id;
+
+    guint16 trace_port;
+
+    MMSerialPortQueueStats queue_stats;
 } MMSerialPortPrivate;
 
+typedef struct {
+    GCallback callback;
+    gpointer user_data;
+} MMQueueWaiter;
+
 typedef struct {
     GByteArray *command;
     guint32 idx;
     guint32 eagain_count;
+    gint64 send_start;
     gboolean started;
     gboolean done;
     GCallback callback;
     gpointer user_data;
     guint32 timeout;
     gboolean cached;
+    guint cache_ttl;
     GCancellable *cancellable;
+    MMSerialCommandPriority priority;
+    gboolean coalesce;
+    /* Callbacks of other identical commands waiting for the same reply */
+    GArray *waiters;
+    gint64 queued_time;
 } MMQueueData;
 
+static void
+queue_data_free (MMQueueData *info)
+{
+    g_clear_object (&info->cancellable);
+    g_byte_array_free (info->command, TRUE);
+    if (info->waiters)
+        g_array_unref (info->waiters);
+    g_slice_free (MMQueueData, info);
+}
+
+/* Delivers the response to every callback waiting for it, returning the number
+ * of bytes consumed */
+static gsize
+queue_data_complete (MMSerialPort *self,
+                     MMQueueData *info,
+                     MMSerialBuffer *response,
+                     GError *error)
+{
+    gsize consumed = response ? mm_serial_buffer_get_len (response) : 0;
+    guint i;
+
+    g_warn_if_fail (MM_SERIAL_PORT_GET_CLASS (self)->handle_response != NULL);
+
+    if (info->callback)
+        consumed = MM_SERIAL_PORT_GET_CLASS (self)->handle_response (self,
+                                                                     response,
+                                                                     error,
+                                                                     info->callback,
+                                                                     info->user_data);
+
+    /* All the callbacks get the same view of the response, which is
+     * consumed only once */
+    for (i = 0; info->waiters && i < info->waiters->len; i++) {
+        MMQueueWaiter *waiter = &g_array_index (info->waiters, MMQueueWaiter, i);
+
+        if (!waiter->callback)
+            continue;
+
+        consumed = MM_SERIAL_PORT_GET_CLASS (self)->handle_response (self,
+                                                                     response,
+                                                                     error,
+                                                                     waiter->callback,
+                                                                     waiter->user_data);
+    }
+
+    return consumed;
+}
+
 #if 0
 static const char *
 baud_to_string (int baud)
@@ -427,6 +503,37 @@ serial_debug (MMSerialPort *self, const char *prefix, const char *buf, gsize len
         MM_SERIAL_PORT_GET_CLASS (self)->debug_log (self, prefix, buf, len);
 }
 
+static guint
+paced_write_interval_ms (MMSerialPortPrivate *priv)
+{
+    return MAX (PACED_WRITE_INTERVAL_MS, priv->send_delay / 1000);
+}
+
+/* Number of bytes of the command which may be written right now, so that the
+ * average rate is one byte every send_delay microseconds since the first one
+ * was sent, without ever writing in a single chunk more than what the line
+ * is able to transmit in a write interval. */
+static guint
+paced_write_len (MMSerialPortPrivate *priv,
+                 MMQueueData *info)
+{
+    guint64 max_chunk;
+    guint64 due;
+
+    max_chunk = (paced_write_interval_ms (priv) * 1000) / priv->send_delay;
+    if (priv->baud)
+        /* ~10 bits per byte on the line */
+        max_chunk = MIN (max_chunk, ((guint64) priv->baud * paced_write_interval_ms (priv)) / 10000);
+    max_chunk = MAX (max_chunk, 1);
+
+    due = ((guint64) (g_get_monotonic_time () - info->send_start) / priv->send_delay) + 1;
+    due = MIN (due, info->command->len);
+
+    if (due <= info->idx)
+        return 1;
+    return (guint) MIN (due - info->idx, max_chunk);
+}
+
 static gboolean
 mm_serial_port_process_command (MMSerialPort *self,
                                 MMQueueData *info,
@@ -451,7 +558,12 @@ mm_serial_port_process_command (MMSerialPort *self,
     /* Only print command the first time */
     if (info->started == FALSE) {
         info->started = TRUE;
+        info->send_start = g_get_monotonic_time ();
         serial_debug (self, "-->", (const char *) info->command->data, info->command->len);
+        mm_serial_trace_record (priv->trace_port,
+                                MM_SERIAL_TRACE_RECORD_TX,
+                                info->command->data,
+                                info->command->len);
     }
 
     if (priv->send_delay == 0) {
@@ -459,12 +571,11 @@ mm_serial_port_process_command (MMSerialPort *self,
         send_len = expected_status = info->command->len;
         p = info->command->data;
     } else {
-        /* Send just one byte of the command */
-        send_len = expected_status = 1;
+        /* Send the bytes of the command due by now */
+        send_len = expected_status = paced_write_len (priv, info);
         p = &info->command->data[info->idx];
     }
 
-    /* Send a single byte of the command */
     errno = 0;
     status = write (priv->fd, p, send_len);
     if (status > 0)
@@ -495,32 +606,146 @@ mm_serial_port_process_command (MMSerialPort *self,
     return TRUE;
 }
 
+typedef struct {
+    GByteArray *response;
+    /* Monotonic time after which the reply is no longer valid, or 0 */
+    gint64 expires;
+} ReplyCacheEntry;
+
+static void
+reply_cache_entry_free (ReplyCacheEntry *entry)
+{
+    g_byte_array_free (entry->response, TRUE);
+    g_slice_free (ReplyCacheEntry, entry);
+}
+
+static void
+reply_cache_remove (MMSerialPortPrivate *priv,
+                    GHashTableIter *iter,
+                    const GByteArray *command,
+                    ReplyCacheEntry *entry)
+{
+    priv->reply_cache_stats.size -= command->len + entry->response->len;
+    priv->reply_cache_stats.n_entries--;
+    if (iter)
+        g_hash_table_iter_remove (iter);
+    else
+        g_hash_table_remove (priv->reply_cache, command);
+}
+
+static void
+reply_cache_purge_expired (MMSerialPortPrivate *priv)
+{
+    GHashTableIter iter;
+    GByteArray *command;
+    ReplyCacheEntry *entry;
+    gint64 now;
+
+    now = g_get_monotonic_time ();
+    g_hash_table_iter_init (&iter, priv->reply_cache);
+    while (g_hash_table_iter_next (&iter, (gpointer *)&command, (gpointer *)&entry)) {
+        if (entry->expires && entry->expires <= now)
+            reply_cache_remove (priv, &iter, command, entry);
+    }
+}
+
 static void
 mm_serial_port_set_cached_reply (MMSerialPort *self,
                                  const GByteArray *command,
-                                 const GByteArray *response)
+                                 MMSerialBuffer *response,
+                                 guint ttl)
 {
     MMSerialPortPrivate *priv = MM_SERIAL_PORT_GET_PRIVATE (self);
+    ReplyCacheEntry *entry;
+    GByteArray *cmd_copy;
+    const guint8 *data;
+    gsize len;
 
     g_return_if_fail (self != NULL);
     g_return_if_fail (MM_IS_SERIAL_PORT (self));
     g_return_if_fail (command != NULL);
 
-    if (response) {
-        GByteArray *cmd_copy = g_byte_array_sized_new (command->len);
-        GByteArray *rsp_copy = g_byte_array_sized_new (response->len);
+    entry = g_hash_table_lookup (priv->reply_cache, command);
+    if (entry)
+        reply_cache_remove (priv, NULL, command, entry);
 
-        g_byte_array_append (cmd_copy, command->data, command->len);
-        g_byte_array_append (rsp_copy, response->data, response->len);
-        g_hash_table_insert (priv->reply_cache, cmd_copy, rsp_copy);
-    } else
-        g_hash_table_remove (MM_SERIAL_PORT_GET_PRIVATE (self)->reply_cache, command);
+    if (!response)
+        return;
+
+    data = mm_serial_buffer_peek (response, &len);
+    if (priv->reply_cache_stats.size + command->len + len > REPLY_CACHE_MAX_SIZE) {
+        reply_cache_purge_expired (priv);
+        if (priv->reply_cache_stats.size + command->len + len > REPLY_CACHE_MAX_SIZE) {
+            priv->reply_cache_stats.n_rejected++;
+            return;
+        }
+    }
+
+    cmd_copy = g_byte_array_sized_new (command->len);
+    g_byte_array_append (cmd_copy, command->data, command->len);
+
+    entry = g_slice_new (ReplyCacheEntry);
+    entry->response = g_byte_array_sized_new (len);
+    g_byte_array_append (entry->response, data, len);
+    entry->expires = ttl ? g_get_monotonic_time () + (gint64) ttl * G_USEC_PER_SEC : 0;
+
+    g_hash_table_insert (priv->reply_cache, cmd_copy, entry);
+    priv->reply_cache_stats.size += command->len + len;
+    priv->reply_cache_stats.n_entries++;
 }
 
 static const GByteArray *
 mm_serial_port_get_cached_reply (MMSerialPort *self, GByteArray *command)
 {
-    return (const GByteArray *) g_hash_table_lookup (MM_SERIAL_PORT_GET_PRIVATE (self)->reply_cache, command);
+    MMSerialPortPrivate *priv = MM_SERIAL_PORT_GET_PRIVATE (self);
+    ReplyCacheEntry *entry;
+
+    entry = g_hash_table_lookup (priv->reply_cache, command);
+    if (entry && entry->expires && entry->expires <= g_get_monotonic_time ()) {
+        reply_cache_remove (priv, NULL, command, entry);
+        entry = NULL;
+    }
+
+    if (!entry) {
+        priv->reply_cache_stats.n_misses++;
+        return NULL;
+    }
+
+    priv->reply_cache_stats.n_hits++;
+    return entry->response;
+}
+
+void
+mm_serial_port_invalidate_cached_replies (MMSerialPort *self,
+                                          const guint8 *prefix,
+                                          gsize prefix_len)
+{
+    MMSerialPortPrivate *priv;
+    GHashTableIter iter;
+    GByteArray *command;
+    ReplyCacheEntry *entry;
+
+    g_return_if_fail (MM_IS_SERIAL_PORT (self));
+
+    priv = MM_SERIAL_PORT_GET_PRIVATE (self);
+    g_hash_table_iter_init (&iter, priv->reply_cache);
+    while (g_hash_table_iter_next (&iter, (gpointer *)&command, (gpointer *)&entry)) {
+        if (command->len >= prefix_len &&
+            memcmp (command->data, prefix, prefix_len) == 0) {
+            reply_cache_remove (priv, &iter, command, entry);
+            priv->reply_cache_stats.n_invalidated++;
+        }
+    }
+}
+
+void
+mm_serial_port_get_reply_cache_stats (MMSerialPort *self,
+                                      MMSerialPortReplyCacheStats *stats)
+{
+    g_return_if_fail (MM_IS_SERIAL_PORT (self));
+    g_return_if_fail (stats != NULL);
+
+    *stats = MM_SERIAL_PORT_GET_PRIVATE (self)->reply_cache_stats;
 }
 
 static void
@@ -546,15 +771,25 @@ mm_serial_port_schedule_queue_process (MMSerialPort *self, guint timeout_ms)
 
 static gsize
 real_handle_response (MMSerialPort *self,
-                      GByteArray *response,
+                      MMSerialBuffer *response,
                       GError *error,
                       GCallback callback,
                       gpointer callback_data)
 {
     MMSerialResponseFn response_callback = (MMSerialResponseFn) callback;
+    const guint8 *data;
+    gsize len;
 
-    response_callback (self, response, error, callback_data);
-    return response->len;
+    if (!response) {
+        response_callback (self, NULL, 0, error, callback_data);
+        return 0;
+    }
+
+    /* The callback gets a borrowed view of the buffer */
+    data = mm_serial_buffer_peek (response, &len);
+    response_callback (self, data, len, error, callback_data);
+
+    return len;
 }
 
 static void
@@ -562,7 +797,7 @@ mm_serial_port_got_response (MMSerialPort *self, GError *error)
 {
     MMSerialPortPrivate *priv = MM_SERIAL_PORT_GET_PRIVATE (self);
     MMQueueData *info;
-    gsize consumed = priv->response->len;
+    gsize consumed = mm_serial_buffer_get_len (priv->response);
 
     if (priv->timeout_id) {
         g_source_remove (priv->timeout_id);
@@ -581,27 +816,19 @@ mm_serial_port_got_response (MMSerialPort *self, GError *error)
     info = (MMQueueData *) g_queue_pop_head (priv->queue);
     if (info) {
         if (info->cached && !error)
-            mm_serial_port_set_cached_reply (self, info->command, priv->response);
+            mm_serial_port_set_cached_reply (self, info->command, priv->response, info->cache_ttl);
 
-        if (info->callback) {
-            g_warn_if_fail (MM_SERIAL_PORT_GET_CLASS (self)->handle_response != NULL);
-            consumed = MM_SERIAL_PORT_GET_CLASS (self)->handle_response (self,
-                                                                         priv->response,
-                                                                         error,
-                                                                         info->callback,
-                                                                         info->user_data);
-        }
+        if (info->callback || info->waiters)
+            consumed = queue_data_complete (self, info, priv->response, error);
 
-        g_clear_object (&info->cancellable);
-        g_byte_array_free (info->command, TRUE);
-        g_slice_free (MMQueueData, info);
+        queue_data_free (info);
     }
 
     if (error)
         g_error_free (error);
 
     if (consumed)
-        g_byte_array_remove_range (priv->response, 0, consumed);
+        mm_serial_buffer_consume (priv->response, consumed);
     if (!g_queue_is_empty (priv->queue))
         mm_serial_port_schedule_queue_process (self, 0);
 }
@@ -668,21 +895,30 @@ mm_serial_port_queue_process (gpointer data)
     if (!info)
         return FALSE;
 
+    if (!info->started) {
+        guint64 wait;
+
+        wait = (guint64) (g_get_monotonic_time () - info->queued_time);
+        priv->queue_stats.n_started++;
+        priv->queue_stats.total_wait_us += wait;
+        priv->queue_stats.max_wait_us = MAX (priv->queue_stats.max_wait_us, wait);
+    }
+
     if (info->cached) {
         const GByteArray *cached = mm_serial_port_get_cached_reply (self, info->command);
 
         if (cached) {
             /* Ensure the response array is fully empty before setting the
              * cached response.  */
-            if (priv->response->len > 0) {
-                mm_warn ("(%s) response array is not empty when using cached "
-                         "reply, cleaning up %u bytes",
+            if (mm_serial_buffer_get_len (priv->response) > 0) {
+                mm_warn ("(%s) response buffer is not empty when using cached "
+                         "reply, cleaning up %" G_GSIZE_FORMAT " bytes",
                          mm_port_get_device (MM_PORT (self)),
-                         priv->response->len);
-                g_byte_array_set_size (priv->response, 0);
+                         mm_serial_buffer_get_len (priv->response));
+                mm_serial_buffer_clear (priv->response);
             }
 
-            g_byte_array_append (priv->response, cached->data, cached->len);
+            mm_serial_buffer_append (priv->response, cached->data, cached->len);
             mm_serial_port_got_response (self, NULL);
             return FALSE;
         }
@@ -712,8 +948,8 @@ mm_serial_port_queue_process (gpointer data)
                                                       mm_serial_port_timed_out,
                                                       self);
         } else {
-            /* Schedule the next byte of the command to be sent */
-            mm_serial_port_schedule_queue_process (self, priv->send_delay / 1000);
+            /* Schedule the next chunk of the command to be sent */
+            mm_serial_port_schedule_queue_process (self, paced_write_interval_ms (priv));
         }
     } else
         mm_serial_port_got_response (self, error);
@@ -723,7 +959,7 @@ mm_serial_port_queue_process (gpointer data)
 
 static gboolean
 parse_response (MMSerialPort *self,
-                GByteArray *response,
+                MMSerialBuffer *response,
                 GError **error)
 {
     if (MM_SERIAL_PORT_GET_CLASS (self)->parse_unsolicited)
@@ -740,7 +976,9 @@ data_available (GIOChannel *source,
 {
     MMSerialPort *self = MM_SERIAL_PORT (data);
     MMSerialPortPrivate *priv = MM_SERIAL_PORT_GET_PRIVATE (self);
-    char buf[SERIAL_BUF_SIZE + 1];
+    guint8 *buf;
+    gsize wanted;
+    gsize to_read;
     gsize bytes_read;
     GIOStatus status;
     MMQueueData *info;
@@ -750,15 +988,13 @@ data_available (GIOChannel *source,
         device = mm_port_get_device (MM_PORT (self));
         mm_dbg ("(%s) unexpected port hangup!", device);
 
-        if (priv->response->len)
-            g_byte_array_remove_range (priv->response, 0, priv->response->len);
+        mm_serial_buffer_clear (priv->response);
         mm_serial_port_close_force (self);
         return FALSE;
     }
 
     if (condition & G_IO_ERR) {
-        if (priv->response->len)
-            g_byte_array_remove_range (priv->response, 0, priv->response->len);
+        mm_serial_buffer_clear (priv->response);
         return TRUE;
     }
 
@@ -770,8 +1006,17 @@ data_available (GIOChannel *source,
     do {
         GError *err = NULL;
 
+        /* Read straight into the free space of the response buffer. Trimming
+         * may leave it more than half full, so with spew control don't read
+         * more than what's left, or the buffer would keep growing. */
+        wanted = SERIAL_BUF_SIZE;
+        if (priv->spew_control &&
+            mm_serial_buffer_get_len (priv->response) < SERIAL_BUF_CAPACITY)
+            wanted = MIN (wanted, SERIAL_BUF_CAPACITY - mm_serial_buffer_get_len (priv->response));
+
         bytes_read = 0;
-        status = g_io_channel_read_chars (source, buf, SERIAL_BUF_SIZE, &bytes_read, &err);
+        buf = mm_serial_buffer_reserve (priv->response, wanted, &to_read);
+        status = g_io_channel_read_chars (source, (gchar *) buf, to_read, &bytes_read, &err);
         if (status == G_IO_STATUS_ERROR) {
             if (err && err->message) {
                 mm_warn ("(%s): read error: %s",
@@ -786,22 +1031,29 @@ data_available (GIOChannel *source,
             break;
 
         g_assert (bytes_read > 0);
-        serial_debug (self, "<--", buf, bytes_read);
-        g_byte_array_append (priv->response, (const guint8 *) buf, bytes_read);
+        serial_debug (self, "<--", (const char *) buf, bytes_read);
+        mm_serial_trace_record (priv->trace_port, MM_SERIAL_TRACE_RECORD_RX, buf, bytes_read);
+        mm_serial_buffer_commit (priv->response, bytes_read);
 
         /* Make sure the response doesn't grow too long */
-        if ((priv->response->len > SERIAL_BUF_SIZE) && priv->spew_control) {
+        if ((mm_serial_buffer_get_len (priv->response) > SERIAL_BUF_SIZE) && priv->spew_control) {
             /* Notify listeners and then trim the buffer */
             g_signal_emit (self, signals[BUFFER_FULL], 0, priv->response);
-            g_byte_array_remove_range (priv->response, 0, (SERIAL_BUF_SIZE / 2));
+            mm_serial_buffer_consume (priv->response, (SERIAL_BUF_SIZE / 2));
         }
 
         if (parse_response (self, priv->response, &err)) {
             /* Reset number of consecutive timeouts only here */
             priv->n_consecutive_timeouts = 0;
             mm_serial_port_got_response (self, err);
+
+            /* Unsolicited data received right after the reply in the same
+             * read would otherwise wait in the buffer until the next one */
+            if (mm_serial_buffer_get_len (priv->response) > 0 &&
+                MM_SERIAL_PORT_GET_CLASS (self)->parse_unsolicited)
+                MM_SERIAL_PORT_GET_CLASS (self)->parse_unsolicited (self, priv->response);
         }
-    } while (   (bytes_read == SERIAL_BUF_SIZE || status == G_IO_STATUS_AGAIN)
+    } while (   (bytes_read == to_read || status == G_IO_STATUS_AGAIN)
              && (priv->watch_id > 0));
 
     return TRUE;
@@ -857,6 +1109,9 @@ mm_serial_port_open (MMSerialPort *self, GError **error)
 
     mm_info ("(%s) opening serial port...", device);
 
+    if (!priv->trace_port)
+        priv->trace_port = mm_serial_trace_register_port (device);
+
     g_get_current_time (&tv_start);
 
     /* Only open a new file descriptor if we weren't given one already */
@@ -914,6 +1169,8 @@ mm_serial_port_open (MMSerialPort *self, GError **error)
 
     priv->channel = g_io_channel_unix_new (priv->fd);
     g_io_channel_set_encoding (priv->channel, NULL, NULL);
+    /* Unbuffered, so that data is read straight into the response buffer */
+    g_io_channel_set_buffered (priv->channel, FALSE);
     priv->watch_id = g_io_add_watch (priv->channel,
                                      G_IO_IN | G_IO_ERR | G_IO_HUP,
                                      data_available, self);
@@ -1027,32 +1284,40 @@ mm_serial_port_close (MMSerialPort *self)
     for (i = 0; i < g_queue_get_length (priv->queue); i++) {
         MMQueueData *item = g_queue_peek_nth (priv->queue, i);
 
-        if (item->callback) {
+        if (item->callback || item->waiters) {
             GError *error;
-            GByteArray *response;
 
-            g_warn_if_fail (MM_SERIAL_PORT_GET_CLASS (self)->handle_response != NULL);
             error = g_error_new_literal (MM_SERIAL_ERROR,
                                          MM_SERIAL_ERROR_SEND_FAILED,
                                          "Serial port is now closed");
-            response = g_byte_array_sized_new (1);
-            g_byte_array_append (response, (const guint8 *) "\0", 1);
-
-            MM_SERIAL_PORT_GET_CLASS (self)->handle_response (self,
-                                                              response,
-                                                              error,
-                                                              item->callback,
-                                                              item->user_data);
+            queue_data_complete (self, item, NULL, error);
             g_error_free (error);
-            g_byte_array_free (response, TRUE);
         }
 
-        g_clear_object (&item->cancellable);
-        g_byte_array_free (item->command, TRUE);
-        g_slice_free (MMQueueData, item);
+        queue_data_free (item);
     }
     g_queue_clear (priv->queue);
 
+    if (priv->queue_stats.n_commands)
+        mm_dbg ("(%s) command queue: %" G_GUINT64_FORMAT " commands (%" G_GUINT64_FORMAT " coalesced), "
+                "max depth %u, wait time avg %" G_GUINT64_FORMAT "ms max %" G_GUINT64_FORMAT "ms",
+                device,
+                priv->queue_stats.n_commands,
+                priv->queue_stats.n_coalesced,
+                priv->queue_stats.max_depth,
+                (priv->queue_stats.n_started ?
+                 (priv->queue_stats.total_wait_us / priv->queue_stats.n_started) / 1000 : 0),
+                priv->queue_stats.max_wait_us / 1000);
+    if (priv->reply_cache_stats.n_hits)
+        mm_dbg ("(%s) reply cache: %u entries (%" G_GSIZE_FORMAT " bytes), "
+                "%" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses, %" G_GUINT64_FORMAT " invalidated",
+                device,
+                priv->reply_cache_stats.n_entries,
+                priv->reply_cache_stats.size,
+                priv->reply_cache_stats.n_hits,
+                priv->reply_cache_stats.n_misses,
+                priv->reply_cache_stats.n_invalidated);
+
     if (priv->timeout_id) {
         g_source_remove (priv->timeout_id);
         priv->timeout_id = 0;
@@ -1099,11 +1364,57 @@ mm_serial_port_close_force (MMSerialPort *self)
     g_signal_emit (self, signals[FORCED_CLOSE], 0);
 }
 
+static MMQueueData *
+find_coalescable_command (MMSerialPortPrivate *priv,
+                          const GByteArray *command,
+                          gboolean cached,
+                          GCancellable *cancellable)
+{
+    GList *l;
+
+    for (l = priv->queue->head; l; l = g_list_next (l)) {
+        MMQueueData *item = l->data;
+
+        if (item->coalesce &&
+            item->cached == cached &&
+            item->cancellable == cancellable &&
+            item->command->len == command->len &&
+            memcmp (item->command->data, command->data, command->len) == 0)
+            return item;
+    }
+
+    return NULL;
+}
+
+static void
+queue_insert (MMSerialPortPrivate *priv,
+              MMQueueData *info)
+{
+    GList *l;
+
+    /* Keep the queue sorted by priority, FIFO within the same priority. The
+     * command at the head is never displaced once it has been started. */
+    for (l = priv->queue->tail; l; l = g_list_previous (l)) {
+        MMQueueData *item = l->data;
+
+        if (item->priority <= info->priority ||
+            (l == priv->queue->head && item->started)) {
+            g_queue_insert_after (priv->queue, l, info);
+            return;
+        }
+    }
+
+    g_queue_push_head (priv->queue, info);
+}
+
 static void
 internal_queue_command (MMSerialPort *self,
                         GByteArray *command,
                         gboolean take_command,
                         gboolean cached,
+                        guint cache_ttl,
+                        MMSerialCommandPriority priority,
+                        gboolean coalesce,
                         guint32 timeout_seconds,
                         GCancellable *cancellable,
                         MMSerialResponseFn callback,
@@ -1119,12 +1430,50 @@ internal_queue_command (MMSerialPort *self,
         GError *error = g_error_new_literal (MM_SERIAL_ERROR,
                                              MM_SERIAL_ERROR_SEND_FAILED,
                                              "Sending command failed: device is not enabled");
-        if (callback)
-            callback (self, NULL, error, user_data);
+        /* Let the subclass call the callback, as it knows its real type */
+        if (callback) {
+            g_warn_if_fail (MM_SERIAL_PORT_GET_CLASS (self)->handle_response != NULL);
+            MM_SERIAL_PORT_GET_CLASS (self)->handle_response (self,
+                                                              NULL,
+                                                              error,
+                                                              (GCallback) callback,
+                                                              user_data);
+        }
         g_error_free (error);
+        if (take_command)
+            g_byte_array_free (command, TRUE);
         return;
     }
 
+    priv->queue_stats.n_commands++;
+
+    /* An identical command is already waiting for its reply, so just wait
+     * for the same one */
+    if (coalesce) {
+        info = find_coalescable_command (priv, command, cached, cancellable);
+        if (info) {
+            MMQueueWaiter waiter;
+
+            waiter.callback = (GCallback) callback;
+            waiter.user_data = user_data;
+            if (!info->waiters)
+                info->waiters = g_array_new (FALSE, FALSE, sizeof (MMQueueWaiter));
+            g_array_append_val (info->waiters, waiter);
+            priv->queue_stats.n_coalesced++;
+
+            /* Move it up if needed */
+            if (priority < info->priority && !info->started) {
+                g_queue_remove (priv->queue, info);
+                info->priority = priority;
+                queue_insert (priv, info);
+            }
+
+            if (take_command)
+                g_byte_array_free (command, TRUE);
+            return;
+        }
+    }
+
     info = g_slice_new0 (MMQueueData);
     if (take_command)
         info->command = command;
@@ -1135,11 +1484,15 @@ internal_queue_command (MMSerialPort *self,
 
     /* Only accept about 3 seconds of EAGAIN for this command */
     if (priv->send_delay)
-        info->eagain_count = 3000000 / priv->send_delay;
+        info->eagain_count = 3000 / paced_write_interval_ms (priv);
     else
         info->eagain_count = 1000;
 
     info->cached = cached;
+    info->cache_ttl = cache_ttl;
+    info->priority = priority;
+    info->coalesce = coalesce;
+    info->queued_time = g_get_monotonic_time ();
     info->timeout = timeout_seconds;
     info->cancellable = (cancellable ? g_object_ref (cancellable) : NULL);
     info->callback = (GCallback) callback;
@@ -1147,9 +1500,11 @@ internal_queue_command (MMSerialPort *self,
 
     /* Clear the cached value for this command if not asking for cached value */
     if (!cached)
-        mm_serial_port_set_cached_reply (self, info->command, NULL);
+        mm_serial_port_set_cached_reply (self, info->command, NULL, 0);
 
-    g_queue_push_tail (priv->queue, info);
+    queue_insert (priv, info);
+    priv->queue_stats.max_depth = MAX (priv->queue_stats.max_depth,
+                                       g_queue_get_length (priv->queue));
 
     if (g_queue_get_length (priv->queue) == 1)
         mm_serial_port_schedule_queue_process (self, 0);
@@ -1164,7 +1519,17 @@ mm_serial_port_queue_command (MMSerialPort *self,
                               MMSerialResponseFn callback,
                               gpointer user_data)
 {
-    internal_queue_command (self, command, take_command, FALSE, timeout_seconds, cancellable, callback, user_data);
+    internal_queue_command (self,
+                            command,
+                            take_command,
+                            FALSE,
+                            0,
+                            MM_SERIAL_COMMAND_PRIORITY_DEFAULT,
+                            FALSE,
+                            timeout_seconds,
+                            cancellable,
+                            callback,
+                            user_data);
 }
 
 void
@@ -1176,7 +1541,68 @@ mm_serial_port_queue_command_cached (MMSerialPort *self,
                                      MMSerialResponseFn callback,
                                      gpointer user_data)
 {
-    internal_queue_command (self, command, take_command, TRUE, timeout_seconds, cancellable, callback, user_data);
+    internal_queue_command (self,
+                            command,
+                            take_command,
+                            TRUE,
+                            0,
+                            MM_SERIAL_COMMAND_PRIORITY_DEFAULT,
+                            FALSE,
+                            timeout_seconds,
+                            cancellable,
+                            callback,
+                            user_data);
+}
+
+void
+mm_serial_port_queue_command_full (MMSerialPort *self,
+                                   GByteArray *command,
+                                   gboolean take_command,
+                                   gboolean cached,
+                                   guint cache_ttl,
+                                   MMSerialCommandPriority priority,
+                                   gboolean coalesce,
+                                   guint32 timeout_seconds,
+                                   GCancellable *cancellable,
+                                   MMSerialResponseFn callback,
+                                   gpointer user_data)
+{
+    internal_queue_command (self,
+                            command,
+                            take_command,
+                            cached,
+                            cache_ttl,
+                            priority,
+                            coalesce,
+                            timeout_seconds,
+                            cancellable,
+                            callback,
+                            user_data);
+}
+
+void
+mm_serial_port_get_queue_stats (MMSerialPort *self,
+                                MMSerialPortQueueStats *stats)
+{
+    MMSerialPortPrivate *priv;
+
+    g_return_if_fail (MM_IS_SERIAL_PORT (self));
+    g_return_if_fail (stats != NULL);
+
+    priv = MM_SERIAL_PORT_GET_PRIVATE (self);
+    *stats = priv->queue_stats;
+    stats->depth = g_queue_get_length (priv->queue);
+}
+
+gboolean
+mm_serial_port_is_waiting_reply (MMSerialPort *self)
+{
+    MMQueueData *info;
+
+    g_return_val_if_fail (MM_IS_SERIAL_PORT (self), FALSE);
+
+    info = (MMQueueData *) g_queue_peek_head (MM_SERIAL_PORT_GET_PRIVATE (self)->queue);
+    return info && info->started;
 }
 
 static gboolean
@@ -1402,12 +1828,9 @@ ba_equal (gconstpointer v1, gconstpointer v2)
         return 0;
 
     g_assert (a && b);
-    if (a->len < b->len)
-        return -1;
-    else if (a->len > b->len)
-        return 1;
+    if (a->len != b->len)
+        return FALSE;
 
-    g_assert (a->len == b->len);
     return !memcmp (a->data, b->data, a->len);
 }
 
@@ -1435,7 +1858,10 @@ mm_serial_port_init (MMSerialPort *self)
 {
     MMSerialPortPrivate *priv = MM_SERIAL_PORT_GET_PRIVATE (self);
 
-    priv->reply_cache = g_hash_table_new_full (ba_hash, ba_equal, ba_free, ba_free);
+    priv->reply_cache = g_hash_table_new_full (ba_hash,
+                                               ba_equal,
+                                               ba_free,
+                                               (GDestroyNotify)reply_cache_entry_free);
 
     priv->fd = -1;
     priv->baud = 57600;
@@ -1445,7 +1871,7 @@ mm_serial_port_init (MMSerialPort *self)
     priv->send_delay = 1000;
 
     priv->queue = g_queue_new ();
-    priv->response = g_byte_array_sized_new (500);
+    priv->response = mm_serial_buffer_new (SERIAL_BUF_CAPACITY);
 }
 
 static void
@@ -1560,7 +1986,7 @@ finalize (GObject *object)
     MMSerialPortPrivate *priv = MM_SERIAL_PORT_GET_PRIVATE (self);
 
     g_hash_table_destroy (priv->reply_cache);
-    g_byte_array_free (priv->response, TRUE);
+    mm_serial_buffer_free (priv->response);
     g_queue_free (priv->queue);
 
     G_OBJECT_CLASS (mm_serial_port_parent_class)->finalize (object);
@@ -22,6 +22,7 @@
 #include <gio/gio.h>
 
 #include "mm-port.h"
+#include "mm-serial-buffer.h"
 
 #define MM_TYPE_SERIAL_PORT            (mm_serial_port_get_type ())
 #define MM_SERIAL_PORT(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), MM_TYPE_SERIAL_PORT, MMSerialPort))
@@ -43,12 +44,49 @@
 typedef struct _MMSerialPort MMSerialPort;
 typedef struct _MMSerialPortClass MMSerialPortClass;
 
+/* Commands are sent in priority order, and in the order they were queued
+ * within the same priority */
+typedef enum {
+    MM_SERIAL_COMMAND_PRIORITY_CONTINUATION = 0, /* Data completing the previous command, e.g. a PDU after a prompt */
+    MM_SERIAL_COMMAND_PRIORITY_INTERACTIVE  = 1, /* Requested by a user, e.g. sending an SMS */
+    MM_SERIAL_COMMAND_PRIORITY_DEFAULT      = 2, /* Anything else, e.g. connection setup */
+    MM_SERIAL_COMMAND_PRIORITY_BACKGROUND   = 3  /* Periodic polling */
+} MMSerialCommandPriority;
+
+typedef struct {
+    /* Commands currently queued, including the one in progress */
+    guint depth;
+    guint max_depth;
+    guint64 n_commands;
+    /* Commands which didn't need to be sent as an identical one was queued */
+    guint64 n_coalesced;
+    /* Commands which got to be sent, or answered from the cache */
+    guint64 n_started;
+    /* Time between queueing a command and starting to send it */
+    guint64 total_wait_us;
+    guint64 max_wait_us;
+} MMSerialPortQueueStats;
+
+typedef struct {
+    guint n_entries;
+    /* Bytes used by the cached commands and replies */
+    gsize size;
+    guint64 n_hits;
+    guint64 n_misses;
+    guint64 n_invalidated;
+    /* Replies not cached because the cache was full */
+    guint64 n_rejected;
+} MMSerialPortReplyCacheStats;
+
 typedef void (*MMSerialFlashFn)        (MMSerialPort *port,
                                         GError *error,
                                         gpointer user_data);
 
+/* The response is a view of the port's buffer, only valid during the
+ * callback; it may be NULL if the command couldn't be sent at all. */
 typedef void (*MMSerialResponseFn)     (MMSerialPort *port,
-                                        GByteArray *response,
+                                        const guint8 *response,
+                                        gsize response_len,
                                         GError *error,
                                         gpointer user_data);
 
@@ -62,9 +100,9 @@ struct _MMSerialPortClass {
 
     /* Called for subclasses to parse unsolicited responses.  If any recognized
      * unsolicited response is found, it should be removed from the 'response'
-     * byte array before returning.
+     * buffer before returning.
      */
-    void     (*parse_unsolicited) (MMSerialPort *self, GByteArray *response);
+    void     (*parse_unsolicited) (MMSerialPort *self, MMSerialBuffer *response);
 
     /* Called to parse the device's response to a command or determine if the
      * response was an error response.  If the response indicates an error, an
@@ -74,15 +112,16 @@ struct _MMSerialPortClass {
      * when the device's response has been recognized and parsed.
      */
     gboolean (*parse_response)    (MMSerialPort *self,
-                                   GByteArray *response,
+                                   MMSerialBuffer *response,
                                    GError **error);
 
     /* Called after parsing to allow the command response to be delivered to
      * it's callback to be handled.  Returns the # of bytes of the response
-     * consumed.
+     * consumed.  The response may be NULL if the command failed before any
+     * reply could be received.
      */
     gsize     (*handle_response)  (MMSerialPort *self,
-                                   GByteArray *response,
+                                   MMSerialBuffer *response,
                                    GError *error,
                                    GCallback callback,
                                    gpointer callback_data);
@@ -98,7 +137,7 @@ struct _MMSerialPortClass {
                                    gsize len);
 
     /* Signals */
-    void (*buffer_full)           (MMSerialPort *port, const GByteArray *buffer);
+    void (*buffer_full)           (MMSerialPort *port, MMSerialBuffer *buffer);
     void (*timed_out)             (MMSerialPort *port, guint n_consecutive_replies);
     void (*forced_close)          (MMSerialPort *port);
 };
@@ -144,4 +183,38 @@ void     mm_serial_port_queue_command_cached (MMSerialPort *self,
                                               MMSerialResponseFn callback,
                                               gpointer user_data);
 
+/* If @cached is set, a previous reply to the same command is used if still
+ * valid, and the reply is kept for @cache_ttl seconds (0 meaning forever).
+ *
+ * If @coalesce is set and an identical command also queued with @coalesce is
+ * still waiting for its reply, the command is not sent again, and the callback
+ * gets the reply of the one already queued. Only meant for commands which
+ * don't change the state of the device. */
+void     mm_serial_port_queue_command_full (MMSerialPort *self,
+                                            GByteArray *command,
+                                            gboolean take_command,
+                                            gboolean cached,
+                                            guint cache_ttl,
+                                            MMSerialCommandPriority priority,
+                                            gboolean coalesce,
+                                            guint32 timeout_seconds,
+                                            GCancellable *cancellable,
+                                            MMSerialResponseFn callback,
+                                            gpointer user_data);
+
+void     mm_serial_port_get_queue_stats (MMSerialPort *self,
+                                         MMSerialPortQueueStats *stats);
+
+/* Whether a command was sent and its reply is expected, i.e. whether the
+ * data received may be that reply */
+gboolean mm_serial_port_is_waiting_reply (MMSerialPort *self);
+
+/* Drops the cached replies of all the commands starting with @prefix */
+void     mm_serial_port_invalidate_cached_replies (MMSerialPort *self,
+                                                   const guint8 *prefix,
+                                                   gsize prefix_len);
+
+void     mm_serial_port_get_reply_cache_stats (MMSerialPort *self,
+                                               MMSerialPortReplyCacheStats *stats);
+
 #endif /* MM_SERIAL_PORT_H */
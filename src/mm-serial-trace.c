@@ -0,0 +1,280 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#include <string.h>
+
+#include <ModemManager.h>
+#include <mm-errors-types.h>
+
+#include "mm-serial-trace.h"
+
+/* Ring buffer with the records, oldest first */
+static guint8 *ring;
+static gsize ring_size;
+static gsize ring_head;
+static gsize ring_len;
+
+/* Port names, indexed by port number - 1 */
+static GPtrArray *ports;
+
+void
+mm_serial_trace_setup (gsize size)
+{
+    mm_serial_trace_shutdown ();
+
+    /* Need room for at least a few records */
+    if (size < 16 * MM_SERIAL_TRACE_RECORD_HDR_SIZE)
+        return;
+
+    ring = g_malloc (size);
+    ring_size = size;
+    ports = g_ptr_array_new_with_free_func (g_free);
+}
+
+void
+mm_serial_trace_shutdown (void)
+{
+    g_free (ring);
+    ring = NULL;
+    ring_size = ring_head = ring_len = 0;
+
+    if (ports) {
+        g_ptr_array_unref (ports);
+        ports = NULL;
+    }
+}
+
+guint16
+mm_serial_trace_register_port (const gchar *name)
+{
+    guint i;
+
+    g_return_val_if_fail (name != NULL, 0);
+
+    if (!ring)
+        return 0;
+
+    /* Ports that come back keep their number */
+    for (i = 0; i < ports->len; i++) {
+        if (g_str_equal (g_ptr_array_index (ports, i), name))
+            return i + 1;
+    }
+
+    if (ports->len == G_MAXUINT16)
+        return 0;
+
+    g_ptr_array_add (ports, g_strdup (name));
+    return ports->len;
+}
+
+/*****************************************************************************/
+
+static void
+ring_read (gsize offset,
+           guint8 *out,
+           gsize len)
+{
+    gsize first;
+
+    offset = (ring_head + offset) % ring_size;
+    first = MIN (len, ring_size - offset);
+    memcpy (out, ring + offset, first);
+    memcpy (out + first, ring, len - first);
+}
+
+static void
+ring_write (const guint8 *in,
+            gsize len)
+{
+    gsize offset;
+    gsize first;
+
+    offset = (ring_head + ring_len) % ring_size;
+    first = MIN (len, ring_size - offset);
+    memcpy (ring + offset, in, first);
+    memcpy (ring, in + first, len - first);
+    ring_len += len;
+}
+
+static void
+build_record_header (guint8 *hdr,
+                     guint64 timestamp,
+                     guint16 port,
+                     MMSerialTraceRecordType type,
+                     guint32 len)
+{
+    timestamp = GUINT64_TO_LE (timestamp);
+    port = GUINT16_TO_LE (port);
+    len = GUINT32_TO_LE (len);
+
+    memcpy (&hdr[0], &timestamp, 8);
+    memcpy (&hdr[8], &port, 2);
+    hdr[10] = (guint8) type;
+    hdr[11] = 0;
+    memcpy (&hdr[12], &len, 4);
+}
+
+static guint32
+get_record_len (const guint8 *hdr)
+{
+    guint32 len;
+
+    memcpy (&len, &hdr[12], 4);
+    return GUINT32_FROM_LE (len);
+}
+
+void
+mm_serial_trace_record (guint16 port,
+                        MMSerialTraceRecordType type,
+                        const guint8 *data,
+                        gsize len)
+{
+    guint8 hdr[MM_SERIAL_TRACE_RECORD_HDR_SIZE];
+    gsize needed;
+
+    if (!ring || !port)
+        return;
+
+    /* Don't let a single huge record wipe the whole history; its first bytes
+     * are usually enough anyway */
+    len = MIN (len, ring_size / 4);
+    needed = MM_SERIAL_TRACE_RECORD_HDR_SIZE + len;
+
+    /* Drop the oldest records until there is room */
+    while (ring_size - ring_len < needed) {
+        guint8 old[MM_SERIAL_TRACE_RECORD_HDR_SIZE];
+        gsize old_size;
+
+        ring_read (0, old, sizeof (old));
+        old_size = MM_SERIAL_TRACE_RECORD_HDR_SIZE + get_record_len (old);
+        ring_head = (ring_head + old_size) % ring_size;
+        ring_len -= old_size;
+    }
+
+    build_record_header (hdr, g_get_real_time (), port, type, len);
+    ring_write (hdr, sizeof (hdr));
+    ring_write (data, len);
+}
+
+/*****************************************************************************/
+
+GByteArray *
+mm_serial_trace_dump (void)
+{
+    GByteArray *trace;
+    guint8 header[MM_SERIAL_TRACE_HEADER_SIZE] = { 0 };
+    guint16 version;
+    guint i;
+
+    trace = g_byte_array_sized_new (MM_SERIAL_TRACE_HEADER_SIZE + ring_len);
+
+    memcpy (&header[0], MM_SERIAL_TRACE_MAGIC, 4);
+    version = GUINT16_TO_LE (MM_SERIAL_TRACE_VERSION);
+    memcpy (&header[4], &version, 2);
+    g_byte_array_append (trace, header, sizeof (header));
+
+    if (!ring)
+        return trace;
+
+    /* Port names first, so that readers don't need to look ahead */
+    for (i = 0; i < ports->len; i++) {
+        const gchar *name = g_ptr_array_index (ports, i);
+        guint8 hdr[MM_SERIAL_TRACE_RECORD_HDR_SIZE];
+
+        build_record_header (hdr, 0, i + 1, MM_SERIAL_TRACE_RECORD_PORT, strlen (name));
+        g_byte_array_append (trace, hdr, sizeof (hdr));
+        g_byte_array_append (trace, (const guint8 *) name, strlen (name));
+    }
+
+    /* And then the ring contents, oldest first */
+    i = trace->len;
+    g_byte_array_set_size (trace, trace->len + ring_len);
+    ring_read (0, trace->data + i, ring_len);
+
+    return trace;
+}
+
+gboolean
+mm_serial_trace_dump_to_file (const gchar *path,
+                              GError **error)
+{
+    GByteArray *trace;
+    gboolean success;
+
+    trace = mm_serial_trace_dump ();
+    success = g_file_set_contents (path, (const gchar *) trace->data, trace->len, error);
+    g_byte_array_unref (trace);
+    return success;
+}
+
+gboolean
+mm_serial_trace_parse (const guint8 *trace,
+                       gsize trace_len,
+                       MMSerialTraceRecordFn callback,
+                       gpointer user_data,
+                       GError **error)
+{
+    guint16 version;
+    gsize offset;
+
+    g_return_val_if_fail (trace != NULL, FALSE);
+
+    if (trace_len < MM_SERIAL_TRACE_HEADER_SIZE ||
+        memcmp (trace, MM_SERIAL_TRACE_MAGIC, 4) != 0) {
+        g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_INVALID_ARGS,
+                     "Not a serial trace");
+        return FALSE;
+    }
+
+    memcpy (&version, &trace[4], 2);
+    if (GUINT16_FROM_LE (version) != MM_SERIAL_TRACE_VERSION) {
+        g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_UNSUPPORTED,
+                     "Unsupported serial trace version %u",
+                     GUINT16_FROM_LE (version));
+        return FALSE;
+    }
+
+    offset = MM_SERIAL_TRACE_HEADER_SIZE;
+    while (offset < trace_len) {
+        const guint8 *hdr = trace + offset;
+        guint64 timestamp;
+        guint16 port;
+        guint32 len;
+
+        if (trace_len - offset < MM_SERIAL_TRACE_RECORD_HDR_SIZE ||
+            trace_len - offset - MM_SERIAL_TRACE_RECORD_HDR_SIZE < get_record_len (hdr)) {
+            g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_INVALID_ARGS,
+                         "Truncated serial trace record at offset %" G_GSIZE_FORMAT,
+                         offset);
+            return FALSE;
+        }
+
+        memcpy (&timestamp, &hdr[0], 8);
+        memcpy (&port, &hdr[8], 2);
+        len = get_record_len (hdr);
+
+        if (callback)
+            callback (GUINT64_FROM_LE (timestamp),
+                      GUINT16_FROM_LE (port),
+                      (MMSerialTraceRecordType) hdr[10],
+                      hdr + MM_SERIAL_TRACE_RECORD_HDR_SIZE,
+                      len,
+                      user_data);
+
+        offset += MM_SERIAL_TRACE_RECORD_HDR_SIZE + len;
+    }
+
+    return TRUE;
+}
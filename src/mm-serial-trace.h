@@ -0,0 +1,80 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#ifndef MM_SERIAL_TRACE_H
+#define MM_SERIAL_TRACE_H
+
+#include <glib.h>
+
+/* Binary trace of the raw data sent to and received from the serial ports.
+ *
+ * Records are kept in a preallocated ring buffer, where the oldest ones get
+ * overwritten, so that tracing is cheap enough to be always enabled. The
+ * trace can then be dumped on demand, with the following format (all
+ * integers are little endian):
+ *
+ *   Header:  "MMST" | guint16 version | guint16 reserved (0)
+ *   Records: guint64 timestamp | guint16 port | guint8 type |
+ *            guint8 reserved (0) | guint32 length | data
+ *
+ * The timestamp is given in microseconds since the Epoch. Dumps start with
+ * a MM_SERIAL_TRACE_RECORD_PORT record for each port, whose data is the
+ * port name, and which gives the port number used in the other records.
+ */
+
+#define MM_SERIAL_TRACE_MAGIC           "MMST"
+#define MM_SERIAL_TRACE_VERSION         1
+#define MM_SERIAL_TRACE_HEADER_SIZE     8
+#define MM_SERIAL_TRACE_RECORD_HDR_SIZE 16
+
+typedef enum {
+    MM_SERIAL_TRACE_RECORD_PORT = 0,
+    MM_SERIAL_TRACE_RECORD_RX   = 1,
+    MM_SERIAL_TRACE_RECORD_TX   = 2,
+} MMSerialTraceRecordType;
+
+/* Size of the ring buffer; 0 disables tracing */
+void        mm_serial_trace_setup         (gsize size);
+void        mm_serial_trace_shutdown      (void);
+
+/* Returns the number to use for the given port in the trace records, or 0
+ * if tracing is disabled */
+guint16     mm_serial_trace_register_port (const gchar *name);
+
+void        mm_serial_trace_record        (guint16 port,
+                                           MMSerialTraceRecordType type,
+                                           const guint8 *data,
+                                           gsize len);
+
+/* Returns the trace in the format described above */
+GByteArray *mm_serial_trace_dump          (void);
+gboolean    mm_serial_trace_dump_to_file  (const gchar *path,
+                                           GError **error);
+
+/* Walks the records of a dumped trace */
+typedef void (*MMSerialTraceRecordFn) (guint64 timestamp,
+                                       guint16 port,
+                                       MMSerialTraceRecordType type,
+                                       const guint8 *data,
+                                       gsize len,
+                                       gpointer user_data);
+
+gboolean    mm_serial_trace_parse         (const guint8 *trace,
+                                           gsize trace_len,
+                                           MMSerialTraceRecordFn callback,
+                                           gpointer user_data,
+                                           GError **error);
+
+#endif /* MM_SERIAL_TRACE_H */
@@ -27,6 +27,7 @@
 #include "mm-iface-modem-messaging.h"
 #include "mm-marshal.h"
 #include "mm-sms-list.h"
+#include "mm-sms-part-index.h"
 #include "mm-sms.h"
 #include "mm-log.h"
 
@@ -51,10 +52,51 @@ struct _MMSmsListPrivate {
     MMBaseModem *modem;
     /* List of sms objects */
     GList *list;
+    /* Index of the parts of the sms objects in the list */
+    MMSmsPartIndex *index;
 };
 
 /*****************************************************************************/
 
+static void
+index_stored_parts (MMSmsList *self,
+                    MMSms *sms)
+{
+    MMSmsStorage storage;
+    GList *l;
+
+    storage = mm_sms_get_storage (sms);
+    if (storage == MM_SMS_STORAGE_UNKNOWN)
+        return;
+
+    for (l = mm_sms_get_parts (sms); l; l = g_list_next (l)) {
+        guint index;
+
+        index = mm_sms_part_get_index ((MMSmsPart *)l->data);
+        if (index != SMS_PART_INVALID_INDEX)
+            mm_sms_part_index_add_stored (self->priv->index, storage, index, sms);
+    }
+}
+
+static void
+sms_storage_updated (MMSms *sms,
+                     GParamSpec *pspec,
+                     MMSmsList *self)
+{
+    /* Parts of SMS created by the user get their indices once stored */
+    index_stored_parts (self, sms);
+}
+
+static void
+remove_from_index (MMSmsList *self,
+                   MMSms *sms)
+{
+    g_signal_handlers_disconnect_by_func (sms, sms_storage_updated, self);
+    mm_sms_part_index_remove_owner (self->priv->index, sms);
+}
+
+/*****************************************************************************/
+
 gboolean
 mm_sms_list_has_local_multipart_reference (MMSmsList *self,
                                            const gchar *number,
@@ -165,6 +207,7 @@ delete_ready (MMSms *sms,
                             ctx->path,
                             (GCompareFunc)cmp_sms_by_path);
     if (l) {
+        remove_from_index (ctx->self, MM_SMS (l->data));
         g_object_unref (MM_SMS (l->data));
         ctx->self->priv->list = g_list_delete_link (ctx->self->priv->list, l);
     }
@@ -226,33 +269,15 @@ mm_sms_list_add_sms (MMSmsList *self,
                      MMSms *sms)
 {
     self->priv->list = g_list_prepend (self->priv->list, g_object_ref (sms));
+    index_stored_parts (self, sms);
+    g_signal_connect (sms,
+                      "notify::storage",
+                      G_CALLBACK (sms_storage_updated),
+                      self);
 }
 
 /*****************************************************************************/
 
-static guint
-cmp_sms_by_concat_reference (MMSms *sms,
-                             gpointer user_data)
-{
-    if (!mm_sms_is_multipart (sms))
-        return -1;
-
-    return (GPOINTER_TO_UINT (user_data) - mm_sms_get_multipart_reference (sms));
-}
-
-typedef struct {
-    guint part_index;
-    MMSmsStorage storage;
-} PartIndexAndStorage;
-
-static guint
-cmp_sms_by_part_index_and_storage (MMSms *sms,
-                                   PartIndexAndStorage *ctx)
-{
-    return !(mm_sms_get_storage (sms) == ctx->storage &&
-             mm_sms_has_part_index (sms, ctx->part_index));
-}
-
 static gboolean
 take_singlepart (MMSmsList *self,
                  MMSmsPart *part,
@@ -271,6 +296,7 @@ take_singlepart (MMSmsList *self,
         return FALSE;
 
     self->priv->list = g_list_prepend (self->priv->list, sms);
+    index_stored_parts (self, sms);
     g_signal_emit (self, signals[SIGNAL_ADDED], 0,
                    mm_sms_get_path (sms),
                    state == MM_SMS_STATE_RECEIVED);
@@ -284,17 +310,29 @@ take_multipart (MMSmsList *self,
                 MMSmsStorage storage,
                 GError **error)
 {
-    GList *l;
     MMSms *sms;
     guint concat_reference;
+    const gchar *number;
+    guint index;
 
     concat_reference = mm_sms_part_get_concat_reference (part);
-    l = g_list_find_custom (self->priv->list,
-                            GUINT_TO_POINTER (concat_reference),
-                            (GCompareFunc)cmp_sms_by_concat_reference);
-    if (l)
+    number = mm_sms_part_get_number (part);
+    index = mm_sms_part_get_index (part);
+
+    sms = mm_sms_part_index_lookup_multipart (self->priv->index, concat_reference, number);
+    if (sms) {
         /* Try to take the part */
-        return mm_sms_multipart_take_part (MM_SMS (l->data), part, error);
+        if (!mm_sms_multipart_take_part (sms, part, error))
+            return FALSE;
+
+        if (storage != MM_SMS_STORAGE_UNKNOWN && index != SMS_PART_INVALID_INDEX)
+            mm_sms_part_index_add_stored (self->priv->index, storage, index, sms);
+
+        /* Once complete, the reference may be reused by a new message */
+        if (mm_sms_multipart_is_complete (sms))
+            mm_sms_part_index_remove_multipart (self->priv->index, concat_reference, number);
+        return TRUE;
+    }
 
     /* Create new Multipart */
     sms = mm_sms_multipart_new (self->priv->modem,
@@ -308,6 +346,9 @@ take_multipart (MMSmsList *self,
         return FALSE;
 
     self->priv->list = g_list_prepend (self->priv->list, sms);
+    index_stored_parts (self, sms);
+    if (!mm_sms_multipart_is_complete (sms))
+        mm_sms_part_index_add_multipart (self->priv->index, concat_reference, number, sms);
     g_signal_emit (self, signals[SIGNAL_ADDED], 0,
                    mm_sms_get_path (sms),
                    (state == MM_SMS_STATE_RECEIVED ||
@@ -321,18 +362,11 @@ mm_sms_list_has_part (MMSmsList *self,
                       MMSmsStorage storage,
                       guint index)
 {
-    PartIndexAndStorage ctx;
-
     if (storage == MM_SMS_STORAGE_UNKNOWN ||
         index == SMS_PART_INVALID_INDEX)
         return FALSE;
 
-    ctx.part_index = index;
-    ctx.storage = storage;
-
-    return !!g_list_find_custom (self->priv->list,
-                                 &ctx,
-                                 (GCompareFunc)cmp_sms_by_part_index_and_storage);
+    return !!mm_sms_part_index_lookup_stored (self->priv->index, storage, index);
 }
 
 gboolean
@@ -342,11 +376,6 @@ mm_sms_list_take_part (MMSmsList *self,
                        MMSmsStorage storage,
                        GError **error)
 {
-    PartIndexAndStorage ctx;
-
-    ctx.part_index = mm_sms_part_get_index (part);
-    ctx.storage = storage;
-
     /* Ensure we don't have already taken a part with the same index */
     if (mm_sms_list_has_part (self,
                               storage,
@@ -440,19 +469,34 @@ mm_sms_list_init (MMSmsList *self)
     self->priv = G_TYPE_INSTANCE_GET_PRIVATE ((self),
                                               MM_TYPE_SMS_LIST,
                                               MMSmsListPrivate);
+    self->priv->index = mm_sms_part_index_new ();
 }
 
 static void
 dispose (GObject *object)
 {
     MMSmsList *self = MM_SMS_LIST (object);
+    GList *l;
 
     g_clear_object (&self->priv->modem);
+    for (l = self->priv->list; l; l = g_list_next (l))
+        remove_from_index (self, MM_SMS (l->data));
     g_list_free_full (self->priv->list, (GDestroyNotify)g_object_unref);
+    self->priv->list = NULL;
 
     G_OBJECT_CLASS (mm_sms_list_parent_class)->dispose (object);
 }
 
+static void
+finalize (GObject *object)
+{
+    MMSmsList *self = MM_SMS_LIST (object);
+
+    mm_sms_part_index_free (self->priv->index);
+
+    G_OBJECT_CLASS (mm_sms_list_parent_class)->finalize (object);
+}
+
 static void
 mm_sms_list_class_init (MMSmsListClass *klass)
 {
@@ -464,6 +508,7 @@ mm_sms_list_class_init (MMSmsListClass *klass)
     object_class->get_property = get_property;
     object_class->set_property = set_property;
     object_class->dispose = dispose;
+    object_class->finalize = finalize;
 
     /* Properties */
     properties[PROP_MODEM] =
@@ -0,0 +1,215 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#include "mm-sms-part-index.h"
+
+struct _MMSmsPartIndex {
+    /* Storage and index (as gint64) to owner */
+    GHashTable *stored;
+    /* Reference and number (as string) to owner */
+    GHashTable *multipart;
+    /* Owner to OwnerKeys, to be able to remove all its entries */
+    GHashTable *by_owner;
+};
+
+typedef struct {
+    /* gint64 keys in the stored table */
+    GArray *stored;
+    /* String keys in the multipart table */
+    GPtrArray *multipart;
+} OwnerKeys;
+
+#define STORED_KEY(storage, index) \
+    ((((gint64) (storage)) << 32) | (gint64) (index))
+
+static void
+owner_keys_free (OwnerKeys *keys)
+{
+    g_array_unref (keys->stored);
+    g_ptr_array_unref (keys->multipart);
+    g_slice_free (OwnerKeys, keys);
+}
+
+static OwnerKeys *
+get_owner_keys (MMSmsPartIndex *self,
+                gpointer owner)
+{
+    OwnerKeys *keys;
+
+    keys = g_hash_table_lookup (self->by_owner, owner);
+    if (!keys) {
+        keys = g_slice_new (OwnerKeys);
+        keys->stored = g_array_new (FALSE, FALSE, sizeof (gint64));
+        keys->multipart = g_ptr_array_new_with_free_func (g_free);
+        g_hash_table_insert (self->by_owner, owner, keys);
+    }
+
+    return keys;
+}
+
+static gchar *
+multipart_key (guint reference,
+               const gchar *number)
+{
+    return g_strdup_printf ("%u/%s", reference, number ? number : "");
+}
+
+MMSmsPartIndex *
+mm_sms_part_index_new (void)
+{
+    MMSmsPartIndex *self;
+
+    self = g_slice_new (MMSmsPartIndex);
+    self->stored = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, NULL);
+    self->multipart = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    self->by_owner = g_hash_table_new_full (g_direct_hash,
+                                            g_direct_equal,
+                                            NULL,
+                                            (GDestroyNotify)owner_keys_free);
+    return self;
+}
+
+void
+mm_sms_part_index_free (MMSmsPartIndex *self)
+{
+    g_hash_table_unref (self->stored);
+    g_hash_table_unref (self->multipart);
+    g_hash_table_unref (self->by_owner);
+    g_slice_free (MMSmsPartIndex, self);
+}
+
+/*****************************************************************************/
+
+void
+mm_sms_part_index_add_stored (MMSmsPartIndex *self,
+                              MMSmsStorage storage,
+                              guint index,
+                              gpointer owner)
+{
+    gint64 *key;
+
+    g_return_if_fail (owner != NULL);
+
+    key = g_new (gint64, 1);
+    *key = STORED_KEY (storage, index);
+    g_hash_table_insert (self->stored, key, owner);
+    g_array_append_val (get_owner_keys (self, owner)->stored, *key);
+}
+
+gpointer
+mm_sms_part_index_lookup_stored (MMSmsPartIndex *self,
+                                 MMSmsStorage storage,
+                                 guint index)
+{
+    gint64 key;
+
+    key = STORED_KEY (storage, index);
+    return g_hash_table_lookup (self->stored, &key);
+}
+
+guint
+mm_sms_part_index_get_n_stored (MMSmsPartIndex *self)
+{
+    return g_hash_table_size (self->stored);
+}
+
+/*****************************************************************************/
+
+void
+mm_sms_part_index_add_multipart (MMSmsPartIndex *self,
+                                 guint reference,
+                                 const gchar *number,
+                                 gpointer owner)
+{
+    gchar *key;
+
+    g_return_if_fail (owner != NULL);
+
+    key = multipart_key (reference, number);
+    g_ptr_array_add (get_owner_keys (self, owner)->multipart, g_strdup (key));
+    g_hash_table_insert (self->multipart, key, owner);
+}
+
+gpointer
+mm_sms_part_index_lookup_multipart (MMSmsPartIndex *self,
+                                    guint reference,
+                                    const gchar *number)
+{
+    gpointer owner;
+    gchar *key;
+
+    key = multipart_key (reference, number);
+    owner = g_hash_table_lookup (self->multipart, key);
+    g_free (key);
+
+    return owner;
+}
+
+void
+mm_sms_part_index_remove_multipart (MMSmsPartIndex *self,
+                                    guint reference,
+                                    const gchar *number)
+{
+    OwnerKeys *keys;
+    gpointer owner;
+    gchar *key;
+    guint i;
+
+    key = multipart_key (reference, number);
+    owner = g_hash_table_lookup (self->multipart, key);
+    if (owner) {
+        g_hash_table_remove (self->multipart, key);
+
+        keys = g_hash_table_lookup (self->by_owner, owner);
+        for (i = 0; keys && i < keys->multipart->len; i++) {
+            if (g_str_equal (g_ptr_array_index (keys->multipart, i), key)) {
+                g_ptr_array_remove_index_fast (keys->multipart, i);
+                break;
+            }
+        }
+    }
+    g_free (key);
+}
+
+/*****************************************************************************/
+
+void
+mm_sms_part_index_remove_owner (MMSmsPartIndex *self,
+                                gpointer owner)
+{
+    OwnerKeys *keys;
+    guint i;
+
+    keys = g_hash_table_lookup (self->by_owner, owner);
+    if (!keys)
+        return;
+
+    /* Entries may have been taken over by another owner since added */
+    for (i = 0; i < keys->stored->len; i++) {
+        gint64 *key = &g_array_index (keys->stored, gint64, i);
+
+        if (g_hash_table_lookup (self->stored, key) == owner)
+            g_hash_table_remove (self->stored, key);
+    }
+
+    for (i = 0; i < keys->multipart->len; i++) {
+        const gchar *key = g_ptr_array_index (keys->multipart, i);
+
+        if (g_hash_table_lookup (self->multipart, key) == owner)
+            g_hash_table_remove (self->multipart, key);
+    }
+
+    g_hash_table_remove (self->by_owner, owner);
+}
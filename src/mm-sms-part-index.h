@@ -0,0 +1,61 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#ifndef MM_SMS_PART_INDEX_H
+#define MM_SMS_PART_INDEX_H
+
+#include <glib.h>
+#include <ModemManager-enums.h>
+
+/* Index of the SMS parts known to a SMS list.
+ *
+ * Each entry points to the owner of the part (i.e. the SMS object), and is
+ * found either by the storage and index where the part is stored, or, for
+ * multipart messages still being assembled, by the concatenation reference
+ * and the number of the remote party.
+ */
+
+typedef struct _MMSmsPartIndex MMSmsPartIndex;
+
+MMSmsPartIndex *mm_sms_part_index_new  (void);
+void            mm_sms_part_index_free (MMSmsPartIndex *self);
+
+void     mm_sms_part_index_add_stored    (MMSmsPartIndex *self,
+                                          MMSmsStorage storage,
+                                          guint index,
+                                          gpointer owner);
+gpointer mm_sms_part_index_lookup_stored (MMSmsPartIndex *self,
+                                          MMSmsStorage storage,
+                                          guint index);
+
+/* @number may be NULL */
+void     mm_sms_part_index_add_multipart    (MMSmsPartIndex *self,
+                                             guint reference,
+                                             const gchar *number,
+                                             gpointer owner);
+gpointer mm_sms_part_index_lookup_multipart (MMSmsPartIndex *self,
+                                             guint reference,
+                                             const gchar *number);
+void     mm_sms_part_index_remove_multipart (MMSmsPartIndex *self,
+                                             guint reference,
+                                             const gchar *number);
+
+/* Removes all the entries pointing to the given owner */
+void     mm_sms_part_index_remove_owner (MMSmsPartIndex *self,
+                                         gpointer owner);
+
+guint    mm_sms_part_index_get_n_stored (MMSmsPartIndex *self);
+
+#endif /* MM_SMS_PART_INDEX_H */
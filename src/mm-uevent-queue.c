@@ -0,0 +1,159 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#include "mm-uevent-queue.h"
+
+typedef struct {
+    gchar *path;
+    /* NULL once cancelled */
+    GObject *device;
+    gboolean added;
+    guint position;
+} PendingUevent;
+
+struct _MMUeventQueue {
+    /* Events in the order they were queued */
+    GPtrArray *events;
+    /* Path to the last event queued for it */
+    GHashTable *last_events;
+    /* Position after the last remove queued; adds before it can't be merged
+     * with newer ones, as that would move them after the remove */
+    guint merge_start;
+    guint n_cancelled;
+};
+
+static void
+pending_uevent_free (PendingUevent *event)
+{
+    if (event->device)
+        g_object_unref (event->device);
+    g_free (event->path);
+    g_slice_free (PendingUevent, event);
+}
+
+static void
+append_event (MMUeventQueue *self,
+              const gchar *path,
+              GObject *device,
+              gboolean added)
+{
+    PendingUevent *event;
+
+    event = g_slice_new (PendingUevent);
+    event->path = g_strdup (path);
+    event->device = g_object_ref (device);
+    event->added = added;
+    event->position = self->events->len;
+    g_ptr_array_add (self->events, event);
+    g_hash_table_replace (self->last_events, event->path, event);
+}
+
+void
+mm_uevent_queue_add (MMUeventQueue *self,
+                     const gchar *path,
+                     GObject *device)
+{
+    PendingUevent *last;
+
+    g_return_if_fail (path != NULL);
+
+    /* Keep just the last one, with the most up to date properties, as long
+     * as that doesn't reorder it with a remove */
+    last = g_hash_table_lookup (self->last_events, path);
+    if (last && last->added && last->device && last->position >= self->merge_start) {
+        g_object_unref (last->device);
+        last->device = g_object_ref (device);
+        return;
+    }
+
+    append_event (self, path, device, TRUE);
+}
+
+void
+mm_uevent_queue_remove (MMUeventQueue *self,
+                        const gchar *path,
+                        GObject *device)
+{
+    PendingUevent *last;
+
+    g_return_if_fail (path != NULL);
+
+    /* A device added and removed within the same batch is never looked at.
+     * The remove is still needed in case it was known from before. */
+    last = g_hash_table_lookup (self->last_events, path);
+    if (last && last->added && last->device) {
+        g_clear_object (&last->device);
+        self->n_cancelled++;
+    }
+
+    /* Already being removed */
+    if (last && !last->added && last->device)
+        return;
+
+    append_event (self, path, device, FALSE);
+    self->merge_start = self->events->len;
+}
+
+guint
+mm_uevent_queue_flush (MMUeventQueue *self,
+                       MMUeventQueueFn callback,
+                       gpointer user_data,
+                       guint *n_cancelled)
+{
+    GPtrArray *events;
+    guint n_processed = 0;
+    guint i;
+
+    /* Processing may end up queueing new events, so take the batch first */
+    events = self->events;
+    if (n_cancelled)
+        *n_cancelled = self->n_cancelled;
+    self->events = g_ptr_array_new_with_free_func ((GDestroyNotify)pending_uevent_free);
+    g_hash_table_remove_all (self->last_events);
+    self->merge_start = 0;
+    self->n_cancelled = 0;
+
+    for (i = 0; i < events->len; i++) {
+        PendingUevent *event = g_ptr_array_index (events, i);
+
+        if (!event->device)
+            continue;
+
+        callback (event->device, event->added, user_data);
+        n_processed++;
+    }
+
+    g_ptr_array_unref (events);
+    return n_processed;
+}
+
+MMUeventQueue *
+mm_uevent_queue_new (void)
+{
+    MMUeventQueue *self;
+
+    self = g_slice_new0 (MMUeventQueue);
+    self->events = g_ptr_array_new_with_free_func ((GDestroyNotify)pending_uevent_free);
+    self->last_events = g_hash_table_new (g_str_hash, g_str_equal);
+    return self;
+}
+
+void
+mm_uevent_queue_free (MMUeventQueue *self)
+{
+    g_hash_table_destroy (self->last_events);
+    g_ptr_array_unref (self->events);
+    g_slice_free (MMUeventQueue, self);
+}
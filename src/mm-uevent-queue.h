@@ -0,0 +1,57 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#ifndef MM_UEVENT_QUEUE_H
+#define MM_UEVENT_QUEUE_H
+
+#include <glib.h>
+#include <glib-object.h>
+
+/* Queue of udev events waiting to be processed in a batch.
+ *
+ * Events are processed in the order they were queued, merging only those
+ * which don't change the outcome: several adds for the same device become
+ * the last one, unless a remove was queued in between, an add followed by a
+ * remove of the same device is dropped, and so are repeated removes.
+ */
+
+typedef struct _MMUeventQueue MMUeventQueue;
+
+MMUeventQueue *mm_uevent_queue_new  (void);
+void           mm_uevent_queue_free (MMUeventQueue *self);
+
+void mm_uevent_queue_add    (MMUeventQueue *self,
+                             const gchar *path,
+                             GObject *device);
+
+/* Removes are always queued, as whether the device is known can only be
+ * told once the adds queued before them are processed */
+void mm_uevent_queue_remove (MMUeventQueue *self,
+                             const gchar *path,
+                             GObject *device);
+
+typedef void (*MMUeventQueueFn) (GObject *device,
+                                 gboolean added,
+                                 gpointer user_data);
+
+/* Empties the queue, calling @callback for each event. Events queued from
+ * the callback are kept for the next flush. Returns the number of events
+ * processed, and the number of add/remove pairs cancelled. */
+guint mm_uevent_queue_flush (MMUeventQueue *self,
+                             MMUeventQueueFn callback,
+                             gpointer user_data,
+                             guint *n_cancelled);
+
+#endif /* MM_UEVENT_QUEUE_H */
@@ -0,0 +1,416 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+/*
+ * Replays the traffic of one port from a serial trace (see mm-serial-trace.h)
+ * through a pty: the data the port received is written on the master side,
+ * and the data the port sent is queued again as commands in a MMAtSerialPort
+ * (or MMQcdmSerialPort) using the slave side. This way the port goes through
+ * the same parsing it did when the trace was taken, which helps reproducing
+ * field failures and benchmarking the parsers with real traffic.
+ */
+
+#include <config.h>
+#include <glib.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <pty.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#include <ModemManager.h>
+#include <mm-errors-types.h>
+
+#include "mm-at-serial-port.h"
+#include "mm-qcdm-serial-port.h"
+#include "mm-serial-parsers.h"
+#include "mm-serial-trace.h"
+#include "mm-log.h"
+
+/* Time to wait for the replies to the last commands */
+#define REPLAY_TAIL_TIMEOUT_SECS 5
+
+static gboolean qcdm;
+static gboolean realtime;
+static gboolean verbose;
+static gchar *port_name;
+static gchar **trace_files;
+
+static GOptionEntry entries[] = {
+    { "qcdm", 'q', 0, G_OPTION_ARG_NONE, &qcdm, "Replay through a QCDM port instead of an AT port", NULL },
+    { "port", 'p', 0, G_OPTION_ARG_STRING, &port_name, "Name of the port to replay (default: the first one with data)", "NAME" },
+    { "realtime", 'r', 0, G_OPTION_ARG_NONE, &realtime, "Keep the original timing between records", NULL },
+    { "verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose, "Print replies and port logs", NULL },
+    { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &trace_files, NULL, "TRACE" },
+    { NULL }
+};
+
+typedef struct {
+    guint64 timestamp;
+    MMSerialTraceRecordType type;
+    GByteArray *data;
+} ReplayRecord;
+
+typedef struct {
+    GMainLoop *loop;
+    MMSerialPort *port;
+    int master;
+    guint master_watch_id;
+    guint step_id;
+
+    guint16 port_id;
+    GArray *records;
+    guint next;
+    gboolean finished;
+
+    /* Bytes of the last command not yet seen on the master side */
+    gsize pending_tx;
+
+    guint n_commands;
+    guint n_replies;
+    guint n_errors;
+    gsize rx_bytes;
+    GTimer *timer;
+} Replay;
+
+static void
+collect_record (guint64 timestamp,
+                guint16 port,
+                MMSerialTraceRecordType type,
+                const guint8 *data,
+                gsize len,
+                Replay *r)
+{
+    ReplayRecord record;
+
+    if (type == MM_SERIAL_TRACE_RECORD_PORT) {
+        if (port_name && !r->port_id && len == strlen (port_name) && memcmp (data, port_name, len) == 0)
+            r->port_id = port;
+        return;
+    }
+
+    /* No port given, replay the first one with data */
+    if (!port_name && !r->port_id)
+        r->port_id = port;
+
+    if (port != r->port_id)
+        return;
+
+    record.timestamp = timestamp;
+    record.type = type;
+    record.data = g_byte_array_sized_new (len);
+    g_byte_array_append (record.data, data, len);
+    g_array_append_val (r->records, record);
+}
+
+/*****************************************************************************/
+
+static void
+check_done (Replay *r)
+{
+    if (r->finished && r->n_replies == r->n_commands)
+        g_main_loop_quit (r->loop);
+}
+
+static void
+at_reply_ready (MMAtSerialPort *port,
+                const gchar *response,
+                gsize response_len,
+                GError *error,
+                Replay *r)
+{
+    r->n_replies++;
+    if (error) {
+        r->n_errors++;
+        if (verbose)
+            g_print ("error: %s\n", error->message);
+    } else if (verbose)
+        g_print ("reply: '%s'\n", response);
+
+    check_done (r);
+}
+
+static void
+qcdm_reply_ready (MMQcdmSerialPort *port,
+                  GByteArray *response,
+                  GError *error,
+                  Replay *r)
+{
+    r->n_replies++;
+    if (error) {
+        r->n_errors++;
+        if (verbose)
+            g_print ("error: %s\n", error->message);
+    } else if (verbose)
+        g_print ("reply: %u bytes\n", response->len);
+
+    check_done (r);
+}
+
+static void
+queue_command (Replay *r,
+               ReplayRecord *record)
+{
+    r->n_commands++;
+
+    if (qcdm) {
+        GByteArray *command;
+
+        command = g_byte_array_sized_new (record->data->len);
+        g_byte_array_append (command, record->data->data, record->data->len);
+        mm_qcdm_serial_port_queue_command (MM_QCDM_SERIAL_PORT (r->port),
+                                           command,
+                                           3,
+                                           NULL,
+                                           (MMQcdmSerialResponseFn) qcdm_reply_ready,
+                                           r);
+    } else {
+        gchar *command;
+
+        command = g_strndup ((const gchar *) record->data->data, record->data->len);
+        mm_at_serial_port_queue_command (MM_AT_SERIAL_PORT (r->port),
+                                         command,
+                                         3,
+                                         TRUE, /* raw, it is already complete */
+                                         NULL,
+                                         (MMAtSerialResponseFn) at_reply_ready,
+                                         r);
+        g_free (command);
+    }
+}
+
+static gboolean replay_step (Replay *r);
+
+static gboolean
+replay_timeout (Replay *r)
+{
+    g_printerr ("Timed out waiting for %u replies\n", r->n_commands - r->n_replies);
+    g_main_loop_quit (r->loop);
+    return FALSE;
+}
+
+/* Go on with the record after the given one */
+static void
+replay_continue (Replay *r,
+                 ReplayRecord *record)
+{
+    guint delay_ms = 0;
+
+    if (realtime && r->next < r->records->len) {
+        ReplayRecord *next = &g_array_index (r->records, ReplayRecord, r->next);
+
+        if (next->timestamp > record->timestamp)
+            delay_ms = (next->timestamp - record->timestamp) / 1000;
+    }
+
+    if (delay_ms)
+        r->step_id = g_timeout_add (delay_ms, (GSourceFunc) replay_step, r);
+    else
+        r->step_id = g_idle_add ((GSourceFunc) replay_step, r);
+}
+
+static gboolean
+replay_step (Replay *r)
+{
+    ReplayRecord *record;
+
+    r->step_id = 0;
+
+    if (r->next == r->records->len) {
+        r->finished = TRUE;
+        r->step_id = g_timeout_add_seconds (REPLAY_TAIL_TIMEOUT_SECS, (GSourceFunc) replay_timeout, r);
+        check_done (r);
+        return FALSE;
+    }
+
+    record = &g_array_index (r->records, ReplayRecord, r->next++);
+
+    if (record->type == MM_SERIAL_TRACE_RECORD_TX) {
+        /* Go on once the port has actually sent it */
+        r->pending_tx = record->data->len;
+        queue_command (r, record);
+        return FALSE;
+    }
+
+    if (record->type == MM_SERIAL_TRACE_RECORD_RX) {
+        gsize written = 0;
+
+        while (written < record->data->len) {
+            ssize_t status;
+
+            status = write (r->master, record->data->data + written, record->data->len - written);
+            if (status < 0 && errno != EAGAIN && errno != EINTR) {
+                g_printerr ("Couldn't write to pty: %s\n", strerror (errno));
+                g_main_loop_quit (r->loop);
+                return FALSE;
+            }
+            if (status > 0)
+                written += status;
+        }
+        r->rx_bytes += written;
+    }
+
+    replay_continue (r, record);
+    return FALSE;
+}
+
+static gboolean
+master_ready (GIOChannel *channel,
+              GIOCondition condition,
+              Replay *r)
+{
+    guint8 buf[4096];
+    ssize_t status;
+
+    status = read (r->master, buf, sizeof (buf));
+    if (status <= 0)
+        return TRUE;
+
+    if (verbose)
+        g_print ("sent: %d bytes\n", (int) status);
+
+    if (r->pending_tx) {
+        r->pending_tx -= MIN (r->pending_tx, (gsize) status);
+        if (!r->pending_tx)
+            replay_continue (r, &g_array_index (r->records, ReplayRecord, r->next - 1));
+    }
+
+    return TRUE;
+}
+
+/*****************************************************************************/
+
+void
+_mm_log (const char *loc,
+         const char *func,
+         guint32 level,
+         const char *fmt,
+         ...)
+{
+    va_list args;
+
+    if (!verbose)
+        return;
+
+    va_start (args, fmt);
+    vfprintf (stderr, fmt, args);
+    va_end (args);
+    g_printerr ("\n");
+}
+
+int main (int argc, char **argv)
+{
+    GOptionContext *context;
+    GError *error = NULL;
+    gchar *contents;
+    gsize contents_len;
+    GIOChannel *channel;
+    Replay r;
+    int slave;
+    guint i;
+
+    g_type_init ();
+
+    context = g_option_context_new ("- replay serial port traffic from a trace");
+    g_option_context_add_main_entries (context, entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        g_printerr ("%s\n", error->message);
+        exit (1);
+    }
+    g_option_context_free (context);
+
+    if (!trace_files || !trace_files[0] || trace_files[1]) {
+        g_printerr ("A single trace file is expected\n");
+        exit (1);
+    }
+
+    if (!g_file_get_contents (trace_files[0], &contents, &contents_len, &error)) {
+        g_printerr ("Couldn't read trace: %s\n", error->message);
+        exit (1);
+    }
+
+    memset (&r, 0, sizeof (r));
+    r.records = g_array_new (FALSE, FALSE, sizeof (ReplayRecord));
+    if (!mm_serial_trace_parse ((const guint8 *) contents, contents_len,
+                                (MMSerialTraceRecordFn) collect_record, &r,
+                                &error)) {
+        g_printerr ("Couldn't parse trace: %s\n", error->message);
+        exit (1);
+    }
+    g_free (contents);
+
+    if (!r.records->len) {
+        g_printerr ("No records to replay\n");
+        exit (1);
+    }
+
+    if (openpty (&r.master, &slave, NULL, NULL, NULL) < 0) {
+        g_printerr ("Couldn't open pty: %s\n", strerror (errno));
+        exit (1);
+    }
+    fcntl (r.master, F_SETFL, O_NONBLOCK);
+
+    if (qcdm)
+        r.port = MM_SERIAL_PORT (mm_qcdm_serial_port_new_fd (slave));
+    else {
+        r.port = g_object_new (MM_TYPE_AT_SERIAL_PORT,
+                               MM_PORT_DEVICE, "replay",
+                               MM_PORT_SUBSYS, MM_PORT_SUBSYS_TTY,
+                               MM_PORT_TYPE, MM_PORT_TYPE_AT,
+                               MM_SERIAL_PORT_FD, slave,
+                               NULL);
+        mm_at_serial_port_set_response_parser (MM_AT_SERIAL_PORT (r.port),
+                                               mm_serial_parser_v1_parse,
+                                               mm_serial_parser_v1_new (),
+                                               mm_serial_parser_v1_destroy);
+    }
+
+    if (!mm_serial_port_open (r.port, &error)) {
+        g_printerr ("Couldn't open port: %s\n", error->message);
+        exit (1);
+    }
+
+    r.loop = g_main_loop_new (NULL, FALSE);
+    channel = g_io_channel_unix_new (r.master);
+    r.master_watch_id = g_io_add_watch (channel, G_IO_IN, (GIOFunc) master_ready, &r);
+    g_io_channel_unref (channel);
+
+    r.timer = g_timer_new ();
+    r.step_id = g_idle_add ((GSourceFunc) replay_step, &r);
+    g_main_loop_run (r.loop);
+    g_timer_stop (r.timer);
+
+    g_print ("Replayed %u records: %u commands, %u replies (%u errors), %" G_GSIZE_FORMAT " bytes received\n",
+             r.records->len, r.n_commands, r.n_replies, r.n_errors, r.rx_bytes);
+    g_print ("Elapsed: %.3f ms\n", g_timer_elapsed (r.timer, NULL) * 1000.0);
+
+    if (r.step_id)
+        g_source_remove (r.step_id);
+    g_source_remove (r.master_watch_id);
+    mm_serial_port_close (r.port);
+    g_object_unref (r.port);
+    close (r.master);
+
+    for (i = 0; i < r.records->len; i++)
+        g_byte_array_unref (g_array_index (r.records, ReplayRecord, i).data);
+    g_array_free (r.records, TRUE);
+    g_timer_destroy (r.timer);
+    g_main_loop_unref (r.loop);
+
+    return (r.n_replies == r.n_commands) ? 0 : 1;
+}
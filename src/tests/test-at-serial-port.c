@@ -15,9 +15,16 @@
 
 #include <config.h>
 #include <string.h>
+#include <errno.h>
+#include <pty.h>
+#include <unistd.h>
+#include <termios.h>
+#include <fcntl.h>
 #include <glib.h>
 
 #include "mm-at-serial-port.h"
+#include "mm-serial-parsers.h"
+#include "mm-error-helpers.h"
 #include "mm-log.h"
 
 typedef struct {
@@ -47,23 +54,701 @@ at_serial_echo_removal (void)
     guint i;
 
     for (i = 0; i < G_N_ELEMENTS (echo_removal_tests); i++) {
-        GByteArray *ba;
+        MMSerialBuffer *buffer;
 
-        /* Note that we add last NUL also to the byte array, so that we can compare
-         * C strings later on */
-        ba = g_byte_array_sized_new (strlen (echo_removal_tests[i].original) + 1);
-        g_byte_array_prepend (ba,
-                              (guint8 *)echo_removal_tests[i].original,
-                              strlen (echo_removal_tests[i].original) + 1);
+        buffer = mm_serial_buffer_new (strlen (echo_removal_tests[i].original) + 1);
+        mm_serial_buffer_append (buffer,
+                                 (guint8 *)echo_removal_tests[i].original,
+                                 strlen (echo_removal_tests[i].original));
 
-        mm_at_serial_port_remove_echo (ba);
+        mm_at_serial_port_remove_echo (buffer);
 
-        g_assert_cmpstr ((gchar *)ba->data, ==, echo_removal_tests[i].without_echo);
+        /* The buffer view is always NUL-terminated, so we can compare C strings */
+        g_assert_cmpstr ((gchar *)mm_serial_buffer_peek (buffer, NULL), ==, echo_removal_tests[i].without_echo);
 
-        g_byte_array_unref (ba);
+        mm_serial_buffer_free (buffer);
     }
 }
 
+typedef struct {
+    const gchar *pattern;
+    GRegexCompileFlags flags;
+    const gchar *prefix;
+} UnsolicitedPrefixTest;
+
+static const UnsolicitedPrefixTest unsolicited_prefix_tests[] = {
+    { "\\r\\n\\+CREG:(.*)\\r\\n", 0, "+CREG:" },
+    { "\\r\\n\\^RSSI:(\\d+)\\r\\n", 0, "^RSSI:" },
+    { "\\r\\n%IPDPACT:\\s*(\\d+),\\s*(\\d+)\\r\\n", 0, "%IPDPACT:" },
+    { "\\r\\n\\+CIEV: (.*),(\\d)\\r\\n", 0, "+CIEV: " },
+    { "\\r\\n\\+PACSP(\\d)\\r\\n", 0, "+PACSP" },
+    { "\\r\\n\\+ZEND\\r\\n", 0, "+ZEND" },
+    { "\\r\\n_OSIGQ:\\s*(\\d+),(\\d)\\r\\n", 0, "_OSIGQ:" },
+    /* Quantified characters are not part of the prefix */
+    { "\\r\\n\\+CRING?:(.*)\\r\\n", 0, "+CRIN" },
+    { "\\r\\n\\+CMTI+:(.*)\\r\\n", 0, "+CMTI" },
+    /* Not indexable */
+    { "\\r\\n\\+CREG:(.*)\\r\\n", G_REGEX_CASELESS, NULL },
+    { "\\+CMTI: (.*)\\r\\n", 0, NULL },
+    { "\\r\\n(\\+CGREG|\\+CREG):(.*)\\r\\n", 0, NULL },
+    { "\\r\\n\\+CREG:|\\r\\n\\+CGREG:", 0, NULL },
+    { "\\r\\n\\+C(.*)\\r\\n", 0, NULL },
+    { "\\r\\n\\s*\\+CREG:(.*)\\r\\n", 0, NULL },
+};
+
+static void
+at_serial_unsolicited_prefix (void)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (unsolicited_prefix_tests); i++) {
+        GRegex *regex;
+        gchar *prefix;
+
+        regex = g_regex_new (unsolicited_prefix_tests[i].pattern,
+                             unsolicited_prefix_tests[i].flags,
+                             0, NULL);
+        g_assert (regex != NULL);
+
+        prefix = mm_at_serial_port_get_unsolicited_msg_prefix (regex);
+        g_assert_cmpstr (prefix, ==, unsolicited_prefix_tests[i].prefix);
+
+        g_free (prefix);
+        g_regex_unref (regex);
+    }
+}
+
+typedef struct {
+    const gchar *response;
+    gboolean found;
+    GQuark (*domain) (void);
+    gint code;
+} FinalResultTest;
+
+static const FinalResultTest final_result_tests[] = {
+    { "\r\nBUSY\r\n", TRUE, mm_connection_error_quark, MM_CONNECTION_ERROR_BUSY },
+    { "\r\nNO ANSWER\r\n", TRUE, mm_connection_error_quark, MM_CONNECTION_ERROR_NO_ANSWER },
+    /* Connection failures are only looked for at the start of a line, so
+     * text that happens to include them doesn't finish the response */
+    { "\r\n+CMGR: 0,,24\r\nLine BUSY, NO ANSWER either\r\n", FALSE, NULL, 0 },
+    { "\r\n+CMGR: 0,,24\r\nLine BUSY, NO ANSWER either\r\n\r\nOK\r\n", TRUE, NULL, 0 },
+    /* Errors without a value are still final, with an unknown error */
+    { "\r\n+CME ERROR: 10\r\n", TRUE, mm_mobile_equipment_error_quark, MM_MOBILE_EQUIPMENT_ERROR_SIM_NOT_INSERTED },
+    { "\r\n+CME ERROR:\r\n", TRUE, mm_mobile_equipment_error_quark, MM_MOBILE_EQUIPMENT_ERROR_UNKNOWN },
+    { "\r\n+CMS ERROR:\r\n", TRUE, mm_message_error_quark, MM_MESSAGE_ERROR_UNKNOWN },
+};
+
+static void
+at_serial_final_result (void)
+{
+    gpointer parser;
+    guint i;
+
+    parser = mm_serial_parser_v1_new ();
+
+    for (i = 0; i < G_N_ELEMENTS (final_result_tests); i++) {
+        const FinalResultTest *test = &final_result_tests[i];
+        GError *error = NULL;
+        gsize reply_start = 0;
+        gsize reply_len = 0;
+        gboolean found;
+
+        found = mm_serial_parser_v1_parse (parser,
+                                           test->response,
+                                           strlen (test->response),
+                                           &reply_start,
+                                           &reply_len,
+                                           &error);
+        g_assert_cmpint (found, ==, test->found);
+        if (test->domain)
+            g_assert_error (error, test->domain (), test->code);
+        else
+            g_assert_no_error (error);
+        g_clear_error (&error);
+    }
+
+    mm_serial_parser_v1_destroy (parser);
+}
+
+/*****************************************************************************/
+/* Fake modem at the master side of a pty, replying to each command with the
+ * matching canned reply, or with OK */
+
+typedef struct {
+    const gchar *command;
+    const gchar *reply;
+} FakeModemReply;
+
+typedef struct {
+    int master;
+    GMainLoop *loop;
+    guint modem_watch;
+    GString *modem_rx;
+    const FakeModemReply *replies;
+    /* Commands received by the modem, in order */
+    GPtrArray *received;
+    MMAtSerialPort *port;
+    /* Callbacks still to be called */
+    guint n_pending;
+} PortTest;
+
+typedef struct {
+    PortTest *t;
+    guint n_calls;
+    gchar *response;
+    GError *error;
+} CommandResult;
+
+static void
+fake_modem_write (PortTest *t, const gchar *data)
+{
+    gsize len = strlen (data);
+    gsize written = 0;
+
+    while (written < len) {
+        gssize n;
+
+        n = write (t->master, data + written, len - written);
+        if (n < 0) {
+            g_assert (errno == EAGAIN);
+            g_usleep (1000);
+            continue;
+        }
+        written += n;
+    }
+}
+
+static gboolean
+fake_modem_data_available (GIOChannel *source,
+                           GIOCondition condition,
+                           PortTest *t)
+{
+    gchar buf[256];
+    gssize n;
+    gchar *eol;
+
+    while ((n = read (t->master, buf, sizeof (buf))) > 0)
+        g_string_append_len (t->modem_rx, buf, n);
+
+    while ((eol = memchr (t->modem_rx->str, '\r', t->modem_rx->len)) != NULL) {
+        const gchar *reply = "\r\nOK\r\n";
+        gchar *command;
+        guint i;
+
+        command = g_strndup (t->modem_rx->str, eol - t->modem_rx->str);
+        g_string_erase (t->modem_rx, 0, eol - t->modem_rx->str + 1);
+
+        for (i = 0; t->replies && t->replies[i].command; i++) {
+            if (strcmp (t->replies[i].command, command) == 0) {
+                reply = t->replies[i].reply;
+                break;
+            }
+        }
+
+        g_ptr_array_add (t->received, command);
+        fake_modem_write (t, reply);
+    }
+
+    return TRUE;
+}
+
+static guint
+fake_modem_count (PortTest *t,
+                  const gchar *command)
+{
+    guint i;
+    guint n = 0;
+
+    for (i = 0; i < t->received->len; i++) {
+        if (strcmp (g_ptr_array_index (t->received, i), command) == 0)
+            n++;
+    }
+    return n;
+}
+
+static void
+port_test_setup (PortTest *t,
+                 gconstpointer replies)
+{
+    struct termios stbuf;
+    GIOChannel *channel;
+    GError *error = NULL;
+    int slave;
+
+    g_assert_cmpint (openpty (&t->master, &slave, NULL, NULL, NULL), ==, 0);
+
+    memset (&stbuf, 0, sizeof (stbuf));
+    tcgetattr (slave, &stbuf);
+    cfmakeraw (&stbuf);
+    tcsetattr (slave, TCSANOW, &stbuf);
+    fcntl (t->master, F_SETFL, O_NONBLOCK);
+
+    t->loop = g_main_loop_new (NULL, FALSE);
+    t->modem_rx = g_string_new (NULL);
+    t->received = g_ptr_array_new_with_free_func (g_free);
+    t->replies = replies;
+    t->n_pending = 0;
+
+    channel = g_io_channel_unix_new (t->master);
+    t->modem_watch = g_io_add_watch (channel, G_IO_IN, (GIOFunc) fake_modem_data_available, t);
+    g_io_channel_unref (channel);
+
+    /* The port takes ownership of the slave fd */
+    t->port = MM_AT_SERIAL_PORT (g_object_new (MM_TYPE_AT_SERIAL_PORT,
+                                               MM_PORT_DEVICE, "pty",
+                                               MM_PORT_SUBSYS, MM_PORT_SUBSYS_TTY,
+                                               MM_PORT_TYPE, MM_PORT_TYPE_AT,
+                                               MM_SERIAL_PORT_FD, slave,
+                                               MM_SERIAL_PORT_SEND_DELAY, (guint64) 0,
+                                               NULL));
+    mm_at_serial_port_set_response_parser (t->port,
+                                           mm_serial_parser_v1_parse,
+                                           mm_serial_parser_v1_new (),
+                                           mm_serial_parser_v1_destroy);
+
+    g_assert (mm_serial_port_open (MM_SERIAL_PORT (t->port), &error));
+    g_assert_no_error (error);
+}
+
+static void
+port_test_teardown (PortTest *t,
+                    gconstpointer replies)
+{
+    mm_serial_port_close (MM_SERIAL_PORT (t->port));
+    g_object_unref (t->port);
+
+    g_source_remove (t->modem_watch);
+    close (t->master);
+    g_ptr_array_unref (t->received);
+    g_string_free (t->modem_rx, TRUE);
+    g_main_loop_unref (t->loop);
+}
+
+static void
+command_ready (MMAtSerialPort *port,
+               const gchar *response,
+               gsize response_len,
+               GError *error,
+               CommandResult *result)
+{
+    /* Every callback must be called exactly once */
+    g_assert_cmpuint (result->n_calls, ==, 0);
+    result->n_calls++;
+
+    result->response = response ? g_strndup (response, response_len) : NULL;
+    if (error)
+        result->error = g_error_copy (error);
+
+    g_assert_cmpuint (result->t->n_pending, >, 0);
+    if (--result->t->n_pending == 0)
+        g_main_loop_quit (result->t->loop);
+}
+
+static void
+command_result_init (CommandResult *result,
+                     PortTest *t)
+{
+    memset (result, 0, sizeof (*result));
+    result->t = t;
+    t->n_pending++;
+}
+
+static void
+command_result_clear (CommandResult *result)
+{
+    g_free (result->response);
+    g_clear_error (&result->error);
+}
+
+static void
+port_test_queue (PortTest *t,
+                 const gchar *command,
+                 CommandResult *result)
+{
+    command_result_init (result, t);
+    mm_at_serial_port_queue_command (t->port,
+                                     command,
+                                     3,
+                                     FALSE,
+                                     NULL,
+                                     (MMAtSerialResponseFn) command_ready,
+                                     result);
+}
+
+static void
+port_test_wait (PortTest *t)
+{
+    if (t->n_pending)
+        g_main_loop_run (t->loop);
+}
+
+/* Runs a single command and checks its reply */
+static void
+port_test_run (PortTest *t,
+               const gchar *command,
+               const gchar *expected_response)
+{
+    CommandResult result;
+
+    port_test_queue (t, command, &result);
+    port_test_wait (t);
+
+    g_assert_no_error (result.error);
+    g_assert_cmpstr (result.response, ==, expected_response);
+    command_result_clear (&result);
+}
+
+/*****************************************************************************/
+/* Reply cache */
+
+static const FakeModemReply cache_replies[] = {
+    { "AT+CSQ",   "\r\n+CSQ: 20,99\r\n\r\nOK\r\n" },
+    { "AT+CREG?", "\r\n+CREG: 0,1\r\n\r\nOK\r\n" },
+    { "AT+CGSN",  "\r\n0123456789\r\n\r\nOK\r\n" },
+    { NULL }
+};
+
+static void
+at_serial_cache_hit (PortTest *t,
+                     gconstpointer replies)
+{
+    /* Background polls are served from the cache while the reply is valid */
+    port_test_run (t, "AT+CSQ", "+CSQ: 20,99");
+    port_test_run (t, "AT+CSQ", "+CSQ: 20,99");
+    port_test_run (t, "AT+CSQ", "+CSQ: 20,99");
+    g_assert_cmpuint (fake_modem_count (t, "AT+CSQ"), ==, 1);
+
+    /* Others are always sent */
+    port_test_run (t, "AT+CGSN", "0123456789");
+    port_test_run (t, "AT+CGSN", "0123456789");
+    g_assert_cmpuint (fake_modem_count (t, "AT+CGSN"), ==, 2);
+}
+
+static void
+at_serial_cache_expiry (PortTest *t,
+                        gconstpointer replies)
+{
+    CommandResult result;
+    GByteArray *command;
+
+    command = g_byte_array_new ();
+    g_byte_array_append (command, (const guint8 *) "AT+CGSN\r", 8);
+
+    /* Kept for 1s */
+    command_result_init (&result, t);
+    mm_serial_port_queue_command_full (MM_SERIAL_PORT (t->port), command, FALSE,
+                                       TRUE, 1, MM_SERIAL_COMMAND_PRIORITY_DEFAULT, FALSE,
+                                       3, NULL, (MMSerialResponseFn) command_ready, &result);
+    port_test_wait (t);
+    g_assert_no_error (result.error);
+    command_result_clear (&result);
+    g_assert_cmpuint (fake_modem_count (t, "AT+CGSN"), ==, 1);
+
+    command_result_init (&result, t);
+    mm_serial_port_queue_command_full (MM_SERIAL_PORT (t->port), command, FALSE,
+                                       TRUE, 1, MM_SERIAL_COMMAND_PRIORITY_DEFAULT, FALSE,
+                                       3, NULL, (MMSerialResponseFn) command_ready, &result);
+    port_test_wait (t);
+    g_assert_cmpstr (result.response, ==, "0123456789");
+    command_result_clear (&result);
+    g_assert_cmpuint (fake_modem_count (t, "AT+CGSN"), ==, 1);
+
+    /* And sent again once expired */
+    g_usleep (1100 * 1000);
+    command_result_init (&result, t);
+    mm_serial_port_queue_command_full (MM_SERIAL_PORT (t->port), command, FALSE,
+                                       TRUE, 1, MM_SERIAL_COMMAND_PRIORITY_DEFAULT, FALSE,
+                                       3, NULL, (MMSerialResponseFn) command_ready, &result);
+    port_test_wait (t);
+    g_assert_cmpstr (result.response, ==, "0123456789");
+    command_result_clear (&result);
+    g_assert_cmpuint (fake_modem_count (t, "AT+CGSN"), ==, 2);
+
+    g_byte_array_free (command, TRUE);
+}
+
+static void
+creg_unsolicited (MMAtSerialPort *port,
+                  GMatchInfo *match_info,
+                  PortTest *t)
+{
+    g_main_loop_quit (t->loop);
+}
+
+static void
+at_serial_cache_unsolicited (PortTest *t,
+                             gconstpointer replies)
+{
+    GRegex *regex;
+
+    regex = g_regex_new ("\\r\\n\\+CREG: (\\d)\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
+    mm_at_serial_port_add_unsolicited_msg_handler (t->port, regex, (MMAtSerialUnsolicitedMsgFn) creg_unsolicited, t, NULL);
+    g_regex_unref (regex);
+
+    port_test_run (t, "AT+CREG?", "+CREG: 0,1");
+    port_test_run (t, "AT+CREG?", "+CREG: 0,1");
+    g_assert_cmpuint (fake_modem_count (t, "AT+CREG?"), ==, 1);
+
+    /* A registration change makes the cached reply stale */
+    fake_modem_write (t, "\r\n+CREG: 5\r\n");
+    g_main_loop_run (t->loop);
+
+    port_test_run (t, "AT+CREG?", "+CREG: 0,1");
+    g_assert_cmpuint (fake_modem_count (t, "AT+CREG?"), ==, 2);
+}
+
+static void
+at_serial_cache_reset (PortTest *t,
+                       gconstpointer replies)
+{
+    port_test_run (t, "AT+CREG?", "+CREG: 0,1");
+    port_test_run (t, "AT+CSQ", "+CSQ: 20,99");
+    port_test_run (t, "AT+CREG?", "+CREG: 0,1");
+    port_test_run (t, "AT+CSQ", "+CSQ: 20,99");
+    g_assert_cmpuint (fake_modem_count (t, "AT+CREG?"), ==, 1);
+    g_assert_cmpuint (fake_modem_count (t, "AT+CSQ"), ==, 1);
+
+    /* Resetting the device drops every cached reply */
+    port_test_run (t, "ATZ", "");
+
+    port_test_run (t, "AT+CREG?", "+CREG: 0,1");
+    port_test_run (t, "AT+CSQ", "+CSQ: 20,99");
+    g_assert_cmpuint (fake_modem_count (t, "AT+CREG?"), ==, 2);
+    g_assert_cmpuint (fake_modem_count (t, "AT+CSQ"), ==, 2);
+}
+
+static void
+at_serial_cache_registration (PortTest *t,
+                              gconstpointer replies)
+{
+    port_test_run (t, "AT+CREG?", "+CREG: 0,1");
+
+    /* Changing the operator or the attachment changes the registration state,
+     * so the next query reaches the modem */
+    port_test_run (t, "AT+COPS=0", "");
+    port_test_run (t, "AT+CREG?", "+CREG: 0,1");
+    g_assert_cmpuint (fake_modem_count (t, "AT+CREG?"), ==, 2);
+
+    port_test_run (t, "AT+CGATT=1", "");
+    port_test_run (t, "AT+CREG?", "+CREG: 0,1");
+    g_assert_cmpuint (fake_modem_count (t, "AT+CREG?"), ==, 3);
+}
+
+static const FakeModemReply error_replies[] = {
+    { "AT+CSQ", "\r\nERROR\r\n" },
+    { NULL }
+};
+
+static void
+at_serial_cache_error (PortTest *t,
+                       gconstpointer replies)
+{
+    CommandResult result;
+    guint i;
+
+    /* Error replies are never cached */
+    for (i = 0; i < 2; i++) {
+        port_test_queue (t, "AT+CSQ", &result);
+        port_test_wait (t);
+        g_assert (result.error != NULL);
+        command_result_clear (&result);
+    }
+    g_assert_cmpuint (fake_modem_count (t, "AT+CSQ"), ==, 2);
+}
+
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* Command queue */
+
+static void
+at_serial_queue_priority (PortTest *t,
+                          gconstpointer replies)
+{
+    CommandResult results[6];
+    static const gchar *expected[] = {
+        "AT+CMGR=1", "AT+CUSD=1", "AT+CGMI", "AT+CGMM", "AT+CGMR", "AT+CSQ"
+    };
+    guint i;
+
+    /* Nothing is sent until the main loop runs, so all these are queued
+     * together: interactive ones go first, background ones last, and FIFO
+     * within the same priority */
+    port_test_queue (t, "AT+CGMI",   &results[0]);
+    port_test_queue (t, "AT+CSQ",    &results[1]);
+    port_test_queue (t, "AT+CGMM",   &results[2]);
+    port_test_queue (t, "AT+CMGR=1", &results[3]);
+    port_test_queue (t, "AT+CGMR",   &results[4]);
+    port_test_queue (t, "AT+CUSD=1", &results[5]);
+    port_test_wait (t);
+
+    g_assert_cmpuint (t->received->len, ==, G_N_ELEMENTS (expected));
+    for (i = 0; i < G_N_ELEMENTS (expected); i++)
+        g_assert_cmpstr (g_ptr_array_index (t->received, i), ==, expected[i]);
+
+    for (i = 0; i < G_N_ELEMENTS (results); i++) {
+        g_assert_cmpuint (results[i].n_calls, ==, 1);
+        g_assert_no_error (results[i].error);
+        command_result_clear (&results[i]);
+    }
+}
+
+static void
+at_serial_queue_started_not_displaced (PortTest *t,
+                                       gconstpointer replies)
+{
+    CommandResult first;
+    CommandResult urgent;
+
+    /* Wait until the first command is in flight before queueing one with
+     * higher priority */
+    port_test_queue (t, "AT+CSQ", &first);
+    while (t->received->len == 0)
+        g_main_context_iteration (NULL, TRUE);
+    port_test_queue (t, "AT+CMGR=1", &urgent);
+    port_test_wait (t);
+
+    g_assert_cmpuint (t->received->len, ==, 2);
+    g_assert_cmpstr (g_ptr_array_index (t->received, 0), ==, "AT+CSQ");
+    g_assert_cmpstr (g_ptr_array_index (t->received, 1), ==, "AT+CMGR=1");
+    g_assert_cmpstr (first.response, ==, "+CSQ: 20,99");
+    command_result_clear (&first);
+    command_result_clear (&urgent);
+}
+
+static const FakeModemReply sms_replies[] = {
+    { "AT+CMGS=20", "\r\n> " },
+    { NULL }
+};
+
+typedef struct {
+    CommandResult cmgs;
+    CommandResult pdu;
+} SmsSendTest;
+
+static void
+cmgs_ready (MMAtSerialPort *port,
+            const gchar *response,
+            gsize response_len,
+            GError *error,
+            SmsSendTest *sms)
+{
+    /* Send the PDU once the modem asks for it; the fake modem only handles
+     * complete lines, so end it with <CR> instead of Ctrl-Z */
+    command_result_init (&sms->pdu, sms->cmgs.t);
+    mm_at_serial_port_queue_command (port,
+                                     "0011000B915121551532F40000A7\r",
+                                     3,
+                                     TRUE,
+                                     NULL,
+                                     (MMAtSerialResponseFn) command_ready,
+                                     &sms->pdu);
+
+    command_ready (port, response, response_len, error, &sms->cmgs);
+}
+
+static void
+at_serial_queue_continuation (PortTest *t,
+                              gconstpointer replies)
+{
+    SmsSendTest sms;
+    CommandResult other;
+
+    /* An interactive command queued while waiting for the prompt must not
+     * be sent before the PDU */
+    command_result_init (&sms.cmgs, t);
+    mm_at_serial_port_queue_command (t->port,
+                                     "AT+CMGS=20",
+                                     3,
+                                     FALSE,
+                                     NULL,
+                                     (MMAtSerialResponseFn) cmgs_ready,
+                                     &sms);
+    port_test_queue (t, "AT+CLCK=\"SC\",2", &other);
+    port_test_wait (t);
+
+    g_assert_cmpuint (t->received->len, ==, 3);
+    g_assert_cmpstr (g_ptr_array_index (t->received, 0), ==, "AT+CMGS=20");
+    g_assert_cmpstr (g_ptr_array_index (t->received, 1), ==, "0011000B915121551532F40000A7");
+    g_assert_cmpstr (g_ptr_array_index (t->received, 2), ==, "AT+CLCK=\"SC\",2");
+
+    g_assert_no_error (sms.cmgs.error);
+    command_result_clear (&sms.cmgs);
+    command_result_clear (&sms.pdu);
+    command_result_clear (&other);
+}
+
+static const FakeModemReply coalesce_replies[] = {
+    { "AT+CSQ",  "\r\n+CSQ: 20,99\r\n\r\nOK\r\n" },
+    { "AT+CGSN", "\r\n0123456789\r\n\r\nOK\r\n" },
+    { "AT+CIMI", "\r\nERROR\r\n" },
+    { NULL }
+};
+
+static void
+at_serial_queue_coalesce (PortTest *t,
+                          gconstpointer replies)
+{
+    CommandResult results[3];
+    MMSerialPortQueueStats stats;
+    guint i;
+
+    /* Identical queries queued together are sent once, and each caller gets
+     * the same reply, once */
+    for (i = 0; i < G_N_ELEMENTS (results); i++)
+        port_test_queue (t, "AT+CGSN", &results[i]);
+    port_test_wait (t);
+
+    /* Give any spurious extra callback a chance to run */
+    while (g_main_context_iteration (NULL, FALSE));
+
+    g_assert_cmpuint (fake_modem_count (t, "AT+CGSN"), ==, 1);
+    for (i = 0; i < G_N_ELEMENTS (results); i++) {
+        g_assert_cmpuint (results[i].n_calls, ==, 1);
+        g_assert_no_error (results[i].error);
+        g_assert_cmpstr (results[i].response, ==, "0123456789");
+        command_result_clear (&results[i]);
+    }
+
+    mm_serial_port_get_queue_stats (MM_SERIAL_PORT (t->port), &stats);
+    g_assert_cmpuint (stats.n_commands, ==, 3);
+    g_assert_cmpuint (stats.n_coalesced, ==, 2);
+    /* Only the command actually sent had to wait */
+    g_assert_cmpuint (stats.n_started, ==, 1);
+}
+
+static void
+at_serial_queue_coalesce_error (PortTest *t,
+                                gconstpointer replies)
+{
+    CommandResult results[3];
+    guint i;
+
+    /* Same for errors */
+    for (i = 0; i < G_N_ELEMENTS (results); i++)
+        port_test_queue (t, "AT+CIMI", &results[i]);
+    port_test_wait (t);
+
+    while (g_main_context_iteration (NULL, FALSE));
+
+    g_assert_cmpuint (fake_modem_count (t, "AT+CIMI"), ==, 1);
+    for (i = 0; i < G_N_ELEMENTS (results); i++) {
+        g_assert_cmpuint (results[i].n_calls, ==, 1);
+        g_assert (results[i].error != NULL);
+        command_result_clear (&results[i]);
+    }
+
+    /* Commands changing the device state are never coalesced */
+    for (i = 0; i < 2; i++)
+        port_test_queue (t, "AT+CMEE=1", &results[i]);
+    port_test_wait (t);
+    g_assert_cmpuint (fake_modem_count (t, "AT+CMEE=1"), ==, 2);
+    for (i = 0; i < 2; i++)
+        command_result_clear (&results[i]);
+}
+
+/*****************************************************************************/
+
 void
 _mm_log (const char *loc,
          const char *func,
@@ -80,6 +765,32 @@ int main (int argc, char **argv)
     g_test_init (&argc, &argv, NULL);
 
     g_test_add_func ("/ModemManager/AT-serial/echo-removal", at_serial_echo_removal);
+    g_test_add_func ("/ModemManager/AT-serial/unsolicited-prefix", at_serial_unsolicited_prefix);
+    g_test_add_func ("/ModemManager/AT-serial/final-result", at_serial_final_result);
+
+    g_test_add ("/ModemManager/AT-serial/cache/hit", PortTest, cache_replies,
+                port_test_setup, at_serial_cache_hit, port_test_teardown);
+    g_test_add ("/ModemManager/AT-serial/cache/expiry", PortTest, cache_replies,
+                port_test_setup, at_serial_cache_expiry, port_test_teardown);
+    g_test_add ("/ModemManager/AT-serial/cache/unsolicited", PortTest, cache_replies,
+                port_test_setup, at_serial_cache_unsolicited, port_test_teardown);
+    g_test_add ("/ModemManager/AT-serial/cache/reset", PortTest, cache_replies,
+                port_test_setup, at_serial_cache_reset, port_test_teardown);
+    g_test_add ("/ModemManager/AT-serial/cache/registration", PortTest, cache_replies,
+                port_test_setup, at_serial_cache_registration, port_test_teardown);
+    g_test_add ("/ModemManager/AT-serial/cache/error", PortTest, error_replies,
+                port_test_setup, at_serial_cache_error, port_test_teardown);
+
+    g_test_add ("/ModemManager/AT-serial/queue/priority", PortTest, coalesce_replies,
+                port_test_setup, at_serial_queue_priority, port_test_teardown);
+    g_test_add ("/ModemManager/AT-serial/queue/started-not-displaced", PortTest, coalesce_replies,
+                port_test_setup, at_serial_queue_started_not_displaced, port_test_teardown);
+    g_test_add ("/ModemManager/AT-serial/queue/continuation", PortTest, sms_replies,
+                port_test_setup, at_serial_queue_continuation, port_test_teardown);
+    g_test_add ("/ModemManager/AT-serial/queue/coalesce", PortTest, coalesce_replies,
+                port_test_setup, at_serial_queue_coalesce, port_test_teardown);
+    g_test_add ("/ModemManager/AT-serial/queue/coalesce-error", PortTest, coalesce_replies,
+                port_test_setup, at_serial_queue_coalesce_error, port_test_teardown);
 
     return g_test_run ();
 }
@@ -326,6 +326,104 @@ test_pack_gsm7_7_chars_offset (void *f, gpointer d)
     g_free (packed);
 }
 
+/* Reference implementations, handling one septet at a time */
+
+static void
+reference_unpack (const guint8 *gsm,
+                  guint32 num_septets,
+                  guint8 start_offset,
+                  guint8 *out)
+{
+    guint32 i;
+
+    for (i = 0; i < num_septets; i++) {
+        guint32 start_bit;
+        guint16 octets;
+
+        start_bit = start_offset + (i * 7);
+        octets = gsm[start_bit / 8];
+        if ((start_bit % 8) > 1)
+            octets |= gsm[(start_bit / 8) + 1] << 8;
+        out[i] = (octets >> (start_bit % 8)) & 0x7F;
+    }
+}
+
+static void
+reference_pack (const guint8 *src,
+                guint32 src_len,
+                guint8 start_offset,
+                guint8 *out)
+{
+    guint32 i, bit;
+
+    for (i = 0; i < src_len; i++) {
+        for (bit = 0; bit < 7; bit++) {
+            guint32 pos = start_offset + (i * 7) + bit;
+
+            if (src[i] & (1 << bit))
+                out[pos / 8] |= 1 << (pos % 8);
+        }
+    }
+}
+
+static void
+test_gsm7_fuzz (void *f, gpointer d)
+{
+    GRand *rand;
+    guint n;
+
+    /* Fixed seed, so that failures can be reproduced */
+    rand = g_rand_new_with_seed (0x0700);
+
+    for (n = 0; n < 5000; n++) {
+        guint32 num_septets, len, i;
+        guint8 offset;
+        guint8 *in, *out, *expected;
+
+        num_septets = g_rand_int_range (rand, 0, 400);
+        offset = g_rand_int_range (rand, 0, 8);
+
+        /* Unpacking, exactly sized input so that overreads get caught */
+        len = ((num_septets * 7) + offset + 7) / 8;
+        in = g_malloc (len);
+        for (i = 0; i < len; i++)
+            in[i] = g_rand_int (rand);
+        out = g_malloc (num_septets + 1);
+        expected = g_malloc (num_septets + 1);
+
+        g_assert_cmpuint (gsm_unpack_into (in, num_septets, offset, out), ==, num_septets);
+        reference_unpack (in, num_septets, offset, expected);
+        g_assert_cmpint (memcmp (out, expected, num_septets), ==, 0);
+
+        g_free (in);
+        g_free (out);
+        g_free (expected);
+
+        /* Packing, with the high bit of the input set now and then */
+        in = g_malloc (num_septets + 1);
+        for (i = 0; i < num_septets; i++)
+            in[i] = g_rand_int (rand);
+        len = gsm_packed_len (num_septets, offset);
+        out = g_malloc (len + 1);
+        expected = g_malloc0 (len + 1);
+
+        g_assert_cmpuint (gsm_pack_into (in, num_septets, offset, out), ==, len);
+        reference_pack (in, num_septets, offset, expected);
+        g_assert_cmpint (memcmp (out, expected, len), ==, 0);
+
+        /* And back */
+        reference_unpack (out, num_septets, offset, expected);
+        for (i = 0; i < num_septets; i++)
+            g_assert_cmpuint (expected[i], ==, in[i] & 0x7F);
+
+        g_free (in);
+        g_free (out);
+        g_free (expected);
+    }
+
+    g_rand_free (rand);
+}
+
 static void
 test_take_convert_ucs2_hex_utf8 (void *f, gpointer d)
 {
@@ -338,6 +436,64 @@ test_take_convert_ucs2_hex_utf8 (void *f, gpointer d)
     g_free (converted);
 }
 
+static void
+test_hex_to_utf8_buf (void *f, gpointer d)
+{
+    gchar out[32];
+    GString *hex;
+    gchar *big;
+    guint i;
+
+    g_assert_cmpint (mm_modem_charset_hex_to_utf8_buf ("0054002d004d006f00620069006c0065",
+                                                       MM_MODEM_CHARSET_UCS2,
+                                                       out, sizeof (out)), ==, 8);
+    g_assert_cmpstr (out, ==, "T-Mobile");
+
+    /* Exactly enough room, and one byte less */
+    g_assert_cmpint (mm_modem_charset_hex_to_utf8_buf ("0054002d004d006f00620069006c0065",
+                                                       MM_MODEM_CHARSET_UCS2,
+                                                       out, 9), ==, 8);
+    g_assert_cmpint (mm_modem_charset_hex_to_utf8_buf ("0054002d004d006f00620069006c0065",
+                                                       MM_MODEM_CHARSET_UCS2,
+                                                       out, 8), ==, -1);
+
+    g_assert_cmpint (mm_modem_charset_hex_to_utf8_buf ("4F72616E6765E9",
+                                                       MM_MODEM_CHARSET_8859_1,
+                                                       out, sizeof (out)), ==, 8);
+    g_assert_cmpstr (out, ==, "Orangeé");
+
+    /* Unpacked GSM, with an extended char */
+    g_assert_cmpint (mm_modem_charset_hex_to_utf8_buf ("3130201B65",
+                                                       MM_MODEM_CHARSET_GSM,
+                                                       out, sizeof (out)), ==, 6);
+    g_assert_cmpstr (out, ==, "10 €");
+
+    g_assert_cmpint (mm_modem_charset_hex_to_utf8_buf ("54452D4D4F42494C45",
+                                                       MM_MODEM_CHARSET_IRA,
+                                                       out, sizeof (out)), ==, 9);
+    g_assert_cmpstr (out, ==, "TE-MOBILE");
+
+    /* Invalid hex */
+    g_assert_cmpint (mm_modem_charset_hex_to_utf8_buf ("005",
+                                                       MM_MODEM_CHARSET_UCS2,
+                                                       out, sizeof (out)), ==, -1);
+    g_assert_cmpint (mm_modem_charset_hex_to_utf8_buf ("00G4",
+                                                       MM_MODEM_CHARSET_UCS2,
+                                                       out, sizeof (out)), ==, -1);
+
+    /* Longer than what's converted at once, same as the allocating version */
+    hex = g_string_new (NULL);
+    for (i = 0; i < 200; i++)
+        g_string_append (hex, "20AC");
+    g_string_append (hex, "0041");
+    big = mm_modem_charset_hex_to_utf8 (hex->str, MM_MODEM_CHARSET_UCS2);
+    g_assert (big);
+    g_assert_cmpuint (strlen (big), ==, 601);
+    g_assert (g_str_has_suffix (big, "€A"));
+    g_free (big);
+    g_string_free (hex, TRUE);
+}
+
 static void
 test_take_convert_ucs2_bad_ascii (void *f, gpointer d)
 {
@@ -395,6 +551,10 @@ int main (int argc, char **argv)
 
     g_test_suite_add (suite, TESTCASE (test_pack_gsm7_7_chars_offset, NULL));
 
+    g_test_suite_add (suite, TESTCASE (test_gsm7_fuzz, NULL));
+
+    g_test_suite_add (suite, TESTCASE (test_hex_to_utf8_buf, NULL));
+
     g_test_suite_add (suite, TESTCASE (test_take_convert_ucs2_hex_utf8, NULL));
     g_test_suite_add (suite, TESTCASE (test_take_convert_ucs2_bad_ascii, NULL));
     g_test_suite_add (suite, TESTCASE (test_take_convert_ucs2_bad_ascii2, NULL));
@@ -0,0 +1,376 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+
+#include "mm-plugin-index.h"
+#include "mm-log.h"
+
+/*****************************************************************************/
+/* Fake plugins and ports, with a set of filters similar to the real ones */
+
+typedef struct {
+    const gchar *drivers[4];
+    guint16 vendor_ids[4];
+    mm_uint16_pair product_ids[4];
+    const gchar *udev_tags[2];
+} Plugin;
+
+typedef struct {
+    const gchar *drivers[3];
+    guint16 vendor;
+    guint16 product;
+    const gchar *udev_tags[2];
+} Port;
+
+static const Plugin plugins[] = {
+    { .vendor_ids = { 0x12d1 } },                               /* huawei */
+    { .vendor_ids = { 0x0af0 }, .drivers = { "hso", "option1" } }, /* option-hso */
+    { .vendor_ids = { 0x0af0, 0x1931 } },                       /* option */
+    { .vendor_ids = { 0x1199, 0x03f0 } },                       /* sierra */
+    { .vendor_ids = { 0x19d2 } },                               /* zte */
+    { .vendor_ids = { 0x1410 } },                               /* novatel */
+    { .vendor_ids = { 0x1410 }, .product_ids = { { 0x1410, 0x9010 }, { 0x1410, 0xb001 } } }, /* novatel-lte */
+    { .vendor_ids = { 0x0bdb, 0x0fce, 0x413c } },               /* mbm */
+    { .vendor_ids = { 0x106c } },                               /* pantech */
+    { .vendor_ids = { 0x1bc7 } },                               /* telit */
+    { .vendor_ids = { 0x0421 } },                               /* nokia */
+    { .vendor_ids = { 0x1c9e, 0x1e0e } },                       /* longcheer */
+    { .vendor_ids = { 0x1e2d } },                               /* cinterion */
+    { .vendor_ids = { 0x0421 }, .udev_tags = { "ID_MM_NOKIA_ICERA_TAGGED" } }, /* nokia-icera */
+    { .vendor_ids = { 0x1004 } },                               /* lg */
+    { .vendor_ids = { 0x04e8 } },                               /* samsung */
+    { .vendor_ids = { 0x1bbb } },                               /* alcatel */
+    { .vendor_ids = { 0x0b3c } },                               /* linktop */
+    { .vendor_ids = { 0x16d8 } },                               /* anydata */
+    { .vendor_ids = { 0x0408 } },                               /* via */
+    { .drivers = { "gobi" } },                                  /* gobi */
+    { .drivers = { "wavecom" } },                               /* wavecom */
+    { .udev_tags = { "ID_MM_X22X_TAGGED" } },                   /* x22x */
+    { .udev_tags = { "ID_MM_SIMTECH_TAGGED" } },                /* simtech */
+    { .drivers = { "motorola" } },                              /* motorola */
+    { },                                                        /* iridium, no mandatory filters */
+};
+
+static const guint16 known_vendors[] = {
+    0x12d1, 0x0af0, 0x1199, 0x19d2, 0x1410, 0x0bdb, 0x106c, 0x1bc7, 0x0421,
+    0x1c9e, 0x1e2d, 0x1004, 0x04e8, 0x1bbb, 0x16d8, 0x0408, 0x05c6, 0x2001,
+};
+
+static const gchar *known_drivers[] = {
+    "option1", "qcserial", "cdc_acm", "hso", "sierra", "qmi_wwan", "cdc_ether", "gobi",
+};
+
+static const gchar *known_udev_tags[] = {
+    "ID_MM_X22X_TAGGED", "ID_MM_SIMTECH_TAGGED", "ID_MM_NOKIA_ICERA_TAGGED",
+};
+
+static void
+build_port (GRand *rand,
+            Port *port)
+{
+    memset (port, 0, sizeof (Port));
+    port->drivers[0] = known_drivers[g_rand_int_range (rand, 0, G_N_ELEMENTS (known_drivers))];
+    if (g_rand_boolean (rand))
+        port->drivers[1] = known_drivers[g_rand_int_range (rand, 0, G_N_ELEMENTS (known_drivers))];
+    /* Some ports without IDs at all */
+    if (g_rand_int_range (rand, 0, 10)) {
+        port->vendor = known_vendors[g_rand_int_range (rand, 0, G_N_ELEMENTS (known_vendors))];
+        port->product = g_rand_boolean (rand) ? 0x9010 : (guint16) g_rand_int_range (rand, 1, 0xffff);
+    }
+    if (!g_rand_int_range (rand, 0, 5))
+        port->udev_tags[0] = known_udev_tags[g_rand_int_range (rand, 0, G_N_ELEMENTS (known_udev_tags))];
+}
+
+static gboolean
+port_has_udev_tag (const gchar *udev_tag,
+                   const Port *port)
+{
+    return (port->udev_tags[0] && g_str_equal (port->udev_tags[0], udev_tag));
+}
+
+/* Same logic as the mandatory pre-probing filters in MMPlugin */
+static gboolean
+plugin_filters_port (const Plugin *plugin,
+                     const Port *port)
+{
+    guint i, j;
+
+    if (plugin->drivers[0]) {
+        gboolean found = FALSE;
+
+        for (i = 0; plugin->drivers[i] && !found; i++)
+            for (j = 0; port->drivers[j] && !found; j++)
+                found = g_str_equal (plugin->drivers[i], port->drivers[j]);
+        if (!found)
+            return TRUE;
+    }
+
+    if (plugin->vendor_ids[0]) {
+        for (i = 0; plugin->vendor_ids[i]; i++)
+            if (plugin->vendor_ids[i] == port->vendor)
+                break;
+        if (!port->vendor || !plugin->vendor_ids[i])
+            return TRUE;
+    }
+
+    if (plugin->product_ids[0].l) {
+        for (i = 0; plugin->product_ids[i].l; i++)
+            if (plugin->product_ids[i].l == port->vendor &&
+                plugin->product_ids[i].r == port->product)
+                break;
+        if (!port->vendor || !port->product || !plugin->product_ids[i].l)
+            return TRUE;
+    }
+
+    if (plugin->udev_tags[0]) {
+        for (i = 0; plugin->udev_tags[i]; i++)
+            if (port_has_udev_tag (plugin->udev_tags[i], port))
+                break;
+        if (!plugin->udev_tags[i])
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static MMPluginIndex *
+build_index (void)
+{
+    MMPluginIndex *index;
+    guint i;
+
+    index = mm_plugin_index_new ();
+    for (i = 0; i < G_N_ELEMENTS (plugins); i++)
+        mm_plugin_index_add (index,
+                             i,
+                             plugins[i].drivers[0] ? (const gchar **) plugins[i].drivers : NULL,
+                             plugins[i].vendor_ids[0] ? plugins[i].vendor_ids : NULL,
+                             plugins[i].product_ids[0].l ? plugins[i].product_ids : NULL,
+                             plugins[i].udev_tags[0] ? (const gchar **) plugins[i].udev_tags : NULL);
+    g_assert_cmpuint (mm_plugin_index_get_n_positions (index), ==, G_N_ELEMENTS (plugins));
+    return index;
+}
+
+static void
+lookup_port (MMPluginIndex *index,
+             const Port *port,
+             gboolean *candidates)
+{
+    memset (candidates, 0, G_N_ELEMENTS (plugins) * sizeof (gboolean));
+    mm_plugin_index_lookup (index,
+                            (const gchar **) port->drivers,
+                            port->vendor,
+                            port->product,
+                            (MMPluginIndexHasUdevTagFn)port_has_udev_tag,
+                            (gpointer)port,
+                            candidates);
+}
+
+/*****************************************************************************/
+
+static void
+test_lookup (void *f, gpointer d)
+{
+    MMPluginIndex *index;
+    gboolean candidates[G_N_ELEMENTS (plugins)];
+    Port port;
+
+    index = build_index ();
+
+    /* Huawei device: the huawei plugin and the one without filters */
+    memset (&port, 0, sizeof (port));
+    port.drivers[0] = "option1";
+    port.vendor = 0x12d1;
+    port.product = 0x1506;
+    lookup_port (index, &port, candidates);
+    g_assert (candidates[0]);
+    g_assert (candidates[G_N_ELEMENTS (plugins) - 1]);
+    g_assert (!candidates[1]);
+    g_assert (!candidates[4]);
+    g_assert (!candidates[20]);
+
+    /* Novatel LTE device, indexed by vendor/product pair */
+    port.drivers[0] = "cdc_acm";
+    port.vendor = 0x1410;
+    port.product = 0x9010;
+    lookup_port (index, &port, candidates);
+    g_assert (candidates[5]);
+    g_assert (candidates[6]);
+    port.product = 0x9011;
+    lookup_port (index, &port, candidates);
+    g_assert (candidates[5]);
+    g_assert (!candidates[6]);
+
+    /* Tagged port without IDs */
+    memset (&port, 0, sizeof (port));
+    port.drivers[0] = "cdc_acm";
+    port.udev_tags[0] = "ID_MM_X22X_TAGGED";
+    lookup_port (index, &port, candidates);
+    g_assert (candidates[22]);
+    g_assert (!candidates[23]);
+    g_assert (!candidates[0]);
+
+    /* Driver only */
+    port.drivers[0] = "gobi";
+    port.udev_tags[0] = NULL;
+    lookup_port (index, &port, candidates);
+    g_assert (candidates[20]);
+    g_assert (!candidates[22]);
+
+    mm_plugin_index_free (index);
+}
+
+static void
+test_superset (void *f, gpointer d)
+{
+    MMPluginIndex *index;
+    GRand *rand;
+    guint n;
+
+    index = build_index ();
+    rand = g_rand_new_with_seed (1234);
+
+    /* Every plugin passing the filters must be a candidate */
+    for (n = 0; n < 10000; n++) {
+        gboolean candidates[G_N_ELEMENTS (plugins)];
+        Port port;
+        guint i;
+
+        build_port (rand, &port);
+        lookup_port (index, &port, candidates);
+        for (i = 0; i < G_N_ELEMENTS (plugins); i++) {
+            if (!plugin_filters_port (&plugins[i], &port))
+                g_assert (candidates[i]);
+        }
+    }
+
+    g_rand_free (rand);
+    mm_plugin_index_free (index);
+}
+
+/*****************************************************************************/
+/* Benchmark: a hub with lots of devices plugged in at once
+ *
+ * Every port of every device needs its plugin list built, so compare running
+ * the filters of all plugins with filtering just the indexed candidates.
+ */
+
+#define BENCHMARK_DEVICES          256
+#define BENCHMARK_PORTS_PER_DEVICE 4
+
+static void
+test_benchmark (void *f, gpointer d)
+{
+    MMPluginIndex *index;
+    GRand *rand;
+    Port *ports;
+    guint n_ports = BENCHMARK_DEVICES * BENCHMARK_PORTS_PER_DEVICE;
+    guint linear_supported = 0;
+    guint indexed_supported = 0;
+    guint n_candidates = 0;
+    gdouble linear_elapsed, indexed_elapsed;
+    guint n, i;
+
+    rand = g_rand_new_with_seed (5678);
+    ports = g_new (Port, n_ports);
+    for (n = 0; n < n_ports; n++)
+        build_port (rand, &ports[n]);
+
+    g_test_timer_start ();
+    for (n = 0; n < n_ports; n++) {
+        for (i = 0; i < G_N_ELEMENTS (plugins); i++) {
+            if (!plugin_filters_port (&plugins[i], &ports[n]))
+                linear_supported++;
+        }
+    }
+    linear_elapsed = g_test_timer_elapsed ();
+
+    g_test_timer_start ();
+    index = build_index ();
+    for (n = 0; n < n_ports; n++) {
+        gboolean candidates[G_N_ELEMENTS (plugins)];
+
+        lookup_port (index, &ports[n], candidates);
+        for (i = 0; i < G_N_ELEMENTS (plugins); i++) {
+            if (!candidates[i])
+                continue;
+            n_candidates++;
+            if (!plugin_filters_port (&plugins[i], &ports[n]))
+                indexed_supported++;
+        }
+    }
+    mm_plugin_index_free (index);
+    indexed_elapsed = g_test_timer_elapsed ();
+
+    g_assert_cmpuint (linear_supported, ==, indexed_supported);
+
+    g_test_message ("%u ports, %u plugins", n_ports, (guint) G_N_ELEMENTS (plugins));
+    g_test_message ("linear:  %.3f us per port",
+                    (linear_elapsed * 1e6) / n_ports);
+    g_test_message ("indexed: %.3f us per port (%.1f candidates per port)",
+                    (indexed_elapsed * 1e6) / n_ports,
+                    (gdouble) n_candidates / n_ports);
+    g_test_minimized_result ((indexed_elapsed * 1e6) / n_ports,
+                             "indexed plugin filtering per-port cost: %.3f us",
+                             (indexed_elapsed * 1e6) / n_ports);
+
+    g_free (ports);
+    g_rand_free (rand);
+}
+
+/*****************************************************************************/
+
+void
+_mm_log (const char *loc,
+         const char *func,
+         guint32 level,
+         const char *fmt,
+         ...)
+{
+    /* Dummy log function */
+}
+
+#if GLIB_CHECK_VERSION(2,25,12)
+typedef GTestFixtureFunc TCFunc;
+#else
+typedef void (*TCFunc)(void);
+#endif
+
+#define TESTCASE(t, d) g_test_create_case (#t, 0, d, NULL, (TCFunc) t, NULL)
+
+int main (int argc, char **argv)
+{
+    GTestSuite *suite;
+    gint result;
+
+    g_type_init ();
+    g_test_init (&argc, &argv, NULL);
+
+    suite = g_test_get_root ();
+
+    g_test_suite_add (suite, TESTCASE (test_lookup, NULL));
+    g_test_suite_add (suite, TESTCASE (test_superset, NULL));
+
+    /* Only run with '-m perf' */
+    if (g_test_perf ())
+        g_test_suite_add (suite, TESTCASE (test_benchmark, NULL));
+
+    result = g_test_run ();
+
+    return result;
+}
@@ -0,0 +1,221 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#include <config.h>
+#include <glib.h>
+#include <glib-object.h>
+
+#include "mm-poll-scheduler.h"
+#include "mm-log.h"
+
+/* First time after now which is a multiple of the given period; this is when
+ * tasks with that interval added right now are first due */
+static gint64
+next_period (guint period)
+{
+    gint64 now;
+
+    now = g_get_monotonic_time () / G_USEC_PER_SEC;
+    return ((now / period) + 1) * period;
+}
+
+static void
+count_run (guint *n_runs)
+{
+    (*n_runs)++;
+}
+
+static void
+test_alignment (void *f, gpointer d)
+{
+    MMPollTask *a, *b, *c;
+    guint n_a = 0, n_b = 0, n_c = 0;
+    gint64 base;
+
+    base = next_period (10);
+
+    /* 7s is rounded up to 10s, so B and C always run together, and together
+     * with A every other time */
+    a = mm_poll_scheduler_add ("test-alignment-a", 5, (MMPollTaskFn) count_run, &n_a);
+    b = mm_poll_scheduler_add ("test-alignment-b", 7, (MMPollTaskFn) count_run, &n_b);
+    c = mm_poll_scheduler_add ("test-alignment-c", 10, (MMPollTaskFn) count_run, &n_c);
+
+    mm_poll_scheduler_run_due (base);
+    g_assert_cmpuint (n_a, ==, 1);
+    g_assert_cmpuint (n_b, ==, 1);
+    g_assert_cmpuint (n_c, ==, 1);
+
+    mm_poll_scheduler_run_due (base + 5);
+    g_assert_cmpuint (n_a, ==, 2);
+    g_assert_cmpuint (n_b, ==, 1);
+    g_assert_cmpuint (n_c, ==, 1);
+
+    mm_poll_scheduler_run_due (base + 10);
+    g_assert_cmpuint (n_a, ==, 3);
+    g_assert_cmpuint (n_b, ==, 2);
+    g_assert_cmpuint (n_c, ==, 2);
+
+    mm_poll_scheduler_remove (a);
+    mm_poll_scheduler_remove (b);
+    mm_poll_scheduler_remove (c);
+}
+
+typedef struct {
+    guint n_runs;
+    MMPollTask *remove;
+    MMPollTask *added;
+    guint n_added_runs;
+} MeddlingTask;
+
+/* Removes another task and adds a new one the first time it runs */
+static void
+meddling_task_run (MeddlingTask *ctx)
+{
+    ctx->n_runs++;
+
+    if (ctx->remove) {
+        mm_poll_scheduler_remove (ctx->remove);
+        ctx->remove = NULL;
+    }
+
+    if (!ctx->added)
+        ctx->added = mm_poll_scheduler_add ("test-meddling-added", 5,
+                                            (MMPollTaskFn) count_run,
+                                            &ctx->n_added_runs);
+}
+
+static void
+test_add_remove_during_tick (void *f, gpointer d)
+{
+    MeddlingTask ctx = { 0 };
+    MMPollTask *meddling;
+    guint n_removed = 0;
+    gint64 base;
+
+    base = next_period (5);
+
+    /* Latest added tasks run first in the same tick, so the meddling one runs
+     * before the one it removes. The new task may well reuse the memory of
+     * the removed one, and it must not run until its own period ends. */
+    ctx.remove = mm_poll_scheduler_add ("test-meddling-removed", 5,
+                                        (MMPollTaskFn) count_run, &n_removed);
+    meddling = mm_poll_scheduler_add ("test-meddling", 5,
+                                      (MMPollTaskFn) meddling_task_run, &ctx);
+
+    mm_poll_scheduler_run_due (base);
+    g_assert_cmpuint (ctx.n_runs, ==, 1);
+    g_assert (ctx.remove == NULL);
+    g_assert (ctx.added != NULL);
+    g_assert_cmpuint (n_removed, ==, 0);
+    g_assert_cmpuint (ctx.n_added_runs, ==, 0);
+
+    mm_poll_scheduler_run_due (base + 5);
+    g_assert_cmpuint (ctx.n_runs, ==, 2);
+    g_assert_cmpuint (n_removed, ==, 0);
+    g_assert_cmpuint (ctx.n_added_runs, ==, 1);
+
+    mm_poll_scheduler_remove (ctx.added);
+    mm_poll_scheduler_remove (meddling);
+}
+
+static void
+do_nothing (gpointer unused)
+{
+}
+
+static void
+test_stats (void *f, gpointer d)
+{
+    MMPollTask *task;
+    guint64 n_runs = 0;
+    guint64 n_overlapped = 0;
+    guint64 total_us = 0;
+    guint64 first_total_us;
+    gint64 base;
+
+    g_assert (!mm_poll_scheduler_get_stats ("test-stats", NULL, NULL, NULL));
+
+    base = next_period (5);
+    task = mm_poll_scheduler_add ("test-stats", 5, do_nothing, NULL);
+
+    /* Not accounted until run */
+    g_assert (!mm_poll_scheduler_get_stats ("test-stats", NULL, NULL, NULL));
+
+    mm_poll_scheduler_run_due (base);
+    g_usleep (2000);
+    mm_poll_scheduler_task_done (task);
+    g_assert (mm_poll_scheduler_get_stats ("test-stats", &n_runs, &n_overlapped, &total_us));
+    g_assert_cmpuint (n_runs, ==, 1);
+    g_assert_cmpuint (n_overlapped, ==, 0);
+    g_assert_cmpuint (total_us, >=, 2000);
+
+    /* Being done twice doesn't count twice */
+    first_total_us = total_us;
+    g_usleep (2000);
+    mm_poll_scheduler_task_done (task);
+    g_assert (mm_poll_scheduler_get_stats ("test-stats", NULL, NULL, &total_us));
+    g_assert_cmpuint (total_us, ==, first_total_us);
+
+    /* Runs while the previous one is still going on are overlapped */
+    mm_poll_scheduler_run_due (base + 5);
+    mm_poll_scheduler_run_due (base + 10);
+    g_assert (mm_poll_scheduler_get_stats ("test-stats", &n_runs, &n_overlapped, NULL));
+    g_assert_cmpuint (n_runs, ==, 3);
+    g_assert_cmpuint (n_overlapped, ==, 1);
+
+    /* Removing a task finishes accounting its last run */
+    mm_poll_scheduler_remove (task);
+    g_assert (mm_poll_scheduler_get_stats ("test-stats", &n_runs, NULL, NULL));
+    g_assert_cmpuint (n_runs, ==, 3);
+
+    mm_poll_scheduler_log_stats ();
+}
+
+void
+_mm_log (const char *loc,
+         const char *func,
+         guint32 level,
+         const char *fmt,
+         ...)
+{
+    /* Dummy log function */
+}
+
+#if GLIB_CHECK_VERSION(2,25,12)
+typedef GTestFixtureFunc TCFunc;
+#else
+typedef void (*TCFunc)(void);
+#endif
+
+#define TESTCASE(t, d) g_test_create_case (#t, 0, d, NULL, (TCFunc) t, NULL)
+
+int main (int argc, char **argv)
+{
+    GTestSuite *suite;
+    gint result;
+
+    g_type_init ();
+    g_test_init (&argc, &argv, NULL);
+
+    suite = g_test_get_root ();
+
+    g_test_suite_add (suite, TESTCASE (test_alignment, NULL));
+    g_test_suite_add (suite, TESTCASE (test_add_remove_during_tick, NULL));
+    g_test_suite_add (suite, TESTCASE (test_stats, NULL));
+
+    result = g_test_run ();
+
+    return result;
+}
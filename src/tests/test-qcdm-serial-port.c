@@ -34,6 +34,7 @@
 #include "libqcdm/src/utils.h"
 #include "libqcdm/src/com.h"
 #include "libqcdm/src/errors.h"
+#include "libqcdm/src/dm-commands.h"
 #include "mm-log.h"
 
 typedef struct {
@@ -108,6 +109,22 @@ server_send_response (int fd, const char *buf, gsize len)
     }
 }
 
+/* Sends the whole response at once, so that it is all received in a
+ * single read */
+static void
+server_send_response_all (int fd, const char *buf, gsize len)
+{
+    ssize_t status;
+
+    if (g_test_verbose ())
+        print_buf (">>>", buf, len);
+
+    errno = 0;
+    status = write (fd, buf, len);
+    g_assert_cmpint (errno, ==, 0);
+    g_assert_cmpint (status, ==, len);
+}
+
 static gsize
 server_wait_request (int fd, char *buf, gsize len)
 {
@@ -396,6 +413,288 @@ test_leading_frame_markers (void *f)
     g_assert (wait_for_child (d, 3));
 }
 
+#define LARGE_RESPONSE_LEN 1200
+
+static void
+qcdm_verinfo_expect_large_cb (MMQcdmSerialPort *port,
+                              GByteArray *response,
+                              GError *error,
+                              gpointer user_data)
+{
+    GMainLoop *loop = user_data;
+    guint i;
+
+    g_assert_no_error (error);
+    g_assert_cmpuint (response->len, ==, LARGE_RESPONSE_LEN);
+    for (i = 0; i < response->len; i++)
+        g_assert_cmpuint (response->data[i], ==, (i * 7) & 0xFF);
+    g_main_loop_quit (loop);
+}
+
+/* Test that a response longer than 1K, with plenty of bytes that need
+ * escaping, is received whole.
+ */
+static void
+test_large_frame (void *f)
+{
+    TestData *d = f;
+    char req[512];
+    gsize req_len;
+    pid_t cpid;
+    char frame[LARGE_RESPONSE_LEN + 2];
+    char rsp[(LARGE_RESPONSE_LEN + 2) * 2 + 1];
+    gsize rsp_len;
+    guint i;
+
+    for (i = 0; i < LARGE_RESPONSE_LEN; i++)
+        frame[i] = (i * 7) & 0xFF;
+    rsp_len = dm_encapsulate_buffer (frame, LARGE_RESPONSE_LEN, sizeof (frame), rsp, sizeof (rsp));
+    g_assert (rsp_len > LARGE_RESPONSE_LEN);
+
+    signal (SIGCHLD, SIG_DFL);
+    cpid = fork ();
+    g_assert (cpid >= 0);
+
+    if (cpid == 0) {
+        /* In the child */
+        qcdm_test_child (d->slave, qcdm_verinfo_expect_large_cb);
+        exit (0);
+    }
+    /* Parent */
+    d->child = cpid;
+
+    req_len = server_wait_request (d->master, req, sizeof (req));
+    g_assert (req_len == 1);
+    g_assert_cmpint (req[0], ==, 0x00);
+
+    server_send_response (d->master, rsp, rsp_len);
+
+    /* We expect the child to exit normally */
+    g_assert (wait_for_child (d, 3));
+}
+
+#define TEST_LOG_CODE 0x107A
+
+typedef struct {
+    GMainLoop *loop;
+    gboolean got_response;
+    guint n_logs;
+} LogTestData;
+
+static void
+log_test_maybe_quit (LogTestData *ctx)
+{
+    if (ctx->got_response && ctx->n_logs == 2)
+        g_main_loop_quit (ctx->loop);
+}
+
+static void
+qcdm_log_cb (MMQcdmSerialPort *port,
+             guint16 log_code,
+             guint64 timestamp,
+             const guint8 *payload,
+             gsize payload_len,
+             gpointer user_data)
+{
+    LogTestData *ctx = user_data;
+
+    g_assert_cmpuint (log_code, ==, TEST_LOG_CODE);
+    g_assert_cmpuint (timestamp, ==, 0x0102030405060708ULL + ctx->n_logs);
+    g_assert_cmpuint (payload_len, ==, 3);
+    g_assert_cmpuint (payload[0], ==, 0x7E);
+    g_assert_cmpuint (payload[1], ==, 0x7D);
+    g_assert_cmpuint (payload[2], ==, ctx->n_logs);
+
+    ctx->n_logs++;
+    log_test_maybe_quit (ctx);
+}
+
+static void
+qcdm_log_verinfo_cb (MMQcdmSerialPort *port,
+                     GByteArray *response,
+                     GError *error,
+                     gpointer user_data)
+{
+    LogTestData *ctx = user_data;
+
+    /* Must be the real reply, not one of the log packets */
+    g_assert_no_error (error);
+    g_assert_cmpuint (response->len, ==, 1);
+    g_assert_cmpuint (response->data[0], ==, 0x00);
+
+    ctx->got_response = TRUE;
+    log_test_maybe_quit (ctx);
+}
+
+static gsize
+build_log_packet (guint16 log_code, guint8 n, char *buf, gsize len)
+{
+    char pkt[sizeof (DMCmdLog) + 3 + 2];
+    DMCmdLog *log = (DMCmdLog *) pkt;
+
+    memset (pkt, 0, sizeof (pkt));
+    log->code = DIAG_CMD_LOG;
+    log->len = GUINT16_TO_LE (sizeof (DMCmdLog) - 4 + 3);
+    log->log_code = GUINT16_TO_LE (log_code);
+    log->timestamp = GUINT64_TO_LE (0x0102030405060708ULL + n);
+    log->data[0] = 0x7E;
+    log->data[1] = 0x7D;
+    log->data[2] = n;
+
+    return dm_encapsulate_buffer (pkt, sizeof (DMCmdLog) + 3, sizeof (pkt), buf, len);
+}
+
+static void
+run_log_packets_test (TestData *d, gboolean single_write)
+{
+    char req[512];
+    gsize req_len;
+    pid_t cpid;
+    char rsp[512];
+    gsize rsp_len = 0;
+    char verinfo_rsp[3] = { 0x00 };
+
+    rsp_len += build_log_packet (TEST_LOG_CODE, 0, &rsp[rsp_len], sizeof (rsp) - rsp_len);
+    rsp_len += build_log_packet (0x1068, 0, &rsp[rsp_len], sizeof (rsp) - rsp_len);
+    rsp_len += dm_encapsulate_buffer (verinfo_rsp, 1, sizeof (verinfo_rsp), &rsp[rsp_len], sizeof (rsp) - rsp_len);
+    rsp_len += build_log_packet (TEST_LOG_CODE, 1, &rsp[rsp_len], sizeof (rsp) - rsp_len);
+
+    signal (SIGCHLD, SIG_DFL);
+    cpid = fork ();
+    g_assert (cpid >= 0);
+
+    if (cpid == 0) {
+        MMQcdmSerialPort *port;
+        LogTestData ctx = { NULL, FALSE, 0 };
+        GByteArray *verinfo;
+        gboolean success;
+        GError *error = NULL;
+
+        /* In the child */
+        g_type_init ();
+
+        ctx.loop = g_main_loop_new (NULL, FALSE);
+
+        port = mm_qcdm_serial_port_new_fd (d->slave);
+        g_assert (port);
+        success = mm_serial_port_open (MM_SERIAL_PORT (port), &error);
+        g_assert_no_error (error);
+        g_assert (success);
+
+        mm_qcdm_serial_port_add_log_handler (port, TEST_LOG_CODE, qcdm_log_cb, &ctx, NULL);
+
+        verinfo = g_byte_array_sized_new (50);
+        verinfo->len = qcdm_cmd_version_info_new ((char *) verinfo->data, 50);
+        mm_qcdm_serial_port_queue_command (port, verinfo, 3, NULL, qcdm_log_verinfo_cb, &ctx);
+        g_main_loop_run (ctx.loop);
+
+        mm_serial_port_close (MM_SERIAL_PORT (port));
+        g_object_unref (port);
+        exit (0);
+    }
+    /* Parent */
+    d->child = cpid;
+
+    req_len = server_wait_request (d->master, req, sizeof (req));
+    g_assert (req_len == 1);
+    g_assert_cmpint (req[0], ==, 0x00);
+
+    if (single_write)
+        server_send_response_all (d->master, rsp, rsp_len);
+    else
+        server_send_response (d->master, rsp, rsp_len);
+
+    /* We expect the child to exit normally */
+    g_assert (wait_for_child (d, 3));
+}
+
+/* Test that DIAG log packets arriving before and after a reply are handed to
+ * the subscribed handler, and not mistaken for the reply itself.
+ */
+static void
+test_log_packets (void *f)
+{
+    run_log_packets_test (f, FALSE);
+}
+
+/* Same, but with the log packets and the reply all in the same read, so
+ * that the last log packet is left in the buffer after the reply */
+static void
+test_log_packets_single_read (void *f)
+{
+    run_log_packets_test (f, TRUE);
+}
+
+/* Test that log packets queued behind a bad frame are handed to the handler
+ * when no command is in flight, instead of being flushed with the bad frame.
+ */
+static void
+test_log_packets_after_bad_frame (void *f)
+{
+    TestData *d = f;
+    char req[512];
+    gsize req_len;
+    pid_t cpid;
+    char rsp[512];
+    gsize rsp_len = 0;
+    char bad[5] = { 0x4B, 0x01, 0x02 };
+    char ready[3] = { 0x7F };
+
+    /* Corrupt the frame after building it, so that its CRC is wrong */
+    rsp_len += dm_encapsulate_buffer (bad, 3, sizeof (bad), &rsp[rsp_len], sizeof (rsp) - rsp_len);
+    rsp[0] ^= 0x01;
+    rsp_len += build_log_packet (TEST_LOG_CODE, 0, &rsp[rsp_len], sizeof (rsp) - rsp_len);
+    rsp_len += build_log_packet (TEST_LOG_CODE, 1, &rsp[rsp_len], sizeof (rsp) - rsp_len);
+
+    signal (SIGCHLD, SIG_DFL);
+    cpid = fork ();
+    g_assert (cpid >= 0);
+
+    if (cpid == 0) {
+        MMQcdmSerialPort *port;
+        LogTestData ctx = { NULL, TRUE, 0 };
+        char buf[8];
+        gsize buf_len;
+        gboolean success;
+        GError *error = NULL;
+
+        /* In the child */
+        g_type_init ();
+
+        ctx.loop = g_main_loop_new (NULL, FALSE);
+
+        port = mm_qcdm_serial_port_new_fd (d->slave);
+        g_assert (port);
+        success = mm_serial_port_open (MM_SERIAL_PORT (port), &error);
+        g_assert_no_error (error);
+        g_assert (success);
+
+        mm_qcdm_serial_port_add_log_handler (port, TEST_LOG_CODE, qcdm_log_cb, &ctx, NULL);
+
+        /* Opening the port flushes it, so only let the parent send the data
+         * once the port is open */
+        buf_len = dm_encapsulate_buffer (ready, 1, sizeof (ready), buf, sizeof (buf));
+        g_assert_cmpint (write (d->slave, buf, buf_len), ==, buf_len);
+
+        g_main_loop_run (ctx.loop);
+
+        mm_serial_port_close (MM_SERIAL_PORT (port));
+        g_object_unref (port);
+        exit (0);
+    }
+    /* Parent */
+    d->child = cpid;
+
+    req_len = server_wait_request (d->master, req, sizeof (req));
+    g_assert (req_len == 1);
+    g_assert_cmpint (req[0], ==, 0x7F);
+
+    server_send_response_all (d->master, rsp, rsp_len);
+
+    /* We expect the child to exit normally */
+    g_assert (wait_for_child (d, 3));
+}
+
 static void
 test_pty_create (gpointer user_data)
 {
@@ -472,6 +771,10 @@ int main (int argc, char **argv)
     g_test_suite_add (suite, TESTCASE_PTY (test_sierra_cns_rejected, data));
     g_test_suite_add (suite, TESTCASE_PTY (test_random_data_rejected, data));
     g_test_suite_add (suite, TESTCASE_PTY (test_leading_frame_markers, data));
+    g_test_suite_add (suite, TESTCASE_PTY (test_large_frame, data));
+    g_test_suite_add (suite, TESTCASE_PTY (test_log_packets, data));
+    g_test_suite_add (suite, TESTCASE_PTY (test_log_packets_single_read, data));
+    g_test_suite_add (suite, TESTCASE_PTY (test_log_packets_after_bad_frame, data));
 
     result = g_test_run ();
 
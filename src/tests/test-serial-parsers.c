@@ -0,0 +1,277 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+
+#include <ModemManager.h>
+#include <mm-errors-types.h>
+
+#include "mm-serial-parsers.h"
+#include "mm-log.h"
+
+typedef gboolean (*ParseFn) (gpointer parser,
+                             const gchar *response,
+                             gsize response_len,
+                             gsize *reply_start,
+                             gsize *reply_len,
+                             GError **error);
+
+/*****************************************************************************/
+/* Both parsers must give the same results for well-formed responses */
+
+static const gchar *responses[] = {
+    "",
+    "\r\n",
+    "\r\nOK",
+    "\r\nOK\r\n",
+    "\r\nOK\r\n\r\n",
+    "\r\n+CSQ: 20,99\r\n",
+    "\r\n+CSQ: 20,99\r\n\r\nOK\r\n",
+    "\r\n+CGMI: \"Huawei\"\r\n\r\nOK\r\n",
+    "\r\n+COPS: 0,0,\"OK Telecom\"\r\n\r\nOK\r\n",
+    "\r\nCONNECT\r\n",
+    "\r\nCONNECT 115200\r\n",
+    "\r\nCONNECT 115200\r\n~\x7d\x23\xc0\x21",
+    "\r\nCONNECT",
+    "\r\n> ",
+    "\r\n>",
+    "\r\n+CME ERROR: 10\r\n",
+    "\r\n+CME ERROR: 1",
+    "\r\n+CME ERROR: SIM not inserted\r\n",
+    "\r\n+CMS ERROR: 500\r\n",
+    "\r\n+CMS ERROR: unknown error\r\n",
+    "\r\nMODEM ERROR: 3\r\n",
+    "\r\nERROR\r\n",
+    "\r\n+CSQ: 20,99\r\n\r\nERROR\r\n",
+    "\r\nCOMMAND NOT SUPPORT\r\n",
+    "\r\nNO CARRIER\r\n",
+    "\r\nBUSY\r\n",
+    "\r\nNO ANSWER\r\n",
+    "\r\nNO DIALTONE\r\n",
+    "\r\n+CSQ: 20,99\r\n\r\nBUSY\r\n",
+    "\r\n+CREG: 1,\"0A1B\",\"00CF3C29\"\r\n",
+};
+
+static void
+check_result (gpointer parser,
+              ParseFn parse_fn,
+              const gchar *response,
+              gboolean *found,
+              gchar **parsed,
+              GError **error)
+{
+    gsize reply_start = 0;
+    gsize reply_len = 0;
+
+    *found = parse_fn (parser, response, strlen (response),
+                       &reply_start, &reply_len,
+                       error);
+    *parsed = *found ? g_strndup (response + reply_start, reply_len) : NULL;
+}
+
+static void
+test_equivalence (void *f, gpointer d)
+{
+    gpointer parser;
+    guint i;
+
+    parser = mm_serial_parser_v1_new ();
+
+    for (i = 0; i < G_N_ELEMENTS (responses); i++) {
+        gboolean found, regex_found;
+        gchar *parsed, *regex_parsed;
+        GError *error = NULL, *regex_error = NULL;
+
+        check_result (parser, mm_serial_parser_v1_parse, responses[i],
+                      &found, &parsed, &error);
+        check_result (parser, mm_serial_parser_v1_parse_regex, responses[i],
+                      &regex_found, &regex_parsed, &regex_error);
+
+        g_assert_cmpint (found, ==, regex_found);
+        g_assert_cmpstr (parsed, ==, regex_parsed);
+        g_assert ((error != NULL) == (regex_error != NULL));
+        if (error) {
+            g_assert_cmpuint (error->domain, ==, regex_error->domain);
+            g_assert_cmpint (error->code, ==, regex_error->code);
+        }
+
+        g_clear_error (&error);
+        g_clear_error (&regex_error);
+        g_free (parsed);
+        g_free (regex_parsed);
+    }
+
+    mm_serial_parser_v1_destroy (parser);
+}
+
+static const struct {
+    const gchar *response;
+    MMConnectionError code;
+} connection_errors[] = {
+    { "\r\nNO CARRIER\r\n",  MM_CONNECTION_ERROR_NO_CARRIER },
+    { "\r\nBUSY\r\n",        MM_CONNECTION_ERROR_BUSY },
+    { "\r\nNO ANSWER\r\n",   MM_CONNECTION_ERROR_NO_ANSWER },
+    { "\r\nNO DIALTONE\r\n", MM_CONNECTION_ERROR_NO_DIALTONE },
+};
+
+static void
+test_connection_errors (void *f, gpointer d)
+{
+    static const ParseFn parse_fns[] = {
+        mm_serial_parser_v1_parse,
+        mm_serial_parser_v1_parse_regex,
+    };
+    gpointer parser;
+    guint i, j;
+
+    parser = mm_serial_parser_v1_new ();
+
+    for (i = 0; i < G_N_ELEMENTS (parse_fns); i++) {
+        for (j = 0; j < G_N_ELEMENTS (connection_errors); j++) {
+            gboolean found;
+            gchar *parsed;
+            GError *error = NULL;
+
+            check_result (parser, parse_fns[i], connection_errors[j].response,
+                          &found, &parsed, &error);
+            g_assert (found);
+            g_assert_error (error, MM_CONNECTION_ERROR, connection_errors[j].code);
+            g_clear_error (&error);
+            g_free (parsed);
+        }
+    }
+
+    mm_serial_parser_v1_destroy (parser);
+}
+
+/*****************************************************************************/
+/* Benchmark: per-read parsing cost
+ *
+ * A response is parsed each time a new chunk of data is read from the port,
+ * so replay every response in small chunks, like a modem sending a few bytes
+ * per USB packet would, and parse the accumulated buffer after each one.
+ */
+
+#define BENCHMARK_ITERATIONS 2000
+#define BENCHMARK_CHUNK_SIZE 8
+
+static gdouble
+benchmark_parser (ParseFn parse_fn,
+                  guint *n_reads)
+{
+    gpointer parser;
+    GString *response;
+    guint iteration;
+    guint i;
+
+    parser = mm_serial_parser_v1_new ();
+    response = g_string_sized_new (256);
+    *n_reads = 0;
+
+    g_test_timer_start ();
+
+    for (iteration = 0; iteration < BENCHMARK_ITERATIONS; iteration++) {
+        for (i = 0; i < G_N_ELEMENTS (responses); i++) {
+            const gchar *p = responses[i];
+            gsize left = strlen (responses[i]);
+
+            g_string_truncate (response, 0);
+            while (left > 0) {
+                GError *error = NULL;
+                gsize chunk = MIN (left, BENCHMARK_CHUNK_SIZE);
+                gsize reply_start, reply_len;
+
+                g_string_append_len (response, p, chunk);
+                p += chunk;
+                left -= chunk;
+                (*n_reads)++;
+
+                if (parse_fn (parser, response->str, response->len,
+                              &reply_start, &reply_len,
+                              &error)) {
+                    g_clear_error (&error);
+                    g_string_truncate (response, 0);
+                }
+            }
+        }
+    }
+
+    g_string_free (response, TRUE);
+    mm_serial_parser_v1_destroy (parser);
+
+    return g_test_timer_elapsed ();
+}
+
+static void
+test_benchmark (void *f, gpointer d)
+{
+    gdouble regex_elapsed, scanner_elapsed;
+    guint n_reads;
+
+    regex_elapsed = benchmark_parser (mm_serial_parser_v1_parse_regex, &n_reads);
+    scanner_elapsed = benchmark_parser (mm_serial_parser_v1_parse, &n_reads);
+
+    g_test_message ("regex parser:   %.3f us per read (%u reads)",
+                    (regex_elapsed * 1e6) / n_reads, n_reads);
+    g_test_message ("scanner parser: %.3f us per read (%u reads)",
+                    (scanner_elapsed * 1e6) / n_reads, n_reads);
+    g_test_minimized_result ((scanner_elapsed * 1e6) / n_reads,
+                             "scanner parser per-read cost: %.3f us",
+                             (scanner_elapsed * 1e6) / n_reads);
+}
+
+/*****************************************************************************/
+
+void
+_mm_log (const char *loc,
+         const char *func,
+         guint32 level,
+         const char *fmt,
+         ...)
+{
+    /* Dummy log function */
+}
+
+#if GLIB_CHECK_VERSION(2,25,12)
+typedef GTestFixtureFunc TCFunc;
+#else
+typedef void (*TCFunc)(void);
+#endif
+
+#define TESTCASE(t, d) g_test_create_case (#t, 0, d, NULL, (TCFunc) t, NULL)
+
+int main (int argc, char **argv)
+{
+    GTestSuite *suite;
+    gint result;
+
+    g_type_init ();
+    g_test_init (&argc, &argv, NULL);
+
+    suite = g_test_get_root ();
+
+    g_test_suite_add (suite, TESTCASE (test_equivalence, NULL));
+    g_test_suite_add (suite, TESTCASE (test_connection_errors, NULL));
+
+    /* Only run with '-m perf' */
+    if (g_test_perf ())
+        g_test_suite_add (suite, TESTCASE (test_benchmark, NULL));
+
+    result = g_test_run ();
+
+    return result;
+}
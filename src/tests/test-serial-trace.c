@@ -0,0 +1,235 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+
+#include <ModemManager.h>
+#include <mm-errors-types.h>
+
+#include "mm-serial-trace.h"
+#include "mm-log.h"
+
+typedef struct {
+    guint16 port;
+    MMSerialTraceRecordType type;
+    gchar *data;
+} Record;
+
+static void
+collect_record (guint64 timestamp,
+                guint16 port,
+                MMSerialTraceRecordType type,
+                const guint8 *data,
+                gsize len,
+                GArray *records)
+{
+    Record record;
+
+    record.port = port;
+    record.type = type;
+    record.data = g_strndup ((const gchar *) data, len);
+    g_array_append_val (records, record);
+}
+
+static GArray *
+dump_and_parse (void)
+{
+    GByteArray *trace;
+    GArray *records;
+    GError *error = NULL;
+
+    records = g_array_new (FALSE, FALSE, sizeof (Record));
+    trace = mm_serial_trace_dump ();
+    g_assert (mm_serial_trace_parse (trace->data, trace->len,
+                                     (MMSerialTraceRecordFn) collect_record, records,
+                                     &error));
+    g_assert_no_error (error);
+    g_byte_array_unref (trace);
+    return records;
+}
+
+static void
+free_records (GArray *records)
+{
+    guint i;
+
+    for (i = 0; i < records->len; i++)
+        g_free (g_array_index (records, Record, i).data);
+    g_array_free (records, TRUE);
+}
+
+static void
+test_record (void *f, gpointer d)
+{
+    GArray *records;
+    guint16 acm0, acm1;
+    Record *r;
+
+    mm_serial_trace_setup (4096);
+
+    acm0 = mm_serial_trace_register_port ("ttyACM0");
+    acm1 = mm_serial_trace_register_port ("ttyACM1");
+    g_assert_cmpuint (acm0, !=, 0);
+    g_assert_cmpuint (acm1, !=, 0);
+    g_assert_cmpuint (acm0, !=, acm1);
+    g_assert_cmpuint (mm_serial_trace_register_port ("ttyACM0"), ==, acm0);
+
+    mm_serial_trace_record (acm0, MM_SERIAL_TRACE_RECORD_TX, (const guint8 *) "AT+CSQ\r", 7);
+    mm_serial_trace_record (acm1, MM_SERIAL_TRACE_RECORD_RX, (const guint8 *) "\r\nRING\r\n", 8);
+    mm_serial_trace_record (acm0, MM_SERIAL_TRACE_RECORD_RX, (const guint8 *) "\r\n+CSQ: 20,99\r\n\r\nOK\r\n", 21);
+
+    records = dump_and_parse ();
+    g_assert_cmpuint (records->len, ==, 5);
+
+    /* Port names come first */
+    r = &g_array_index (records, Record, 0);
+    g_assert_cmpuint (r->type, ==, MM_SERIAL_TRACE_RECORD_PORT);
+    g_assert_cmpuint (r->port, ==, acm0);
+    g_assert_cmpstr (r->data, ==, "ttyACM0");
+    r = &g_array_index (records, Record, 1);
+    g_assert_cmpuint (r->type, ==, MM_SERIAL_TRACE_RECORD_PORT);
+    g_assert_cmpuint (r->port, ==, acm1);
+    g_assert_cmpstr (r->data, ==, "ttyACM1");
+
+    r = &g_array_index (records, Record, 2);
+    g_assert_cmpuint (r->type, ==, MM_SERIAL_TRACE_RECORD_TX);
+    g_assert_cmpuint (r->port, ==, acm0);
+    g_assert_cmpstr (r->data, ==, "AT+CSQ\r");
+    r = &g_array_index (records, Record, 3);
+    g_assert_cmpuint (r->type, ==, MM_SERIAL_TRACE_RECORD_RX);
+    g_assert_cmpuint (r->port, ==, acm1);
+    g_assert_cmpstr (r->data, ==, "\r\nRING\r\n");
+    r = &g_array_index (records, Record, 4);
+    g_assert_cmpuint (r->type, ==, MM_SERIAL_TRACE_RECORD_RX);
+    g_assert_cmpuint (r->port, ==, acm0);
+    g_assert_cmpstr (r->data, ==, "\r\n+CSQ: 20,99\r\n\r\nOK\r\n");
+
+    free_records (records);
+    mm_serial_trace_shutdown ();
+}
+
+static void
+test_wrap (void *f, gpointer d)
+{
+    GArray *records;
+    guint16 port;
+    guint i;
+
+    mm_serial_trace_setup (1024);
+    port = mm_serial_trace_register_port ("ttyUSB0");
+
+    /* Odd sized records, so that they end up split at the end of the ring */
+    for (i = 0; i < 500; i++) {
+        gchar *str;
+
+        str = g_strdup_printf ("\r\n+CREG: %u\r\n", i);
+        mm_serial_trace_record (port, MM_SERIAL_TRACE_RECORD_RX, (const guint8 *) str, strlen (str));
+        g_free (str);
+    }
+
+    /* The oldest records are gone, the rest are there in order */
+    records = dump_and_parse ();
+    g_assert_cmpuint (records->len, >, 10);
+    g_assert_cmpuint (records->len, <, 500);
+    for (i = 1; i < records->len; i++) {
+        gchar *expected;
+
+        expected = g_strdup_printf ("\r\n+CREG: %u\r\n", 500 - records->len + i);
+        g_assert_cmpstr (g_array_index (records, Record, i).data, ==, expected);
+        g_free (expected);
+    }
+
+    free_records (records);
+    mm_serial_trace_shutdown ();
+}
+
+static void
+test_disabled (void *f, gpointer d)
+{
+    GArray *records;
+
+    mm_serial_trace_setup (0);
+    g_assert_cmpuint (mm_serial_trace_register_port ("ttyACM0"), ==, 0);
+    mm_serial_trace_record (0, MM_SERIAL_TRACE_RECORD_TX, (const guint8 *) "AT\r", 3);
+
+    records = dump_and_parse ();
+    g_assert_cmpuint (records->len, ==, 0);
+    free_records (records);
+}
+
+static void
+test_truncated (void *f, gpointer d)
+{
+    GByteArray *trace;
+    GError *error = NULL;
+
+    mm_serial_trace_setup (4096);
+    mm_serial_trace_record (mm_serial_trace_register_port ("ttyACM0"),
+                            MM_SERIAL_TRACE_RECORD_TX, (const guint8 *) "AT\r", 3);
+    trace = mm_serial_trace_dump ();
+    mm_serial_trace_shutdown ();
+
+    g_assert (!mm_serial_trace_parse (trace->data, trace->len - 1, NULL, NULL, &error));
+    g_assert_error (error, MM_CORE_ERROR, MM_CORE_ERROR_INVALID_ARGS);
+    g_clear_error (&error);
+
+    g_assert (!mm_serial_trace_parse ((const guint8 *) "NOTATRACE", 9, NULL, NULL, &error));
+    g_assert_error (error, MM_CORE_ERROR, MM_CORE_ERROR_INVALID_ARGS);
+    g_clear_error (&error);
+
+    g_byte_array_unref (trace);
+}
+
+/*****************************************************************************/
+
+void
+_mm_log (const char *loc,
+         const char *func,
+         guint32 level,
+         const char *fmt,
+         ...)
+{
+    /* Dummy log function */
+}
+
+#if GLIB_CHECK_VERSION(2,25,12)
+typedef GTestFixtureFunc TCFunc;
+#else
+typedef void (*TCFunc)(void);
+#endif
+
+#define TESTCASE(t, d) g_test_create_case (#t, 0, d, NULL, (TCFunc) t, NULL)
+
+int main (int argc, char **argv)
+{
+    GTestSuite *suite;
+    gint result;
+
+    g_type_init ();
+    g_test_init (&argc, &argv, NULL);
+
+    suite = g_test_get_root ();
+
+    g_test_suite_add (suite, TESTCASE (test_record, NULL));
+    g_test_suite_add (suite, TESTCASE (test_wrap, NULL));
+    g_test_suite_add (suite, TESTCASE (test_disabled, NULL));
+    g_test_suite_add (suite, TESTCASE (test_truncated, NULL));
+
+    result = g_test_run ();
+
+    return result;
+}
@@ -0,0 +1,194 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#include <config.h>
+#include <glib.h>
+
+#include "mm-sms-part-index.h"
+#include "mm-log.h"
+
+/* Owners are just fake pointers */
+#define OWNER(i) GUINT_TO_POINTER ((guint) (i) + 1)
+
+/*****************************************************************************/
+
+static void
+test_stored (void)
+{
+    MMSmsPartIndex *index;
+
+    index = mm_sms_part_index_new ();
+
+    mm_sms_part_index_add_stored (index, MM_SMS_STORAGE_SM, 0, OWNER (0));
+    mm_sms_part_index_add_stored (index, MM_SMS_STORAGE_SM, 1, OWNER (1));
+    mm_sms_part_index_add_stored (index, MM_SMS_STORAGE_ME, 0, OWNER (2));
+
+    g_assert (mm_sms_part_index_lookup_stored (index, MM_SMS_STORAGE_SM, 0) == OWNER (0));
+    g_assert (mm_sms_part_index_lookup_stored (index, MM_SMS_STORAGE_SM, 1) == OWNER (1));
+    g_assert (mm_sms_part_index_lookup_stored (index, MM_SMS_STORAGE_ME, 0) == OWNER (2));
+    g_assert (mm_sms_part_index_lookup_stored (index, MM_SMS_STORAGE_ME, 1) == NULL);
+    g_assert (mm_sms_part_index_lookup_stored (index, MM_SMS_STORAGE_MT, 0) == NULL);
+
+    mm_sms_part_index_remove_owner (index, OWNER (0));
+    g_assert (mm_sms_part_index_lookup_stored (index, MM_SMS_STORAGE_SM, 0) == NULL);
+    g_assert (mm_sms_part_index_lookup_stored (index, MM_SMS_STORAGE_SM, 1) == OWNER (1));
+    g_assert_cmpuint (mm_sms_part_index_get_n_stored (index), ==, 2);
+
+    /* Removing unknown owners is fine */
+    mm_sms_part_index_remove_owner (index, OWNER (0));
+    mm_sms_part_index_remove_owner (index, OWNER (100));
+    g_assert_cmpuint (mm_sms_part_index_get_n_stored (index), ==, 2);
+
+    mm_sms_part_index_free (index);
+}
+
+static void
+test_multipart (void)
+{
+    MMSmsPartIndex *index;
+
+    index = mm_sms_part_index_new ();
+
+    mm_sms_part_index_add_multipart (index, 10, "+34600000001", OWNER (0));
+    mm_sms_part_index_add_multipart (index, 10, "+34600000002", OWNER (1));
+    mm_sms_part_index_add_multipart (index, 11, NULL, OWNER (2));
+
+    /* Same reference, different senders */
+    g_assert (mm_sms_part_index_lookup_multipart (index, 10, "+34600000001") == OWNER (0));
+    g_assert (mm_sms_part_index_lookup_multipart (index, 10, "+34600000002") == OWNER (1));
+    g_assert (mm_sms_part_index_lookup_multipart (index, 10, "+34600000003") == NULL);
+    g_assert (mm_sms_part_index_lookup_multipart (index, 11, NULL) == OWNER (2));
+    g_assert (mm_sms_part_index_lookup_multipart (index, 12, NULL) == NULL);
+
+    /* Completed message, the reference may be reused */
+    mm_sms_part_index_remove_multipart (index, 10, "+34600000001");
+    g_assert (mm_sms_part_index_lookup_multipart (index, 10, "+34600000001") == NULL);
+    mm_sms_part_index_add_multipart (index, 10, "+34600000001", OWNER (3));
+    g_assert (mm_sms_part_index_lookup_multipart (index, 10, "+34600000001") == OWNER (3));
+
+    /* The old owner going away doesn't affect the new one */
+    mm_sms_part_index_remove_owner (index, OWNER (0));
+    g_assert (mm_sms_part_index_lookup_multipart (index, 10, "+34600000001") == OWNER (3));
+
+    mm_sms_part_index_remove_owner (index, OWNER (1));
+    g_assert (mm_sms_part_index_lookup_multipart (index, 10, "+34600000002") == NULL);
+
+    mm_sms_part_index_free (index);
+}
+
+/*****************************************************************************/
+
+#define STRESS_N_PARTS      10000
+#define STRESS_PARTS_PER_SMS    4
+
+static void
+test_stress (void)
+{
+    MMSmsPartIndex *index;
+    gchar number[32];
+    gdouble elapsed;
+    guint i;
+
+    index = mm_sms_part_index_new ();
+
+    /* Load all parts, as done when listing a full storage of multipart
+     * messages from different senders */
+    g_test_timer_start ();
+    for (i = 0; i < STRESS_N_PARTS; i++) {
+        guint sms = i / STRESS_PARTS_PER_SMS;
+        guint reference = sms % 256;
+
+        g_snprintf (number, sizeof (number), "+3460%07u", sms / 256);
+
+        /* New parts are checked before being taken */
+        g_assert (mm_sms_part_index_lookup_stored (index, MM_SMS_STORAGE_ME, i) == NULL);
+
+        if (i % STRESS_PARTS_PER_SMS == 0) {
+            g_assert (mm_sms_part_index_lookup_multipart (index, reference, number) == NULL);
+            mm_sms_part_index_add_multipart (index, reference, number, OWNER (sms));
+        } else
+            g_assert (mm_sms_part_index_lookup_multipart (index, reference, number) == OWNER (sms));
+
+        mm_sms_part_index_add_stored (index, MM_SMS_STORAGE_ME, i, OWNER (sms));
+
+        if (i % STRESS_PARTS_PER_SMS == STRESS_PARTS_PER_SMS - 1)
+            mm_sms_part_index_remove_multipart (index, reference, number);
+    }
+    elapsed = g_test_timer_elapsed ();
+
+    g_assert_cmpuint (mm_sms_part_index_get_n_stored (index), ==, STRESS_N_PARTS);
+    g_test_minimized_result (elapsed,
+                             "loaded %u SMS parts in %.3f ms",
+                             STRESS_N_PARTS,
+                             elapsed * 1000);
+
+    /* A full reload finds all parts */
+    for (i = 0; i < STRESS_N_PARTS; i++)
+        g_assert (mm_sms_part_index_lookup_stored (index, MM_SMS_STORAGE_ME, i) ==
+                  OWNER (i / STRESS_PARTS_PER_SMS));
+
+    /* Delete every other message */
+    for (i = 0; i < STRESS_N_PARTS / STRESS_PARTS_PER_SMS; i += 2)
+        mm_sms_part_index_remove_owner (index, OWNER (i));
+    g_assert_cmpuint (mm_sms_part_index_get_n_stored (index), ==, STRESS_N_PARTS / 2);
+
+    for (i = 0; i < STRESS_N_PARTS; i++) {
+        guint sms = i / STRESS_PARTS_PER_SMS;
+
+        g_assert (mm_sms_part_index_lookup_stored (index, MM_SMS_STORAGE_ME, i) ==
+                  ((sms % 2) ? OWNER (sms) : NULL));
+    }
+
+    mm_sms_part_index_free (index);
+}
+
+/*****************************************************************************/
+
+void
+_mm_log (const char *loc,
+         const char *func,
+         guint32 level,
+         const char *fmt,
+         ...)
+{
+    /* Dummy log function */
+}
+
+#if GLIB_CHECK_VERSION(2,25,12)
+typedef GTestFixtureFunc TCFunc;
+#else
+typedef void (*TCFunc)(void);
+#endif
+
+#define TESTCASE(t, d) g_test_create_case (#t, 0, d, NULL, (TCFunc) t, NULL)
+
+int main (int argc, char **argv)
+{
+    GTestSuite *suite;
+    gint result;
+
+    g_type_init ();
+    g_test_init (&argc, &argv, NULL);
+
+    suite = g_test_get_root ();
+
+    g_test_suite_add (suite, TESTCASE (test_stored, NULL));
+    g_test_suite_add (suite, TESTCASE (test_multipart, NULL));
+    g_test_suite_add (suite, TESTCASE (test_stress, NULL));
+
+    result = g_test_run ();
+
+    return result;
+}
@@ -0,0 +1,246 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2012 Google, Inc.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <glib-object.h>
+
+#include "mm-uevent-queue.h"
+#include "mm-log.h"
+
+#define PORT_A   "/sys/devices/pci0000:00/usb1/1-1/1-1:1.0/ttyUSB0"
+#define PORT_B   "/sys/devices/pci0000:00/usb1/1-1/1-1:1.1/ttyUSB1"
+#define PARENT_X "/sys/devices/pci0000:00/usb1/1-1"
+
+/* Fake udev devices, just tagged with their path and a generation number so
+ * that the most up to date one can be told apart */
+static GObject *
+fake_device_new (const gchar *path,
+                 guint generation)
+{
+    GObject *device;
+
+    device = g_object_new (G_TYPE_OBJECT, NULL);
+    g_object_set_data_full (device, "path", g_strdup (path), g_free);
+    g_object_set_data (device, "generation", GUINT_TO_POINTER (generation));
+    return device;
+}
+
+static void
+queue_add (MMUeventQueue *queue,
+           const gchar *path,
+           guint generation)
+{
+    GObject *device;
+
+    device = fake_device_new (path, generation);
+    mm_uevent_queue_add (queue, path, device);
+    g_object_unref (device);
+}
+
+static void
+queue_remove (MMUeventQueue *queue,
+              const gchar *path)
+{
+    GObject *device;
+
+    device = fake_device_new (path, 0);
+    mm_uevent_queue_remove (queue, path, device);
+    g_object_unref (device);
+}
+
+static void
+record_event (GObject *device,
+              gboolean added,
+              GString *processed)
+{
+    guint generation;
+
+    generation = GPOINTER_TO_UINT (g_object_get_data (device, "generation"));
+    if (processed->len)
+        g_string_append_c (processed, ' ');
+    g_string_append_printf (processed, "%s:%s",
+                            added ? "add" : "remove",
+                            (const gchar *) g_object_get_data (device, "path"));
+    if (generation)
+        g_string_append_printf (processed, "#%u", generation);
+}
+
+static void
+check_flush (MMUeventQueue *queue,
+             const gchar *expected,
+             guint expected_cancelled)
+{
+    GString *processed;
+    guint n_cancelled;
+
+    processed = g_string_new (NULL);
+    mm_uevent_queue_flush (queue, (MMUeventQueueFn)record_event, processed, &n_cancelled);
+    g_assert_cmpstr (processed->str, ==, expected);
+    g_assert_cmpuint (n_cancelled, ==, expected_cancelled);
+    g_string_free (processed);
+}
+
+static void
+test_merge_adds (void *f, gpointer d)
+{
+    MMUeventQueue *queue;
+
+    /* Interleaved add and change events of two ports become one each, with
+     * the latest properties */
+    queue = mm_uevent_queue_new ();
+    queue_add (queue, PORT_A, 1);
+    queue_add (queue, PORT_B, 1);
+    queue_add (queue, PORT_A, 2);
+    queue_add (queue, PORT_B, 2);
+    check_flush (queue,
+                 "add:" PORT_A "#2 add:" PORT_B "#2",
+                 0);
+
+    /* Nothing left */
+    check_flush (queue, "", 0);
+    mm_uevent_queue_free (queue);
+}
+
+static void
+test_cancel (void *f, gpointer d)
+{
+    MMUeventQueue *queue;
+
+    queue = mm_uevent_queue_new ();
+
+    /* A port added and removed right away is never looked at; the remove is
+     * kept in case the port was known from an earlier batch */
+    queue_add (queue, PORT_A, 1);
+    queue_remove (queue, PORT_A);
+    check_flush (queue, "remove:" PORT_A, 1);
+
+    /* And removed only once */
+    queue_add (queue, PORT_A, 1);
+    queue_remove (queue, PORT_A);
+    queue_remove (queue, PORT_A);
+    check_flush (queue, "remove:" PORT_A, 1);
+
+    mm_uevent_queue_free (queue);
+}
+
+static void
+test_remove_parent (void *f, gpointer d)
+{
+    MMUeventQueue *queue;
+
+    /* A port added and then its parent removed within the same batch: the
+     * remove must come after the add, so that the device created for the
+     * port is gone once the batch is processed */
+    queue = mm_uevent_queue_new ();
+    queue_add (queue, PORT_A, 1);
+    queue_add (queue, PORT_B, 1);
+    queue_remove (queue, PARENT_X);
+    check_flush (queue,
+                 "add:" PORT_A "#1 add:" PORT_B "#1 remove:" PARENT_X,
+                 0);
+
+    mm_uevent_queue_free (queue);
+}
+
+static void
+test_replug (void *f, gpointer d)
+{
+    MMUeventQueue *queue;
+
+    /* Port removed, then its parent, and then the port added back: the new
+     * port must be added after the old parent is gone */
+    queue = mm_uevent_queue_new ();
+    queue_remove (queue, PORT_A);
+    queue_remove (queue, PARENT_X);
+    queue_add (queue, PORT_A, 1);
+    check_flush (queue,
+                 "remove:" PORT_A " remove:" PARENT_X " add:" PORT_A "#1",
+                 0);
+
+    /* Same if the port had a change event before being unplugged; that one
+     * can't be merged with the add after the remove */
+    queue_add (queue, PORT_B, 1);
+    queue_remove (queue, PARENT_X);
+    queue_add (queue, PORT_B, 2);
+    check_flush (queue,
+                 "add:" PORT_B "#1 remove:" PARENT_X " add:" PORT_B "#2",
+                 0);
+
+    mm_uevent_queue_free (queue);
+}
+
+static void
+requeue_event (GObject *device,
+               gboolean added,
+               MMUeventQueue *queue)
+{
+    queue_add (queue, PORT_B, 1);
+}
+
+static void
+test_queue_while_flushing (void *f, gpointer d)
+{
+    MMUeventQueue *queue;
+    guint n_processed;
+
+    /* Events queued while processing wait for the next flush */
+    queue = mm_uevent_queue_new ();
+    queue_add (queue, PORT_A, 1);
+    n_processed = mm_uevent_queue_flush (queue, (MMUeventQueueFn)requeue_event, queue, NULL);
+    g_assert_cmpuint (n_processed, ==, 1);
+    check_flush (queue, "add:" PORT_B "#1", 0);
+    mm_uevent_queue_free (queue);
+}
+
+void
+_mm_log (const char *loc,
+         const char *func,
+         guint32 level,
+         const char *fmt,
+         ...)
+{
+    /* Dummy log function */
+}
+
+#if GLIB_CHECK_VERSION(2,25,12)
+typedef GTestFixtureFunc TCFunc;
+#else
+typedef void (*TCFunc)(void);
+#endif
+
+#define TESTCASE(t, d) g_test_create_case (#t, 0, d, NULL, (TCFunc) t, NULL)
+
+int main (int argc, char **argv)
+{
+    GTestSuite *suite;
+    gint result;
+
+    g_type_init ();
+    g_test_init (&argc, &argv, NULL);
+
+    suite = g_test_get_root ();
+
+    g_test_suite_add (suite, TESTCASE (test_merge_adds, NULL));
+    g_test_suite_add (suite, TESTCASE (test_cancel, NULL));
+    g_test_suite_add (suite, TESTCASE (test_remove_parent, NULL));
+    g_test_suite_add (suite, TESTCASE (test_replug, NULL));
+    g_test_suite_add (suite, TESTCASE (test_queue_while_flushing, NULL));
+
+    result = g_test_run ();
+
+    return result;
+}